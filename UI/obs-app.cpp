@@ -72,6 +72,7 @@ bool portable_mode = false;
 static bool multi = false;
 static bool log_verbose = false;
 static bool unfiltered_log = false;
+static bool opt_profiler_trace = false;
 bool opt_start_streaming = false;
 bool opt_start_recording = false;
 bool opt_studio_mode = false;
@@ -1855,26 +1856,42 @@ ProfilerSnapshot GetSnapshot()
 	return ProfilerSnapshot{profile_snapshot_create(), SnapshotRelease};
 }
 
-static void SaveProfilerData(const ProfilerSnapshot &snap)
+static BPtr<char> GetProfilerDataPath(const char *extension)
 {
 	if (currentLogFile.empty())
-		return;
+		return nullptr;
 
 	auto pos = currentLogFile.rfind('.');
 	if (pos == currentLogFile.npos)
-		return;
+		return nullptr;
 
 #define LITERAL_SIZE(x) x, (sizeof(x) - 1)
 	ostringstream dst;
 	dst.write(LITERAL_SIZE("obs-studio/profiler_data/"));
 	dst.write(currentLogFile.c_str(), pos);
-	dst.write(LITERAL_SIZE(".csv.gz"));
+	dst << extension;
 #undef LITERAL_SIZE
 
-	BPtr<char> path = GetConfigPathPtr(dst.str().c_str());
+	return GetConfigPathPtr(dst.str().c_str());
+}
+
+static void SaveProfilerData(const ProfilerSnapshot &snap)
+{
+	BPtr<char> path = GetProfilerDataPath(".csv.gz");
+	if (!path)
+		return;
+
 	if (!profiler_snapshot_dump_csv_gz(snap.get(), path))
 		blog(LOG_WARNING, "Could not save profiler data to '%s'",
 		     static_cast<const char *>(path));
+
+	if (!opt_profiler_trace)
+		return;
+
+	path = GetProfilerDataPath(".trace.json.gz");
+	if (!profiler_trace_dump_json_gz(path))
+		blog(LOG_WARNING, "Could not save profiler trace to '%s'",
+		     static_cast<const char *>(path));
 }
 
 static auto ProfilerFree = [](void *) {
@@ -1903,6 +1920,9 @@ static int run_program(fstream &logFile, int argc, char *argv[])
 	profiler_start();
 	profile_register_root(run_program_init, 0);
 
+	if (opt_profiler_trace)
+		profiler_trace_start(0);
+
 	ScopeProfiler prof{run_program_init};
 
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 11, 0))
@@ -2600,6 +2620,9 @@ int main(int argc, char *argv[])
 		} else if (arg_is(argv[i], "--disable-updater", nullptr)) {
 			opt_disable_updater = true;
 
+		} else if (arg_is(argv[i], "--profiler-trace", nullptr)) {
+			opt_profiler_trace = true;
+
 		} else if (arg_is(argv[i], "--help", "-h")) {
 			std::string help =
 				"--help, -h: Get list of available commands.\n\n"
@@ -2617,7 +2640,8 @@ int main(int argc, char *argv[])
 				"--multi, -m: Don't warn when launching multiple instances.\n\n"
 				"--verbose: Make log more verbose.\n"
 				"--always-on-top: Start in 'always on top' mode.\n\n"
-				"--unfiltered_log: Make log unfiltered.\n\n"
+				"--unfiltered_log: Make log unfiltered.\n"
+				"--profiler-trace: Save a profiler timeline trace on exit.\n\n"
 				"--disable-updater: Disable built-in updater (Windows/Mac only)\n\n";
 
 #ifdef _WIN32
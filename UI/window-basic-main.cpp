@@ -1398,6 +1398,8 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_string(basicConfig, "Video", "ColorSpace", "709");
 	config_set_default_string(basicConfig, "Video", "ColorRange",
 				  "Partial");
+	config_set_default_bool(basicConfig, "Video", "ParallelVideoOutputs",
+				false);
 
 	config_set_default_string(basicConfig, "Audio", "MonitoringDeviceId",
 				  "default");
@@ -1406,6 +1408,7 @@ bool OBSBasic::InitBasicConfigDefaults()
 		Str("Basic.Settings.Advanced.Audio.MonitoringDevice"
 		    ".Default"));
 	config_set_default_uint(basicConfig, "Audio", "SampleRate", 48000);
+	config_set_default_bool(basicConfig, "Audio", "LowLatencyAudio", false);
 	config_set_default_string(basicConfig, "Audio", "ChannelSetup",
 				  "Stereo");
 	config_set_default_double(basicConfig, "Audio", "MeterDecayRate",
@@ -3986,6 +3989,10 @@ int OBSBasic::ResetVideo()
 	}
 
 	if (ret == OBS_VIDEO_SUCCESS) {
+		bool parallel = config_get_bool(basicConfig, "Video",
+						"ParallelVideoOutputs");
+		video_output_set_parallel_inputs(obs_get_video(), parallel);
+
 		OBSBasicStats::InitializeValues();
 		OBSProjector::UpdateMultiviewProjectors();
 	}
@@ -4019,7 +4026,13 @@ bool OBSBasic::ResetAudio()
 	else
 		ai.speakers = SPEAKERS_STEREO;
 
-	return obs_reset_audio(&ai);
+	if (!obs_reset_audio(&ai))
+		return false;
+
+	bool lowLatency =
+		config_get_bool(basicConfig, "Audio", "LowLatencyAudio");
+	audio_output_set_low_latency(obs_get_audio(), lowLatency);
+	return true;
 }
 
 void OBSBasic::ResetAudioDevice(const char *sourceId, const char *deviceId,
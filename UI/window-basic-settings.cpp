@@ -542,11 +542,13 @@ OBSBasicSettings::OBSBasicSettings(QWidget *parent)
 	HookWidget(ui->colorFormat,          COMBO_CHANGED,  ADV_CHANGED);
 	HookWidget(ui->colorSpace,           COMBO_CHANGED,  ADV_CHANGED);
 	HookWidget(ui->colorRange,           COMBO_CHANGED,  ADV_CHANGED);
+	HookWidget(ui->parallelVideoOutputs, CHECK_CHANGED,  ADV_CHANGED);
 	HookWidget(ui->disableOSXVSync,      CHECK_CHANGED,  ADV_CHANGED);
 	HookWidget(ui->resetOSXVSync,        CHECK_CHANGED,  ADV_CHANGED);
 #if defined(_WIN32) || defined(__APPLE__) || HAVE_PULSEAUDIO
 	HookWidget(ui->monitoringDevice,     COMBO_CHANGED,  ADV_CHANGED);
 #endif
+	HookWidget(ui->lowLatencyAudio,      CHECK_CHANGED,  ADV_CHANGED);
 #ifdef _WIN32
 	HookWidget(ui->disableAudioDucking,  CHECK_CHANGED,  ADV_CHANGED);
 	HookWidget(ui->browserHWAccel,       CHECK_CHANGED,  ADV_RESTART);
@@ -592,8 +594,10 @@ OBSBasicSettings::OBSBasicSettings(QWidget *parent)
 #endif
 
 #if !defined(_WIN32) && !defined(__APPLE__) && !HAVE_PULSEAUDIO
-	delete ui->audioAdvGroupBox;
-	ui->audioAdvGroupBox = nullptr;
+	delete ui->monitoringDeviceLabel;
+	delete ui->monitoringDevice;
+	ui->monitoringDeviceLabel = nullptr;
+	ui->monitoringDevice = nullptr;
 #endif
 
 #ifdef _WIN32
@@ -640,9 +644,7 @@ OBSBasicSettings::OBSBasicSettings(QWidget *parent)
 	delete ui->enableLowLatencyMode;
 	delete ui->browserHWAccel;
 	delete ui->sourcesGroup;
-#if defined(__APPLE__) || HAVE_PULSEAUDIO
 	delete ui->disableAudioDucking;
-#endif
 	ui->rendererLabel = nullptr;
 	ui->renderer = nullptr;
 	ui->adapterLabel = nullptr;
@@ -654,10 +656,8 @@ OBSBasicSettings::OBSBasicSettings(QWidget *parent)
 	ui->enableLowLatencyMode = nullptr;
 	ui->browserHWAccel = nullptr;
 	ui->sourcesGroup = nullptr;
-#if defined(__APPLE__) || HAVE_PULSEAUDIO
 	ui->disableAudioDucking = nullptr;
 #endif
-#endif
 
 #ifndef __APPLE__
 	delete ui->disableOSXVSync;
@@ -2444,6 +2444,10 @@ void OBSBasicSettings::LoadAdvancedSettings()
 	int rbTime = config_get_int(main->Config(), "AdvOut", "RecRBTime");
 	int rbSize = config_get_int(main->Config(), "AdvOut", "RecRBSize");
 	bool autoRemux = config_get_bool(main->Config(), "Video", "AutoRemux");
+	bool parallelVideoOutputs = config_get_bool(main->Config(), "Video",
+						    "ParallelVideoOutputs");
+	bool lowLatencyAudio =
+		config_get_bool(main->Config(), "Audio", "LowLatencyAudio");
 	const char *hotkeyFocusType = config_get_string(
 		App()->GlobalConfig(), "General", "HotkeyFocusType");
 	bool dynBitrate =
@@ -2480,6 +2484,8 @@ void OBSBasicSettings::LoadAdvancedSettings()
 	SetComboByName(ui->colorFormat, videoColorFormat);
 	SetComboByName(ui->colorSpace, videoColorSpace);
 	SetComboByValue(ui->colorRange, videoColorRange);
+	ui->parallelVideoOutputs->setChecked(parallelVideoOutputs);
+	ui->lowLatencyAudio->setChecked(lowLatencyAudio);
 
 	if (!SetComboByValue(ui->bindToIP, bindIP))
 		SetInvalidValue(ui->bindToIP, bindIP, bindIP);
@@ -3166,10 +3172,22 @@ void OBSBasicSettings::SaveAdvancedSettings()
 	SaveCombo(ui->colorFormat, "Video", "ColorFormat");
 	SaveCombo(ui->colorSpace, "Video", "ColorSpace");
 	SaveComboData(ui->colorRange, "Video", "ColorRange");
+	if (WidgetChanged(ui->parallelVideoOutputs)) {
+		bool parallel = ui->parallelVideoOutputs->isChecked();
+		config_set_bool(main->Config(), "Video", "ParallelVideoOutputs",
+				parallel);
+		video_output_set_parallel_inputs(obs_get_video(), parallel);
+	}
 #if defined(_WIN32) || defined(__APPLE__) || HAVE_PULSEAUDIO
 	SaveCombo(ui->monitoringDevice, "Audio", "MonitoringDeviceName");
 	SaveComboData(ui->monitoringDevice, "Audio", "MonitoringDeviceId");
 #endif
+	if (WidgetChanged(ui->lowLatencyAudio)) {
+		bool lowLatency = ui->lowLatencyAudio->isChecked();
+		config_set_bool(main->Config(), "Audio", "LowLatencyAudio",
+				lowLatency);
+		audio_output_set_low_latency(obs_get_audio(), lowLatency);
+	}
 
 #ifdef _WIN32
 	if (WidgetChanged(ui->disableAudioDucking)) {
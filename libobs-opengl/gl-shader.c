@@ -189,9 +189,8 @@ static inline bool gl_process_attribs(struct gs_shader *shader,
 	return true;
 }
 
-static bool gl_shader_init(struct gs_shader *shader,
-			   struct gl_shader_parser *glsp, const char *file,
-			   char **error_string)
+static bool gl_shader_compile(struct gs_shader *shader, const char *gl_string,
+			      const char *file, char **error_string)
 {
 	GLenum type = convert_shader_type(shader->type);
 	int compiled = 0;
@@ -201,8 +200,7 @@ static bool gl_shader_init(struct gs_shader *shader,
 	if (!gl_success("glCreateShader") || !shader->obj)
 		return false;
 
-	glShaderSource(shader->obj, 1, (const GLchar **)&glsp->gl_string.array,
-		       0);
+	glShaderSource(shader->obj, 1, (const GLchar **)&gl_string, 0);
 	if (!gl_success("glShaderSource"))
 		return false;
 
@@ -214,7 +212,7 @@ static bool gl_shader_init(struct gs_shader *shader,
 	blog(LOG_DEBUG, "+++++++++++++++++++++++++++++++++++");
 	blog(LOG_DEBUG, "  GL shader string for: %s", file);
 	blog(LOG_DEBUG, "-----------------------------------");
-	blog(LOG_DEBUG, "%s", glsp->gl_string.array);
+	blog(LOG_DEBUG, "%s", gl_string);
 	blog(LOG_DEBUG, "+++++++++++++++++++++++++++++++++++");
 #endif
 
@@ -239,6 +237,15 @@ static bool gl_shader_init(struct gs_shader *shader,
 	}
 
 	gl_get_shader_info(shader->obj, file, error_string);
+	return success;
+}
+
+static bool gl_shader_init(struct gs_shader *shader,
+			   struct gl_shader_parser *glsp, const char *file,
+			   char **error_string)
+{
+	bool success = gl_shader_compile(shader, glsp->gl_string.array, file,
+					 error_string);
 
 	if (success)
 		success = gl_add_params(shader, glsp);
@@ -263,12 +270,20 @@ static struct gs_shader *shader_create(gs_device_t *device,
 	shader->device = device;
 	shader->type = type;
 
+	/* a cached shader compiled successfully with this driver before, so
+	 * compiling it can wait until a program needs to be linked */
+	if (gl_shader_cache_load(shader, shader_str))
+		return shader;
+
 	gl_shader_parser_init(&glsp, type);
 	if (!gl_shader_parse(&glsp, shader_str, file))
 		success = false;
 	else
 		success = gl_shader_init(shader, &glsp, file, error_string);
 
+	if (success)
+		gl_shader_cache_save(shader, shader_str, &glsp);
+
 	if (!success) {
 		gs_shader_destroy(shader);
 		shader = NULL;
@@ -346,6 +361,7 @@ void gs_shader_destroy(gs_shader_t *shader)
 		gl_success("glDeleteShader");
 	}
 
+	bfree(shader->gl_string);
 	da_free(shader->samplers);
 	da_free(shader->params);
 	da_free(shader->attribs);
@@ -629,38 +645,86 @@ static inline bool assign_program_params(struct gs_program *program)
 	return true;
 }
 
-struct gs_program *gs_program_create(struct gs_device *device)
+static bool gl_shader_compile_cached(struct gs_shader *shader)
+{
+	bool success;
+
+	if (shader->obj)
+		return true;
+
+	success = gl_shader_compile(shader, shader->gl_string, "(cached)",
+				    NULL);
+	bfree(shader->gl_string);
+	shader->gl_string = NULL;
+
+	return success;
+}
+
+static bool link_program(struct gs_program *program)
 {
-	struct gs_program *program = bzalloc(sizeof(*program));
 	int linked = false;
+	bool success = false;
 
-	program->device = device;
-	program->vertex_shader = device->cur_vertex_shader;
-	program->pixel_shader = device->cur_pixel_shader;
+	if (!gl_shader_compile_cached(program->vertex_shader) ||
+	    !gl_shader_compile_cached(program->pixel_shader))
+		return false;
 
-	program->obj = glCreateProgram();
-	if (!gl_success("glCreateProgram"))
-		goto error_detach_neither;
+	if (program->device->program_binary) {
+		glProgramParameteri(program->obj,
+				    GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+				    GL_TRUE);
+		gl_success("glProgramParameteri");
+	}
 
 	glAttachShader(program->obj, program->vertex_shader->obj);
 	if (!gl_success("glAttachShader (vertex)"))
-		goto error_detach_neither;
+		return false;
 
 	glAttachShader(program->obj, program->pixel_shader->obj);
 	if (!gl_success("glAttachShader (pixel)"))
-		goto error_detach_vertex;
+		goto detach_vertex;
 
 	glLinkProgram(program->obj);
 	if (!gl_success("glLinkProgram"))
-		goto error;
+		goto detach;
 
 	glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
 	if (!gl_success("glGetProgramiv"))
-		goto error;
+		goto detach;
 
-	if (linked == GL_FALSE) {
+	if (linked == GL_FALSE)
 		print_link_errors(program->obj);
+	else
+		success = true;
+
+detach:
+	glDetachShader(program->obj, program->pixel_shader->obj);
+	gl_success("glDetachShader (pixel)");
+
+detach_vertex:
+	glDetachShader(program->obj, program->vertex_shader->obj);
+	gl_success("glDetachShader (vertex)");
+
+	return success;
+}
+
+struct gs_program *gs_program_create(struct gs_device *device)
+{
+	struct gs_program *program = bzalloc(sizeof(*program));
+
+	program->device = device;
+	program->vertex_shader = device->cur_vertex_shader;
+	program->pixel_shader = device->cur_pixel_shader;
+
+	program->obj = glCreateProgram();
+	if (!gl_success("glCreateProgram"))
 		goto error;
+
+	if (!gl_program_cache_load(program)) {
+		if (!link_program(program))
+			goto error;
+
+		gl_program_cache_save(program);
 	}
 
 	if (!assign_program_attribs(program))
@@ -668,12 +732,6 @@ struct gs_program *gs_program_create(struct gs_device *device)
 	if (!assign_program_params(program))
 		goto error;
 
-	glDetachShader(program->obj, program->vertex_shader->obj);
-	gl_success("glDetachShader (vertex)");
-
-	glDetachShader(program->obj, program->pixel_shader->obj);
-	gl_success("glDetachShader (pixel)");
-
 	program->next = device->first_program;
 	program->prev_next = &device->first_program;
 	device->first_program = program;
@@ -683,14 +741,6 @@ struct gs_program *gs_program_create(struct gs_device *device)
 	return program;
 
 error:
-	glDetachShader(program->obj, program->pixel_shader->obj);
-	gl_success("glDetachShader (pixel)");
-
-error_detach_vertex:
-	glDetachShader(program->obj, program->vertex_shader->obj);
-	gl_success("glDetachShader (vertex)");
-
-error_detach_neither:
 	gs_program_destroy(program);
 	return NULL;
 }
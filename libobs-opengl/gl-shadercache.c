@@ -0,0 +1,538 @@
+/******************************************************************************
+    Copyright (C) 2020 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+
+#include <obs-config.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/file-serializer.h>
+#include "gl-subsystem.h"
+#include "gl-shaderparser.h"
+
+/*
+ * On-disk cache of translated shaders and linked program binaries.
+ *
+ * A shader file holds the GLSL translation of an effect shader along with
+ * its parameters, attributes and samplers, so a cache hit skips both the
+ * translation and the compile.  A program file holds the binary returned by
+ * glGetProgramBinary for a vertex/pixel shader pair.  Every key includes
+ * the libobs version and the driver strings (vendor, renderer, GL and GLSL
+ * versions), so updating either invalidates the whole cache.
+ */
+
+#define SHADER_CACHE_MAGIC 0x4853424F /* "OBSH" */
+#define PROGRAM_CACHE_MAGIC 0x5053424F /* "OBSP" */
+
+/* increment whenever the file layout or the translation output changes */
+#define SHADER_CACHE_VERSION 1
+
+static inline uint64_t hash_data(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+static inline uint64_t hash_string(uint64_t hash, const char *str)
+{
+	return hash_data(hash, str ? str : "", (str ? strlen(str) : 0) + 1);
+}
+
+void gl_shader_cache_init(struct gs_device *device)
+{
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	uint32_t version = SHADER_CACHE_VERSION;
+	uint32_t api_version = LIBOBS_API_VER;
+	GLint formats = 0;
+
+	hash = hash_data(hash, &version, sizeof(version));
+	hash = hash_data(hash, &api_version, sizeof(api_version));
+	hash = hash_string(hash, OBS_VERSION);
+	hash = hash_string(hash, (const char *)glGetString(GL_VENDOR));
+	hash = hash_string(hash, (const char *)glGetString(GL_RENDERER));
+	hash = hash_string(hash, (const char *)glGetString(GL_VERSION));
+	hash = hash_string(hash, (const char *)glGetString(
+					 GL_SHADING_LANGUAGE_VERSION));
+	device->shader_cache_key = hash;
+
+	if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary) {
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		gl_success("glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS)");
+	}
+
+	device->program_binary = formats > 0;
+}
+
+void device_set_shader_cache_path(gs_device_t *device, const char *path)
+{
+	bfree(device->shader_cache_path);
+	device->shader_cache_path = NULL;
+
+	if (os_mkdirs(path) == MKDIR_ERROR) {
+		blog(LOG_WARNING,
+		     "Could not create shader cache directory '%s'", path);
+		return;
+	}
+
+	device->shader_cache_path = bstrdup(path);
+}
+
+static inline void get_cache_file(struct dstr *path,
+				  const struct gs_device *device,
+				  uint64_t hash, const char *ext)
+{
+	dstr_printf(path, "%s/%016" PRIx64 ".%s", device->shader_cache_path,
+		    hash, ext);
+}
+
+/* ------------------------------------------------------------------------- */
+/* file helpers */
+
+static inline void write_u32(struct serializer *s, uint32_t val)
+{
+	s_write(s, &val, sizeof(val));
+}
+
+static inline void write_u64(struct serializer *s, uint64_t val)
+{
+	s_write(s, &val, sizeof(val));
+}
+
+static inline void write_data(struct serializer *s, const void *data,
+			      size_t size)
+{
+	write_u32(s, (uint32_t)size);
+	s_write(s, data, size);
+}
+
+static inline void write_string(struct serializer *s, const char *str)
+{
+	write_data(s, str, strlen(str));
+}
+
+static inline bool read_u32(struct serializer *s, uint32_t *val)
+{
+	return s_read(s, val, sizeof(*val)) == sizeof(*val);
+}
+
+static inline bool read_u64(struct serializer *s, uint64_t *val)
+{
+	return s_read(s, val, sizeof(*val)) == sizeof(*val);
+}
+
+static bool read_data(struct serializer *s, void **data, size_t *size)
+{
+	uint32_t len;
+
+	*data = NULL;
+	if (!read_u32(s, &len))
+		return false;
+
+	*data = bmalloc((size_t)len + 1);
+	if (s_read(s, *data, len) != len) {
+		bfree(*data);
+		*data = NULL;
+		return false;
+	}
+
+	((char *)*data)[len] = 0;
+	if (size)
+		*size = len;
+	return true;
+}
+
+static inline bool read_string(struct serializer *s, char **str)
+{
+	return read_data(s, (void **)str, NULL);
+}
+
+static bool open_cache_file(struct serializer *s, struct gs_device *device,
+			    uint64_t hash, const char *ext, uint32_t magic)
+{
+	struct dstr path = {0};
+	uint32_t val;
+	bool success;
+
+	get_cache_file(&path, device, hash, ext);
+	success = file_input_serializer_init(s, path.array);
+	dstr_free(&path);
+
+	if (!success)
+		return false;
+
+	if (!read_u32(s, &val) || val != magic) {
+		file_input_serializer_free(s);
+		return false;
+	}
+
+	return true;
+}
+
+static bool create_cache_file(struct serializer *s, struct gs_device *device,
+			      uint64_t hash, const char *ext, uint32_t magic)
+{
+	struct dstr path = {0};
+	bool success;
+
+	/* written to a temporary file first so that other instances never
+	 * see a partial file */
+	get_cache_file(&path, device, hash, ext);
+	success = file_output_serializer_init_safe(s, path.array, "tmp");
+	dstr_free(&path);
+
+	if (success)
+		write_u32(s, magic);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* shaders */
+
+static uint64_t get_shader_hash(const struct gs_shader *shader,
+				const char *shader_str)
+{
+	uint32_t type = (uint32_t)shader->type;
+	uint64_t hash = shader->device->shader_cache_key;
+
+	hash = hash_data(hash, &type, sizeof(type));
+	return hash_string(hash, shader_str);
+}
+
+static bool read_shader_param(struct serializer *s, struct gs_shader *shader)
+{
+	struct gs_shader_param param = {0};
+	uint32_t type, array_count, texture_id;
+	uint64_t sampler_id;
+	void *def_value;
+	size_t def_size;
+
+	if (!read_string(s, &param.name))
+		return false;
+
+	if (!read_u32(s, &type) || !read_u32(s, &array_count) ||
+	    !read_u32(s, &texture_id) || !read_u64(s, &sampler_id) ||
+	    !read_data(s, &def_value, &def_size)) {
+		bfree(param.name);
+		return false;
+	}
+
+	param.type = (enum gs_shader_param_type)type;
+	param.array_count = (int)array_count;
+	param.texture_id = (GLint)texture_id;
+	param.sampler_id = (size_t)sampler_id;
+	param.shader = shader;
+	param.changed = param.type != GS_SHADER_PARAM_TEXTURE;
+
+	da_copy_array(param.def_value, def_value, def_size);
+	da_copy(param.cur_value, param.def_value);
+	bfree(def_value);
+
+	da_push_back(shader->params, &param);
+	return true;
+}
+
+static bool read_shader_attrib(struct serializer *s, struct gs_shader *shader)
+{
+	struct shader_attrib attrib = {0};
+	uint32_t type, index;
+
+	if (!read_string(s, &attrib.name))
+		return false;
+
+	if (!read_u32(s, &type) || !read_u32(s, &index)) {
+		bfree(attrib.name);
+		return false;
+	}
+
+	attrib.type = (enum attrib_type)type;
+	attrib.index = index;
+
+	da_push_back(shader->attribs, &attrib);
+	return true;
+}
+
+static bool read_shader_sampler(struct serializer *s, struct gs_shader *shader)
+{
+	struct gs_sampler_info info = {0};
+	uint32_t vals[6];
+	gs_samplerstate_t *sampler;
+
+	for (size_t i = 0; i < 6; i++) {
+		if (!read_u32(s, &vals[i]))
+			return false;
+	}
+
+	info.filter = (enum gs_sample_filter)vals[0];
+	info.address_u = (enum gs_address_mode)vals[1];
+	info.address_v = (enum gs_address_mode)vals[2];
+	info.address_w = (enum gs_address_mode)vals[3];
+	info.max_anisotropy = (int)vals[4];
+	info.border_color = vals[5];
+
+	sampler = device_samplerstate_create(shader->device, &info);
+	da_push_back(shader->samplers, &sampler);
+	return true;
+}
+
+static bool read_shader(struct serializer *s, struct gs_shader *shader,
+			const char *shader_str)
+{
+	uint32_t num;
+	char *source;
+	bool match;
+
+	/* the hash only selects the file, the source has to match exactly */
+	if (!read_string(s, &source))
+		return false;
+
+	match = strcmp(source, shader_str) == 0;
+	bfree(source);
+
+	if (!match || !read_string(s, &shader->gl_string))
+		return false;
+
+	if (!read_u32(s, &num))
+		return false;
+	for (uint32_t i = 0; i < num; i++) {
+		if (!read_shader_param(s, shader))
+			return false;
+	}
+
+	if (!read_u32(s, &num))
+		return false;
+	for (uint32_t i = 0; i < num; i++) {
+		if (!read_shader_attrib(s, shader))
+			return false;
+	}
+
+	if (!read_u32(s, &num))
+		return false;
+	for (uint32_t i = 0; i < num; i++) {
+		if (!read_shader_sampler(s, shader))
+			return false;
+	}
+
+	return true;
+}
+
+static void reset_shader(struct gs_shader *shader)
+{
+	for (size_t i = 0; i < shader->params.num; i++) {
+		struct gs_shader_param *param = shader->params.array + i;
+		bfree(param->name);
+		da_free(param->cur_value);
+		da_free(param->def_value);
+	}
+
+	for (size_t i = 0; i < shader->attribs.num; i++)
+		bfree(shader->attribs.array[i].name);
+
+	for (size_t i = 0; i < shader->samplers.num; i++)
+		gs_samplerstate_destroy(shader->samplers.array[i]);
+
+	da_free(shader->params);
+	da_free(shader->attribs);
+	da_free(shader->samplers);
+
+	bfree(shader->gl_string);
+	shader->gl_string = NULL;
+}
+
+bool gl_shader_cache_load(struct gs_shader *shader, const char *shader_str)
+{
+	struct gs_device *device = shader->device;
+	struct serializer s;
+	bool success;
+
+	if (!device->shader_cache_path)
+		return false;
+
+	shader->cache_hash = get_shader_hash(shader, shader_str);
+
+	if (!open_cache_file(&s, device, shader->cache_hash, "shader",
+			     SHADER_CACHE_MAGIC))
+		return false;
+
+	success = read_shader(&s, shader, shader_str);
+	file_input_serializer_free(&s);
+
+	if (!success) {
+		reset_shader(shader);
+		return false;
+	}
+
+	shader->viewproj = gs_shader_get_param_by_name(shader, "ViewProj");
+	shader->world = gs_shader_get_param_by_name(shader, "World");
+	return true;
+}
+
+void gl_shader_cache_save(struct gs_shader *shader, const char *shader_str,
+			  const struct gl_shader_parser *glsp)
+{
+	struct gs_device *device = shader->device;
+	const struct shader_parser *parser = &glsp->parser;
+	struct serializer s;
+
+	if (!device->shader_cache_path || !shader->cache_hash)
+		return;
+
+	if (!create_cache_file(&s, device, shader->cache_hash, "shader",
+			       SHADER_CACHE_MAGIC))
+		return;
+
+	write_string(&s, shader_str);
+	write_string(&s, glsp->gl_string.array);
+
+	write_u32(&s, (uint32_t)shader->params.num);
+	for (size_t i = 0; i < shader->params.num; i++) {
+		struct gs_shader_param *param = shader->params.array + i;
+
+		write_string(&s, param->name);
+		write_u32(&s, (uint32_t)param->type);
+		write_u32(&s, (uint32_t)param->array_count);
+		write_u32(&s, (uint32_t)param->texture_id);
+		write_u64(&s, (uint64_t)param->sampler_id);
+		write_data(&s, param->def_value.array, param->def_value.num);
+	}
+
+	write_u32(&s, (uint32_t)shader->attribs.num);
+	for (size_t i = 0; i < shader->attribs.num; i++) {
+		struct shader_attrib *attrib = shader->attribs.array + i;
+
+		write_string(&s, attrib->name);
+		write_u32(&s, (uint32_t)attrib->type);
+		write_u32(&s, (uint32_t)attrib->index);
+	}
+
+	write_u32(&s, (uint32_t)parser->samplers.num);
+	for (size_t i = 0; i < parser->samplers.num; i++) {
+		struct gs_sampler_info info;
+
+		shader_sampler_convert(parser->samplers.array + i, &info);
+		write_u32(&s, (uint32_t)info.filter);
+		write_u32(&s, (uint32_t)info.address_u);
+		write_u32(&s, (uint32_t)info.address_v);
+		write_u32(&s, (uint32_t)info.address_w);
+		write_u32(&s, (uint32_t)info.max_anisotropy);
+		write_u32(&s, info.border_color);
+	}
+
+	file_output_serializer_free(&s);
+}
+
+/* ------------------------------------------------------------------------- */
+/* programs */
+
+static inline uint64_t get_program_hash(const struct gs_program *program)
+{
+	uint64_t hash = program->device->shader_cache_key;
+
+	hash = hash_data(hash, &program->vertex_shader->cache_hash,
+			 sizeof(uint64_t));
+	return hash_data(hash, &program->pixel_shader->cache_hash,
+			 sizeof(uint64_t));
+}
+
+static inline bool program_cacheable(const struct gs_program *program)
+{
+	const struct gs_device *device = program->device;
+
+	return device->shader_cache_path && device->program_binary &&
+	       program->vertex_shader->cache_hash &&
+	       program->pixel_shader->cache_hash;
+}
+
+bool gl_program_cache_load(struct gs_program *program)
+{
+	struct serializer s;
+	uint64_t vs_hash, ps_hash;
+	uint32_t format;
+	void *binary = NULL;
+	size_t size = 0;
+	GLint linked = GL_FALSE;
+	bool success;
+
+	if (!program_cacheable(program))
+		return false;
+
+	if (!open_cache_file(&s, program->device, get_program_hash(program),
+			     "program", PROGRAM_CACHE_MAGIC))
+		return false;
+
+	success = read_u64(&s, &vs_hash) && read_u64(&s, &ps_hash) &&
+		  vs_hash == program->vertex_shader->cache_hash &&
+		  ps_hash == program->pixel_shader->cache_hash &&
+		  read_u32(&s, &format) && read_data(&s, &binary, &size);
+	file_input_serializer_free(&s);
+
+	if (!success) {
+		bfree(binary);
+		return false;
+	}
+
+	/* drivers may reject binaries of other driver builds even when the
+	 * version strings match, that simply falls back to linking */
+	glProgramBinary(program->obj, (GLenum)format, binary, (GLsizei)size);
+	bfree(binary);
+
+	while (glGetError() != GL_NO_ERROR)
+		;
+
+	glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
+	return gl_success("glGetProgramiv") && linked == GL_TRUE;
+}
+
+void gl_program_cache_save(struct gs_program *program)
+{
+	struct serializer s;
+	GLint size = 0;
+	GLsizei written = 0;
+	GLenum format = 0;
+	void *binary;
+
+	if (!program_cacheable(program))
+		return;
+
+	glGetProgramiv(program->obj, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (!gl_success("glGetProgramiv") || size <= 0)
+		return;
+
+	binary = bmalloc(size);
+	glGetProgramBinary(program->obj, size, &written, &format, binary);
+	if (!gl_success("glGetProgramBinary") || written <= 0)
+		goto exit;
+
+	if (!create_cache_file(&s, program->device, get_program_hash(program),
+			       "program", PROGRAM_CACHE_MAGIC))
+		goto exit;
+
+	write_u64(&s, program->vertex_shader->cache_hash);
+	write_u64(&s, program->pixel_shader->cache_hash);
+	write_u32(&s, (uint32_t)format);
+	write_data(&s, binary, (size_t)written);
+
+	file_output_serializer_free(&s);
+
+exit:
+	bfree(binary);
+}
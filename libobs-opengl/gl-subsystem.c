@@ -245,6 +245,8 @@ int device_create(gs_device_t **p_device, uint32_t adapter)
 	gl_enable(GL_CULL_FACE);
 	gl_gen_vertex_arrays(1, &device->empty_vao);
 
+	gl_shader_cache_init(device);
+
 	gl_clear_context(device);
 	device->cur_swap = NULL;
 
@@ -275,6 +277,7 @@ void device_destroy(gs_device_t *device)
 
 		gl_delete_vertex_arrays(1, &device->empty_vao);
 
+		bfree(device->shader_cache_path);
 		da_free(device->proj_stack);
 		gl_platform_destroy(device->plat);
 		bfree(device);
@@ -437,6 +437,11 @@ struct gs_shader {
 	enum gs_shader_type type;
 	GLuint obj;
 
+	/* shaders loaded from the cache are only compiled when a program
+	 * using them is not in the cache either */
+	uint64_t cache_hash;
+	char *gl_string;
+
 	struct gs_shader_param *viewproj;
 	struct gs_shader_param *world;
 
@@ -467,6 +472,17 @@ extern struct gs_program *gs_program_create(struct gs_device *device);
 extern void gs_program_destroy(struct gs_program *program);
 extern void program_update_params(struct gs_program *shader);
 
+struct gl_shader_parser;
+
+extern void gl_shader_cache_init(struct gs_device *device);
+extern bool gl_shader_cache_load(struct gs_shader *shader,
+				 const char *shader_str);
+extern void gl_shader_cache_save(struct gs_shader *shader,
+				 const char *shader_str,
+				 const struct gl_shader_parser *glsp);
+extern bool gl_program_cache_load(struct gs_program *program);
+extern void gl_program_cache_save(struct gs_program *program);
+
 struct gs_vertex_buffer {
 	GLuint vao;
 	GLuint vertex_buffer;
@@ -611,6 +627,10 @@ struct gs_device {
 
 	struct gs_program *first_program;
 
+	char *shader_cache_path;
+	uint64_t shader_cache_key;
+	bool program_binary;
+
 	enum gs_cull_mode cur_cull_mode;
 	struct gs_rect cur_viewport;
 
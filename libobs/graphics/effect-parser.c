@@ -2084,5 +2084,6 @@ static bool ep_compile(struct effect_parser *ep)
 			success = false;
 	}
 
+	effect_build_name_index(ep->effect);
 	return success;
 }
@@ -35,12 +35,114 @@ void gs_effect_destroy(gs_effect_t *effect)
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+
+static volatile long name_lookups = 0;
+
+static inline uint32_t hash_name(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void name_index_init(struct effect_name_index *index, size_t num)
+{
+	size_t size = 4;
+
+	while (size < num * 2)
+		size <<= 1;
+
+	index->slots = bzalloc(size * sizeof(struct effect_name_slot));
+	index->mask = size - 1;
+}
+
+/* returns the next candidate with a matching hash, or 0 once the probe hits
+ * an empty slot */
+static inline uint32_t name_index_next(const struct effect_name_index *index,
+				       uint32_t hash, size_t *pos)
+{
+	const struct effect_name_slot *slot;
+
+	while ((slot = index->slots + *pos)->idx) {
+		*pos = (*pos + 1) & index->mask;
+		if (slot->hash == hash)
+			return slot->idx;
+	}
+
+	return 0;
+}
+
+static void name_index_insert(struct effect_name_index *index,
+			      uint32_t hash, size_t idx)
+{
+	size_t pos = hash & index->mask;
+
+	while (index->slots[pos].idx)
+		pos = (pos + 1) & index->mask;
+
+	index->slots[pos].hash = hash;
+	index->slots[pos].idx = (uint32_t)idx + 1;
+}
+
+void effect_build_name_index(gs_effect_t *effect)
+{
+	size_t i;
+
+	bfree(effect->param_index.slots);
+	bfree(effect->technique_index.slots);
+
+	/* duplicate names keep resolving to the first entry, as they did
+	 * with the linear search, since it is inserted first */
+	name_index_init(&effect->param_index, effect->params.num);
+	for (i = 0; i < effect->params.num; i++) {
+		const char *name = effect->params.array[i].name;
+		name_index_insert(&effect->param_index, hash_name(name), i);
+	}
+
+	name_index_init(&effect->technique_index, effect->techniques.num);
+	for (i = 0; i < effect->techniques.num; i++) {
+		const char *name = effect->techniques.array[i].name;
+		name_index_insert(&effect->technique_index, hash_name(name), i);
+	}
+}
+
+long gs_effect_get_name_lookup_count(void)
+{
+	return os_atomic_load_long(&name_lookups);
+}
+
+/* ------------------------------------------------------------------------- */
+
 gs_technique_t *gs_effect_get_technique(const gs_effect_t *effect,
 					const char *name)
 {
 	if (!effect)
 		return NULL;
 
+	os_atomic_inc_long(&name_lookups);
+
+	if (effect->technique_index.slots) {
+		uint32_t hash = hash_name(name);
+		size_t pos = hash & effect->technique_index.mask;
+		uint32_t idx;
+
+		while ((idx = name_index_next(&effect->technique_index, hash,
+					      &pos)) != 0) {
+			struct gs_effect_technique *tech =
+				effect->techniques.array + idx - 1;
+			if (strcmp(tech->name, name) == 0)
+				return tech;
+		}
+
+		return NULL;
+	}
+
 	for (size_t i = 0; i < effect->techniques.num; i++) {
 		struct gs_effect_technique *tech = effect->techniques.array + i;
 		if (strcmp(tech->name, name) == 0)
@@ -58,22 +160,18 @@ gs_technique_t *gs_effect_get_current_technique(const gs_effect_t *effect)
 	return effect->cur_technique;
 }
 
-bool gs_effect_loop(gs_effect_t *effect, const char *name)
+static bool effect_loop(gs_effect_t *effect, gs_technique_t *tech,
+			const char *name)
 {
-	if (!effect) {
-		return false;
-	}
-
 	if (!effect->looping) {
-		gs_technique_t *tech;
-
 		if (!!gs_get_effect()) {
 			blog(LOG_WARNING, "gs_effect_loop: An effect is "
 					  "already active");
 			return false;
 		}
 
-		tech = gs_effect_get_technique(effect, name);
+		if (!tech)
+			tech = gs_effect_get_technique(effect, name);
 		if (!tech) {
 			blog(LOG_WARNING,
 			     "gs_effect_loop: Technique '%s' "
@@ -100,6 +198,24 @@ bool gs_effect_loop(gs_effect_t *effect, const char *name)
 	return true;
 }
 
+bool gs_effect_loop(gs_effect_t *effect, const char *name)
+{
+	if (!effect) {
+		return false;
+	}
+
+	return effect_loop(effect, NULL, name);
+}
+
+bool gs_technique_loop(gs_technique_t *technique)
+{
+	if (!technique) {
+		return false;
+	}
+
+	return effect_loop(technique->effect, technique, technique->name);
+}
+
 size_t gs_technique_begin(gs_technique_t *tech)
 {
 	if (!tech)
@@ -221,6 +337,8 @@ bool gs_technique_begin_pass_by_name(gs_technique_t *tech, const char *name)
 	if (!tech)
 		return false;
 
+	os_atomic_inc_long(&name_lookups);
+
 	for (size_t i = 0; i < tech->passes.num; i++) {
 		struct gs_effect_pass *pass = tech->passes.array + i;
 		if (strcmp(pass->name, name) == 0) {
@@ -285,6 +403,23 @@ gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect,
 
 	struct gs_effect_param *params = effect->params.array;
 
+	os_atomic_inc_long(&name_lookups);
+
+	if (effect->param_index.slots) {
+		uint32_t hash = hash_name(name);
+		size_t pos = hash & effect->param_index.mask;
+		uint32_t idx;
+
+		while ((idx = name_index_next(&effect->param_index, hash,
+					      &pos)) != 0) {
+			struct gs_effect_param *param = params + idx - 1;
+			if (strcmp(param->name, name) == 0)
+				return param;
+		}
+
+		return NULL;
+	}
+
 	for (size_t i = 0; i < effect->params.num; i++) {
 		struct gs_effect_param *param = params + i;
 
@@ -348,6 +483,8 @@ gs_epass_t *gs_technique_get_pass_by_name(const gs_technique_t *technique,
 		return NULL;
 	struct gs_effect_pass *passes = technique->passes.array;
 
+	os_atomic_inc_long(&name_lookups);
+
 	for (size_t i = 0; i < technique->passes.num; i++) {
 		struct gs_effect_pass *g_pass = passes + i;
 		if (strcmp(g_pass->name, name) == 0)
@@ -147,6 +147,20 @@ static inline void effect_technique_free(struct gs_effect_technique *t)
 
 /* ------------------------------------------------------------------------- */
 
+/* open-addressing index of parameter/technique names, built once the effect
+ * is compiled.  idx is the array index + 1, 0 marks an empty slot */
+struct effect_name_slot {
+	uint32_t hash;
+	uint32_t idx;
+};
+
+struct effect_name_index {
+	struct effect_name_slot *slots;
+	size_t mask;
+};
+
+/* ------------------------------------------------------------------------- */
+
 struct gs_effect {
 	bool processing;
 	bool cached;
@@ -155,6 +169,9 @@ struct gs_effect {
 	DARRAY(struct gs_effect_param) params;
 	DARRAY(struct gs_effect_technique) techniques;
 
+	struct effect_name_index param_index;
+	struct effect_name_index technique_index;
+
 	struct gs_effect_technique *cur_technique;
 	struct gs_effect_pass *cur_pass;
 
@@ -183,12 +200,18 @@ static inline void effect_free(gs_effect_t *effect)
 	da_free(effect->params);
 	da_free(effect->techniques);
 
+	bfree(effect->param_index.slots);
+	bfree(effect->technique_index.slots);
+	effect->param_index.slots = NULL;
+	effect->technique_index.slots = NULL;
+
 	bfree(effect->effect_path);
 	bfree(effect->effect_dir);
 	effect->effect_path = NULL;
 	effect->effect_dir = NULL;
 }
 
+void effect_build_name_index(gs_effect_t *effect);
 EXPORT void effect_upload_params(gs_effect_t *effect, bool changed_only);
 EXPORT void effect_upload_shader_params(gs_effect_t *effect,
 					gs_shader_t *shader,
@@ -35,6 +35,8 @@ struct gs_exports {
 	void (*device_enter_context)(gs_device_t *device);
 	void (*device_leave_context)(gs_device_t *device);
 	void *(*device_get_device_obj)(gs_device_t *device);
+	void (*device_set_shader_cache_path)(gs_device_t *device,
+					     const char *path);
 	gs_swapchain_t *(*device_swapchain_create)(
 		gs_device_t *device, const struct gs_init_data *data);
 	void (*device_resize)(gs_device_t *device, uint32_t x, uint32_t y);
@@ -178,6 +180,11 @@ struct gs_exports {
 	bool (*gs_texture_map)(gs_texture_t *tex, uint8_t **ptr,
 			       uint32_t *linesize);
 	void (*gs_texture_unmap)(gs_texture_t *tex);
+	bool (*gs_texture_set_image_region)(gs_texture_t *tex,
+					    const uint8_t *data,
+					    uint32_t linesize, uint32_t x,
+					    uint32_t y, uint32_t cx,
+					    uint32_t cy);
 	bool (*gs_texture_is_rect)(const gs_texture_t *tex);
 	void *(*gs_texture_get_obj)(const gs_texture_t *tex);
 
@@ -297,6 +297,18 @@ void *gs_get_device_obj(void)
 		thread_graphics->device);
 }
 
+void gs_set_shader_cache_path(const char *path)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p("gs_set_shader_cache_path", path))
+		return;
+
+	if (graphics->exports.device_set_shader_cache_path)
+		graphics->exports.device_set_shader_cache_path(graphics->device,
+							       path);
+}
+
 const char *gs_get_device_name(void)
 {
 	return gs_valid("gs_get_device_name")
@@ -2304,6 +2316,22 @@ void gs_texture_unmap(gs_texture_t *tex)
 	graphics->exports.gs_texture_unmap(tex);
 }
 
+bool gs_texture_set_image_region(gs_texture_t *tex, const uint8_t *data,
+				 uint32_t linesize, uint32_t x, uint32_t y,
+				 uint32_t cx, uint32_t cy)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p2("gs_texture_set_image_region", tex, data))
+		return false;
+
+	if (graphics->exports.gs_texture_set_image_region)
+		return graphics->exports.gs_texture_set_image_region(
+			tex, data, linesize, x, y, cx, cy);
+	else
+		return false;
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	graphics_t *graphics = thread_graphics;
@@ -403,6 +403,14 @@ EXPORT gs_eparam_t *gs_param_get_annotation_by_name(const gs_eparam_t *param,
  * unloading. */
 EXPORT bool gs_effect_loop(gs_effect_t *effect, const char *name);
 
+/** Same as gs_effect_loop, with a technique handle that was looked up once
+ * with gs_effect_get_technique instead of a name. */
+EXPORT bool gs_technique_loop(gs_technique_t *technique);
+
+/** Total number of technique, parameter and pass lookups by name done so
+ * far.  Only meant for debugging, the value wraps around. */
+EXPORT long gs_effect_get_name_lookup_count(void);
+
 /** used internally */
 EXPORT void gs_effect_update_params(gs_effect_t *effect);
 
@@ -508,6 +516,9 @@ EXPORT void gs_leave_context(void);
 EXPORT graphics_t *gs_get_context(void);
 EXPORT void *gs_get_device_obj(void);
 
+/** Directory where the device may keep compiled shaders between sessions */
+EXPORT void gs_set_shader_cache_path(const char *path);
+
 EXPORT void gs_matrix_push(void);
 EXPORT void gs_matrix_pop(void);
 EXPORT void gs_matrix_identity(void);
@@ -735,6 +746,15 @@ gs_texture_get_color_format(const gs_texture_t *tex);
 EXPORT bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr,
 			   uint32_t *linesize);
 EXPORT void gs_texture_unmap(gs_texture_t *tex);
+/**
+ * Uploads a region of a texture.  data points to the top-left pixel of the
+ * region in an image of the given linesize.  Returns false if the region
+ * could not be uploaded, in which case the whole image should be set with
+ * gs_texture_set_image.  (currently GL only)
+ */
+EXPORT bool gs_texture_set_image_region(gs_texture_t *tex, const uint8_t *data,
+					uint32_t linesize, uint32_t x,
+					uint32_t y, uint32_t cx, uint32_t cy);
 /** special-case function (GL only) - specifies whether the texture is a
  * GL_TEXTURE_RECTANGLE type, which doesn't use normalized texture
  * coordinates, doesn't support mipmapping, and requires address clamping */
@@ -18,10 +18,71 @@
 #include "image-file.h"
 #include "../util/base.h"
 #include "../util/platform.h"
+#include "../util/threading.h"
 
 #define blog(level, format, ...) \
 	blog(level, "%s: " format, __FUNCTION__, __VA_ARGS__)
 
+/* animated gifs whose decoded frames fit in this are kept fully decoded,
+ * larger ones are streamed through a ring of frames that fits in it */
+#define GIF_FRAME_CACHE_LIMIT (64 * 1024 * 1024)
+#define GIF_MAX_STREAM_FRAMES 16
+
+/* disposal methods, as defined in libnsgif.c */
+#define GIF_FRAME_CLEAR 2
+#define GIF_FRAME_RESTORE 3
+
+struct gs_image_stream {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	os_event_t *wake;
+
+	/* only used by the decode thread once playback starts */
+	gif_animation gif;
+	size_t frame_size;
+
+	/* frame 0, kept to restart playback without waiting */
+	uint8_t *first_frame;
+
+	/* ring of decoded frames ahead of the play head.  frames are
+	 * numbered by sequence (loop * frame_count + frame) */
+	uint8_t *frames;
+	uint64_t *frame_seqs;
+	size_t num_frames;
+	size_t head;
+	size_t count;
+
+	uint64_t end_seq;
+	uint64_t play_seq;
+	bool restart;
+	bool stop;
+
+	uint64_t decode_time_ns;
+	uint64_t frames_decoded;
+
+	/* graphics thread only */
+	uint64_t shown_seq;
+	uint64_t missed_seq;
+};
+
+struct gs_image_animation {
+	/* set for gifs too large to keep all of their frames decoded, which
+	 * are then decoded ahead of playback on a thread instead */
+	struct gs_image_stream *stream;
+	int uploaded_frame;
+
+	uint64_t decode_time_ns;
+	uint64_t frames_decoded;
+	uint64_t cache_hits;
+	uint64_t cache_misses;
+};
+
+static inline struct gs_image_stream *
+get_stream(const gs_image_file_t *image)
+{
+	return image->animation ? image->animation->stream : NULL;
+}
+
 static void *bi_def_bitmap_create(int width, int height)
 {
 	return bmalloc(width * height * 4);
@@ -60,6 +121,155 @@ static inline int get_full_decoded_gif_size(gs_image_file_t *image)
 	       image->gif.frame_count;
 }
 
+static inline int get_loop_count(const gif_animation *gif)
+{
+	return gif->loop_count >= 0xFFFF ? 0 : gif->loop_count;
+}
+
+static void *stream_thread(void *data)
+{
+	struct gs_image_stream *stream = data;
+	uint64_t frame_count = stream->gif.frame_count;
+	uint64_t seq = 1;
+
+	os_set_thread_name("gif stream decode");
+
+	for (;;) {
+		uint8_t *slot = NULL;
+		uint64_t start;
+		bool wait;
+		bool success;
+
+		pthread_mutex_lock(&stream->mutex);
+
+		if (stream->stop) {
+			pthread_mutex_unlock(&stream->mutex);
+			break;
+		}
+
+		/* frame 0 is decoded again to reset the decoder's canvas */
+		if (stream->restart) {
+			stream->restart = false;
+			seq = 0;
+		}
+
+		/* more than a loop behind, skip to the loop being played */
+		if (stream->play_seq > seq + frame_count)
+			seq = stream->play_seq - stream->play_seq % frame_count;
+
+		wait = (stream->end_seq && seq >= stream->end_seq) ||
+		       (seq && stream->count == stream->num_frames);
+
+		if (!wait && seq) {
+			size_t idx = (stream->head + stream->count) %
+				     stream->num_frames;
+			slot = stream->frames + idx * stream->frame_size;
+		}
+
+		pthread_mutex_unlock(&stream->mutex);
+
+		if (wait) {
+			os_event_wait(stream->wake);
+			continue;
+		}
+
+		start = os_gettime_ns();
+		success = gif_decode_frame(&stream->gif,
+					   (unsigned int)(seq % frame_count)) ==
+			  GIF_OK;
+		if (success && slot)
+			memcpy(slot, stream->gif.frame_image,
+			       stream->frame_size);
+
+		pthread_mutex_lock(&stream->mutex);
+
+		stream->decode_time_ns += os_gettime_ns() - start;
+		stream->frames_decoded++;
+
+		/* a restart while decoding invalidates the slot */
+		if (slot && !stream->restart) {
+			size_t idx = (stream->head + stream->count) %
+				     stream->num_frames;
+			stream->frame_seqs[idx] = seq;
+			stream->count++;
+		}
+
+		pthread_mutex_unlock(&stream->mutex);
+
+		if (!success)
+			blog(LOG_WARNING, "Couldn't decode frame %u",
+			     (unsigned int)(seq % frame_count));
+		seq++;
+	}
+
+	return NULL;
+}
+
+static bool init_stream(gs_image_file_t *image)
+{
+	struct gs_image_stream *stream = bzalloc(sizeof(*stream));
+	int loops = get_loop_count(&image->gif);
+
+	stream->frame_size = (size_t)image->gif.width * image->gif.height * 4;
+	stream->num_frames = GIF_FRAME_CACHE_LIMIT / stream->frame_size;
+	if (stream->num_frames > GIF_MAX_STREAM_FRAMES)
+		stream->num_frames = GIF_MAX_STREAM_FRAMES;
+	if (!stream->num_frames)
+		stream->num_frames = 1;
+
+	stream->first_frame = bmemdup(image->gif.frame_image,
+				      stream->frame_size);
+	stream->frames = bmalloc(stream->frame_size * stream->num_frames);
+	stream->frame_seqs =
+		bzalloc(sizeof(*stream->frame_seqs) * stream->num_frames);
+	stream->end_seq = (uint64_t)loops * image->gif.frame_count;
+
+	/* the decode thread takes over the decoder, image->gif is only used
+	 * for frame timing from here on */
+	stream->gif = image->gif;
+
+	if (pthread_mutex_init(&stream->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (os_event_init(&stream->wake, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail_event;
+	if (pthread_create(&stream->thread, NULL, stream_thread, stream) != 0)
+		goto fail_thread;
+
+	image->animation->stream = stream;
+	return true;
+
+fail_thread:
+	os_event_destroy(stream->wake);
+fail_event:
+	pthread_mutex_destroy(&stream->mutex);
+fail_mutex:
+	blog(LOG_WARNING, "Failed to start decode thread for %ux%u gif",
+	     image->gif.width, image->gif.height);
+	bfree(stream->first_frame);
+	bfree(stream->frames);
+	bfree(stream->frame_seqs);
+	bfree(stream);
+	return false;
+}
+
+static void free_stream(struct gs_image_stream *stream)
+{
+	pthread_mutex_lock(&stream->mutex);
+	stream->stop = true;
+	pthread_mutex_unlock(&stream->mutex);
+
+	os_event_signal(stream->wake);
+	pthread_join(stream->thread, NULL);
+
+	gif_finalise(&stream->gif);
+	os_event_destroy(stream->wake);
+	pthread_mutex_destroy(&stream->mutex);
+	bfree(stream->first_frame);
+	bfree(stream->frames);
+	bfree(stream->frame_seqs);
+	bfree(stream);
+}
+
 static inline void *alloc_mem(gs_image_file_t *image, uint64_t *mem_usage,
 			      size_t size)
 {
@@ -125,14 +335,35 @@ static bool init_animated_gif(gs_image_file_t *image, const char *path,
 	max_size = (uint64_t)image->gif.width * (uint64_t)image->gif.height *
 		   (uint64_t)image->gif.frame_count * 4LLU;
 
-	if ((uint64_t)get_full_decoded_gif_size(image) != max_size) {
+	image->is_animated_gif = (image->gif.frame_count > 1 && result >= 0);
+	if (image->is_animated_gif)
+		image->animation = bzalloc(sizeof(struct gs_image_animation));
+
+	if (image->is_animated_gif && max_size > GIF_FRAME_CACHE_LIMIT) {
+		gif_decode_frame(&image->gif, 0);
+
+		image->cx = (uint32_t)image->gif.width;
+		image->cy = (uint32_t)image->gif.height;
+		image->format = GS_RGBA;
+
+		if (!init_stream(image))
+			goto fail;
+
+		/* ring, first frame and the frame being decoded */
+		if (mem_usage) {
+			struct gs_image_stream *stream = get_stream(image);
+
+			*mem_usage += stream->frame_size *
+				      (stream->num_frames + 2);
+			*mem_usage += size;
+		}
+
+	} else if ((uint64_t)get_full_decoded_gif_size(image) != max_size) {
 		blog(LOG_WARNING, "Gif '%s' overflowed maximum pointer size",
 		     path);
 		goto fail;
-	}
 
-	image->is_animated_gif = (image->gif.frame_count > 1 && result >= 0);
-	if (image->is_animated_gif) {
+	} else if (image->is_animated_gif) {
 		gif_decode_frame(&image->gif, 0);
 
 		image->animation_frame_cache =
@@ -225,7 +456,9 @@ void gs_image_file_free(gs_image_file_t *image)
 		return;
 
 	if (image->loaded) {
-		if (image->is_animated_gif) {
+		if (get_stream(image)) {
+			free_stream(get_stream(image));
+		} else if (image->is_animated_gif) {
 			gif_finalise(&image->gif);
 			bfree(image->animation_frame_cache);
 			bfree(image->animation_frame_data);
@@ -236,6 +469,7 @@ void gs_image_file_free(gs_image_file_t *image)
 
 	bfree(image->texture_data);
 	bfree(image->gif_data);
+	bfree(image->animation);
 	memset(image, 0, sizeof(*image));
 }
 
@@ -249,10 +483,18 @@ void gs_image_file_init_texture(gs_image_file_t *image)
 	if (!image->loaded)
 		return;
 
-	if (image->is_animated_gif) {
+	if (get_stream(image)) {
+		image->texture = gs_texture_create(
+			image->cx, image->cy, image->format, 1,
+			(const uint8_t **)&get_stream(image)->first_frame,
+			GS_DYNAMIC);
+		image->animation->uploaded_frame = 0;
+
+	} else if (image->is_animated_gif) {
 		image->texture = gs_texture_create(
 			image->cx, image->cy, image->format, 1,
 			(const uint8_t **)&image->gif.frame_image, GS_DYNAMIC);
+		image->animation->uploaded_frame = 0;
 
 	} else {
 		image->texture = gs_texture_create(
@@ -298,9 +540,16 @@ static inline int calculate_new_frame(gs_image_file_t *image,
 
 static void decode_new_frame(gs_image_file_t *image, int new_frame)
 {
-	if (!image->animation_frame_cache[new_frame]) {
+	struct gs_image_animation *anim = image->animation;
+
+	if (image->animation_frame_cache[new_frame]) {
+		anim->cache_hits++;
+	} else {
+		uint64_t start = os_gettime_ns();
 		int last_frame;
 
+		anim->cache_misses++;
+
 		/* if looped, decode frame 0 */
 		last_frame = (new_frame < image->last_decoded_frame)
 				     ? 0
@@ -308,8 +557,12 @@ static void decode_new_frame(gs_image_file_t *image, int new_frame)
 
 		/* decode missed frames */
 		for (int i = last_frame; i < new_frame; i++) {
-			if (gif_decode_frame(&image->gif, i) != GIF_OK)
+			anim->frames_decoded++;
+			if (gif_decode_frame(&image->gif, i) != GIF_OK) {
+				anim->decode_time_ns +=
+					os_gettime_ns() - start;
 				return;
+			}
 		}
 
 		/* decode actual desired frame */
@@ -325,33 +578,163 @@ static void decode_new_frame(gs_image_file_t *image, int new_frame)
 
 			image->last_decoded_frame = new_frame;
 		}
+
+		anim->frames_decoded++;
+		anim->decode_time_ns += os_gettime_ns() - start;
 	}
 
 	image->cur_frame = new_frame;
 }
 
+/* moves the play head of a streamed gif forward to new_frame */
+static void advance_stream(gs_image_file_t *image, int new_frame)
+{
+	struct gs_image_stream *stream = image->animation->stream;
+	int frame_count = (int)image->gif.frame_count;
+	int frames = (new_frame - image->cur_frame + frame_count) % frame_count;
+
+	pthread_mutex_lock(&stream->mutex);
+	stream->play_seq += frames;
+	pthread_mutex_unlock(&stream->mutex);
+
+	image->cur_frame = new_frame;
+}
+
 bool gs_image_file_tick(gs_image_file_t *image, uint64_t elapsed_time_ns)
 {
+	struct gs_image_stream *stream;
 	int loops;
 
 	if (!image->is_animated_gif || !image->loaded)
 		return false;
 
-	loops = image->gif.loop_count;
-	if (loops >= 0xFFFF)
-		loops = 0;
+	loops = get_loop_count(&image->gif);
 
 	if (!loops || image->cur_loop < loops) {
 		int new_frame =
 			calculate_new_frame(image, elapsed_time_ns, loops);
 
 		if (new_frame != image->cur_frame) {
-			decode_new_frame(image, new_frame);
+			if (image->animation->stream)
+				advance_stream(image, new_frame);
+			else
+				decode_new_frame(image, new_frame);
 			return true;
 		}
 	}
 
-	return false;
+	/* the frame to show was not decoded yet on the last update */
+	stream = image->animation->stream;
+	return stream && stream->shown_seq != stream->play_seq;
+}
+
+/* a frame drawn on top of the one before it only changes its own redraw
+ * area, so when that one is in the texture only the area is uploaded.
+ * frames following a disposed one are uploaded whole. */
+static void upload_frame(gs_image_file_t *image, const uint8_t *data,
+			 int frame)
+{
+	struct gs_image_animation *anim = image->animation;
+	uint32_t linesize = image->cx * 4;
+
+	if (frame > 0 && anim->uploaded_frame == frame - 1 &&
+	    image->gif.frames[frame - 1].disposal_method != GIF_FRAME_CLEAR &&
+	    image->gif.frames[frame - 1].disposal_method != GIF_FRAME_RESTORE) {
+		const gif_frame *cur = &image->gif.frames[frame];
+		uint32_t x1 = cur->redraw_x;
+		uint32_t y1 = cur->redraw_y;
+		uint32_t x2 = cur->redraw_x + cur->redraw_width;
+		uint32_t y2 = cur->redraw_y + cur->redraw_height;
+
+		if (x2 > image->cx)
+			x2 = image->cx;
+		if (y2 > image->cy)
+			y2 = image->cy;
+
+		if (x1 >= x2 || y1 >= y2 ||
+		    gs_texture_set_image_region(image->texture,
+						data + y1 * linesize + x1 * 4,
+						linesize, x1, y1, x2 - x1,
+						y2 - y1)) {
+			anim->uploaded_frame = frame;
+			return;
+		}
+	}
+
+	gs_texture_set_image(image->texture, data, linesize, false);
+	anim->uploaded_frame = frame;
+}
+
+/* drops the frames the play head has passed and returns the newest one that
+ * is not ahead of it */
+static const uint8_t *get_stream_frame(struct gs_image_stream *stream,
+				       uint64_t *seq)
+{
+	const uint8_t *data = NULL;
+	size_t dropped = 0;
+
+	pthread_mutex_lock(&stream->mutex);
+
+	if (stream->play_seq == 0) {
+		data = stream->first_frame;
+		*seq = 0;
+	} else {
+		while (stream->count > 1) {
+			size_t next = (stream->head + 1) % stream->num_frames;
+			if (stream->frame_seqs[next] > stream->play_seq)
+				break;
+
+			stream->head = next;
+			stream->count--;
+			dropped++;
+		}
+
+		if (stream->count &&
+		    stream->frame_seqs[stream->head] <= stream->play_seq) {
+			data = stream->frames +
+			       stream->head * stream->frame_size;
+			*seq = stream->frame_seqs[stream->head];
+		}
+	}
+
+	pthread_mutex_unlock(&stream->mutex);
+
+	if (dropped)
+		os_event_signal(stream->wake);
+	return data;
+}
+
+static void update_stream_texture(gs_image_file_t *image)
+{
+	struct gs_image_animation *anim = image->animation;
+	struct gs_image_stream *stream = anim->stream;
+	uint64_t frame_count = image->gif.frame_count;
+	uint64_t play_seq;
+	const uint8_t *data;
+	uint64_t seq;
+
+	pthread_mutex_lock(&stream->mutex);
+	play_seq = stream->play_seq;
+	pthread_mutex_unlock(&stream->mutex);
+
+	data = get_stream_frame(stream, &seq);
+
+	if (data && seq == play_seq) {
+		if (stream->missed_seq != play_seq)
+			anim->cache_hits++;
+	} else if (stream->missed_seq != play_seq) {
+		stream->missed_seq = play_seq;
+		anim->cache_misses++;
+	}
+
+	if (!data || seq == stream->shown_seq)
+		return;
+
+	if (seq != stream->shown_seq + 1)
+		anim->uploaded_frame = -1;
+
+	upload_frame(image, data, (int)(seq % frame_count));
+	stream->shown_seq = seq;
 }
 
 void gs_image_file_update_texture(gs_image_file_t *image)
@@ -359,10 +742,57 @@ void gs_image_file_update_texture(gs_image_file_t *image)
 	if (!image->is_animated_gif || !image->loaded)
 		return;
 
+	if (image->animation->stream) {
+		update_stream_texture(image);
+		return;
+	}
+
 	if (!image->animation_frame_cache[image->cur_frame])
 		decode_new_frame(image, image->cur_frame);
 
-	gs_texture_set_image(image->texture,
-			     image->animation_frame_cache[image->cur_frame],
-			     image->gif.width * 4, false);
+	upload_frame(image, image->animation_frame_cache[image->cur_frame],
+		     image->cur_frame);
+}
+
+void gs_image_file_reset_animation(gs_image_file_t *image)
+{
+	struct gs_image_stream *stream = get_stream(image);
+
+	image->cur_frame = 0;
+	image->cur_loop = 0;
+	image->cur_time = 0;
+
+	if (stream) {
+		pthread_mutex_lock(&stream->mutex);
+		stream->play_seq = 0;
+		stream->count = 0;
+		stream->restart = true;
+		pthread_mutex_unlock(&stream->mutex);
+
+		os_event_signal(stream->wake);
+	}
+}
+
+void gs_image_file_get_stats(const gs_image_file_t *image,
+			     struct gs_image_file_stats *stats)
+{
+	const struct gs_image_animation *anim = image->animation;
+	struct gs_image_stream *stream = get_stream(image);
+
+	memset(stats, 0, sizeof(*stats));
+	if (!anim)
+		return;
+
+	stats->decode_time_ns = anim->decode_time_ns;
+	stats->frames_decoded = anim->frames_decoded;
+	stats->cache_hits = anim->cache_hits;
+	stats->cache_misses = anim->cache_misses;
+	stats->streaming = !!stream;
+
+	if (stream) {
+		pthread_mutex_lock(&stream->mutex);
+		stats->decode_time_ns += stream->decode_time_ns;
+		stats->frames_decoded += stream->frames_decoded;
+		pthread_mutex_unlock(&stream->mutex);
+	}
 }
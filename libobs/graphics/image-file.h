@@ -24,6 +24,8 @@
 extern "C" {
 #endif
 
+struct gs_image_animation;
+
 struct gs_image_file {
 	gs_texture_t *texture;
 	enum gs_color_format format;
@@ -44,6 +46,17 @@ struct gs_image_file {
 
 	uint8_t *texture_data;
 	gif_bitmap_callback_vt bitmap_callbacks;
+
+	/* playback state of animated gifs, private to libobs */
+	struct gs_image_animation *animation;
+};
+
+struct gs_image_file_stats {
+	uint64_t decode_time_ns;
+	uint64_t frames_decoded;
+	uint64_t cache_hits;
+	uint64_t cache_misses;
+	bool streaming;
 };
 
 struct gs_image_file2 {
@@ -61,6 +74,9 @@ EXPORT void gs_image_file_init_texture(gs_image_file_t *image);
 EXPORT bool gs_image_file_tick(gs_image_file_t *image,
 			       uint64_t elapsed_time_ns);
 EXPORT void gs_image_file_update_texture(gs_image_file_t *image);
+EXPORT void gs_image_file_reset_animation(gs_image_file_t *image);
+EXPORT void gs_image_file_get_stats(const gs_image_file_t *image,
+				    struct gs_image_file_stats *stats);
 
 EXPORT void gs_image_file2_init(gs_image_file2_t *if2, const char *file);
 
@@ -86,6 +102,11 @@ static inline void gs_image_file2_update_texture(gs_image_file2_t *if2)
 	gs_image_file_update_texture(&if2->image);
 }
 
+static inline void gs_image_file2_reset_animation(gs_image_file2_t *if2)
+{
+	gs_image_file_reset_animation(&if2->image);
+}
+
 #ifdef __cplusplus
 }
 #endif
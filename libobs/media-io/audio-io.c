@@ -26,6 +26,7 @@
 #include "../util/util_uint64.h"
 
 #include "audio-io.h"
+#include "audio-kernels.h"
 #include "audio-resampler.h"
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
@@ -63,6 +64,7 @@ struct audio_output {
 
 	pthread_t thread;
 	os_event_t *stop_event;
+	volatile bool low_latency;
 
 	bool initialized;
 
@@ -133,17 +135,8 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 		if (!mix->inputs.num)
 			continue;
 
-		for (size_t plane = 0; plane < audio->planes; plane++) {
-			float *mix_data = mix->buffer[plane];
-			float *mix_end = &mix_data[float_size];
-
-			while (mix_data < mix_end) {
-				float val = *mix_data;
-				val = (val > 1.0f) ? 1.0f : val;
-				val = (val < -1.0f) ? -1.0f : val;
-				*(mix_data++) = val;
-			}
-		}
+		for (size_t plane = 0; plane < audio->planes; plane++)
+			audio_clamp(mix->buffer[plane], float_size);
 	}
 }
 
@@ -195,6 +188,23 @@ static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
 }
 
+/* in low latency mode, the end of the wait polls the clock instead of
+ * depending on how quickly the scheduler wakes the thread up */
+#define LOW_LATENCY_POLL_NS 500000ULL
+
+static inline void wait_for_tick(struct audio_output *audio, uint64_t time)
+{
+	if (audio->low_latency && time > LOW_LATENCY_POLL_NS) {
+		os_sleepto_ns(time - LOW_LATENCY_POLL_NS);
+		while (os_gettime_ns() < time)
+			;
+	} else {
+		os_sleepto_ns(time);
+	}
+}
+
+static const char *audio_tick_lateness_name = "audio_tick_lateness";
+
 static void *audio_thread(void *param)
 {
 	struct audio_output *audio = param;
@@ -203,8 +213,6 @@ static void *audio_thread(void *param)
 	uint64_t start_time = os_gettime_ns();
 	uint64_t prev_time = start_time;
 	uint64_t audio_time = prev_time;
-	uint32_t audio_wait_time = (uint32_t)(
-		audio_frames_to_ns(rate, AUDIO_OUTPUT_FRAMES) / 1000000);
 
 	os_set_thread_name("audio-io: audio thread");
 
@@ -215,11 +223,17 @@ static void *audio_thread(void *param)
 	while (os_event_try(audio->stop_event) == EAGAIN) {
 		uint64_t cur_time;
 
-		os_sleep_ms(audio_wait_time);
+		/* wake up when the next tick is due, the ticks are only
+		 * processed back to back if the thread could not keep up */
+		wait_for_tick(audio, audio_time);
 
 		profile_start(audio_thread_name);
 
 		cur_time = os_gettime_ns();
+		profile_record(audio_tick_lateness_name,
+			       cur_time > audio_time ? cur_time - audio_time
+						     : 0);
+
 		while (audio_time <= cur_time) {
 			samples += AUDIO_OUTPUT_FRAMES;
 			audio_time =
@@ -422,6 +436,14 @@ const struct audio_output_info *audio_output_get_info(const audio_t *audio)
 	return audio ? &audio->info : NULL;
 }
 
+void audio_output_set_low_latency(audio_t *audio, bool low_latency)
+{
+	if (!audio)
+		return;
+
+	audio->low_latency = low_latency;
+}
+
 bool audio_output_active(const audio_t *audio)
 {
 	if (!audio)
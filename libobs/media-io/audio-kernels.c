@@ -0,0 +1,205 @@
+/******************************************************************************
+    Copyright (C) 2020 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "audio-kernels.h"
+
+#include "../util/sse-intrin.h"
+
+#define S16_SCALE 32767.0f
+
+void audio_mix_add(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 out = _mm_loadu_ps(dst + i);
+		__m128 in = _mm_loadu_ps(src + i);
+		_mm_storeu_ps(dst + i, _mm_add_ps(out, in));
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+void audio_mix_add_gain(float *dst, const float *src, const float *gain,
+			size_t count)
+{
+	size_t i = 0;
+
+	/* two vectors per iteration, with three streams a single one stalls
+	 * on its loads */
+	for (; i + 8 <= count; i += 8) {
+		__m128 in0 = _mm_mul_ps(_mm_loadu_ps(src + i),
+					_mm_loadu_ps(gain + i));
+		__m128 in1 = _mm_mul_ps(_mm_loadu_ps(src + i + 4),
+					_mm_loadu_ps(gain + i + 4));
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), in0));
+		_mm_storeu_ps(dst + i + 4,
+			      _mm_add_ps(_mm_loadu_ps(dst + i + 4), in1));
+	}
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 out = _mm_loadu_ps(dst + i);
+		__m128 in = _mm_mul_ps(_mm_loadu_ps(src + i),
+				       _mm_loadu_ps(gain + i));
+		_mm_storeu_ps(dst + i, _mm_add_ps(out, in));
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i] * gain[i];
+}
+
+void audio_mix_add_ramp(float *dst, const float *src, float gain, float step,
+			size_t count)
+{
+	__m128 cur = _mm_set_ps(gain + step * 3.0f, gain + step * 2.0f,
+				gain + step, gain);
+	__m128 inc = _mm_set1_ps(step * 4.0f);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 out = _mm_loadu_ps(dst + i);
+		__m128 in = _mm_mul_ps(_mm_loadu_ps(src + i), cur);
+		_mm_storeu_ps(dst + i, _mm_add_ps(out, in));
+		cur = _mm_add_ps(cur, inc);
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i] * (gain + step * (float)i);
+}
+
+void audio_mul(float *data, float vol, size_t count)
+{
+	__m128 vol_val = _mm_set1_ps(vol);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(data + i,
+			      _mm_mul_ps(_mm_loadu_ps(data + i), vol_val));
+
+	for (; i < count; i++)
+		data[i] *= vol;
+}
+
+void audio_mul_buf(float *data, const float *vol, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i),
+						   _mm_loadu_ps(vol + i)));
+
+	for (; i < count; i++)
+		data[i] *= vol[i];
+}
+
+static inline float clamp_sample(float val)
+{
+	val = (val > 1.0f) ? 1.0f : val;
+	val = (val < -1.0f) ? -1.0f : val;
+	return val;
+}
+
+void audio_clamp(float *data, size_t count)
+{
+	__m128 max_val = _mm_set1_ps(1.0f);
+	__m128 min_val = _mm_set1_ps(-1.0f);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 val = _mm_loadu_ps(data + i);
+		val = _mm_max_ps(_mm_min_ps(val, max_val), min_val);
+		_mm_storeu_ps(data + i, val);
+	}
+
+	for (; i < count; i++)
+		data[i] = clamp_sample(data[i]);
+}
+
+void audio_float_to_s16(int16_t *dst, const float *src, size_t count)
+{
+	__m128 max_val = _mm_set1_ps(1.0f);
+	__m128 min_val = _mm_set1_ps(-1.0f);
+	__m128 scale = _mm_set1_ps(S16_SCALE);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 lo = _mm_loadu_ps(src + i);
+		__m128 hi = _mm_loadu_ps(src + i + 4);
+
+		lo = _mm_max_ps(_mm_min_ps(lo, max_val), min_val);
+		hi = _mm_max_ps(_mm_min_ps(hi, max_val), min_val);
+
+		__m128i packed =
+			_mm_packs_epi32(_mm_cvttps_epi32(_mm_mul_ps(lo, scale)),
+					_mm_cvttps_epi32(_mm_mul_ps(hi, scale)));
+		_mm_storeu_si128((__m128i *)(dst + i), packed);
+	}
+
+	for (; i < count; i++)
+		dst[i] = (int16_t)(clamp_sample(src[i]) * S16_SCALE);
+}
+
+void audio_interleave(float *dst, const float *const *src, size_t channels,
+		      size_t frames)
+{
+	size_t i = 0;
+
+	if (channels == 2) {
+		const float *left = src[0];
+		const float *right = src[1];
+
+		for (; i + 4 <= frames; i += 4) {
+			__m128 l = _mm_loadu_ps(left + i);
+			__m128 r = _mm_loadu_ps(right + i);
+			_mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(l, r));
+			_mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(l, r));
+		}
+	}
+
+	for (; i < frames; i++) {
+		for (size_t ch = 0; ch < channels; ch++)
+			dst[i * channels + ch] = src[ch][i];
+	}
+}
+
+void audio_deinterleave(float *const *dst, const float *src, size_t channels,
+			size_t frames)
+{
+	size_t i = 0;
+
+	if (channels == 2) {
+		float *left = dst[0];
+		float *right = dst[1];
+
+		for (; i + 4 <= frames; i += 4) {
+			__m128 a = _mm_loadu_ps(src + i * 2);
+			__m128 b = _mm_loadu_ps(src + i * 2 + 4);
+			_mm_storeu_ps(left + i,
+				      _mm_shuffle_ps(a, b,
+						     _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(right + i,
+				      _mm_shuffle_ps(a, b,
+						     _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+
+	for (; i < frames; i++) {
+		for (size_t ch = 0; ch < channels; ch++)
+			dst[ch][i] = src[i * channels + ch];
+	}
+}
@@ -0,0 +1,66 @@
+/******************************************************************************
+    Copyright (C) 2020 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Vectorized kernels for float audio.  Buffers do not need to be aligned and
+ * counts do not need to be a multiple of the vector size.
+ */
+
+/* dst[i] += src[i] */
+EXPORT void audio_mix_add(float *dst, const float *src, size_t count);
+
+/* dst[i] += src[i] * gain[i] */
+EXPORT void audio_mix_add_gain(float *dst, const float *src,
+			       const float *gain, size_t count);
+
+/* dst[i] += src[i] * (gain + step * i) */
+EXPORT void audio_mix_add_ramp(float *dst, const float *src, float gain,
+			       float step, size_t count);
+
+/* data[i] *= vol */
+EXPORT void audio_mul(float *data, float vol, size_t count);
+
+/* data[i] *= vol[i] */
+EXPORT void audio_mul_buf(float *data, const float *vol, size_t count);
+
+/* clamps data to -1.0..1.0 */
+EXPORT void audio_clamp(float *data, size_t count);
+
+/* clamps src to -1.0..1.0 and scales it to 16 bit, rounding toward zero */
+EXPORT void audio_float_to_s16(int16_t *dst, const float *src, size_t count);
+
+/*
+ * Conversion between planar and interleaved float audio
+ */
+
+EXPORT void audio_interleave(float *dst, const float *const *src,
+			     size_t channels, size_t frames);
+
+EXPORT void audio_deinterleave(float *const *dst, const float *src,
+			       size_t channels, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
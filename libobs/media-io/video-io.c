@@ -31,31 +31,75 @@
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
-#define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
+#define MAX_INPUT_QUEUE 2
 
 struct cached_frame_info {
 	struct video_data frame;
 	int skipped;
 	int count;
+
+	/* waiting to be output by the video thread, next queued frame */
+	bool queued;
+	size_t next;
+
+	/* frames still queued to or being output by input threads */
+	long refs;
+};
+
+struct video_input_frame {
+	struct cached_frame_info *info;
+	struct video_data frame;
+};
+
+struct converted_frame {
+	struct video_frame frame;
+	uint64_t timestamp;
+	bool valid;
+	long refs;
+};
+
+/* scaler shared by all inputs with the same conversion, so that a frame is
+ * converted once per target no matter how many inputs want it */
+struct video_conversion {
+	struct video_scale_info info;
+	video_scaler_t *scaler;
+	long inputs;
+
+	pthread_mutex_t mutex;
+	DARRAY(struct converted_frame *) frames;
 };
 
 struct video_input {
+	struct video_output *video;
 	struct video_scale_info conversion;
-	video_scaler_t *scaler;
-	struct video_frame frame[MAX_CONVERT_BUFFERS];
-	int cur_frame;
+	struct video_conversion *converter;
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
-};
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
+	/* parallel inputs: scaled and output from a thread of their own, a
+	 * frame is skipped for this input only when its queue is full */
+	bool threaded;
+	pthread_t thread;
+	volatile bool stop;
+
+	/* the thread is being joined without input_mutex held, in which
+	 * case frames are skipped for this input.  removed: disconnected
+	 * meanwhile, freed by whoever joins the thread.  detached: the
+	 * input was disconnected from its own thread, which frees it. */
+	bool stopping;
+	bool removed;
+	bool detached;
+	os_sem_t *queue_sem;
+	pthread_mutex_t queue_mutex;
+	struct video_input_frame queue[MAX_INPUT_QUEUE];
+	size_t queue_start;
+	size_t queue_num;
+
+	long skipped_frames;
+	long total_frames;
+};
 
 struct video_output {
 	struct video_output_info info;
@@ -72,9 +116,16 @@ struct video_output {
 	bool initialized;
 
 	pthread_mutex_t input_mutex;
-	DARRAY(struct video_input) inputs;
+	DARRAY(struct video_input *) inputs;
+	DARRAY(struct video_conversion *) conversions;
+	bool parallel_inputs;
+
+	/* detached input threads still running, signaled with input_cond */
+	size_t detached_inputs;
+	pthread_cond_t input_cond;
 
 	size_t available_frames;
+	size_t queued_frames;
 	size_t first_added;
 	size_t last_added;
 	struct cached_frame_info cache[MAX_CACHE_SIZE];
@@ -85,35 +136,334 @@ struct video_output {
 
 /* ------------------------------------------------------------------------- */
 
-static inline bool scale_video_output(struct video_input *input,
-				      struct video_data *data)
+static inline bool scale_info_equal(const struct video_scale_info *a,
+				    const struct video_scale_info *b)
 {
-	bool success = true;
+	return a->format == b->format && a->width == b->width &&
+	       a->height == b->height && a->range == b->range &&
+	       a->colorspace == b->colorspace;
+}
 
-	if (input->scaler) {
-		struct video_frame *frame;
+/* Returns a referenced frame holding the converted data, which is only
+ * scaled if no other input already converted this frame. */
+static struct converted_frame *convert_frame(struct video_conversion *conv,
+					     struct video_data *data)
+{
+	struct converted_frame *converted = NULL;
+	struct converted_frame *unused = NULL;
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+	pthread_mutex_lock(&conv->mutex);
 
-		frame = &input->frame[input->cur_frame];
+	for (size_t i = 0; i < conv->frames.num; i++) {
+		struct converted_frame *cur = conv->frames.array[i];
 
-		success = video_scaler_scale(input->scaler, frame->data,
-					     frame->linesize,
-					     (const uint8_t *const *)data->data,
-					     data->linesize);
+		if (cur->valid && cur->timestamp == data->timestamp) {
+			converted = cur;
+			break;
+		}
+		if (!unused && !cur->refs)
+			unused = cur;
+	}
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i] = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
-		} else {
+	if (!converted) {
+		/* every frame is held by input threads still outputting */
+		if (!unused) {
+			unused = bzalloc(sizeof(*unused));
+			video_frame_init(&unused->frame, conv->info.format,
+					 conv->info.width, conv->info.height);
+			da_push_back(conv->frames, &unused);
+		}
+
+		unused->valid = video_scaler_scale(
+			conv->scaler, unused->frame.data,
+			unused->frame.linesize,
+			(const uint8_t *const *)data->data, data->linesize);
+		unused->timestamp = data->timestamp;
+
+		if (unused->valid)
+			converted = unused;
+		else
 			blog(LOG_WARNING, "video-io: Could not scale frame!");
+	}
+
+	if (converted)
+		converted->refs++;
+
+	pthread_mutex_unlock(&conv->mutex);
+
+	if (converted) {
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			data->data[i] = converted->frame.data[i];
+			data->linesize[i] = converted->frame.linesize[i];
 		}
 	}
 
-	return success;
+	return converted;
+}
+
+static inline void output_video_input(struct video_input *input,
+				      struct video_data *data)
+{
+	struct video_conversion *conv = input->converter;
+	struct converted_frame *converted = NULL;
+
+	if (conv) {
+		converted = convert_frame(conv, data);
+		if (!converted)
+			return;
+	}
+
+	input->callback(input->param, data);
+
+	if (converted) {
+		pthread_mutex_lock(&conv->mutex);
+		converted->refs--;
+		pthread_mutex_unlock(&conv->mutex);
+	}
+}
+
+/* A cached frame can be reused once the video thread is done with it and no
+ * input thread holds it anymore.  Call with data_mutex locked. */
+static inline void release_cached_frame(struct video_output *video,
+					struct cached_frame_info *frame_info)
+{
+	if (!frame_info->queued && frame_info->refs == 0)
+		video->available_frames++;
+}
+
+static void queue_input_frame(struct video_input *input,
+			      struct cached_frame_info *frame_info,
+			      const struct video_data *frame)
+{
+	struct video_output *video = input->video;
+	bool queued = false;
+
+	input->total_frames++;
+
+	pthread_mutex_lock(&input->queue_mutex);
+
+	if (input->queue_num < MAX_INPUT_QUEUE) {
+		size_t idx = (input->queue_start + input->queue_num) %
+			     MAX_INPUT_QUEUE;
+
+		pthread_mutex_lock(&video->data_mutex);
+		frame_info->refs++;
+		pthread_mutex_unlock(&video->data_mutex);
+
+		input->queue[idx].info = frame_info;
+		input->queue[idx].frame = *frame;
+		input->queue_num++;
+		queued = true;
+	}
+
+	pthread_mutex_unlock(&input->queue_mutex);
+
+	if (queued)
+		os_sem_post(input->queue_sem);
+	else
+		input->skipped_frames++;
+}
+
+static void video_input_detached_exit(struct video_input *input);
+
+static void *video_input_thread(void *param)
+{
+	struct video_input *input = param;
+	struct video_output *video = input->video;
+
+	os_set_thread_name("video-io: input thread");
+
+	while (os_sem_wait(input->queue_sem) == 0) {
+		struct video_input_frame item;
+		bool empty;
+
+		pthread_mutex_lock(&input->queue_mutex);
+
+		empty = input->queue_num == 0;
+		if (!empty) {
+			item = input->queue[input->queue_start];
+			if (++input->queue_start == MAX_INPUT_QUEUE)
+				input->queue_start = 0;
+			input->queue_num--;
+		}
+
+		pthread_mutex_unlock(&input->queue_mutex);
+
+		if (empty) {
+			if (os_atomic_load_bool(&input->stop))
+				break;
+			continue;
+		}
+
+		/* frames still queued on disconnect are only released */
+		if (!os_atomic_load_bool(&input->stop))
+			output_video_input(input, &item.frame);
+
+		pthread_mutex_lock(&video->data_mutex);
+		if (--item.info->refs == 0)
+			release_cached_frame(video, item.info);
+		pthread_mutex_unlock(&video->data_mutex);
+	}
+
+	if (input->detached)
+		video_input_detached_exit(input);
+	return NULL;
+}
+
+static struct video_conversion *
+video_conversion_get(struct video_output *video,
+		     const struct video_scale_info *info)
+{
+	struct video_conversion *conv;
+
+	for (size_t i = 0; i < video->conversions.num; i++) {
+		conv = video->conversions.array[i];
+		if (scale_info_equal(&conv->info, info)) {
+			conv->inputs++;
+			return conv;
+		}
+	}
+
+	struct video_scale_info from = {.format = video->info.format,
+					.width = video->info.width,
+					.height = video->info.height,
+					.range = video->info.range,
+					.colorspace = video->info.colorspace};
+
+	conv = bzalloc(sizeof(*conv));
+	conv->info = *info;
+
+	int ret = video_scaler_create(&conv->scaler, &conv->info, &from,
+				      VIDEO_SCALE_FAST_BILINEAR);
+	if (ret != VIDEO_SCALER_SUCCESS) {
+		if (ret == VIDEO_SCALER_BAD_CONVERSION)
+			blog(LOG_ERROR, "video_input_init: Bad "
+					"scale conversion type");
+		else
+			blog(LOG_ERROR, "video_input_init: Failed to "
+					"create scaler");
+
+		bfree(conv);
+		return NULL;
+	}
+
+	if (pthread_mutex_init(&conv->mutex, NULL) != 0) {
+		video_scaler_destroy(conv->scaler);
+		bfree(conv);
+		return NULL;
+	}
+
+	conv->inputs = 1;
+	da_push_back(video->conversions, &conv);
+	return conv;
+}
+
+static void video_conversion_release(struct video_output *video,
+				     struct video_conversion *conv)
+{
+	if (--conv->inputs > 0)
+		return;
+
+	da_erase_item(video->conversions, &conv);
+
+	for (size_t i = 0; i < conv->frames.num; i++) {
+		video_frame_free(&conv->frames.array[i]->frame);
+		bfree(conv->frames.array[i]);
+	}
+	da_free(conv->frames);
+
+	pthread_mutex_destroy(&conv->mutex);
+	video_scaler_destroy(conv->scaler);
+	bfree(conv);
+}
+
+static void video_input_start_thread(struct video_input *input)
+{
+	if (os_sem_init(&input->queue_sem, 0) != 0)
+		goto fail;
+	if (pthread_mutex_init(&input->queue_mutex, NULL) != 0) {
+		os_sem_destroy(input->queue_sem);
+		goto fail;
+	}
+	if (pthread_create(&input->thread, NULL, video_input_thread, input) !=
+	    0) {
+		pthread_mutex_destroy(&input->queue_mutex);
+		os_sem_destroy(input->queue_sem);
+		goto fail;
+	}
+
+	input->threaded = true;
+	return;
+
+fail:
+	input->queue_sem = NULL;
+	blog(LOG_WARNING, "video-io: Failed to create input thread, "
+			  "output from the video thread instead");
+}
+
+static inline void video_input_signal_stop(struct video_input *input)
+{
+	os_atomic_set_bool(&input->stop, true);
+	os_sem_post(input->queue_sem);
+}
+
+/* once the thread exited */
+static void video_input_thread_exited(struct video_input *input)
+{
+	pthread_mutex_destroy(&input->queue_mutex);
+	os_sem_destroy(input->queue_sem);
+	input->queue_sem = NULL;
+	input->queue_start = 0;
+	input->queue_num = 0;
+	input->threaded = false;
+	input->stop = false;
+
+	if (input->skipped_frames)
+		blog(LOG_INFO,
+		     "Video input stopped, number of skipped "
+		     "frames due to output lag: %ld/%ld (%0.1f%%)",
+		     input->skipped_frames, input->total_frames,
+		     (double)input->skipped_frames /
+			     (double)input->total_frames * 100.0);
+
+	input->skipped_frames = 0;
+	input->total_frames = 0;
+}
+
+/* frames still queued are released, the input is then output from the video
+ * thread again */
+static void video_input_stop_thread(struct video_input *input)
+{
+	if (!input->threaded)
+		return;
+
+	video_input_signal_stop(input);
+	pthread_join(input->thread, NULL);
+	video_input_thread_exited(input);
+}
+
+static void video_input_free(struct video_input *input)
+{
+	video_input_stop_thread(input);
+
+	if (input->converter)
+		video_conversion_release(input->video, input->converter);
+	bfree(input);
+}
+
+/* an input thread cannot join itself, so an input disconnected from its own
+ * thread is freed by that thread once its loop ends */
+static void video_input_detached_exit(struct video_input *input)
+{
+	struct video_output *video = input->video;
+
+	video_input_thread_exited(input);
+
+	pthread_mutex_lock(&video->input_mutex);
+	video_input_free(input);
+	if (--video->detached_inputs == 0)
+		pthread_cond_broadcast(&video->input_cond);
+	pthread_mutex_unlock(&video->input_mutex);
 }
 
 static inline bool video_output_cur_frame(struct video_output *video)
@@ -135,11 +485,15 @@ static inline bool video_output_cur_frame(struct video_output *video)
 	pthread_mutex_lock(&video->input_mutex);
 
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
+		struct video_input *input = video->inputs.array[i];
 		struct video_data frame = frame_info->frame;
 
-		if (scale_video_output(input, &frame))
-			input->callback(input->param, &frame);
+		if (input->stopping)
+			continue;
+		else if (input->threaded)
+			queue_input_frame(input, frame_info, &frame);
+		else
+			output_video_input(input, &frame);
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
@@ -153,11 +507,10 @@ static inline bool video_output_cur_frame(struct video_output *video)
 	skipped = frame_info->skipped > 0;
 
 	if (complete) {
-		if (++video->first_added == video->info.cache_size)
-			video->first_added = 0;
-
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
+		frame_info->queued = false;
+		video->first_added = frame_info->next;
+		video->queued_frames--;
+		release_cached_frame(video, frame_info);
 	} else if (skipped) {
 		--frame_info->skipped;
 		os_atomic_inc_long(&video->skipped_frames);
@@ -247,6 +600,8 @@ int video_output_open(video_t **video, struct video_output_info *info)
 		goto fail;
 	if (pthread_mutex_init(&out->input_mutex, &attr) != 0)
 		goto fail;
+	if (pthread_cond_init(&out->input_cond, NULL) != 0)
+		goto fail;
 	if (os_sem_init(&out->update_semaphore, 0) != 0)
 		goto fail;
 	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
@@ -270,9 +625,15 @@ void video_output_close(video_t *video)
 
 	video_output_stop(video);
 
+	pthread_mutex_lock(&video->input_mutex);
+	while (video->detached_inputs)
+		pthread_cond_wait(&video->input_cond, &video->input_mutex);
+	pthread_mutex_unlock(&video->input_mutex);
+
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_free(video->inputs.array[i]);
 	da_free(video->inputs);
+	da_free(video->conversions);
 
 	for (size_t i = 0; i < video->info.cache_size; i++)
 		video_frame_free((struct video_frame *)&video->cache[i]);
@@ -280,6 +641,7 @@ void video_output_close(video_t *video)
 	os_sem_destroy(video->update_semaphore);
 	pthread_mutex_destroy(&video->data_mutex);
 	pthread_mutex_destroy(&video->input_mutex);
+	pthread_cond_destroy(&video->input_cond);
 	bfree(video);
 }
 
@@ -289,7 +651,7 @@ static size_t video_get_input_idx(const video_t *video,
 				  void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -303,32 +665,9 @@ static inline bool video_input_init(struct video_input *input,
 	if (input->conversion.width != video->info.width ||
 	    input->conversion.height != video->info.height ||
 	    input->conversion.format != video->info.format) {
-		struct video_scale_info from = {.format = video->info.format,
-						.width = video->info.width,
-						.height = video->info.height,
-						.range = video->info.range,
-						.colorspace =
-							video->info.colorspace};
-
-		int ret = video_scaler_create(&input->scaler,
-					      &input->conversion, &from,
-					      VIDEO_SCALE_FAST_BILINEAR);
-		if (ret != VIDEO_SCALER_SUCCESS) {
-			if (ret == VIDEO_SCALER_BAD_CONVERSION)
-				blog(LOG_ERROR, "video_input_init: Bad "
-						"scale conversion type");
-			else
-				blog(LOG_ERROR, "video_input_init: Failed to "
-						"create scaler");
-
-			return false;
-		}
-
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-					 input->conversion.format,
-					 input->conversion.width,
-					 input->conversion.height);
+		input->converter =
+			video_conversion_get(video, &input->conversion);
+		return input->converter != NULL;
 	}
 
 	return true;
@@ -352,27 +691,30 @@ bool video_output_connect(
 	pthread_mutex_lock(&video->input_mutex);
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input = bzalloc(sizeof(*input));
 
-		input.callback = callback;
-		input.param = param;
+		input->video = video;
+		input->callback = callback;
+		input->param = param;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format = video->info.format;
-			input.conversion.width = video->info.width;
-			input.conversion.height = video->info.height;
+			input->conversion.format = video->info.format;
+			input->conversion.width = video->info.width;
+			input->conversion.height = video->info.height;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
+		success = video_input_init(input, video);
 		if (success) {
+			if (video->parallel_inputs)
+				video_input_start_thread(input);
+
 			if (video->inputs.num == 0) {
 				if (!os_atomic_load_long(&video->gpu_refs)) {
 					reset_frames(video);
@@ -380,6 +722,8 @@ bool video_output_connect(
 				os_atomic_set_bool(&video->raw_active, true);
 			}
 			da_push_back(video->inputs, &input);
+		} else {
+			video_input_free(input);
 		}
 	}
 
@@ -410,6 +754,8 @@ void video_output_disconnect(video_t *video,
 					      struct video_data *frame),
 			     void *param)
 {
+	struct video_input *input = NULL;
+
 	if (!video || !callback)
 		return;
 
@@ -417,7 +763,7 @@ void video_output_disconnect(video_t *video,
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array + idx);
+		input = video->inputs.array[idx];
 		da_erase(video->inputs, idx);
 
 		if (video->inputs.num == 0) {
@@ -426,9 +772,87 @@ void video_output_disconnect(video_t *video,
 				log_skipped(video);
 			}
 		}
+
+		if (input->stopping) {
+			input->removed = true;
+			input = NULL;
+
+		} else if (input->threaded &&
+			   pthread_equal(pthread_self(), input->thread)) {
+			input->detached = true;
+			video->detached_inputs++;
+			pthread_detach(input->thread);
+			video_input_signal_stop(input);
+			input = NULL;
+		}
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
+
+	/* the input thread may be in a callback that disconnects or connects
+	 * another input, so it is joined without input_mutex held */
+	if (input) {
+		video_input_stop_thread(input);
+
+		pthread_mutex_lock(&video->input_mutex);
+		video_input_free(input);
+		pthread_mutex_unlock(&video->input_mutex);
+	}
+}
+
+void video_output_set_parallel_inputs(video_t *video, bool parallel)
+{
+	if (!video)
+		return;
+
+	DARRAY(struct video_input *) stopping;
+	da_init(stopping);
+
+	/* the video thread outputs frames with input_mutex locked */
+	pthread_mutex_lock(&video->input_mutex);
+
+	if (video->parallel_inputs != parallel) {
+		video->parallel_inputs = parallel;
+
+		for (size_t i = 0; i < video->inputs.num; i++) {
+			struct video_input *input = video->inputs.array[i];
+
+			if (input->stopping || input->detached)
+				continue;
+
+			if (parallel) {
+				video_input_start_thread(input);
+			} else if (input->threaded) {
+				input->stopping = true;
+				video_input_signal_stop(input);
+				da_push_back(stopping, &input);
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	/* joined without input_mutex held, an input thread may be in a
+	 * callback that disconnects its input */
+	for (size_t i = 0; i < stopping.num; i++)
+		pthread_join(stopping.array[i]->thread, NULL);
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	for (size_t i = 0; i < stopping.num; i++) {
+		struct video_input *input = stopping.array[i];
+
+		video_input_thread_exited(input);
+		input->stopping = false;
+
+		if (input->removed)
+			video_input_free(input);
+		else if (video->parallel_inputs)
+			video_input_start_thread(input);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+	da_free(stopping);
 }
 
 bool video_output_active(const video_t *video)
@@ -455,20 +879,35 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 	pthread_mutex_lock(&video->data_mutex);
 
 	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
-		video->cache[video->last_added].skipped += count;
+		if (video->queued_frames) {
+			video->cache[video->last_added].count += count;
+			video->cache[video->last_added].skipped += count;
+		} else {
+			/* every frame is held by input threads */
+			for (int i = 0; i < count; i++) {
+				os_atomic_inc_long(&video->skipped_frames);
+				os_atomic_inc_long(&video->total_frames);
+			}
+		}
 		locked = false;
 
 	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
-		}
-
-		cfi = &video->cache[video->last_added];
+		size_t idx = 0;
+		while (video->cache[idx].queued || video->cache[idx].refs)
+			idx++;
+
+		if (video->queued_frames++)
+			video->cache[video->last_added].next = idx;
+		else
+			video->first_added = idx;
+		video->last_added = idx;
+		video->available_frames--;
+
+		cfi = &video->cache[idx];
 		cfi->frame.timestamp = timestamp;
 		cfi->count = count;
 		cfi->skipped = 0;
+		cfi->queued = true;
 
 		memcpy(frame, &cfi->frame, sizeof(*frame));
 
@@ -487,7 +926,6 @@ void video_output_unlock_frame(video_t *video)
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	video->available_frames--;
 	os_sem_post(video->update_semaphore);
 
 	pthread_mutex_unlock(&video->data_mutex);
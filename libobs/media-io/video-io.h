@@ -242,6 +242,8 @@ EXPORT void video_output_disconnect(video_t *video,
 						     struct video_data *frame),
 				    void *param);
 
+EXPORT void video_output_set_parallel_inputs(video_t *video, bool parallel);
+
 EXPORT bool video_output_active(const video_t *video);
 
 EXPORT const struct video_output_info *
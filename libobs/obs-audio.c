@@ -17,6 +17,7 @@
 
 #include <inttypes.h>
 #include "obs-internal.h"
+#include "media-io/audio-kernels.h"
 #include "util/util_uint64.h"
 
 struct ts_info {
@@ -26,6 +27,7 @@ struct ts_info {
 
 #define DEBUG_AUDIO 0
 #define MAX_BUFFERING_TICKS 45
+#define MAX_AUDIO_RENDER_THREADS 4
 
 static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
@@ -65,18 +67,10 @@ static inline void mix_audio(struct audio_output_data *mixes,
 	}
 
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-		for (size_t ch = 0; ch < channels; ch++) {
-			register float *mix = mixes[mix_idx].data[ch];
-			register float *aud =
-				source->audio_output_buf[mix_idx][ch];
-			register float *end;
-
-			mix += start_point;
-			end = aud + total_floats;
-
-			while (aud < end)
-				*(mix++) += *(aud++);
-		}
+		for (size_t ch = 0; ch < channels; ch++)
+			audio_mix_add(mixes[mix_idx].data[ch] + start_point,
+				      source->audio_output_buf[mix_idx][ch],
+				      total_floats);
 	}
 }
 
@@ -380,6 +374,148 @@ static inline void release_audio_sources(struct obs_core_audio *audio)
 		obs_source_release(audio->render_order.array[i]);
 }
 
+static void render_audio_source(struct obs_core_audio *audio,
+				obs_source_t *source)
+{
+	size_t channels = audio_output_get_channels(audio->audio);
+	size_t sample_rate = audio_output_get_sample_rate(audio->audio);
+	size_t audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
+
+	if (!source->profile_audio_render_name)
+		source->profile_audio_render_name =
+			profile_store_name(obs_get_profiler_name_store(),
+					   "audio_render(%s)",
+					   source->context.name);
+
+	profile_start(source->profile_audio_render_name);
+	obs_source_audio_render(source, audio->render_mixers, channels,
+				sample_rate, audio_size);
+	profile_end(source->profile_audio_render_name);
+}
+
+/* called by the audio thread and the render threads until the sources of the
+ * current level have all been taken */
+static void render_audio_jobs(struct obs_core_audio *audio)
+{
+	for (;;) {
+		obs_source_t *source = NULL;
+
+		pthread_mutex_lock(&audio->render_mutex);
+		if (audio->render_next < audio->render_jobs.num)
+			source = audio->render_jobs.array[audio->render_next++];
+		pthread_mutex_unlock(&audio->render_mutex);
+
+		if (!source)
+			break;
+
+		render_audio_source(audio, source);
+
+		pthread_mutex_lock(&audio->render_mutex);
+		if (--audio->render_pending == 0)
+			os_event_signal(audio->render_done);
+		pthread_mutex_unlock(&audio->render_mutex);
+	}
+}
+
+static void wait_for_audio_jobs(struct obs_core_audio *audio)
+{
+	for (;;) {
+		bool done;
+
+		pthread_mutex_lock(&audio->render_mutex);
+		done = audio->render_pending == 0;
+		pthread_mutex_unlock(&audio->render_mutex);
+
+		if (done)
+			break;
+
+		os_event_wait(audio->render_done);
+	}
+}
+
+static void get_child_level(obs_source_t *parent, obs_source_t *child,
+			    void *param)
+{
+	int *level = param;
+
+	if (child->audio_render_level >= *level)
+		*level = child->audio_render_level + 1;
+
+	UNUSED_PARAMETER(parent);
+}
+
+/* A source can only be rendered once the sources it mixes (scene items,
+ * transition sources) are, so each source gets a level above the ones of its
+ * children.  Children that come later in the render order were never
+ * rendered before their parent and are ignored, as before. */
+static int calc_audio_render_levels(struct obs_core_audio *audio)
+{
+	int max_level = 0;
+
+	for (size_t i = 0; i < audio->render_order.num; i++)
+		audio->render_order.array[i]->audio_render_level = -1;
+
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+		int level = 0;
+
+		obs_source_enum_active_sources(source, get_child_level, &level);
+		source->audio_render_level = level;
+
+		if (level > max_level)
+			max_level = level;
+	}
+
+	return max_level;
+}
+
+static void render_audio_tree(struct obs_core_audio *audio, uint32_t mixers)
+{
+	int max_level;
+
+	audio->render_mixers = mixers;
+
+	if (!audio->render_threads.num || audio->render_order.num < 2) {
+		for (size_t i = 0; i < audio->render_order.num; i++)
+			render_audio_source(audio,
+					    audio->render_order.array[i]);
+		return;
+	}
+
+	max_level = calc_audio_render_levels(audio);
+
+	for (int level = 0; level <= max_level; level++) {
+		size_t num_jobs;
+		size_t num_wakes;
+
+		pthread_mutex_lock(&audio->render_mutex);
+
+		da_resize(audio->render_jobs, 0);
+		for (size_t i = 0; i < audio->render_order.num; i++) {
+			obs_source_t *source = audio->render_order.array[i];
+			if (source->audio_render_level == level)
+				da_push_back(audio->render_jobs, &source);
+		}
+
+		num_jobs = audio->render_jobs.num;
+		audio->render_next = 0;
+		audio->render_pending = num_jobs;
+
+		pthread_mutex_unlock(&audio->render_mutex);
+
+		/* the audio thread takes a share of the sources itself */
+		num_wakes = num_jobs ? num_jobs - 1 : 0;
+		if (num_wakes > audio->render_threads.num)
+			num_wakes = audio->render_threads.num;
+
+		for (size_t i = 0; i < num_wakes; i++)
+			os_sem_post(audio->render_sem);
+
+		render_audio_jobs(audio);
+		wait_for_audio_jobs(audio);
+	}
+}
+
 bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 		    uint64_t *out_ts, uint32_t mixers,
 		    struct audio_output_data *mixes)
@@ -390,7 +526,6 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	size_t sample_rate = audio_output_get_sample_rate(audio->audio);
 	size_t channels = audio_output_get_channels(audio->audio);
 	struct ts_info ts = {start_ts_in, end_ts_in};
-	size_t audio_size;
 	uint64_t min_ts;
 
 	da_resize(audio->render_order, 0);
@@ -400,8 +535,6 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	circlebuf_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
-	audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
-
 #if DEBUG_AUDIO == 1
 	blog(LOG_DEBUG, "ts %llu-%llu", ts.start, ts.end);
 #endif
@@ -432,11 +565,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	/* ------------------------------------------------ */
 	/* render audio data */
-	for (size_t i = 0; i < audio->render_order.num; i++) {
-		obs_source_t *source = audio->render_order.array[i];
-		obs_source_audio_render(source, mixers, channels, sample_rate,
-					audio_size);
-	}
+	render_audio_tree(audio, mixers);
 
 	/* ------------------------------------------------ */
 	/* get minimum audio timestamp */
@@ -500,3 +629,84 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	UNUSED_PARAMETER(param);
 	return true;
 }
+
+static const char *audio_render_thread_name = "audio_render_thread";
+
+static void *audio_render_thread(void *param)
+{
+	struct obs_core_audio *audio = param;
+
+	os_set_thread_name("libobs: audio render thread");
+
+	while (os_sem_wait(audio->render_sem) == 0) {
+		if (audio->render_stop)
+			break;
+
+		profile_start(audio_render_thread_name);
+		render_audio_jobs(audio);
+		profile_end(audio_render_thread_name);
+
+		profile_reenable_thread();
+	}
+
+	return NULL;
+}
+
+void obs_audio_render_threads_start(struct obs_core_audio *audio)
+{
+	int num_threads = os_get_logical_cores() - 1;
+
+	pthread_mutex_init_value(&audio->render_mutex);
+
+	if (num_threads > MAX_AUDIO_RENDER_THREADS)
+		num_threads = MAX_AUDIO_RENDER_THREADS;
+	if (num_threads <= 0)
+		return;
+
+	if (pthread_mutex_init(&audio->render_mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&audio->render_sem, 0) != 0)
+		goto fail;
+	if (os_event_init(&audio->render_done, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
+	for (int i = 0; i < num_threads; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, audio_render_thread, audio) !=
+		    0)
+			break;
+
+		da_push_back(audio->render_threads, &thread);
+	}
+
+	if (audio->render_threads.num) {
+		blog(LOG_INFO, "Rendering audio sources on %d threads",
+		     (int)audio->render_threads.num + 1);
+		return;
+	}
+
+fail:
+	blog(LOG_WARNING, "Failed to create audio render threads, "
+			  "rendering audio sources from the audio thread");
+	obs_audio_render_threads_stop(audio);
+}
+
+void obs_audio_render_threads_stop(struct obs_core_audio *audio)
+{
+	audio->render_stop = true;
+
+	for (size_t i = 0; i < audio->render_threads.num; i++)
+		os_sem_post(audio->render_sem);
+	for (size_t i = 0; i < audio->render_threads.num; i++)
+		pthread_join(audio->render_threads.array[i], NULL);
+
+	da_free(audio->render_threads);
+	da_free(audio->render_jobs);
+
+	os_event_destroy(audio->render_done);
+	os_sem_destroy(audio->render_sem);
+	pthread_mutex_destroy(&audio->render_mutex);
+	audio->render_done = NULL;
+	audio->render_sem = NULL;
+}
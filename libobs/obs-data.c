@@ -31,7 +31,9 @@
 struct obs_data_item {
 	volatile long ref;
 	struct obs_data *parent;
+	struct obs_data_item *prev;
 	struct obs_data_item *next;
+	uint32_t hash;
 	enum obs_data_type type;
 	size_t name_len;
 	size_t data_len;
@@ -46,6 +48,13 @@ struct obs_data {
 	volatile long ref;
 	char *json;
 	struct obs_data_item *first_item;
+	struct obs_data_item *last_item;
+	size_t num_items;
+
+	/* open addressing index of the items by name, only built once there
+	 * are enough items for the list walk to matter */
+	struct obs_data_item **index;
+	size_t index_size;
 };
 
 struct obs_data_array {
@@ -261,6 +270,19 @@ static inline void item_autoselect_data_addref(struct obs_data_item *item)
 	}
 }
 
+/* FNV-1a */
+static inline uint32_t hash_name(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
 static struct obs_data_item *obs_data_item_create(const char *name,
 						  const void *data, size_t size,
 						  enum obs_data_type type,
@@ -281,6 +303,7 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 	item->capacity = total_size;
 	item->type = type;
 	item->name_len = name_size;
+	item->hash = hash_name(name);
 	item->ref = 1;
 
 	if (default_data) {
@@ -302,45 +325,197 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 	return item;
 }
 
-static struct obs_data_item **get_item_prev_next(struct obs_data *data,
-						 struct obs_data_item *current)
+/* ------------------------------------------------------------------------- */
+/* Item index */
+
+#define INDEX_MIN_ITEMS 16
+
+static inline size_t index_home(const struct obs_data *data, uint32_t hash)
 {
-	if (!current || !data)
-		return NULL;
+	return hash & (data->index_size - 1);
+}
+
+static size_t index_find_name(const struct obs_data *data, const char *name,
+			      uint32_t hash)
+{
+	size_t mask = data->index_size - 1;
+	size_t i = index_home(data, hash);
+
+	for (;;) {
+		struct obs_data_item *item = data->index[i];
+
+		if (!item || (item->hash == hash &&
+			      strcmp(get_item_name(item), name) == 0))
+			return i;
+
+		i = (i + 1) & mask;
+	}
+}
+
+static size_t index_find_item(const struct obs_data *data,
+			      const struct obs_data_item *item, uint32_t hash)
+{
+	size_t mask = data->index_size - 1;
+	size_t i = index_home(data, hash);
+
+	while (data->index[i] != item)
+		i = (i + 1) & mask;
 
-	struct obs_data_item **prev_next = &data->first_item;
+	return i;
+}
+
+static void index_rebuild(struct obs_data *data, size_t size)
+{
 	struct obs_data_item *item = data->first_item;
 
-	while (item) {
-		if (item == current)
-			return prev_next;
+	bfree(data->index);
+	data->index = bzalloc(size * sizeof(struct obs_data_item *));
+	data->index_size = size;
 
-		prev_next = &item->next;
+	while (item) {
+		data->index[index_find_item(data, NULL, item->hash)] = item;
 		item = item->next;
 	}
+}
 
-	return NULL;
+/* kept at most half full, so that probing always ends on an empty slot */
+static void index_add(struct obs_data *data, struct obs_data_item *item)
+{
+	size_t size = data->index_size;
+
+	if (!size && data->num_items < INDEX_MIN_ITEMS)
+		return;
+
+	if (data->num_items * 2 > size) {
+		if (!size)
+			size = INDEX_MIN_ITEMS * 2;
+		while (data->num_items * 2 > size)
+			size *= 2;
+
+		index_rebuild(data, size);
+		return;
+	}
+
+	data->index[index_find_item(data, NULL, item->hash)] = item;
 }
 
-static inline void obs_data_item_detach(struct obs_data_item *item)
+static void index_remove(struct obs_data *data, struct obs_data_item *item)
 {
-	struct obs_data_item **prev_next =
-		get_item_prev_next(item->parent, item);
+	size_t mask = data->index_size - 1;
+	size_t hole, i;
 
-	if (prev_next) {
-		*prev_next = item->next;
-		item->next = NULL;
+	if (!data->index_size)
+		return;
+
+	hole = i = index_find_item(data, item, item->hash);
+
+	/* move back the items that were probed past the removed one */
+	for (;;) {
+		struct obs_data_item *cur;
+		size_t home;
+
+		i = (i + 1) & mask;
+		cur = data->index[i];
+		if (!cur)
+			break;
+
+		home = index_home(data, cur->hash);
+		if (hole <= i ? (home <= hole || home > i)
+			      : (home <= hole && home > i)) {
+			data->index[hole] = cur;
+			hole = i;
+		}
+	}
+
+	data->index[hole] = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Item list, sorted by name */
+
+static void obs_data_item_attach(struct obs_data *data,
+				 struct obs_data_item *item)
+{
+	const char *name = get_item_name(item);
+	struct obs_data_item *prev = data->last_item;
+
+	/* items loaded from json come in order, check the end first */
+	if (prev && strcmp(get_item_name(prev), name) > 0) {
+		struct obs_data_item *next = data->first_item;
+
+		prev = NULL;
+		while (next && strcmp(get_item_name(next), name) < 0) {
+			prev = next;
+			next = next->next;
+		}
 	}
+
+	item->parent = data;
+	item->prev = prev;
+	item->next = prev ? prev->next : data->first_item;
+
+	if (prev)
+		prev->next = item;
+	else
+		data->first_item = item;
+
+	if (item->next)
+		item->next->prev = item;
+	else
+		data->last_item = item;
+
+	data->num_items++;
+	index_add(data, item);
+}
+
+static inline void obs_data_item_detach(struct obs_data_item *item)
+{
+	struct obs_data *data = item->parent;
+
+	if (!data)
+		return;
+
+	index_remove(data, item);
+
+	if (item->prev)
+		item->prev->next = item->next;
+	else
+		data->first_item = item->next;
+
+	if (item->next)
+		item->next->prev = item->prev;
+	else
+		data->last_item = item->prev;
+
+	data->num_items--;
+
+	item->parent = NULL;
+	item->prev = NULL;
+	item->next = NULL;
 }
 
+/* the item was moved by brealloc, old_ptr must not be dereferenced */
 static inline void obs_data_item_reattach(struct obs_data_item *old_ptr,
 					  struct obs_data_item *new_ptr)
 {
-	struct obs_data_item **prev_next =
-		get_item_prev_next(new_ptr->parent, old_ptr);
+	struct obs_data *data = new_ptr->parent;
+
+	if (!data)
+		return;
+
+	if (new_ptr->prev)
+		new_ptr->prev->next = new_ptr;
+	else
+		data->first_item = new_ptr;
+
+	if (new_ptr->next)
+		new_ptr->next->prev = new_ptr;
+	else
+		data->last_item = new_ptr;
 
-	if (prev_next)
-		*prev_next = new_ptr;
+	if (data->index_size)
+		data->index[index_find_item(data, old_ptr, new_ptr->hash)] =
+			new_ptr;
 }
 
 static struct obs_data_item *
@@ -708,12 +883,19 @@ static inline void obs_data_destroy(struct obs_data *data)
 
 	while (item) {
 		struct obs_data_item *next = item->next;
+
+		/* items still referenced elsewhere outlive the object */
+		item->parent = NULL;
+		item->prev = NULL;
+		item->next = NULL;
+
 		obs_data_item_release(&item);
 		item = next;
 	}
 
 	/* NOTE: don't use bfree for json text, allocated by json */
 	free(data->json);
+	bfree(data->index);
 	bfree(data);
 }
 
@@ -772,6 +954,10 @@ static struct obs_data_item *get_item(struct obs_data *data, const char *name)
 	if (!data)
 		return NULL;
 
+	if (data->index_size)
+		return data->index[index_find_name(data, name,
+						   hash_name(name))];
+
 	struct obs_data_item *item = data->first_item;
 
 	while (item) {
@@ -794,31 +980,8 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 	if ((!item || (item && !*item)) && data) {
 		new_item = obs_data_item_create(name, ptr, size, type,
 						default_data, autoselect_data);
-
-		obs_data_item_t *prev = obs_data_first(data);
-		obs_data_item_t *next = obs_data_first(data);
-		obs_data_item_next(&next);
-		for (; prev && next;
-		     obs_data_item_next(&prev), obs_data_item_next(&next)) {
-			if (strcmp(get_item_name(next), name) > 0)
-				break;
-		}
-
-		new_item->parent = data;
-		if (prev && strcmp(get_item_name(prev), name) < 0) {
-			prev->next = new_item;
-			new_item->next = next;
-
-		} else {
-			data->first_item = new_item;
-			new_item->next = prev;
-		}
-
-		if (!prev)
-			data->first_item = new_item;
-
-		obs_data_item_release(&prev);
-		obs_data_item_release(&next);
+		if (new_item)
+			obs_data_item_attach(data, new_item);
 
 	} else if (default_data) {
 		obs_data_item_set_default_data(item, ptr, size, type);
@@ -415,6 +415,16 @@ bool obs_encoder_get_extra_data(const obs_encoder_t *encoder,
 	return false;
 }
 
+void obs_encoder_request_keyframe(obs_encoder_t *encoder)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_request_keyframe"))
+		return;
+	if (encoder->info.type != OBS_ENCODER_VIDEO)
+		return;
+
+	os_atomic_set_bool(&encoder->keyframe_requested, true);
+}
+
 obs_data_t *obs_encoder_get_settings(const obs_encoder_t *encoder)
 {
 	if (!obs_encoder_valid(encoder, "obs_encoder_get_settings"))
@@ -648,6 +658,48 @@ void obs_encoder_stop(obs_encoder_t *encoder,
 		pthread_mutex_unlock(&encoder->init_mutex);
 }
 
+bool obs_encoder_add_packet_callback(
+	obs_encoder_t *encoder,
+	void (*new_packet)(void *param, struct encoder_packet *packet),
+	void *param)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_add_packet_callback"))
+		return false;
+	if (!obs_ptr_valid(new_packet, "obs_encoder_add_packet_callback"))
+		return false;
+
+	if (!obs_encoder_initialize(encoder))
+		return false;
+
+	obs_encoder_start(encoder, new_packet, param);
+	return true;
+}
+
+void obs_encoder_remove_packet_callback(
+	obs_encoder_t *encoder,
+	void (*new_packet)(void *param, struct encoder_packet *packet),
+	void *param)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_remove_packet_callback"))
+		return;
+
+	obs_encoder_stop(encoder, new_packet, param);
+}
+
+size_t obs_encoder_get_num_consumers(obs_encoder_t *encoder)
+{
+	size_t num;
+
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_num_consumers"))
+		return 0;
+
+	pthread_mutex_lock(&encoder->callbacks_mutex);
+	num = encoder->callbacks.num;
+	pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+	return num;
+}
+
 const char *obs_encoder_get_codec(const obs_encoder_t *encoder)
 {
 	return obs_encoder_valid(encoder, "obs_encoder_get_codec")
@@ -1046,6 +1098,8 @@ static void receive_video(void *param, struct video_data *frame)
 
 	enc_frame.frames = 1;
 	enc_frame.pts = encoder->cur_pts;
+	enc_frame.force_keyframe =
+		os_atomic_set_bool(&encoder->keyframe_requested, false);
 
 	if (do_encode(encoder, &enc_frame))
 		encoder->cur_pts += encoder->timebase_num;
@@ -1308,15 +1362,121 @@ void obs_encoder_remove_output(struct obs_encoder *encoder,
 	pthread_mutex_unlock(&encoder->outputs_mutex);
 }
 
+/* ------------------------------------------------------------------------- */
+/* packet instances are recycled by size class rather than allocated for every
+ * packet of every output */
+
+#define PACKET_POOL_MIN_SHIFT 9 /* 512 bytes */
+#define PACKET_POOL_CLASSES 14  /* up to 4 MiB */
+#define PACKET_POOL_MAX_BYTES (32 * 1024 * 1024)
+
+/* the reference count of pooled blocks is biased, so that releasing the last
+ * reference of a pooled block can be told apart from a plain allocation */
+#define PACKET_POOL_REFS 0x40000000L
+
+struct packet_block {
+	struct packet_block *next;
+	size_t size_class;
+	long refs; /* followed by the packet data */
+};
+
+static pthread_mutex_t packet_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct packet_block *packet_pool[PACKET_POOL_CLASSES];
+static size_t packet_pool_bytes = 0;
+static volatile long packet_pool_hits = 0;
+static volatile long packet_pool_misses = 0;
+
+static inline size_t packet_block_size(size_t size_class)
+{
+	return (size_t)1 << (size_class + PACKET_POOL_MIN_SHIFT);
+}
+
+static long *packet_pool_alloc(size_t size)
+{
+	size_t total = offsetof(struct packet_block, refs) + sizeof(long) +
+		       size;
+	struct packet_block *block;
+	size_t size_class = 0;
+
+	while (size_class < PACKET_POOL_CLASSES &&
+	       packet_block_size(size_class) < total)
+		size_class++;
+
+	if (size_class == PACKET_POOL_CLASSES) {
+		long *p_refs = bmalloc(size + sizeof(long));
+		*p_refs = 1;
+		os_atomic_inc_long(&packet_pool_misses);
+		return p_refs;
+	}
+
+	pthread_mutex_lock(&packet_pool_mutex);
+	block = packet_pool[size_class];
+	if (block) {
+		packet_pool[size_class] = block->next;
+		packet_pool_bytes -= packet_block_size(size_class);
+	}
+	pthread_mutex_unlock(&packet_pool_mutex);
+
+	if (block) {
+		os_atomic_inc_long(&packet_pool_hits);
+	} else {
+		block = bmalloc(packet_block_size(size_class));
+		block->size_class = size_class;
+		os_atomic_inc_long(&packet_pool_misses);
+	}
+
+	block->refs = PACKET_POOL_REFS + 1;
+	return &block->refs;
+}
+
+static void packet_pool_recycle(long *p_refs)
+{
+	struct packet_block *block =
+		(struct packet_block *)((uint8_t *)p_refs -
+					offsetof(struct packet_block, refs));
+	size_t block_size = packet_block_size(block->size_class);
+
+	pthread_mutex_lock(&packet_pool_mutex);
+	if (packet_pool_bytes + block_size <= PACKET_POOL_MAX_BYTES) {
+		block->next = packet_pool[block->size_class];
+		packet_pool[block->size_class] = block;
+		packet_pool_bytes += block_size;
+		block = NULL;
+	}
+	pthread_mutex_unlock(&packet_pool_mutex);
+
+	bfree(block);
+}
+
+void obs_encoder_packet_pool_free(void)
+{
+	long hits = os_atomic_set_long(&packet_pool_hits, 0);
+	long misses = os_atomic_set_long(&packet_pool_misses, 0);
+
+	if (hits || misses)
+		blog(LOG_INFO, "Encoder packet pool: %ld hits, %ld misses",
+		     hits, misses);
+
+	pthread_mutex_lock(&packet_pool_mutex);
+	for (size_t i = 0; i < PACKET_POOL_CLASSES; i++) {
+		while (packet_pool[i]) {
+			struct packet_block *next = packet_pool[i]->next;
+			bfree(packet_pool[i]);
+			packet_pool[i] = next;
+		}
+	}
+	packet_pool_bytes = 0;
+	pthread_mutex_unlock(&packet_pool_mutex);
+}
+
 void obs_encoder_packet_create_instance(struct encoder_packet *dst,
 					const struct encoder_packet *src)
 {
 	long *p_refs;
 
 	*dst = *src;
-	p_refs = bmalloc(src->size + sizeof(long));
+	p_refs = packet_pool_alloc(src->size);
 	dst->data = (void *)(p_refs + 1);
-	*p_refs = 1;
 	memcpy(dst->data, src->data, src->size);
 }
 
@@ -1354,8 +1514,12 @@ void obs_encoder_packet_release(struct encoder_packet *pkt)
 
 	if (pkt->data) {
 		long *p_refs = ((long *)pkt->data) - 1;
-		if (os_atomic_dec_long(p_refs) == 0)
+		long refs = os_atomic_dec_long(p_refs);
+
+		if (refs == 0)
 			bfree(p_refs);
+		else if (refs == PACKET_POOL_REFS)
+			packet_pool_recycle(p_refs);
 	}
 
 	memset(pkt, 0, sizeof(struct encoder_packet));
@@ -0,0 +1,103 @@
+/******************************************************************************
+    Copyright (C) 2013-2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "util/c99defs.h"
+#include "util/bmem.h"
+#include "obs.h"
+
+/*
+ * Per-track buffers of the encoded packets an output interleaves.  Packets
+ * of a track arrive in dts order, so each track is a growable ring buffer
+ * and the interleaved order is a merge of the track heads.
+ */
+
+/* encoded packets of one track waiting to be interleaved, in dts order */
+struct interleaved_track {
+	struct encoder_packet *packets;
+	size_t capacity;
+	size_t start;
+	size_t num;
+};
+
+/* video track, then one track per audio mix */
+#define INTERLEAVED_TRACKS (MAX_AUDIO_MIXES + 1)
+
+static inline struct encoder_packet *
+interleaved_track_get(struct interleaved_track *track, size_t idx)
+{
+	return &track->packets[(track->start + idx) & (track->capacity - 1)];
+}
+
+static inline void interleaved_track_push(struct interleaved_track *track,
+					  const struct encoder_packet *packet)
+{
+	if (track->num == track->capacity) {
+		size_t capacity = track->capacity ? track->capacity * 2 : 32;
+		struct encoder_packet *packets =
+			bmalloc(capacity * sizeof(*packets));
+
+		for (size_t i = 0; i < track->num; i++)
+			packets[i] = *interleaved_track_get(track, i);
+
+		bfree(track->packets);
+		track->packets = packets;
+		track->capacity = capacity;
+		track->start = 0;
+	}
+
+	*interleaved_track_get(track, track->num++) = *packet;
+}
+
+static inline void interleaved_track_pop(struct interleaved_track *track)
+{
+	track->start = (track->start + 1) & (track->capacity - 1);
+	track->num--;
+}
+
+/* walks the merged order from the per-track positions in |pos| and returns
+ * the next packet (video first when timestamps are equal) */
+static inline struct encoder_packet *
+interleaved_tracks_next(struct interleaved_track *tracks, const size_t *pos,
+			size_t *track_idx)
+{
+	struct encoder_packet *next = NULL;
+
+	for (size_t i = 0; i < INTERLEAVED_TRACKS; i++) {
+		struct interleaved_track *track = &tracks[i];
+		struct encoder_packet *packet;
+
+		if (pos[i] == track->num)
+			continue;
+
+		packet = interleaved_track_get(track, pos[i]);
+		if (!next || packet->dts_usec < next->dts_usec) {
+			next = packet;
+			*track_idx = i;
+		}
+	}
+
+	return next;
+}
+
+static inline struct encoder_packet *
+interleaved_tracks_first(struct interleaved_track *tracks, size_t *track_idx)
+{
+	size_t pos[INTERLEAVED_TRACKS] = {0};
+	return interleaved_tracks_next(tracks, pos, track_idx);
+}
@@ -35,6 +35,7 @@
 #include "media-io/audio-io.h"
 
 #include "obs.h"
+#include "obs-interleave.h"
 
 #define NUM_TEXTURES 2
 #define NUM_CHANNELS 3
@@ -283,6 +284,7 @@ struct obs_core_video {
 	uint64_t video_frame_interval_ns;
 	uint64_t video_avg_frame_time_ns;
 	double video_fps;
+	double video_avg_name_lookups;
 	video_t *video;
 	pthread_t video_thread;
 	uint32_t total_frames;
@@ -326,6 +328,18 @@ struct obs_core_audio {
 	DARRAY(struct obs_source *) render_order;
 	DARRAY(struct obs_source *) root_nodes;
 
+	/* sources of the same level of the audio tree are rendered in
+	 * parallel by the render threads and the audio thread itself */
+	DARRAY(pthread_t) render_threads;
+	DARRAY(struct obs_source *) render_jobs;
+	pthread_mutex_t render_mutex;
+	os_sem_t *render_sem;
+	os_event_t *render_done;
+	size_t render_next;
+	size_t render_pending;
+	uint32_t render_mixers;
+	volatile bool render_stop;
+
 	uint64_t buffered_ts;
 	struct circlebuf buffered_timestamps;
 	int buffering_wait_ticks;
@@ -442,6 +456,8 @@ struct obs_graphics_context {
 	uint64_t frame_time_total_ns;
 	uint64_t fps_total_ns;
 	uint32_t fps_total_frames;
+	uint64_t name_lookups_total;
+	long last_name_lookups;
 #ifdef _WIN32
 	bool gpu_was_active;
 #endif
@@ -463,6 +479,8 @@ extern gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file);
 extern bool audio_callback(void *param, uint64_t start_ts_in,
 			   uint64_t end_ts_in, uint64_t *out_ts,
 			   uint32_t mixers, struct audio_output_data *mixes);
+extern void obs_audio_render_threads_start(struct obs_core_audio *audio);
+extern void obs_audio_render_threads_stop(struct obs_core_audio *audio);
 
 extern void
 start_raw_video(video_t *video, const struct video_scale_info *conversion,
@@ -559,6 +577,11 @@ struct async_frame {
 	struct obs_source_frame *frame;
 	long unused_count;
 	bool used;
+
+	/* set for frames queued with obs_source_output_video_ref, whose planes
+	 * belong to the source until release is called */
+	void (*release)(void *param, struct obs_source_frame *frame);
+	void *release_param;
 };
 
 enum audio_action_type {
@@ -656,6 +679,8 @@ struct obs_source {
 	struct obs_audio_data audio_data;
 	size_t audio_storage_size;
 	uint32_t audio_mixers;
+	int audio_render_level;
+	const char *profile_audio_render_name;
 	float user_volume;
 	float volume;
 	int64_t sync_offset;
@@ -927,7 +952,7 @@ struct obs_output {
 	pthread_t end_data_capture_thread;
 	os_event_t *stopping_event;
 	pthread_mutex_t interleaved_mutex;
-	DARRAY(struct encoder_packet) interleaved_packets;
+	struct interleaved_track interleaved_tracks[INTERLEAVED_TRACKS];
 	int stop_code;
 
 	int reconnect_retry_sec;
@@ -1060,6 +1085,7 @@ struct obs_encoder {
 
 	volatile bool active;
 	volatile bool paused;
+	volatile bool keyframe_requested;
 	bool initialized;
 
 	/* indicates ownership of the info.id buffer */
@@ -1127,6 +1153,8 @@ extern bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame);
 extern void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 				    bool received, struct encoder_packet *pkt);
 
+extern void obs_encoder_packet_pool_free(void);
+
 void obs_encoder_destroy(obs_encoder_t *encoder);
 
 /* ------------------------------------------------------------------------- */
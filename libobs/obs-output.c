@@ -169,10 +169,19 @@ fail:
 
 static inline void free_packets(struct obs_output *output)
 {
-	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_encoder_packet_release(output->interleaved_packets.array +
-					   i);
-	da_free(output->interleaved_packets);
+	for (size_t i = 0; i < INTERLEAVED_TRACKS; i++) {
+		struct interleaved_track *track =
+			&output->interleaved_tracks[i];
+
+		for (size_t j = 0; j < track->num; j++) {
+			struct encoder_packet *packet =
+				interleaved_track_get(track, j);
+			obs_encoder_packet_release(packet);
+		}
+
+		bfree(track->packets);
+		memset(track, 0, sizeof(*track));
+	}
 }
 
 static inline void clear_audio_buffers(obs_output_t *output)
@@ -924,6 +933,18 @@ void obs_output_set_reconnect_settings(obs_output_t *output, int retry_count,
 	output->reconnect_retry_sec = retry_sec;
 }
 
+void obs_output_get_reconnect_settings(const obs_output_t *output,
+				       int *retry_count, int *retry_sec)
+{
+	if (!obs_output_valid(output, "obs_output_get_reconnect_settings"))
+		return;
+
+	if (retry_count)
+		*retry_count = output->reconnect_retry_max;
+	if (retry_sec)
+		*retry_sec = output->reconnect_retry_sec;
+}
+
 // NOTE LUDO: #80 add getStats
 void obs_output_get_stats(const obs_output_t *output)
 {
@@ -1277,9 +1298,32 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 }
 #endif
 
+static inline struct encoder_packet *
+next_interleaved_packet(struct obs_output *output, const size_t *pos,
+			size_t *track_idx)
+{
+	return interleaved_tracks_next(output->interleaved_tracks, pos,
+				       track_idx);
+}
+
+static inline struct encoder_packet *
+first_interleaved_packet(struct obs_output *output, size_t *track_idx)
+{
+	return interleaved_tracks_first(output->interleaved_tracks, track_idx);
+}
+
+static inline void insert_interleaved_packet(struct obs_output *output,
+					     struct encoder_packet *out)
+{
+	size_t idx = out->type == OBS_ENCODER_VIDEO ? 0 : out->track_idx + 1;
+	interleaved_track_push(&output->interleaved_tracks[idx], out);
+}
+
 static inline void send_interleaved(struct obs_output *output)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	size_t track_idx;
+	struct encoder_packet out =
+		*first_interleaved_packet(output, &track_idx);
 
 	/* do not send an interleaved packet if there's no packet of the
 	 * opposing type of a higher timestamp in the interleave buffer.
@@ -1287,7 +1331,7 @@ static inline void send_interleaved(struct obs_output *output)
 	if (!has_higher_opposing_ts(output, &out))
 		return;
 
-	da_erase(output->interleaved_packets, 0);
+	interleaved_track_pop(&output->interleaved_tracks[track_idx]);
 
 	if (out.type == OBS_ENCODER_VIDEO) {
 		output->total_frames++;
@@ -1347,12 +1391,17 @@ static size_t get_interleaved_start_idx(struct obs_output *output)
 		find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
 	size_t video_idx = DARRAY_INVALID;
 	size_t idx = 0;
+	size_t pos[INTERLEAVED_TRACKS] = {0};
+	struct encoder_packet *packet;
+	size_t track_idx;
 
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
+	for (size_t i = 0;
+	     (packet = next_interleaved_packet(output, pos, &track_idx));
+	     i++) {
 		int64_t diff;
 
+		pos[track_idx]++;
+
 		if (packet->type != OBS_ENCODER_AUDIO) {
 			if (packet == first_video)
 				video_idx = i;
@@ -1386,7 +1435,7 @@ static int prune_premature_packets(struct obs_output *output)
 	}
 
 	max_idx = video_idx;
-	video = &output->interleaved_packets.array[video_idx];
+	video = find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
 	duration_usec = video->timebase_num * 1000000LL / video->timebase_den;
 
 	for (size_t i = 0; i < audio_mixes; i++) {
@@ -1400,7 +1449,7 @@ static int prune_premature_packets(struct obs_output *output)
 			return -1;
 		}
 
-		audio = &output->interleaved_packets.array[audio_idx];
+		audio = find_first_packet_type(output, OBS_ENCODER_AUDIO, i);
 		if (audio_idx > max_idx)
 			max_idx = audio_idx;
 
@@ -1415,12 +1464,13 @@ static int prune_premature_packets(struct obs_output *output)
 static void discard_to_idx(struct obs_output *output, size_t idx)
 {
 	for (size_t i = 0; i < idx; i++) {
+		size_t track_idx;
 		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
+			first_interleaved_packet(output, &track_idx);
+
 		obs_encoder_packet_release(packet);
+		interleaved_track_pop(&output->interleaved_tracks[track_idx]);
 	}
-
-	da_erase_range(output->interleaved_packets, 0, idx);
 }
 
 #define DEBUG_STARTING_PACKETS 0
@@ -1432,9 +1482,13 @@ static bool prune_interleaved_packets(struct obs_output *output)
 
 #if DEBUG_STARTING_PACKETS == 1
 	blog(LOG_DEBUG, "--------- Pruning! %d ---------", prune_start);
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
+	size_t pos[INTERLEAVED_TRACKS] = {0};
+	struct encoder_packet *packet;
+	size_t track_idx;
+	for (size_t i = 0;
+	     (packet = next_interleaved_packet(output, pos, &track_idx));
+	     i++) {
+		pos[track_idx]++;
 		blog(LOG_DEBUG, "packet: %s %d, ts: %lld, pruned = %s",
 		     packet->type == OBS_ENCODER_AUDIO ? "audio" : "video",
 		     (int)packet->track_idx, packet->dts_usec,
@@ -1456,43 +1510,30 @@ static bool prune_interleaved_packets(struct obs_output *output)
 	return true;
 }
 
-static int find_first_packet_type_idx(struct obs_output *output,
-				      enum obs_encoder_type type,
-				      size_t audio_idx)
+static inline struct interleaved_track *
+find_track(struct obs_output *output, enum obs_encoder_type type,
+	   size_t audio_idx)
 {
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
-
-			return (int)i;
-		}
-	}
-
-	return -1;
+	size_t idx = type == OBS_ENCODER_VIDEO ? 0 : audio_idx + 1;
+	return &output->interleaved_tracks[idx];
 }
 
-static int find_last_packet_type_idx(struct obs_output *output,
-				     enum obs_encoder_type type,
-				     size_t audio_idx)
+static int find_first_packet_type_idx(struct obs_output *output,
+				      enum obs_encoder_type type,
+				      size_t audio_idx)
 {
-	for (size_t i = output->interleaved_packets.num; i > 0; i--) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i - 1];
+	struct interleaved_track *track = find_track(output, type, audio_idx);
+	size_t pos[INTERLEAVED_TRACKS] = {0};
+	size_t track_idx;
 
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
+	if (!track->num)
+		return -1;
 
-			return (int)(i - 1);
-		}
+	for (int i = 0; next_interleaved_packet(output, pos, &track_idx);
+	     i++) {
+		if (&output->interleaved_tracks[track_idx] == track)
+			return i;
+		pos[track_idx]++;
 	}
 
 	return -1;
@@ -1502,16 +1543,16 @@ static inline struct encoder_packet *
 find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
 		       size_t audio_idx)
 {
-	int idx = find_first_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
+	struct interleaved_track *track = find_track(output, type, audio_idx);
+	return track->num ? interleaved_track_get(track, 0) : NULL;
 }
 
 static inline struct encoder_packet *
 find_last_packet_type(struct obs_output *output, enum obs_encoder_type type,
 		      size_t audio_idx)
 {
-	int idx = find_last_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
+	struct interleaved_track *track = find_track(output, type, audio_idx);
+	return track->num ? interleaved_track_get(track, track->num - 1) : NULL;
 }
 
 static bool get_audio_and_video_packets(struct obs_output *output,
@@ -1590,64 +1631,33 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	output->highest_audio_ts -= audio[0]->dts_usec;
 	output->highest_video_ts -= video->dts_usec;
 
-	/* apply new offsets to all existing packet DTS/PTS values */
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		apply_interleaved_packet_offset(output, packet);
-	}
+	/* apply new offsets to all existing packet DTS/PTS values, which
+	 * keeps every track in order */
+	for (size_t i = 0; i < INTERLEAVED_TRACKS; i++) {
+		struct interleaved_track *track =
+			&output->interleaved_tracks[i];
 
-	return true;
-}
-
-static inline void insert_interleaved_packet(struct obs_output *output,
-					     struct encoder_packet *out)
-{
-	size_t idx;
-	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *cur_packet;
-		cur_packet = output->interleaved_packets.array + idx;
-
-		if (out->dts_usec == cur_packet->dts_usec &&
-		    out->type == OBS_ENCODER_VIDEO) {
-			break;
-		} else if (out->dts_usec < cur_packet->dts_usec) {
-			break;
+		for (size_t j = 0; j < track->num; j++) {
+			struct encoder_packet *packet =
+				interleaved_track_get(track, j);
+			apply_interleaved_packet_offset(output, packet);
 		}
 	}
 
-	da_insert(output->interleaved_packets, idx, out);
-}
-
-static void resort_interleaved_packets(struct obs_output *output)
-{
-	DARRAY(struct encoder_packet) old_array;
-
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0,
-	       sizeof(output->interleaved_packets));
-
-	for (size_t i = 0; i < old_array.num; i++)
-		insert_interleaved_packet(output, &old_array.array[i]);
-
-	da_free(old_array);
+	return true;
 }
 
 static void discard_unused_audio_packets(struct obs_output *output,
 					 int64_t dts_usec)
 {
-	size_t idx = 0;
+	size_t track_idx;
+	struct encoder_packet *p;
 
-	for (; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *p =
-			&output->interleaved_packets.array[idx];
-
-		if (p->dts_usec >= dts_usec)
-			break;
+	while ((p = first_interleaved_packet(output, &track_idx)) &&
+	       p->dts_usec < dts_usec) {
+		obs_encoder_packet_release(p);
+		interleaved_track_pop(&output->interleaved_tracks[track_idx]);
 	}
-
-	if (idx)
-		discard_to_idx(output, idx);
 }
 
 static void interleave_packets(void *data, struct encoder_packet *packet)
@@ -1695,10 +1705,8 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->received_audio && output->received_video) {
 		if (!was_started) {
 			if (prune_interleaved_packets(output)) {
-				if (initialize_interleaved_packets(output)) {
-					resort_interleaved_packets(output);
+				if (initialize_interleaved_packets(output))
 					send_interleaved(output);
-				}
 			}
 		} else {
 			send_interleaved(output);
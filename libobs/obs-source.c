@@ -21,6 +21,7 @@
 #include "media-io/format-conversion.h"
 #include "media-io/video-frame.h"
 #include "media-io/audio-io.h"
+#include "media-io/audio-kernels.h"
 #include "util/threading.h"
 #include "util/platform.h"
 #include "util/util_uint64.h"
@@ -578,6 +579,21 @@ static inline void obs_source_frame_decref(struct obs_source_frame *frame)
 		obs_source_frame_destroy(frame);
 }
 
+/* hands the planes of a frame queued with obs_source_output_video_ref back to
+ * the source */
+static inline void release_ref_frame(struct async_frame *af)
+{
+	af->release(af->release_param, af->frame);
+	bfree(af->frame);
+}
+
+/* frames queued with obs_source_output_video_ref stay in the cache until the
+ * cache holds their last reference */
+static inline bool ref_frame_unused(const struct async_frame *af)
+{
+	return os_atomic_load_long(&af->frame->refs) == 1;
+}
+
 static bool obs_source_filter_remove_refless(obs_source_t *source,
 					     obs_source_t *filter);
 
@@ -624,8 +640,14 @@ void obs_source_destroy(struct obs_source *source)
 	obs_hotkey_unregister(source->push_to_mute_key);
 	obs_hotkey_pair_unregister(source->mute_unmute_key);
 
-	for (i = 0; i < source->async_cache.num; i++)
-		obs_source_frame_decref(source->async_cache.array[i].frame);
+	for (i = 0; i < source->async_cache.num; i++) {
+		struct async_frame *af = &source->async_cache.array[i];
+
+		if (af->release)
+			release_ref_frame(af);
+		else
+			obs_source_frame_decref(af->frame);
+	}
 
 	gs_enter_context(obs->video.graphics);
 	if (source->async_texrender)
@@ -2699,10 +2721,23 @@ static inline bool async_texture_changed(struct obs_source *source,
 
 static inline void free_async_cache(struct obs_source *source)
 {
-	for (size_t i = 0; i < source->async_cache.num; i++)
-		obs_source_frame_decref(source->async_cache.array[i].frame);
+	for (size_t i = source->async_cache.num; i > 0; i--) {
+		struct async_frame *af = &source->async_cache.array[i - 1];
+
+		/* frames of the source that are still being output are
+		 * released by remove_async_frame */
+		if (af->release && !ref_frame_unused(af)) {
+			af->used = false;
+			continue;
+		}
+
+		if (af->release)
+			release_ref_frame(af);
+		else
+			obs_source_frame_decref(af->frame);
+		da_erase(source->async_cache, i - 1);
+	}
 
-	da_resize(source->async_cache, 0);
 	da_resize(source->async_frames, 0);
 	source->cur_async_frame = NULL;
 	source->prev_async_frame = NULL;
@@ -2716,7 +2751,7 @@ static void clean_cache(obs_source_t *source)
 {
 	for (size_t i = source->async_cache.num; i > 0; i--) {
 		struct async_frame *af = &source->async_cache.array[i - 1];
-		if (!af->used) {
+		if (!af->used && !af->release) {
 			if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
 				obs_source_frame_destroy(af->frame);
 				da_erase(source->async_cache, i - 1);
@@ -2726,19 +2761,16 @@ static void clean_cache(obs_source_t *source)
 }
 
 #define MAX_ASYNC_FRAMES 30
-//if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_source_frame_destroy(output)
-static inline struct obs_source_frame *
-cache_video(struct obs_source *source, const struct obs_source_frame *frame)
-{
-	struct obs_source_frame *new_frame = NULL;
-
-	pthread_mutex_lock(&source->async_mutex);
 
+/* called with async_mutex held before a new frame is queued.  returns false
+ * if too many frames were queued, in which case the queue has been flushed */
+static bool update_async_cache(struct obs_source *source,
+			       const struct obs_source_frame *frame)
+{
 	if (source->async_frames.num >= MAX_ASYNC_FRAMES) {
 		free_async_cache(source);
 		source->last_frame_ts = 0;
-		pthread_mutex_unlock(&source->async_mutex);
-		return NULL;
+		return false;
 	}
 
 	if (async_texture_changed(source, frame)) {
@@ -2747,13 +2779,29 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 		source->async_cache_height = frame->height;
 	}
 
-	const enum video_format format = frame->format;
-	source->async_cache_format = format;
+	source->async_cache_format = frame->format;
 	source->async_cache_full_range = frame->full_range;
+	return true;
+}
+
+//if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_source_frame_destroy(output)
+static inline struct obs_source_frame *
+cache_video(struct obs_source *source, const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *new_frame = NULL;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (!update_async_cache(source, frame)) {
+		pthread_mutex_unlock(&source->async_mutex);
+		return NULL;
+	}
+
+	const enum video_format format = frame->format;
 
 	for (size_t i = 0; i < source->async_cache.num; i++) {
 		struct async_frame *af = &source->async_cache.array[i];
-		if (!af->used) {
+		if (!af->used && !af->release) {
 			new_frame = af->frame;
 			new_frame->format = format;
 			af->used = true;
@@ -2772,6 +2820,8 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 		new_af.frame = new_frame;
 		new_af.used = true;
 		new_af.unused_count = 0;
+		new_af.release = NULL;
+		new_af.release_param = NULL;
 		new_frame->refs = 1;
 
 		da_push_back(source->async_cache, &new_af);
@@ -2864,6 +2914,91 @@ void obs_source_output_video2(obs_source_t *source,
 	obs_source_output_video_internal(source, &new_frame);
 }
 
+/* drops the queued frames of the source, the ones that are being output are
+ * released by remove_async_frame */
+static void flush_ref_frames(obs_source_t *source,
+			     void (*release)(void *param,
+					     struct obs_source_frame *frame),
+			     void *param)
+{
+	pthread_mutex_lock(&source->async_mutex);
+
+	for (size_t i = source->async_cache.num; i > 0; i--) {
+		struct async_frame *af = &source->async_cache.array[i - 1];
+		struct obs_source_frame *frame = af->frame;
+
+		if (af->release != release || af->release_param != param)
+			continue;
+
+		da_erase_item(source->async_frames, &frame);
+		if (source->cur_async_frame == frame)
+			source->cur_async_frame = NULL;
+		if (source->prev_async_frame == frame)
+			source->prev_async_frame = NULL;
+
+		if (ref_frame_unused(af)) {
+			release_ref_frame(af);
+			da_erase(source->async_cache, i - 1);
+		} else {
+			af->used = false;
+		}
+	}
+
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
+/* the frame is queued as is: it gets an entry of its own in the async cache,
+ * which is never reused for other frames, and remove_async_frame hands the
+ * planes back to the source once the cache holds its last reference */
+void obs_source_output_video_ref(
+	obs_source_t *source, const struct obs_source_frame *frame,
+	void (*release)(void *param, struct obs_source_frame *frame),
+	void *param)
+{
+	struct obs_source_frame *new_frame;
+	struct async_frame af = {0};
+
+	if (!release) {
+		obs_source_output_video(source, frame);
+		return;
+	}
+	if (!frame) {
+		if (obs_source_valid(source, "obs_source_output_video_ref"))
+			flush_ref_frames(source, release, param);
+		return;
+	}
+
+	new_frame = bmemdup(frame, sizeof(*frame));
+	new_frame->full_range =
+		format_is_yuv(frame->format) ? frame->full_range : true;
+	new_frame->refs = 1;
+	new_frame->prev_frame = false;
+
+	af.frame = new_frame;
+	af.used = true;
+	af.release = release;
+	af.release_param = param;
+
+	if (!obs_source_valid(source, "obs_source_output_video_ref")) {
+		release_ref_frame(&af);
+		return;
+	}
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (!update_async_cache(source, new_frame)) {
+		pthread_mutex_unlock(&source->async_mutex);
+		release_ref_frame(&af);
+		return;
+	}
+
+	da_push_back(source->async_cache, &af);
+	da_push_back(source->async_frames, &new_frame);
+	source->async_active = true;
+
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
 void obs_source_set_async_rotation(obs_source_t *source, long rotation)
 {
 	if (source)
@@ -3135,25 +3270,19 @@ static void copy_audio_data(obs_source_t *source, const uint8_t *const data[],
 		source->audio_storage_size = size;
 }
 
-/* TODO: SSE optimization */
 static void downmix_to_mono_planar(struct obs_source *source, uint32_t frames)
 {
 	size_t channels = audio_output_get_channels(obs->audio.audio);
 	const float channels_i = 1.0f / (float)channels;
 	float **data = (float **)source->audio_data.data;
 
-	for (size_t channel = 1; channel < channels; channel++) {
-		for (uint32_t frame = 0; frame < frames; frame++)
-			data[0][frame] += data[channel][frame];
-	}
+	for (size_t channel = 1; channel < channels; channel++)
+		audio_mix_add(data[0], data[channel], frames);
 
-	for (uint32_t frame = 0; frame < frames; frame++)
-		data[0][frame] *= channels_i;
+	audio_mul(data[0], channels_i, frames);
 
-	for (size_t channel = 1; channel < channels; channel++) {
-		for (uint32_t frame = 0; frame < frames; frame++)
-			data[channel][frame] = data[0][frame];
-	}
+	for (size_t channel = 1; channel < channels; channel++)
+		memcpy(data[channel], data[0], frames * sizeof(float));
 }
 
 static void process_audio_balancing(struct obs_source *source, uint32_t frames,
@@ -3270,10 +3399,17 @@ void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 	for (size_t i = 0; i < source->async_cache.num; i++) {
 		struct async_frame *f = &source->async_cache.array[i];
 
-		if (f->frame == frame) {
+		if (f->frame != frame)
+			continue;
+
+		/* frames of the source are returned as soon as possible */
+		if (f->release && ref_frame_unused(f)) {
+			release_ref_frame(f);
+			da_erase(source->async_cache, i);
+		} else {
 			f->used = false;
-			break;
 		}
+		break;
 	}
 }
 
@@ -4412,24 +4548,16 @@ static float get_source_volume(obs_source_t *source, uint64_t os_time)
 static inline void multiply_output_audio(obs_source_t *source, size_t mix,
 					 size_t channels, float vol)
 {
-	register float *out = source->audio_output_buf[mix][0];
-	register float *end = out + AUDIO_OUTPUT_FRAMES * channels;
-
-	while (out < end)
-		*(out++) *= vol;
+	audio_mul(source->audio_output_buf[mix][0], vol,
+		  AUDIO_OUTPUT_FRAMES * channels);
 }
 
 static inline void multiply_vol_data(obs_source_t *source, size_t mix,
 				     size_t channels, float *vol_data)
 {
-	for (size_t ch = 0; ch < channels; ch++) {
-		register float *out = source->audio_output_buf[mix][ch];
-		register float *end = out + AUDIO_OUTPUT_FRAMES;
-		register float *vol = vol_data;
-
-		while (out < end)
-			*(out++) *= *(vol++);
-	}
+	for (size_t ch = 0; ch < channels; ch++)
+		audio_mul_buf(source->audio_output_buf[mix][ch], vol_data,
+			      AUDIO_OUTPUT_FRAMES);
 }
 
 static inline void apply_audio_action(obs_source_t *source,
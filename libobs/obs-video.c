@@ -928,6 +928,7 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 
 	uint64_t frame_start = os_gettime_ns();
 	uint64_t frame_time_ns;
+	long name_lookups;
 	bool raw_active = obs->video.raw_active > 0;
 #ifdef _WIN32
 	const bool gpu_active = obs->video.gpu_encoder_active > 0;
@@ -988,9 +989,15 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	video_sleep(&obs->video, raw_active, gpu_active, &obs->video.video_time,
 		    context->interval);
 
+	name_lookups = gs_effect_get_name_lookup_count();
+
 	context->frame_time_total_ns += frame_time_ns;
 	context->fps_total_ns += (obs->video.video_time - context->last_time);
 	context->fps_total_frames++;
+	context->name_lookups_total +=
+		(unsigned long)name_lookups -
+		(unsigned long)context->last_name_lookups;
+	context->last_name_lookups = name_lookups;
 
 	if (context->fps_total_ns >= 1000000000ULL) {
 		obs->video.video_fps =
@@ -999,10 +1006,14 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 		obs->video.video_avg_frame_time_ns =
 			context->frame_time_total_ns /
 			(uint64_t)context->fps_total_frames;
+		obs->video.video_avg_name_lookups =
+			(double)context->name_lookups_total /
+			(double)context->fps_total_frames;
 
 		context->frame_time_total_ns = 0;
 		context->fps_total_ns = 0;
 		context->fps_total_frames = 0;
+		context->name_lookups_total = 0;
 	}
 
 	return !stop_requested;
@@ -1036,6 +1047,8 @@ void *obs_graphics_thread(void *param)
 	context.frame_time_total_ns = 0;
 	context.fps_total_ns = 0;
 	context.fps_total_frames = 0;
+	context.name_lookups_total = 0;
+	context.last_name_lookups = gs_effect_get_name_lookup_count();
 	context.last_time = 0;
 #ifdef _WIN32
 	context.gpu_was_active = false;
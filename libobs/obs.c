@@ -282,6 +282,14 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 
 	gs_enter_context(video->graphics);
 
+	if (obs->module_config_path) {
+		struct dstr cache_path = {0};
+		dstr_printf(&cache_path, "%s/%s/shader-cache",
+			    obs->module_config_path, ovi->graphics_module);
+		gs_set_shader_cache_path(cache_path.array);
+		dstr_free(&cache_path);
+	}
+
 	char *filename = obs_find_data_file("default.effect");
 	video->default_effect = gs_effect_create_from_file(filename, NULL);
 	bfree(filename);
@@ -586,6 +594,8 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
 
+	obs_audio_render_threads_start(audio);
+
 	errorcode = audio_output_open(&audio->audio, ai);
 	if (errorcode == AUDIO_OUTPUT_SUCCESS)
 		return true;
@@ -603,6 +613,8 @@ static void obs_free_audio(void)
 	if (audio->audio)
 		audio_output_close(audio->audio);
 
+	obs_audio_render_threads_stop(audio);
+
 	circlebuf_free(&audio->buffered_timestamps);
 	da_free(audio->render_order);
 	da_free(audio->root_nodes);
@@ -1041,6 +1053,7 @@ void obs_shutdown(void)
 	obs_free_video();
 	obs_free_hotkeys();
 	obs_free_graphics();
+	obs_encoder_packet_pool_free();
 	proc_handler_destroy(obs->procs);
 	signal_handler_destroy(obs->signals);
 	obs->procs = NULL;
@@ -2194,6 +2207,11 @@ uint64_t obs_get_average_frame_time_ns(void)
 	return obs->video.video_avg_frame_time_ns;
 }
 
+double obs_get_average_effect_name_lookups(void)
+{
+	return obs->video.video_avg_name_lookups;
+}
+
 uint64_t obs_get_frame_interval_ns(void)
 {
 	return obs->video.video_frame_interval_ns;
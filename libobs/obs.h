@@ -745,6 +745,7 @@ EXPORT uint64_t obs_get_video_frame_time(void);
 
 EXPORT double obs_get_active_fps(void);
 EXPORT uint64_t obs_get_average_frame_time_ns(void);
+EXPORT double obs_get_average_effect_name_lookups(void);
 EXPORT uint64_t obs_get_frame_interval_ns(void);
 
 EXPORT uint32_t obs_get_total_frames(void);
@@ -1204,6 +1205,20 @@ EXPORT void obs_source_output_video(obs_source_t *source,
 EXPORT void obs_source_output_video2(obs_source_t *source,
 				     const struct obs_source_frame2 *frame);
 
+/**
+ * Outputs asynchronous video data without copying it.  The planes of the
+ * frame stay owned by the caller and must remain valid until libobs calls
+ * release, once the frame has been uploaded or output (or dropped).  release
+ * is called exactly once per frame, from any thread, and must not call back
+ * into the source.  A NULL frame releases the queued frames of release and
+ * param that are not being output, so that the source can get its buffers
+ * back when it stops capturing.
+ */
+EXPORT void obs_source_output_video_ref(
+	obs_source_t *source, const struct obs_source_frame *frame,
+	void (*release)(void *param, struct obs_source_frame *frame),
+	void *param);
+
 EXPORT void obs_source_set_async_rotation(obs_source_t *source, long rotation);
 
 /**
@@ -1859,6 +1874,10 @@ EXPORT obs_service_t *obs_output_get_service(const obs_output_t *output);
 EXPORT void obs_output_set_reconnect_settings(obs_output_t *output,
 					      int retry_count, int retry_sec);
 
+/** Gets the reconnect settings, for outputs that reconnect by themselves. */
+EXPORT void obs_output_get_reconnect_settings(const obs_output_t *output,
+					      int *retry_count, int *retry_sec);
+
 EXPORT void obs_output_get_stats(const obs_output_t *output);
 EXPORT const char *obs_output_get_stats_list(const obs_output_t *output);
 EXPORT uint64_t obs_output_get_total_bytes(const obs_output_t *output);
@@ -2076,6 +2095,35 @@ EXPORT void obs_encoder_update(obs_encoder_t *encoder, obs_data_t *settings);
 EXPORT bool obs_encoder_get_extra_data(const obs_encoder_t *encoder,
 				       uint8_t **extra_data, size_t *size);
 
+/**
+ * Requests that the next raw frame handed to a video encoder is encoded as a
+ * keyframe.  Used by outputs that receive picture loss feedback.
+ */
+EXPORT void obs_encoder_request_keyframe(obs_encoder_t *encoder);
+
+/**
+ * Initializes and starts an encoder on behalf of an output that consumes its
+ * packets directly rather than through the encoded output path (for example
+ * a raw output that only needs the video track pre-encoded).
+ */
+EXPORT bool obs_encoder_add_packet_callback(
+	obs_encoder_t *encoder,
+	void (*new_packet)(void *param, struct encoder_packet *packet),
+	void *param);
+
+/** Stops delivering packets started with obs_encoder_add_packet_callback */
+EXPORT void obs_encoder_remove_packet_callback(
+	obs_encoder_t *encoder,
+	void (*new_packet)(void *param, struct encoder_packet *packet),
+	void *param);
+
+/**
+ * Returns the number of outputs and packet callbacks currently receiving the
+ * packets of this encoder.  An output that changes the encoder's settings
+ * while running should only do so if it is the only one.
+ */
+EXPORT size_t obs_encoder_get_num_consumers(obs_encoder_t *encoder);
+
 /** Returns the current settings for this encoder */
 EXPORT obs_data_t *obs_encoder_get_settings(const obs_encoder_t *encoder);
 
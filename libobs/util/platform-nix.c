@@ -48,6 +48,11 @@
 #include <spawn.h>
 #endif
 
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+
 #include "darray.h"
 #include "dstr.h"
 #include "platform.h"
@@ -152,6 +157,19 @@ bool os_sleepto_ns(uint64_t time_target)
 	if (time_target < current)
 		return false;
 
+#ifdef __linux__
+	/* an absolute deadline does not drift when the thread is preempted
+	 * between reading the clock and going to sleep */
+	struct timespec deadline;
+	deadline.tv_sec = time_target / 1000000000;
+	deadline.tv_nsec = time_target % 1000000000;
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline,
+			       NULL) == EINTR)
+		;
+
+	return true;
+#else
 	time_target -= current;
 
 	struct timespec req, remain;
@@ -166,6 +184,7 @@ bool os_sleepto_ns(uint64_t time_target)
 	}
 
 	return true;
+#endif
 }
 
 void os_sleep_ms(uint32_t duration)
@@ -679,6 +698,500 @@ void os_inhibit_sleep_destroy(os_inhibit_t *info)
 
 #endif
 
+#ifdef __linux__
+
+/* a burst of changes is reported once no new change came in for a while,
+ * or at the latest some time after its first change (files appended to
+ * continuously, like logs) */
+#define FILE_WATCH_QUIET_NS 50000000ULL
+#define FILE_WATCH_MAX_DELAY_NS 500000000ULL
+
+/* how often the directories of lost watches are watched again */
+#define FILE_WATCH_RETRY_NS 1000000000ULL
+
+#define FILE_WATCH_MASK                                                    \
+	(IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | \
+	 IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF)
+
+struct os_file_watch {
+	int wd;
+	char *dir_path;
+	char *name;
+	os_file_watch_cb callback;
+	void *param;
+	bool pending;
+};
+
+/* inotify watches directories, so that files being replaced (saved to a
+ * temporary file and renamed) or created later are noticed too */
+struct watch_dir {
+	int wd;
+	DARRAY(struct os_file_watch *) watches;
+};
+
+struct file_watch_service {
+	pthread_t thread;
+	int fd;
+	int stop_pipe[2];
+
+	DARRAY(struct watch_dir) dirs;
+	size_t num_watches;
+
+	/* watches whose directory was removed, moved or unmounted, they
+	 * have no wd until their directory can be watched again */
+	DARRAY(struct os_file_watch *) lost;
+	uint64_t last_retry;
+
+	uint64_t first_change;
+	uint64_t last_change;
+
+	/* callbacks are called without the mutex held, calling is the watch
+	 * whose callback is running */
+	DARRAY(struct os_file_watch *) dispatch;
+	struct os_file_watch *calling;
+};
+
+static pthread_mutex_t file_watch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t file_watch_cond = PTHREAD_COND_INITIALIZER;
+static struct file_watch_service *file_watch_service = NULL;
+
+static struct watch_dir *find_watch_dir(struct file_watch_service *service,
+					int wd)
+{
+	for (size_t i = 0; i < service->dirs.num; i++) {
+		if (service->dirs.array[i].wd == wd)
+			return service->dirs.array + i;
+	}
+
+	return NULL;
+}
+
+static void add_to_watch_dir(struct file_watch_service *service,
+			     struct os_file_watch *watch, int wd)
+{
+	struct watch_dir *dir = find_watch_dir(service, wd);
+
+	if (!dir) {
+		dir = da_push_back_new(service->dirs);
+		dir->wd = wd;
+	}
+
+	watch->wd = wd;
+	da_push_back(dir->watches, &watch);
+}
+
+static void set_changed(struct file_watch_service *service)
+{
+	service->last_change = os_gettime_ns();
+	if (!service->first_change)
+		service->first_change = service->last_change;
+}
+
+/* name is NULL to mark every file of the directory */
+static void mark_changed(struct file_watch_service *service,
+			 struct watch_dir *dir, const char *name)
+{
+	bool changed = false;
+
+	for (size_t i = 0; i < dir->watches.num; i++) {
+		struct os_file_watch *watch = dir->watches.array[i];
+
+		if (!name || strcmp(watch->name, name) == 0) {
+			watch->pending = true;
+			changed = true;
+		}
+	}
+
+	if (changed)
+		set_changed(service);
+}
+
+/* the wd of the directory is no longer valid, its files are reported as
+ * changed and are watched again once the directory is back */
+static void lose_watch_dir(struct file_watch_service *service,
+			   struct watch_dir *dir)
+{
+	mark_changed(service, dir, NULL);
+
+	for (size_t i = 0; i < dir->watches.num; i++) {
+		struct os_file_watch *watch = dir->watches.array[i];
+
+		blog(LOG_DEBUG, "file watch: lost '%s', polling it",
+		     watch->dir_path);
+
+		watch->wd = -1;
+		da_push_back(service->lost, &watch);
+	}
+
+	if (!service->last_retry)
+		service->last_retry = os_gettime_ns();
+
+	da_free(dir->watches);
+	da_erase(service->dirs, dir - service->dirs.array);
+}
+
+static void retry_lost_watches(struct file_watch_service *service)
+{
+	service->last_retry = os_gettime_ns();
+
+	for (size_t i = service->lost.num; i > 0; i--) {
+		struct os_file_watch *watch = service->lost.array[i - 1];
+		int wd = inotify_add_watch(service->fd, watch->dir_path,
+					   FILE_WATCH_MASK);
+
+		if (wd == -1)
+			continue;
+
+		add_to_watch_dir(service, watch, wd);
+		da_erase(service->lost, i - 1);
+
+		/* the file may have come back with its directory */
+		watch->pending = true;
+		set_changed(service);
+	}
+
+	if (!service->lost.num)
+		service->last_retry = 0;
+}
+
+static void process_events(struct file_watch_service *service,
+			   const char *buf, size_t size)
+{
+	const struct inotify_event *event;
+
+	for (size_t pos = 0; pos < size; pos += sizeof(*event) + event->len) {
+		struct watch_dir *dir;
+
+		event = (const struct inotify_event *)(buf + pos);
+
+		if (event->mask & IN_Q_OVERFLOW) {
+			for (size_t i = 0; i < service->dirs.num; i++)
+				mark_changed(service, service->dirs.array + i,
+					     NULL);
+			continue;
+		}
+
+		dir = find_watch_dir(service, event->wd);
+		if (!dir)
+			continue;
+
+		/* the directory itself went away, a moved directory is still
+		 * watched under its new name so its watch is removed */
+		if (event->mask & IN_MOVE_SELF)
+			inotify_rm_watch(service->fd, dir->wd);
+
+		if (event->mask & (IN_IGNORED | IN_MOVE_SELF))
+			lose_watch_dir(service, dir);
+		else if (!event->len)
+			mark_changed(service, dir, NULL);
+		else
+			mark_changed(service, dir, event->name);
+	}
+}
+
+static void collect_pending(struct file_watch_service *service,
+			    struct os_file_watch *watch)
+{
+	if (watch->pending) {
+		watch->pending = false;
+		da_push_back(service->dispatch, &watch);
+	}
+}
+
+static void collect_changes(struct file_watch_service *service)
+{
+	service->first_change = 0;
+
+	for (size_t i = 0; i < service->dirs.num; i++) {
+		struct watch_dir *dir = service->dirs.array + i;
+
+		for (size_t j = 0; j < dir->watches.num; j++)
+			collect_pending(service, dir->watches.array[j]);
+	}
+
+	for (size_t i = 0; i < service->lost.num; i++)
+		collect_pending(service, service->lost.array[i]);
+}
+
+/* called with the mutex held, which is released around each callback.
+ * os_file_watch_destroy removes its watch from the dispatch list, and waits
+ * for its callback if it is the one running. */
+static void dispatch_changes(struct file_watch_service *service)
+{
+	while (service->dispatch.num) {
+		struct os_file_watch *watch = service->dispatch.array[0];
+
+		da_erase(service->dispatch, 0);
+		service->calling = watch;
+
+		pthread_mutex_unlock(&file_watch_mutex);
+		watch->callback(watch->param);
+		pthread_mutex_lock(&file_watch_mutex);
+
+		service->calling = NULL;
+		pthread_cond_broadcast(&file_watch_cond);
+	}
+}
+
+static inline uint64_t change_due(struct file_watch_service *service)
+{
+	uint64_t due = service->last_change + FILE_WATCH_QUIET_NS;
+
+	if (due > service->first_change + FILE_WATCH_MAX_DELAY_NS)
+		due = service->first_change + FILE_WATCH_MAX_DELAY_NS;
+	return due;
+}
+
+static void *file_watch_thread(void *data)
+{
+	struct file_watch_service *service = data;
+	struct pollfd fds[2] = {
+		{.fd = service->fd, .events = POLLIN},
+		{.fd = service->stop_pipe[0], .events = POLLIN},
+	};
+	char buf[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+
+	os_set_thread_name("file watch");
+
+	for (;;) {
+		int timeout = -1;
+		uint64_t due = 0;
+		uint64_t now;
+		ssize_t size;
+
+		pthread_mutex_lock(&file_watch_mutex);
+
+		now = os_gettime_ns();
+		if (service->lost.num &&
+		    now >= service->last_retry + FILE_WATCH_RETRY_NS)
+			retry_lost_watches(service);
+
+		if (service->first_change) {
+			due = change_due(service);
+			if (now >= due) {
+				collect_changes(service);
+				due = 0;
+			}
+		}
+
+		dispatch_changes(service);
+
+		if (service->lost.num) {
+			uint64_t retry = service->last_retry +
+					 FILE_WATCH_RETRY_NS;
+			if (!due || retry < due)
+				due = retry;
+		}
+
+		if (due) {
+			now = os_gettime_ns();
+			if (due > now)
+				timeout = (int)((due - now + 999999) / 1000000);
+			else
+				timeout = 0;
+		}
+
+		pthread_mutex_unlock(&file_watch_mutex);
+
+		if (poll(fds, 2, timeout) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			blog(LOG_ERROR, "file watch: poll failed, errno %d",
+			     errno);
+			break;
+		}
+
+		/* the other end of the pipe is closed to stop */
+		if (fds[1].revents)
+			break;
+		if (!(fds[0].revents & POLLIN))
+			continue;
+
+		size = read(service->fd, buf, sizeof(buf));
+		if (size <= 0)
+			continue;
+
+		pthread_mutex_lock(&file_watch_mutex);
+		process_events(service, buf, (size_t)size);
+		pthread_mutex_unlock(&file_watch_mutex);
+	}
+
+	return NULL;
+}
+
+static struct file_watch_service *start_file_watch_service(void)
+{
+	struct file_watch_service *service = bzalloc(sizeof(*service));
+
+	service->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (service->fd == -1) {
+		blog(LOG_WARNING, "file watch: inotify_init1 failed, errno %d",
+		     errno);
+		goto fail_inotify;
+	}
+
+	if (pipe(service->stop_pipe) != 0)
+		goto fail_pipe;
+	if (pthread_create(&service->thread, NULL, file_watch_thread,
+			   service) != 0)
+		goto fail_thread;
+
+	return service;
+
+fail_thread:
+	close(service->stop_pipe[0]);
+	close(service->stop_pipe[1]);
+fail_pipe:
+	close(service->fd);
+fail_inotify:
+	bfree(service);
+	return NULL;
+}
+
+/* must be called without the mutex held, and with no watches left */
+static void stop_file_watch_service(struct file_watch_service *service)
+{
+	close(service->stop_pipe[1]);
+	pthread_join(service->thread, NULL);
+
+	close(service->stop_pipe[0]);
+	close(service->fd);
+	da_free(service->dirs);
+	da_free(service->lost);
+	da_free(service->dispatch);
+	bfree(service);
+}
+
+os_file_watch_t *os_file_watch_create(const char *path,
+				      os_file_watch_cb callback, void *param)
+{
+	struct file_watch_service *service;
+	struct file_watch_service *unused = NULL;
+	struct os_file_watch *watch = NULL;
+	struct dstr dir_path = {0};
+	const char *name;
+	int wd;
+
+	if (!path || !callback)
+		return NULL;
+
+	name = strrchr(path, '/');
+	if (name) {
+		dstr_ncopy(&dir_path, path, name == path ? 1 : name - path);
+		name++;
+	} else {
+		dstr_copy(&dir_path, ".");
+		name = path;
+	}
+
+	if (!*name)
+		goto fail;
+
+	pthread_mutex_lock(&file_watch_mutex);
+
+	service = file_watch_service;
+	if (!service) {
+		service = start_file_watch_service();
+		if (!service)
+			goto fail_locked;
+		file_watch_service = service;
+	}
+
+	wd = inotify_add_watch(service->fd, dir_path.array, FILE_WATCH_MASK);
+	if (wd == -1) {
+		blog(LOG_DEBUG, "file watch: could not watch '%s', errno %d",
+		     dir_path.array, errno);
+
+		if (!service->num_watches) {
+			file_watch_service = NULL;
+			unused = service;
+		}
+		goto fail_locked;
+	}
+
+	watch = bzalloc(sizeof(*watch));
+	watch->dir_path = bstrdup(dir_path.array);
+	watch->name = bstrdup(name);
+	watch->callback = callback;
+	watch->param = param;
+
+	add_to_watch_dir(service, watch, wd);
+	service->num_watches++;
+
+fail_locked:
+	pthread_mutex_unlock(&file_watch_mutex);
+
+	if (unused)
+		stop_file_watch_service(unused);
+fail:
+	dstr_free(&dir_path);
+	return watch;
+}
+
+void os_file_watch_destroy(os_file_watch_t *watch)
+{
+	struct file_watch_service *service;
+	struct watch_dir *dir;
+
+	if (!watch)
+		return;
+
+	pthread_mutex_lock(&file_watch_mutex);
+
+	service = file_watch_service;
+	dir = watch->wd == -1 ? NULL : find_watch_dir(service, watch->wd);
+
+	if (dir) {
+		da_erase_item(dir->watches, &watch);
+		if (!dir->watches.num) {
+			inotify_rm_watch(service->fd, dir->wd);
+			da_free(dir->watches);
+			da_erase(service->dirs, dir - service->dirs.array);
+		}
+	} else {
+		da_erase_item(service->lost, &watch);
+	}
+
+	da_erase_item(service->dispatch, &watch);
+	while (service->calling == watch)
+		pthread_cond_wait(&file_watch_cond, &file_watch_mutex);
+
+	/* the thread only runs while there are watches */
+	if (--service->num_watches == 0)
+		file_watch_service = NULL;
+	else
+		service = NULL;
+
+	pthread_mutex_unlock(&file_watch_mutex);
+
+	if (service)
+		stop_file_watch_service(service);
+
+	bfree(watch->dir_path);
+	bfree(watch->name);
+	bfree(watch);
+}
+
+#else
+
+os_file_watch_t *os_file_watch_create(const char *path,
+				      os_file_watch_cb callback, void *param)
+{
+	UNUSED_PARAMETER(path);
+	UNUSED_PARAMETER(callback);
+	UNUSED_PARAMETER(param);
+	return NULL;
+}
+
+void os_file_watch_destroy(os_file_watch_t *watch)
+{
+	UNUSED_PARAMETER(watch);
+}
+
+#endif
+
 void os_breakpoint()
 {
 	raise(SIGTRAP);
@@ -1040,6 +1040,21 @@ void os_inhibit_sleep_destroy(os_inhibit_t *info)
 	}
 }
 
+/* no watch backend yet, files are polled */
+os_file_watch_t *os_file_watch_create(const char *path,
+				      os_file_watch_cb callback, void *param)
+{
+	UNUSED_PARAMETER(path);
+	UNUSED_PARAMETER(callback);
+	UNUSED_PARAMETER(param);
+	return NULL;
+}
+
+void os_file_watch_destroy(os_file_watch_t *watch)
+{
+	UNUSED_PARAMETER(watch);
+}
+
 void os_breakpoint(void)
 {
 	__debugbreak();
@@ -179,6 +179,30 @@ EXPORT os_inhibit_t *os_inhibit_sleep_create(const char *reason);
 EXPORT bool os_inhibit_sleep_set_active(os_inhibit_t *info, bool active);
 EXPORT void os_inhibit_sleep_destroy(os_inhibit_t *info);
 
+/*
+ * Watches a file for changes (written, replaced, created or deleted).  The
+ * callback is called from a thread shared by all watches, a short while
+ * after the last change of a burst.  Once os_file_watch_destroy returns the
+ * callback is no longer running and won't be called again.  A callback must
+ * not destroy its own watch.
+ *
+ * A watch whose directory goes away reports a change and is watched again
+ * once the directory is back.  Changes to symlink targets or on network file
+ * systems may be missed, so watched files should still be polled slowly.
+ *
+ * Returns NULL if the file cannot be watched, or if there is no watch
+ * backend on this platform (currently only Linux has one), in which case
+ * the file has to be polled instead.
+ */
+struct os_file_watch;
+typedef struct os_file_watch os_file_watch_t;
+typedef void (*os_file_watch_cb)(void *param);
+
+EXPORT os_file_watch_t *os_file_watch_create(const char *path,
+					     os_file_watch_cb callback,
+					     void *param);
+EXPORT void os_file_watch_destroy(os_file_watch_t *watch);
+
 EXPORT void os_breakpoint(void);
 
 EXPORT int os_get_physical_cores(void);
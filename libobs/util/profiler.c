@@ -6,10 +6,15 @@
 #include "platform.h"
 #include "threading.h"
 
+#include <errno.h>
 #include <math.h>
 
 #include <zlib.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 //#define TRACK_OVERHEAD
 
 struct profiler_snapshot {
@@ -256,25 +261,209 @@ static void merge_call(profile_entry *entry, profile_call *call,
 #endif
 }
 
-static bool enabled = false;
+/* ------------------------------------------------------------------------- */
+/* Per-thread event buffers
+ *
+ * profile_start/profile_end only append begin/end events to a ring buffer
+ * owned by the calling thread, without taking any lock.  The rings are
+ * drained by a collector thread, and whenever a snapshot or trace is
+ * requested; the call trees are rebuilt from the events on that side and
+ * merged into the root entries.
+ *
+ * A buffer is referenced by its thread and by the list of the collector, and
+ * freed once both are done with it: the thread drops its reference when it
+ * exits, or when it starts a new root call after profiler_free, so that it
+ * never writes to a freed buffer. */
+
+#define PROFILE_EVENTS_SIZE 8192
+#define PROFILE_EVENTS_MASK (PROFILE_EVENTS_SIZE - 1)
+#define PROFILE_COLLECT_INTERVAL_MS 50
+
+enum profile_event_type {
+	PROFILE_EVENT_BEGIN,
+	PROFILE_EVENT_END,
+	PROFILE_EVENT_RECORD,
+};
+
+struct profile_event {
+	enum profile_event_type type;
+	const char *name;
+	uint64_t time;
+	/* duration for PROFILE_EVENT_RECORD, overhead timestamps otherwise */
+	uint64_t data;
+};
+
+typedef struct profile_thread profile_thread;
+struct profile_thread {
+	struct profile_event events[PROFILE_EVENTS_SIZE];
+	volatile long head;
+	volatile long tail;
+	volatile long dropped;
+	volatile bool exited;
+	volatile long refs;
+
+	/* owning thread only */
+	DARRAY(const char *) stack;
+	size_t skip_depth;
+
+	/* collector only */
+	profile_call *context;
+	long reported_dropped;
+	uint32_t id;
+	bool named;
+};
+
+struct profile_thread_name {
+	uint32_t id;
+	const char *name;
+};
+
+struct profile_trace_event {
+	const char *name;
+	uint64_t start;
+	uint64_t duration;
+	uint32_t thread_id;
+};
+
+struct profile_trace {
+	bool active;
+	uint64_t start_time;
+	struct profile_trace_event *events;
+	size_t size;
+	size_t next;
+	size_t num;
+};
+
+static volatile bool enabled = false;
 static pthread_mutex_t root_mutex = PTHREAD_MUTEX_INITIALIZER;
 static DARRAY(profile_root_entry) root_entries;
 
-static THREAD_LOCAL profile_call *thread_context = NULL;
+/* lock order: collect_mutex, then root_mutex */
+static pthread_mutex_t collect_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(profile_thread *) threads;
+static DARRAY(struct profile_thread_name) thread_names;
+static struct profile_trace trace;
+static uint32_t next_thread_id = 1;
+static volatile long generation = 1;
+#ifdef _WIN32
+static DWORD thread_key = FLS_OUT_OF_INDEXES;
+#else
+static pthread_key_t thread_key;
+#endif
+static bool thread_key_valid = false;
+static pthread_t collect_thread;
+static os_event_t *collect_event = NULL;
+static bool collect_thread_active = false;
+
+static THREAD_LOCAL profile_thread *thread_events = NULL;
+static THREAD_LOCAL long thread_generation = 0;
 static THREAD_LOCAL bool thread_enabled = true;
 
+static void collect_events(void);
+static void release_thread(profile_thread *thread);
+
+static void *collect_thread_func(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	os_set_thread_name("profiler: collect");
+
+	while (os_event_timedwait(collect_event, PROFILE_COLLECT_INTERVAL_MS) ==
+	       ETIMEDOUT) {
+		pthread_mutex_lock(&collect_mutex);
+		collect_events();
+		pthread_mutex_unlock(&collect_mutex);
+	}
+
+	return NULL;
+}
+
+/* unlike pthread key destructors, fiber local storage callbacks also run when
+ * threads that were not created with pthread_create exit */
+#ifdef _WIN32
+static void WINAPI thread_exit(void *data)
+#else
+static void thread_exit(void *data)
+#endif
+{
+	profile_thread *thread = data;
+	if (!thread)
+		return;
+
+	os_atomic_set_bool(&thread->exited, true);
+	release_thread(thread);
+}
+
+/* the key is never deleted, exiting threads still hold their buffers after
+ * profiler_free */
+static bool create_thread_key(void)
+{
+#ifdef _WIN32
+	thread_key = FlsAlloc(thread_exit);
+	return thread_key != FLS_OUT_OF_INDEXES;
+#else
+	return pthread_key_create(&thread_key, thread_exit) == 0;
+#endif
+}
+
+static void set_thread_key(profile_thread *thread)
+{
+	if (!thread_key_valid)
+		return;
+
+#ifdef _WIN32
+	FlsSetValue(thread_key, thread);
+#else
+	pthread_setspecific(thread_key, thread);
+#endif
+}
+
 void profiler_start(void)
 {
+	pthread_mutex_lock(&collect_mutex);
+	if (!thread_key_valid)
+		thread_key_valid = create_thread_key();
+
+	if (!collect_thread_active &&
+	    os_event_init(&collect_event, OS_EVENT_TYPE_MANUAL) == 0) {
+		collect_thread_active = pthread_create(&collect_thread, NULL,
+						       collect_thread_func,
+						       NULL) == 0;
+		if (!collect_thread_active) {
+			os_event_destroy(collect_event);
+			collect_event = NULL;
+		}
+	}
+	pthread_mutex_unlock(&collect_mutex);
+
 	pthread_mutex_lock(&root_mutex);
-	enabled = true;
+	os_atomic_set_bool(&enabled, true);
 	pthread_mutex_unlock(&root_mutex);
 }
 
+static void stop_collect_thread(void)
+{
+	pthread_mutex_lock(&collect_mutex);
+	bool active = collect_thread_active;
+	collect_thread_active = false;
+	pthread_mutex_unlock(&collect_mutex);
+
+	if (!active)
+		return;
+
+	os_event_signal(collect_event);
+	pthread_join(collect_thread, NULL);
+	os_event_destroy(collect_event);
+	collect_event = NULL;
+}
+
 void profiler_stop(void)
 {
 	pthread_mutex_lock(&root_mutex);
-	enabled = false;
+	os_atomic_set_bool(&enabled, false);
 	pthread_mutex_unlock(&root_mutex);
+
+	stop_collect_thread();
 }
 
 void profile_reenable_thread(void)
@@ -282,9 +471,7 @@ void profile_reenable_thread(void)
 	if (thread_enabled)
 		return;
 
-	pthread_mutex_lock(&root_mutex);
-	thread_enabled = enabled;
-	pthread_mutex_unlock(&root_mutex);
+	thread_enabled = os_atomic_load_bool(&enabled);
 }
 
 static bool lock_root(void)
@@ -292,7 +479,6 @@ static bool lock_root(void)
 	pthread_mutex_lock(&root_mutex);
 	if (!enabled) {
 		pthread_mutex_unlock(&root_mutex);
-		thread_enabled = false;
 		return false;
 	}
 
@@ -365,31 +551,106 @@ static void merge_context(profile_call *context)
 	free_call_context(prev_call);
 }
 
+/* drops the buffer of the calling thread */
+static void unregister_thread(void)
+{
+	profile_thread *thread = thread_events;
+
+	set_thread_key(NULL);
+	thread_events = NULL;
+	release_thread(thread);
+}
+
+/* called between root calls, once profiler_free dropped the buffer from the
+ * collector, which no longer reads it */
+static profile_thread *get_thread(void)
+{
+	if (thread_events &&
+	    thread_generation != os_atomic_load_long(&generation))
+		unregister_thread();
+
+	return thread_events;
+}
+
+static profile_thread *register_thread(void)
+{
+	profile_thread *thread = bzalloc(sizeof(profile_thread));
+	thread->refs = 2;
+
+	pthread_mutex_lock(&collect_mutex);
+	thread->id = next_thread_id++;
+	da_push_back(threads, &thread);
+	thread_generation = os_atomic_load_long(&generation);
+	set_thread_key(thread);
+	pthread_mutex_unlock(&collect_mutex);
+
+	thread_events = thread;
+	return thread;
+}
+
+/* Fails unless there is room for |reserve| more events afterwards, which
+ * keeps one slot free for the end event of every call that is still open */
+static inline bool push_event(profile_thread *thread,
+			      enum profile_event_type type, const char *name,
+			      uint64_t time, uint64_t data, size_t reserve)
+{
+	long head = thread->head;
+	long tail = os_atomic_load_long(&thread->tail);
+	size_t used = (size_t)(head - tail) & PROFILE_EVENTS_MASK;
+
+	if (PROFILE_EVENTS_SIZE - used <= reserve + 1)
+		return false;
+
+	struct profile_event *event = &thread->events[head];
+	event->type = type;
+	event->name = name;
+	event->time = time;
+	event->data = data;
+
+	/* full barrier, the event must be visible before the new head
+	 * (os_atomic_set_long only acquires) */
+	os_atomic_compare_swap_long(&thread->head, head,
+				    (head + 1) & PROFILE_EVENTS_MASK);
+	return true;
+}
+
 void profile_start(const char *name)
 {
 	if (!thread_enabled)
 		return;
 
-	profile_call new_call = {
-		.name = name,
+	uint64_t data = 0;
 #ifdef TRACK_OVERHEAD
-		.overhead_start = os_gettime_ns(),
+	data = os_gettime_ns();
 #endif
-		.parent = thread_context,
-	};
 
-	profile_call *call = NULL;
+	profile_thread *thread = thread_events;
+	if (!thread || !thread->stack.num) {
+		thread = get_thread();
 
-	if (new_call.parent) {
-		size_t idx = da_push_back(new_call.parent->children, &new_call);
-		call = &new_call.parent->children.array[idx];
-	} else {
-		call = bmalloc(sizeof(profile_call));
-		memcpy(call, &new_call, sizeof(profile_call));
+		if (!os_atomic_load_bool(&enabled)) {
+			thread_enabled = false;
+			return;
+		}
+
+		if (!thread)
+			thread = register_thread();
+	}
+
+	size_t depth = thread->stack.num;
+	da_push_back(thread->stack, &name);
+
+	/* a call that did not fit is dropped along with all its children */
+	if (thread->skip_depth) {
+		os_atomic_inc_long(&thread->dropped);
+		return;
 	}
 
-	thread_context = call;
-	call->start_time = os_gettime_ns();
+	if (!push_event(thread, PROFILE_EVENT_BEGIN, name, os_gettime_ns(),
+			data, depth + 1)) {
+		thread->skip_depth = depth + 1;
+		os_atomic_inc_long(&thread->dropped);
+	}
 }
 
 void profile_end(const char *name)
@@ -398,47 +659,245 @@ void profile_end(const char *name)
 	if (!thread_enabled)
 		return;
 
-	profile_call *call = thread_context;
-	if (!call) {
+	profile_thread *thread = thread_events;
+	if (!thread || !thread->stack.num) {
 		blog(LOG_ERROR, "Called profile end with no active profile");
 		return;
 	}
 
-	if (!call->name)
-		call->name = name;
+	size_t idx = thread->stack.num - 1;
+	const char *call_name = thread->stack.array[idx];
+	if (!call_name)
+		call_name = name;
 
-	if (call->name != name) {
+	if (call_name != name) {
 		blog(LOG_ERROR,
 		     "Called profile end with mismatching name: "
 		     "start(\"%s\"[%p]) <-> end(\"%s\"[%p])",
-		     call->name, call->name, name, name);
+		     call_name, call_name, name, name);
 
-		profile_call *parent = call->parent;
-		while (parent && parent->parent && parent->name != name)
-			parent = parent->parent;
+		size_t parent = idx;
+		while (parent && thread->stack.array[parent - 1] != name)
+			parent--;
 
-		if (!parent || parent->name != name)
+		if (!parent)
 			return;
 
-		while (call->name != name) {
-			profile_end(call->name);
-			call = call->parent;
-		}
+		while (thread->stack.num > parent)
+			profile_end(thread->stack.array[thread->stack.num - 1]);
+
+		idx = parent - 1;
+	}
+
+	da_pop_back(thread->stack);
+
+	if (thread->skip_depth) {
+		if (thread->skip_depth == idx + 1)
+			thread->skip_depth = 0;
+		return;
+	}
+
+	uint64_t data = 0;
+#ifdef TRACK_OVERHEAD
+	data = os_gettime_ns();
+#endif
+
+	push_event(thread, PROFILE_EVENT_END, name, end, data, 0);
+}
+
+void profile_record(const char *name, uint64_t duration)
+{
+	uint64_t time = os_gettime_ns();
+	if (!thread_enabled)
+		return;
+
+	profile_thread *thread = thread_events;
+	if (!thread || !thread->stack.num) {
+		blog(LOG_ERROR, "Called profile record with no active profile");
+		return;
 	}
 
-	thread_context = call->parent;
+	if (thread->skip_depth)
+		return;
+
+	if (!push_event(thread, PROFILE_EVENT_RECORD, name, time, duration,
+			thread->stack.num))
+		os_atomic_inc_long(&thread->dropped);
+}
+
+static void trace_add(profile_thread *thread, const char *name,
+		      uint64_t start, uint64_t end)
+{
+	if (!trace.active)
+		return;
+
+	struct profile_trace_event *event = &trace.events[trace.next];
+	event->name = name;
+	event->start = start;
+	event->duration = end - start;
+	event->thread_id = thread->id;
 
-	call->end_time = end;
+	trace.next = (trace.next + 1) % trace.size;
+	if (trace.num < trace.size)
+		trace.num++;
+}
+
+static void replay_begin(profile_thread *thread,
+			 const struct profile_event *event)
+{
+	profile_call new_call = {
+		.name = event->name,
 #ifdef TRACK_OVERHEAD
-	call->overhead_end = os_gettime_ns();
+		.overhead_start = event->data,
 #endif
+		.start_time = event->time,
+		.parent = thread->context,
+	};
+
+	profile_call *call = NULL;
+
+	if (new_call.parent) {
+		size_t idx = da_push_back(new_call.parent->children, &new_call);
+		call = &new_call.parent->children.array[idx];
+	} else {
+		call = bmalloc(sizeof(profile_call));
+		memcpy(call, &new_call, sizeof(profile_call));
+	}
+
+	thread->context = call;
+}
+
+static void replay_end(profile_thread *thread,
+		       const struct profile_event *event)
+{
+	profile_call *call = thread->context;
+	if (!call)
+		return;
+
+	if (!call->name)
+		call->name = event->name;
+
+	thread->context = call->parent;
+
+	call->end_time = event->time;
+#ifdef TRACK_OVERHEAD
+	call->overhead_end = event->data;
+#endif
+
+	trace_add(thread, call->name, call->start_time, call->end_time);
 
 	if (call->parent)
 		return;
 
+	/* traces name threads after their first root call */
+	if (!thread->named) {
+		struct profile_thread_name *name =
+			da_push_back_new(thread_names);
+		name->id = thread->id;
+		name->name = call->name;
+		thread->named = true;
+	}
+
 	merge_context(call);
 }
 
+static void replay_record(profile_thread *thread,
+			  const struct profile_event *event)
+{
+	profile_call *parent = thread->context;
+	if (!parent)
+		return;
+
+	profile_call call = {
+		.name = event->name,
+		.start_time = 0,
+		.end_time = event->data,
+#ifdef TRACK_OVERHEAD
+		.overhead_start = 0,
+		.overhead_end = event->data,
+#endif
+		.parent = parent,
+	};
+
+	da_push_back(parent->children, &call);
+
+	trace_add(thread, event->name, event->time - event->data, event->time);
+}
+
+static void collect_thread_events(profile_thread *thread)
+{
+	long head = os_atomic_load_long(&thread->head);
+	long tail = thread->tail;
+
+	while (tail != head) {
+		const struct profile_event *event = &thread->events[tail];
+
+		switch (event->type) {
+		case PROFILE_EVENT_BEGIN:
+			replay_begin(thread, event);
+			break;
+		case PROFILE_EVENT_END:
+			replay_end(thread, event);
+			break;
+		case PROFILE_EVENT_RECORD:
+			replay_record(thread, event);
+			break;
+		}
+
+		tail = (tail + 1) & PROFILE_EVENTS_MASK;
+	}
+
+	os_atomic_compare_swap_long(&thread->tail, thread->tail, tail);
+
+	long dropped = os_atomic_load_long(&thread->dropped);
+	if (dropped != thread->reported_dropped) {
+		blog(LOG_WARNING,
+		     "profiler: thread %" PRIu32 " dropped %ld events, "
+		     "its event buffer was full",
+		     thread->id, dropped - thread->reported_dropped);
+		thread->reported_dropped = dropped;
+	}
+}
+
+static void free_thread(profile_thread *thread)
+{
+	profile_call *root = thread->context;
+	while (root && root->parent)
+		root = root->parent;
+
+	if (root)
+		free_call_context(root);
+
+	da_free(thread->stack);
+	bfree(thread);
+}
+
+static void release_thread(profile_thread *thread)
+{
+	if (thread && os_atomic_dec_long(&thread->refs) == 0)
+		free_thread(thread);
+}
+
+/* must be called with collect_mutex held */
+static void collect_events(void)
+{
+	for (size_t i = 0; i < threads.num;) {
+		profile_thread *thread = threads.array[i];
+
+		/* anything written before the exit flag is drained below */
+		bool exited = os_atomic_load_bool(&thread->exited);
+
+		collect_thread_events(thread);
+
+		if (exited) {
+			release_thread(thread);
+			da_erase(threads, i);
+		} else {
+			i++;
+		}
+	}
+}
+
 static int profiler_time_entry_compare(const void *first, const void *second)
 {
 	int64_t diff = ((profiler_time_entry *)second)->time_delta -
@@ -803,11 +1262,30 @@ void profiler_free(void)
 {
 	DARRAY(profile_root_entry) old_root_entries = {0};
 
+	stop_collect_thread();
+
 	pthread_mutex_lock(&root_mutex);
-	enabled = false;
+	os_atomic_set_bool(&enabled, false);
 	da_move(old_root_entries, root_entries);
 	pthread_mutex_unlock(&root_mutex);
 
+	pthread_mutex_lock(&collect_mutex);
+	os_atomic_inc_long(&generation);
+
+	/* other threads keep their buffers until their current root call
+	 * ends */
+	for (size_t i = 0; i < threads.num; i++)
+		release_thread(threads.array[i]);
+	da_free(threads);
+	da_free(thread_names);
+
+	bfree(trace.events);
+	memset(&trace, 0, sizeof(trace));
+	pthread_mutex_unlock(&collect_mutex);
+
+	if (thread_events && !thread_events->stack.num)
+		unregister_thread();
+
 	for (size_t i = 0; i < old_root_entries.num; i++) {
 		profile_root_entry *entry = &old_root_entries.array[i];
 
@@ -926,6 +1404,10 @@ profiler_snapshot_t *profile_snapshot_create(void)
 {
 	profiler_snapshot_t *snap = bzalloc(sizeof(profiler_snapshot_t));
 
+	pthread_mutex_lock(&collect_mutex);
+	collect_events();
+	pthread_mutex_unlock(&collect_mutex);
+
 	pthread_mutex_lock(&root_mutex);
 	da_reserve(snap->roots, root_entries.num);
 	for (size_t i = 0; i < root_entries.num; i++) {
@@ -1037,22 +1519,28 @@ static void dump_csv_gzwrite(void *data, struct dstr *buffer)
 	gzwrite(data, buffer->array, (unsigned)buffer->len);
 }
 
-bool profiler_snapshot_dump_csv_gz(const profiler_snapshot_t *snap,
-				   const char *filename)
+static gzFile open_gz(const char *filename)
 {
-	gzFile gz;
 #ifdef _WIN32
 	wchar_t *filename_w = NULL;
+	gzFile gz;
 
 	os_utf8_to_wcs_ptr(filename, 0, &filename_w);
 	if (!filename_w)
-		return false;
+		return NULL;
 
 	gz = gzopen_w(filename_w, "wb");
 	bfree(filename_w);
+	return gz;
 #else
-	gz = gzopen(filename, "wb");
+	return gzopen(filename, "wb");
 #endif
+}
+
+bool profiler_snapshot_dump_csv_gz(const profiler_snapshot_t *snap,
+				   const char *filename)
+{
+	gzFile gz = open_gz(filename);
 	if (!gz)
 		return false;
 
@@ -1171,3 +1659,144 @@ uint64_t profiler_snapshot_entry_overall_between_calls_count(
 {
 	return entry ? entry->overall_between_calls_count : 0;
 }
+
+/* ------------------------------------------------------------------------- */
+/* Profiler trace */
+
+#define PROFILE_TRACE_DEFAULT_EVENTS (256 * 1024)
+
+void profiler_trace_start(size_t max_events)
+{
+	if (!max_events)
+		max_events = PROFILE_TRACE_DEFAULT_EVENTS;
+
+	pthread_mutex_lock(&collect_mutex);
+
+	/* calls that ended before the trace started are not part of it */
+	collect_events();
+
+	bfree(trace.events);
+	trace.events = bmalloc(sizeof(struct profile_trace_event) * max_events);
+	trace.size = max_events;
+	trace.next = 0;
+	trace.num = 0;
+	trace.start_time = os_gettime_ns();
+	trace.active = true;
+
+	pthread_mutex_unlock(&collect_mutex);
+}
+
+void profiler_trace_stop(void)
+{
+	pthread_mutex_lock(&collect_mutex);
+	if (trace.active) {
+		collect_events();
+		trace.active = false;
+	}
+	pthread_mutex_unlock(&collect_mutex);
+}
+
+static void cat_json_string(struct dstr *dst, const char *str)
+{
+	dstr_cat_ch(dst, '"');
+
+	for (; str && *str; str++) {
+		unsigned char ch = (unsigned char)*str;
+
+		if (ch == '"' || ch == '\\') {
+			dstr_cat_ch(dst, '\\');
+			dstr_cat_ch(dst, (char)ch);
+		} else if (ch < 0x20) {
+			dstr_catf(dst, "\\u%04x", ch);
+		} else {
+			dstr_cat_ch(dst, (char)ch);
+		}
+	}
+
+	dstr_cat_ch(dst, '"');
+}
+
+static inline double trace_time_usec(uint64_t time)
+{
+	return (double)(int64_t)(time - trace.start_time) / 1000.;
+}
+
+/* Chrome trace event format, which chrome://tracing and Perfetto open */
+static void profiler_trace_dump(dump_csv_func func, void *data)
+{
+	struct dstr buffer = {0};
+	const char *sep = "";
+
+	pthread_mutex_lock(&collect_mutex);
+
+	if (trace.active)
+		collect_events();
+
+	dstr_copy(&buffer, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	func(data, &buffer);
+
+	for (size_t i = 0; i < thread_names.num; i++) {
+		struct profile_thread_name *name = &thread_names.array[i];
+
+		dstr_printf(&buffer,
+			    "%s\n{\"ph\":\"M\",\"pid\":1,\"tid\":%" PRIu32
+			    ",\"name\":\"thread_name\",\"args\":{\"name\":",
+			    sep, name->id);
+		cat_json_string(&buffer, name->name);
+		dstr_cat(&buffer, "}}");
+		func(data, &buffer);
+		sep = ",";
+	}
+
+	size_t idx = trace.size ? (trace.next + trace.size - trace.num) %
+					  trace.size
+				: 0;
+
+	for (size_t i = 0; i < trace.num; i++) {
+		struct profile_trace_event *event = &trace.events[idx];
+
+		dstr_printf(&buffer,
+			    "%s\n{\"ph\":\"X\",\"pid\":1,\"tid\":%" PRIu32
+			    ",\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+			    sep, event->thread_id,
+			    trace_time_usec(event->start),
+			    event->duration / 1000.);
+		cat_json_string(&buffer, event->name);
+		dstr_cat_ch(&buffer, '}');
+		func(data, &buffer);
+		sep = ",";
+
+		idx = (idx + 1) % trace.size;
+	}
+
+	pthread_mutex_unlock(&collect_mutex);
+
+	dstr_copy(&buffer, "\n]}\n");
+	func(data, &buffer);
+
+	dstr_free(&buffer);
+}
+
+bool profiler_trace_dump_json(const char *filename)
+{
+	FILE *f = os_fopen(filename, "wb+");
+	if (!f)
+		return false;
+
+	profiler_trace_dump(dump_csv_fwrite, f);
+
+	fclose(f);
+	return true;
+}
+
+bool profiler_trace_dump_json_gz(const char *filename)
+{
+	gzFile gz = open_gz(filename);
+	if (!gz)
+		return false;
+
+	profiler_trace_dump(dump_csv_gzwrite, gz);
+
+	gzclose_w(gz);
+	return true;
+}
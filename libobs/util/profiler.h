@@ -19,6 +19,7 @@ EXPORT void profile_register_root(const char *name,
 
 EXPORT void profile_start(const char *name);
 EXPORT void profile_end(const char *name);
+EXPORT void profile_record(const char *name, uint64_t duration);
 
 EXPORT void profile_reenable_thread(void);
 
@@ -114,6 +115,15 @@ EXPORT uint64_t profiler_snapshot_entry_max_time_between_calls(
 EXPORT uint64_t profiler_snapshot_entry_overall_between_calls_count(
 	profiler_snapshot_entry_t *entry);
 
+/* ------------------------------------------------------------------------- */
+/* Profiler trace */
+
+EXPORT void profiler_trace_start(size_t max_events);
+EXPORT void profiler_trace_stop(void);
+
+EXPORT bool profiler_trace_dump_json(const char *filename);
+EXPORT bool profiler_trace_dump_json_gz(const char *filename);
+
 #ifdef __cplusplus
 }
 #endif
@@ -54,6 +54,7 @@
 #define _mm_srai_epi16 simde_mm_srai_epi16
 #define _mm_shufflelo_epi16 simde_mm_shufflelo_epi16
 #define _mm_storeu_si128 simde_mm_storeu_si128
+#define _mm_cvttps_epi32 simde_mm_cvttps_epi32
 
 #define _MM_SHUFFLE SIMDE_MM_SHUFFLE
 #define _MM_TRANSPOSE4_PS SIMDE_MM_TRANSPOSE4_PS
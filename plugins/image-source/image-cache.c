@@ -0,0 +1,506 @@
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/darray.h>
+#include <sys/stat.h>
+
+#include "image-cache.h"
+
+#define blog(level, msg, ...) blog(level, "image-cache: " msg, ##__VA_ARGS__)
+
+#define MAX_DECODE_THREADS 4
+
+/* decoded images kept around, including the ones still in use */
+#define CACHE_BUDGET (400 * 1024 * 1024)
+
+struct image_asset {
+	char *path;
+	time_t mtime;
+	bool exclusive;
+	bool stale;
+
+	/* everything below is protected by the cache mutex */
+	long refs;
+	bool queued;
+	enum image_asset_state state;
+	uint64_t last_used;
+
+	uint32_t cx;
+	uint32_t cy;
+	bool size_known;
+
+	gs_image_file2_t if2;
+	uint64_t mem_usage;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	DARRAY(struct image_asset *) assets;
+	DARRAY(struct image_asset *) queue;
+	uint64_t mem_usage;
+	uint64_t use_count;
+
+	os_sem_t *sem;
+	pthread_t threads[MAX_DECODE_THREADS];
+	size_t num_threads;
+	volatile bool stop;
+} cache;
+
+static bool get_modified_timestamp(const char *path, time_t *mtime)
+{
+	struct stat stats;
+	if (os_stat(path, &stats) != 0)
+		return false;
+	*mtime = stats.st_mtime;
+	return true;
+}
+
+/* same test gs_image_file uses to decide whether to try the gif decoder */
+static inline bool may_be_animated(const char *path)
+{
+	size_t len = strlen(path);
+	return len > 4 && strcmp(path + len - 4, ".gif") == 0;
+}
+
+static void free_image(gs_image_file2_t *if2)
+{
+	if (if2->image.loaded) {
+		obs_enter_graphics();
+		gs_image_file2_free(if2);
+		obs_leave_graphics();
+	}
+}
+
+static void free_images(struct darray *array)
+{
+	DARRAY(gs_image_file2_t) images;
+	images.da = *array;
+
+	for (size_t i = 0; i < images.num; i++)
+		free_image(images.array + i);
+
+	da_free(images);
+}
+
+static void free_asset(struct image_asset *asset)
+{
+	free_image(&asset->if2);
+	bfree(asset->path);
+	bfree(asset);
+}
+
+/* ------------------------------------------------------------------------- */
+/* the functions below require the cache mutex                               */
+
+static inline void touch_asset(struct image_asset *asset)
+{
+	asset->last_used = ++cache.use_count;
+}
+
+static void queue_asset(struct image_asset *asset, bool urgent)
+{
+	asset->queued = true;
+
+	if (urgent)
+		da_insert(cache.queue, 0, &asset);
+	else
+		da_push_back(cache.queue, &asset);
+
+	os_sem_post(cache.sem);
+}
+
+/* drops the pixels but keeps the entry, so the size stays known */
+static void evict_asset(struct image_asset *asset, struct darray *evicted)
+{
+	DARRAY(gs_image_file2_t) images;
+	images.da = *evicted;
+
+	cache.mem_usage -= asset->mem_usage;
+	asset->mem_usage = 0;
+	asset->state = IMAGE_ASSET_PENDING;
+
+	da_push_back(images, &asset->if2);
+	memset(&asset->if2, 0, sizeof(asset->if2));
+
+	*evicted = images.da;
+}
+
+static void trim_cache(struct darray *evicted)
+{
+	while (cache.mem_usage > CACHE_BUDGET) {
+		struct image_asset *lru = NULL;
+
+		for (size_t i = 0; i < cache.assets.num; i++) {
+			struct image_asset *asset = cache.assets.array[i];
+
+			if (asset->refs || asset->state != IMAGE_ASSET_LOADED)
+				continue;
+			if (!lru || asset->last_used < lru->last_used)
+				lru = asset;
+		}
+
+		if (!lru)
+			break;
+
+		evict_asset(lru, evicted);
+	}
+}
+
+static struct image_asset *find_asset(const char *path, time_t mtime)
+{
+	for (size_t i = 0; i < cache.assets.num; i++) {
+		struct image_asset *asset = cache.assets.array[i];
+
+		if (asset->mtime == mtime && strcmp(asset->path, path) == 0)
+			return asset;
+	}
+
+	return NULL;
+}
+
+static inline struct image_asset *create_asset(const char *path, time_t mtime,
+					       bool exclusive)
+{
+	struct image_asset *asset = bzalloc(sizeof(struct image_asset));
+	asset->path = bstrdup(path);
+	asset->mtime = mtime;
+	asset->exclusive = exclusive;
+	asset->state = IMAGE_ASSET_PENDING;
+	return asset;
+}
+
+/* older versions of a file that changed are never going to be requested
+ * again, drop the ones nobody uses anymore */
+static void remove_stale_assets(const char *path, time_t mtime,
+				struct darray *removed)
+{
+	DARRAY(struct image_asset *) list;
+	list.da = *removed;
+
+	for (size_t i = cache.assets.num; i > 0; i--) {
+		struct image_asset *asset = cache.assets.array[i - 1];
+
+		if (asset->mtime == mtime || strcmp(asset->path, path) != 0)
+			continue;
+
+		asset->stale = true;
+		if (asset->refs || asset->queued)
+			continue;
+
+		cache.mem_usage -= asset->mem_usage;
+		da_erase(cache.assets, i - 1);
+		da_push_back(list, &asset);
+	}
+
+	*removed = list.da;
+}
+
+static struct image_asset *get_asset(const char *path, bool prefetch,
+				     struct darray *removed)
+{
+	struct image_asset *asset;
+	time_t mtime;
+
+	if (!path || !*path || !get_modified_timestamp(path, &mtime))
+		return NULL;
+
+	if (may_be_animated(path)) {
+		if (prefetch)
+			return NULL;
+
+		asset = create_asset(path, mtime, true);
+		asset->refs = 1;
+		queue_asset(asset, true);
+		return asset;
+	}
+
+	asset = find_asset(path, mtime);
+	if (!asset) {
+		remove_stale_assets(path, mtime, removed);
+
+		asset = create_asset(path, mtime, false);
+		da_push_back(cache.assets, &asset);
+	}
+
+	if (!prefetch)
+		asset->refs++;
+
+	touch_asset(asset);
+
+	if (asset->state == IMAGE_ASSET_PENDING && !asset->queued)
+		queue_asset(asset, !prefetch);
+	return asset;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void free_removed_assets(struct darray *array)
+{
+	DARRAY(struct image_asset *) list;
+	list.da = *array;
+
+	for (size_t i = 0; i < list.num; i++)
+		free_asset(list.array[i]);
+
+	da_free(list);
+}
+
+static void finish_decode(struct image_asset *asset, gs_image_file2_t *if2)
+{
+	DARRAY(gs_image_file2_t) evicted;
+	bool destroy = false;
+
+	da_init(evicted);
+
+	pthread_mutex_lock(&cache.mutex);
+
+	asset->queued = false;
+
+	if (asset->exclusive && !asset->refs) {
+		destroy = true;
+	} else if (asset->stale && !asset->refs) {
+		da_erase_item(cache.assets, &asset);
+		destroy = true;
+	} else {
+		asset->if2 = *if2;
+		asset->mem_usage = if2->mem_usage;
+		cache.mem_usage += if2->mem_usage;
+
+		asset->cx = if2->image.cx;
+		asset->cy = if2->image.cy;
+		asset->size_known = true;
+		asset->state = if2->image.loaded ? IMAGE_ASSET_LOADED
+						 : IMAGE_ASSET_FAILED;
+
+		trim_cache(&evicted.da);
+	}
+
+	pthread_mutex_unlock(&cache.mutex);
+
+	if (destroy) {
+		free_image(if2);
+		free_asset(asset);
+	}
+
+	free_images(&evicted.da);
+}
+
+static void *decode_thread(void *unused)
+{
+	os_set_thread_name("image-cache: decode");
+
+	while (os_sem_wait(cache.sem) == 0) {
+		struct image_asset *asset;
+		gs_image_file2_t if2 = {0};
+		bool skip;
+
+		if (os_atomic_load_bool(&cache.stop))
+			break;
+
+		pthread_mutex_lock(&cache.mutex);
+		asset = cache.queue.array[0];
+		da_erase(cache.queue, 0);
+		skip = asset->exclusive && !asset->refs;
+		pthread_mutex_unlock(&cache.mutex);
+
+		if (!skip) {
+			blog(LOG_DEBUG, "decoding '%s'", asset->path);
+			gs_image_file2_init(&if2, asset->path);
+			if (!if2.image.loaded)
+				blog(LOG_WARNING, "failed to load '%s'",
+				     asset->path);
+		}
+
+		finish_decode(asset, &if2);
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+void image_cache_init(void)
+{
+	int threads = os_get_logical_cores() / 2;
+	if (threads > MAX_DECODE_THREADS)
+		threads = MAX_DECODE_THREADS;
+	if (threads < 1)
+		threads = 1;
+
+	pthread_mutex_init(&cache.mutex, NULL);
+	os_sem_init(&cache.sem, 0);
+
+	for (int i = 0; i < threads; i++) {
+		if (pthread_create(&cache.threads[cache.num_threads], NULL,
+				   decode_thread, NULL) == 0)
+			cache.num_threads++;
+	}
+}
+
+void image_cache_free(void)
+{
+	os_atomic_set_bool(&cache.stop, true);
+
+	for (size_t i = 0; i < cache.num_threads; i++)
+		os_sem_post(cache.sem);
+	for (size_t i = 0; i < cache.num_threads; i++)
+		pthread_join(cache.threads[i], NULL);
+
+	/* whatever is still queued belongs to the cache at this point */
+	for (size_t i = 0; i < cache.queue.num; i++) {
+		struct image_asset *asset = cache.queue.array[i];
+		if (asset->exclusive)
+			free_asset(asset);
+	}
+
+	for (size_t i = 0; i < cache.assets.num; i++)
+		free_asset(cache.assets.array[i]);
+
+	da_free(cache.queue);
+	da_free(cache.assets);
+	os_sem_destroy(cache.sem);
+	pthread_mutex_destroy(&cache.mutex);
+	memset(&cache, 0, sizeof(cache));
+}
+
+struct image_asset *image_cache_acquire(const char *path)
+{
+	DARRAY(struct image_asset *) removed;
+	struct image_asset *asset;
+
+	da_init(removed);
+
+	pthread_mutex_lock(&cache.mutex);
+	asset = get_asset(path, false, &removed.da);
+	pthread_mutex_unlock(&cache.mutex);
+
+	free_removed_assets(&removed.da);
+	return asset;
+}
+
+bool image_cache_prefetch(const char *path)
+{
+	DARRAY(struct image_asset *) removed;
+	time_t mtime;
+
+	if (!path || !*path || !get_modified_timestamp(path, &mtime))
+		return false;
+	if (may_be_animated(path))
+		return true;
+
+	da_init(removed);
+
+	pthread_mutex_lock(&cache.mutex);
+	get_asset(path, true, &removed.da);
+	pthread_mutex_unlock(&cache.mutex);
+
+	free_removed_assets(&removed.da);
+	return true;
+}
+
+void image_asset_release(struct image_asset *asset)
+{
+	DARRAY(gs_image_file2_t) evicted;
+	bool destroy = false;
+
+	if (!asset)
+		return;
+
+	da_init(evicted);
+
+	pthread_mutex_lock(&cache.mutex);
+
+	if (--asset->refs == 0 && !asset->queued) {
+		if (asset->exclusive) {
+			cache.mem_usage -= asset->mem_usage;
+			destroy = true;
+
+		} else if (asset->stale) {
+			cache.mem_usage -= asset->mem_usage;
+			da_erase_item(cache.assets, &asset);
+			destroy = true;
+		}
+	}
+
+	if (!asset->exclusive)
+		touch_asset(asset);
+
+	trim_cache(&evicted.da);
+
+	pthread_mutex_unlock(&cache.mutex);
+
+	if (destroy)
+		free_asset(asset);
+
+	free_images(&evicted.da);
+}
+
+bool image_cache_get_size(const char *path, uint32_t *cx, uint32_t *cy)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&cache.mutex);
+
+	for (size_t i = 0; i < cache.assets.num; i++) {
+		struct image_asset *asset = cache.assets.array[i];
+
+		if (!asset->size_known || strcmp(asset->path, path) != 0)
+			continue;
+
+		*cx = asset->cx;
+		*cy = asset->cy;
+		found = true;
+
+		if (!asset->stale)
+			break;
+	}
+
+	pthread_mutex_unlock(&cache.mutex);
+	return found;
+}
+
+enum image_asset_state image_asset_get_state(const struct image_asset *asset)
+{
+	enum image_asset_state state;
+
+	pthread_mutex_lock(&cache.mutex);
+	state = asset->state;
+	pthread_mutex_unlock(&cache.mutex);
+
+	return state;
+}
+
+time_t image_asset_get_mtime(const struct image_asset *asset)
+{
+	return asset->mtime;
+}
+
+uint64_t image_asset_get_memory_usage(const struct image_asset *asset)
+{
+	uint64_t mem_usage;
+
+	pthread_mutex_lock(&cache.mutex);
+	mem_usage = asset->mem_usage;
+	pthread_mutex_unlock(&cache.mutex);
+
+	return mem_usage;
+}
+
+gs_image_file2_t *image_asset_get_image(struct image_asset *asset)
+{
+	return image_asset_get_state(asset) == IMAGE_ASSET_LOADED
+		       ? &asset->if2
+		       : NULL;
+}
+
+gs_texture_t *image_asset_get_texture(struct image_asset *asset)
+{
+	gs_image_file2_t *if2 = image_asset_get_image(asset);
+	if (!if2)
+		return NULL;
+
+	/* only the graphics thread creates textures, and a held asset is
+	 * never evicted, so this needs no lock */
+	if (!if2->image.texture)
+		gs_image_file2_init_texture(if2);
+
+	return if2->image.texture;
+}
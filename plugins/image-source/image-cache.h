@@ -0,0 +1,55 @@
+#pragma once
+
+#include <obs-module.h>
+#include <graphics/image-file.h>
+
+/*
+ * Module-wide cache of decoded images, keyed by path and modification time.
+ *
+ * Images are decoded by a small pool of worker threads.  Sources that show
+ * the same file share one entry and one texture.  Entries nobody holds a
+ * reference to stay cached until the memory budget is exceeded, then the
+ * least recently used ones are dropped.
+ *
+ * Animated gifs have per-source playback state, so each reference to one
+ * gets its own private entry, which is still decoded on the pool.
+ */
+
+struct image_asset;
+
+enum image_asset_state {
+	IMAGE_ASSET_PENDING,
+	IMAGE_ASSET_LOADED,
+	IMAGE_ASSET_FAILED,
+};
+
+extern void image_cache_init(void);
+extern void image_cache_free(void);
+
+/** Gets a reference to the image of a file, and starts decoding it if it is
+ * not cached yet.  Returns NULL if the file does not exist. */
+extern struct image_asset *image_cache_acquire(const char *path);
+extern void image_asset_release(struct image_asset *asset);
+
+/** Decodes a file in the background without holding a reference to it, so
+ * that a later image_cache_acquire finds it ready.  Animated gifs are not
+ * prefetched.  Returns false if the file does not exist. */
+extern bool image_cache_prefetch(const char *path);
+
+/** Size of the image if it was decoded at some point, even if the pixels
+ * have been dropped from the cache since.  A file that failed to decode
+ * has a size of 0x0. */
+extern bool image_cache_get_size(const char *path, uint32_t *cx,
+				 uint32_t *cy);
+
+extern enum image_asset_state
+image_asset_get_state(const struct image_asset *asset);
+extern time_t image_asset_get_mtime(const struct image_asset *asset);
+extern uint64_t image_asset_get_memory_usage(const struct image_asset *asset);
+
+/** The decoded image, once loaded.  Only animated gifs may be modified by
+ * the holder (ticked and updated), other images are shared. */
+extern gs_image_file2_t *image_asset_get_image(struct image_asset *asset);
+
+/** Creates the texture on first use.  Requires the graphics context. */
+extern gs_texture_t *image_asset_get_texture(struct image_asset *asset);
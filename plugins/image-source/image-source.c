@@ -1,9 +1,12 @@
 #include <obs-module.h>
 #include <graphics/image-file.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include <util/dstr.h>
 #include <sys/stat.h>
 
+#include "image-cache.h"
+
 #define blog(log_level, format, ...)                    \
 	blog(log_level, "[image_source: '%s'] " format, \
 	     obs_source_get_name(context->source), ##__VA_ARGS__)
@@ -22,7 +25,19 @@ struct image_source {
 	uint64_t last_time;
 	bool active;
 
-	gs_image_file2_t if2;
+	/* set from the file watch thread, the file is polled less often
+	 * while it is watched */
+	os_file_watch_t *file_watch;
+	volatile bool file_changed;
+
+	/* the next version of the file is kept here while it is being
+	 * decoded, so the current one stays on screen until it is ready.
+	 * both are only swapped or released with the graphics context
+	 * entered, since tick and render use them on the graphics thread. */
+	struct image_asset *asset;
+	struct image_asset *next_asset;
+	uint32_t cx;
+	uint32_t cy;
 };
 
 static time_t get_modified_timestamp(const char *filename)
@@ -39,42 +54,91 @@ static const char *image_source_get_name(void *unused)
 	return obs_module_text("ImageInput");
 }
 
+static inline gs_image_file_t *get_image(struct image_source *context)
+{
+	gs_image_file2_t *if2 = context->asset
+					? image_asset_get_image(context->asset)
+					: NULL;
+	return if2 ? &if2->image : NULL;
+}
+
+/* the size is kept aside so that it can be read without the graphics
+ * context, an asset that is still being decoded has no size yet */
+static inline void update_size(struct image_source *context)
+{
+	gs_image_file_t *image = get_image(context);
+
+	context->cx = image ? image->cx : 0;
+	context->cy = image ? image->cy : 0;
+}
+
 static void image_source_load(struct image_source *context)
 {
 	char *file = context->file;
-
-	obs_enter_graphics();
-	gs_image_file2_free(&context->if2);
-	obs_leave_graphics();
+	struct image_asset *asset = NULL;
 
 	if (file && *file) {
 		debug("loading texture '%s'", file);
-		context->file_timestamp = get_modified_timestamp(file);
-		gs_image_file2_init(&context->if2, file);
+		asset = image_cache_acquire(file);
+		context->file_timestamp = asset ? image_asset_get_mtime(asset)
+						: -1;
 		context->update_time_elapsed = 0;
 
-		obs_enter_graphics();
-		gs_image_file2_init_texture(&context->if2);
-		obs_leave_graphics();
-
-		if (!context->if2.image.loaded)
+		if (!asset)
 			warn("failed to load texture '%s'", file);
 	}
+
+	obs_enter_graphics();
+
+	image_asset_release(context->next_asset);
+	context->next_asset = NULL;
+
+	if (asset && context->asset &&
+	    image_asset_get_state(asset) == IMAGE_ASSET_PENDING) {
+		context->next_asset = asset;
+	} else {
+		image_asset_release(context->asset);
+		context->asset = asset;
+	}
+
+	update_size(context);
+	obs_leave_graphics();
 }
 
 static void image_source_unload(struct image_source *context)
 {
 	obs_enter_graphics();
-	gs_image_file2_free(&context->if2);
+
+	image_asset_release(context->next_asset);
+	image_asset_release(context->asset);
+	context->next_asset = NULL;
+	context->asset = NULL;
+
+	update_size(context);
 	obs_leave_graphics();
 }
 
+static void image_source_file_changed(void *data)
+{
+	struct image_source *context = data;
+	os_atomic_set_bool(&context->file_changed, true);
+}
+
 static void image_source_update(void *data, obs_data_t *settings)
 {
 	struct image_source *context = data;
 	const char *file = obs_data_get_string(settings, "file");
 	const bool unload = obs_data_get_bool(settings, "unload");
 
+	if (!context->file || strcmp(context->file, file) != 0) {
+		os_file_watch_destroy(context->file_watch);
+		context->file_watch =
+			*file ? os_file_watch_create(
+					file, image_source_file_changed,
+					context)
+			      : NULL;
+	}
+
 	if (context->file)
 		bfree(context->file);
 	context->file = bstrdup(file);
@@ -121,6 +185,7 @@ static void image_source_destroy(void *data)
 {
 	struct image_source *context = data;
 
+	os_file_watch_destroy(context->file_watch);
 	image_source_unload(context);
 
 	if (context->file)
@@ -131,26 +196,57 @@ static void image_source_destroy(void *data)
 static uint32_t image_source_getwidth(void *data)
 {
 	struct image_source *context = data;
-	return context->if2.image.cx;
+	return context->cx;
 }
 
 static uint32_t image_source_getheight(void *data)
 {
 	struct image_source *context = data;
-	return context->if2.image.cy;
+	return context->cy;
 }
 
 static void image_source_render(void *data, gs_effect_t *effect)
 {
 	struct image_source *context = data;
+	gs_texture_t *texture;
+	gs_image_file_t *image;
 
-	if (!context->if2.image.texture)
+	if (!context->asset)
 		return;
 
+	texture = image_asset_get_texture(context->asset);
+	if (!texture)
+		return;
+
+	image = get_image(context);
+
 	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
-			      context->if2.image.texture);
-	gs_draw_sprite(context->if2.image.texture, 0, context->if2.image.cx,
-		       context->if2.image.cy);
+			      texture);
+	gs_draw_sprite(texture, 0, image->cx, image->cy);
+}
+
+/* animated gifs are never shared, so their playback state is ours */
+static inline gs_image_file2_t *get_animation(struct image_source *context)
+{
+	gs_image_file2_t *if2 = context->asset
+					? image_asset_get_image(context->asset)
+					: NULL;
+	return if2 && if2->image.is_animated_gif && if2->image.texture ? if2
+									: NULL;
+}
+
+static void log_animation_stats(struct image_source *context,
+				gs_image_file2_t *animation)
+{
+	struct gs_image_file_stats stats;
+	gs_image_file_get_stats(&animation->image, &stats);
+
+	debug("%s gif: %" PRIu64 " frames decoded in %.1f ms, "
+	      "%" PRIu64 " frames ready in time, %" PRIu64 " late, "
+	      "%.1f MB",
+	      stats.streaming ? "streamed" : "cached", stats.frames_decoded,
+	      (double)stats.decode_time_ns / 1000000.0, stats.cache_hits,
+	      stats.cache_misses, (double)animation->mem_usage / 1048576.0);
 }
 
 static void image_source_tick(void *data, float seconds)
@@ -160,8 +256,30 @@ static void image_source_tick(void *data, float seconds)
 
 	context->update_time_elapsed += seconds;
 
+	obs_enter_graphics();
+
+	if (context->next_asset &&
+	    image_asset_get_state(context->next_asset) != IMAGE_ASSET_PENDING) {
+		image_asset_release(context->asset);
+		context->asset = context->next_asset;
+		context->next_asset = NULL;
+		context->last_time = frame_time;
+	}
+
+	update_size(context);
+	obs_leave_graphics();
+
+	/* a change while hidden is picked up once showing again.  watched
+	 * files are still polled now and then, the watch misses changes to
+	 * symlink targets and on network file systems */
 	if (obs_source_showing(context->source)) {
-		if (context->update_time_elapsed >= 1.0f) {
+		float interval = context->file_watch ? 5.0f : 1.0f;
+
+		if (context->file_watch &&
+		    os_atomic_set_bool(&context->file_changed, false)) {
+			image_source_load(context);
+
+		} else if (context->update_time_elapsed >= interval) {
 			time_t t = get_modified_timestamp(context->file);
 			context->update_time_elapsed = 0.0f;
 
@@ -171,43 +289,38 @@ static void image_source_tick(void *data, float seconds)
 		}
 	}
 
+	/* keeps the asset from being replaced while it is animated */
+	obs_enter_graphics();
+
+	gs_image_file2_t *animation = get_animation(context);
+
 	if (obs_source_active(context->source)) {
 		if (!context->active) {
-			if (context->if2.image.is_animated_gif)
+			if (animation)
 				context->last_time = frame_time;
 			context->active = true;
 		}
 
-	} else {
-		if (context->active) {
-			if (context->if2.image.is_animated_gif) {
-				context->if2.image.cur_frame = 0;
-				context->if2.image.cur_loop = 0;
-				context->if2.image.cur_time = 0;
-
-				obs_enter_graphics();
-				gs_image_file2_update_texture(&context->if2);
-				obs_leave_graphics();
-			}
+		if (context->last_time && animation) {
+			uint64_t elapsed = frame_time - context->last_time;
 
-			context->active = false;
+			if (gs_image_file2_tick(animation, elapsed))
+				gs_image_file2_update_texture(animation);
 		}
 
-		return;
-	}
-
-	if (context->last_time && context->if2.image.is_animated_gif) {
-		uint64_t elapsed = frame_time - context->last_time;
-		bool updated = gs_image_file2_tick(&context->if2, elapsed);
+		context->last_time = frame_time;
 
-		if (updated) {
-			obs_enter_graphics();
-			gs_image_file2_update_texture(&context->if2);
-			obs_leave_graphics();
+	} else if (context->active) {
+		if (animation) {
+			log_animation_stats(context, animation);
+			gs_image_file2_reset_animation(animation);
+			gs_image_file2_update_texture(animation);
 		}
+
+		context->active = false;
 	}
 
-	context->last_time = frame_time;
+	obs_leave_graphics();
 }
 
 static const char *image_filter =
@@ -249,7 +362,13 @@ static obs_properties_t *image_source_properties(void *data)
 uint64_t image_source_get_memory_usage(void *data)
 {
 	struct image_source *s = data;
-	return s->if2.mem_usage;
+	uint64_t usage;
+
+	obs_enter_graphics();
+	usage = s->asset ? image_asset_get_memory_usage(s->asset) : 0;
+	obs_leave_graphics();
+
+	return usage;
 }
 
 static struct obs_source_info image_source_info = {
@@ -290,5 +409,12 @@ bool obs_module_load(void)
 	obs_register_source(&color_source_info_v2);
 	obs_register_source(&color_source_info_v3);
 	obs_register_source(&slideshow_info);
+
+	image_cache_init();
 	return true;
 }
+
+void obs_module_unload(void)
+{
+	image_cache_free();
+}
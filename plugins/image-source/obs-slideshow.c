@@ -4,6 +4,8 @@
 #include <util/darray.h>
 #include <util/dstr.h>
 
+#include "image-cache.h"
+
 #define do_log(level, format, ...)               \
 	blog(level, "[slideshow: '%s'] " format, \
 	     obs_source_get_name(ss->source), ##__VA_ARGS__)
@@ -61,14 +63,14 @@
 
 /* ------------------------------------------------------------------------- */
 
-extern uint64_t image_source_get_memory_usage(void *data);
-
-#define BYTES_TO_MBYTES (1024 * 1024)
-#define MAX_MEM_USAGE (400 * BYTES_TO_MBYTES)
+#define PREFETCH_SLIDES 2
 
 struct image_file_data {
 	char *path;
 	obs_source_t *source;
+	uint32_t cx;
+	uint32_t cy;
+	bool size_known;
 };
 
 enum behavior {
@@ -97,10 +99,19 @@ struct slideshow {
 
 	float elapsed;
 	size_t cur_item;
+	size_t next_random;
 
 	uint32_t cx;
 	uint32_t cy;
-	uint64_t mem_usage;
+	int custom_cx;
+	int custom_cy;
+	bool aspect_only;
+	bool use_auto;
+
+	/* images are decoded in the background, the automatic size is
+	 * updated as their sizes become known */
+	bool size_pending;
+	float size_check_elapsed;
 
 	pthread_mutex_t mutex;
 	DARRAY(struct image_file_data) files;
@@ -165,8 +176,10 @@ static obs_source_t *create_source_from_file(const char *file)
 	obs_data_t *settings = obs_data_create();
 	obs_source_t *source;
 
+	/* slides only hold on to their image while they are shown, the
+	 * image cache keeps the recently used ones around */
 	obs_data_set_string(settings, "file", file);
-	obs_data_set_bool(settings, "unload", false);
+	obs_data_set_bool(settings, "unload", true);
 	source = obs_source_create_private("image_source", NULL, settings);
 
 	obs_data_release(settings);
@@ -191,6 +204,33 @@ static inline size_t random_file(struct slideshow *ss)
 	return (size_t)rand() % ss->files.num;
 }
 
+static size_t random_next_file(struct slideshow *ss)
+{
+	size_t next = ss->cur_item;
+	if (ss->files.num > 1) {
+		while (next == ss->cur_item)
+			next = random_file(ss);
+	}
+	return next;
+}
+
+static void prefetch_slides(struct slideshow *ss)
+{
+	size_t item = ss->cur_item;
+
+	if (ss->randomize) {
+		ss->next_random = random_next_file(ss);
+		image_cache_prefetch(ss->files.array[ss->next_random].path);
+		return;
+	}
+
+	for (size_t i = 0; i < PREFETCH_SLIDES && i + 1 < ss->files.num; i++) {
+		if (++item >= ss->files.num)
+			item = 0;
+		image_cache_prefetch(ss->files.array[item].path);
+	}
+}
+
 /* ------------------------------------------------------------------------- */
 
 static const char *ss_getname(void *unused)
@@ -200,7 +240,7 @@ static const char *ss_getname(void *unused)
 }
 
 static void add_file(struct slideshow *ss, struct darray *array,
-		     const char *path, uint32_t *cx, uint32_t *cy)
+		     const char *path)
 {
 	DARRAY(struct image_file_data) new_files;
 	struct image_file_data data;
@@ -218,23 +258,88 @@ static void add_file(struct slideshow *ss, struct darray *array,
 		new_source = create_source_from_file(path);
 
 	if (new_source) {
-		uint32_t new_cx = obs_source_get_width(new_source);
-		uint32_t new_cy = obs_source_get_height(new_source);
-
 		data.path = bstrdup(path);
 		data.source = new_source;
+		data.cx = 0;
+		data.cy = 0;
+		data.size_known = false;
 		da_push_back(new_files, &data);
+	}
+
+	*array = new_files.da;
+}
 
-		if (new_cx > *cx)
-			*cx = new_cx;
-		if (new_cy > *cy)
-			*cy = new_cy;
+/* returns false if some of the sizes are not known yet */
+static bool get_max_size(struct darray *array, uint32_t *cx, uint32_t *cy)
+{
+	DARRAY(struct image_file_data) files;
+	bool all_known = true;
+
+	files.da = *array;
+
+	for (size_t i = 0; i < files.num; i++) {
+		struct image_file_data *file = files.array + i;
+
+		if (!file->size_known) {
+			if (image_cache_get_size(file->path, &file->cx,
+						 &file->cy)) {
+				file->size_known = true;
+			} else {
+				/* animated gifs are only known once shown */
+				file->cx = obs_source_get_width(file->source);
+				file->cy = obs_source_get_height(file->source);
+				file->size_known = file->cx || file->cy;
+			}
+		}
+
+		if (!file->size_known) {
+			all_known = false;
+			continue;
+		}
 
-		void *source_data = obs_obj_get_data(new_source);
-		ss->mem_usage += image_source_get_memory_usage(source_data);
+		if (file->cx > *cx)
+			*cx = file->cx;
+		if (file->cy > *cy)
+			*cy = file->cy;
 	}
 
-	*array = new_files.da;
+	return all_known;
+}
+
+static void update_size(struct slideshow *ss)
+{
+	uint32_t cx = 0;
+	uint32_t cy = 0;
+
+	pthread_mutex_lock(&ss->mutex);
+	ss->size_pending = !get_max_size(&ss->files.da, &cx, &cy);
+	pthread_mutex_unlock(&ss->mutex);
+
+	if (!ss->use_auto) {
+		double cx_f = (double)cx;
+		double cy_f = (double)cy;
+
+		double old_aspect = cx_f / cy_f;
+		double new_aspect =
+			(double)ss->custom_cx / (double)ss->custom_cy;
+
+		if (ss->aspect_only) {
+			if (fabs(old_aspect - new_aspect) > EPSILON) {
+				if (new_aspect > old_aspect)
+					cx = (uint32_t)(cy_f * new_aspect);
+				else
+					cy = (uint32_t)(cx_f / new_aspect);
+			}
+		} else {
+			cx = (uint32_t)ss->custom_cx;
+			cy = (uint32_t)ss->custom_cy;
+			ss->size_pending = false;
+		}
+	}
+
+	ss->cx = cx;
+	ss->cy = cy;
+	obs_transition_set_size(ss->transition, cx, cy);
 }
 
 static bool valid_extension(const char *ext)
@@ -264,6 +369,7 @@ static void do_transition(void *data, bool to_null)
 		obs_transition_start(ss->transition, OBS_TRANSITION_MODE_AUTO,
 				     ss->tr_speed,
 				     ss->files.array[ss->cur_item].source);
+		prefetch_slides(ss);
 
 	} else {
 		obs_transition_start(ss->transition, OBS_TRANSITION_MODE_AUTO,
@@ -284,8 +390,6 @@ static void ss_update(void *data, obs_data_t *settings)
 	const char *tr_name;
 	uint32_t new_duration;
 	uint32_t new_speed;
-	uint32_t cx = 0;
-	uint32_t cy = 0;
 	size_t count;
 	const char *behavior;
 	const char *mode;
@@ -334,8 +438,6 @@ static void ss_update(void *data, obs_data_t *settings)
 	/* ------------------------------------- */
 	/* create new list of sources */
 
-	ss->mem_usage = 0;
-
 	for (size_t i = 0; i < count; i++) {
 		obs_data_t *item = obs_data_array_item(array, i);
 		const char *path = obs_data_get_string(item, "value");
@@ -361,23 +463,16 @@ static void ss_update(void *data, obs_data_t *settings)
 				dstr_copy(&dir_path, path);
 				dstr_cat_ch(&dir_path, '/');
 				dstr_cat(&dir_path, ent->d_name);
-				add_file(ss, &new_files.da, dir_path.array, &cx,
-					 &cy);
-
-				if (ss->mem_usage >= MAX_MEM_USAGE)
-					break;
+				add_file(ss, &new_files.da, dir_path.array);
 			}
 
 			dstr_free(&dir_path);
 			os_closedir(dir);
 		} else {
-			add_file(ss, &new_files.da, path, &cx, &cy);
+			add_file(ss, &new_files.da, path);
 		}
 
 		obs_data_release(item);
-
-		if (ss->mem_usage >= MAX_MEM_USAGE)
-			break;
 	}
 
 	/* ------------------------------------- */
@@ -435,33 +530,32 @@ static void ss_update(void *data, obs_data_t *settings)
 		}
 	}
 
-	if (!use_auto) {
-		double cx_f = (double)cx;
-		double cy_f = (double)cy;
+	ss->custom_cx = cx_in;
+	ss->custom_cy = cy_in;
+	ss->aspect_only = aspect_only;
+	ss->use_auto = use_auto;
 
-		double old_aspect = cx_f / cy_f;
-		double new_aspect = (double)cx_in / (double)cy_in;
+	/* the automatic size needs the size of every image, start decoding
+	 * the ones that are not known yet */
+	if (use_auto || aspect_only) {
+		pthread_mutex_lock(&ss->mutex);
+		for (size_t i = 0; i < ss->files.num; i++) {
+			struct image_file_data *file = ss->files.array + i;
 
-		if (aspect_only) {
-			if (fabs(old_aspect - new_aspect) > EPSILON) {
-				if (new_aspect > old_aspect)
-					cx = (uint32_t)(cy_f * new_aspect);
-				else
-					cy = (uint32_t)(cx_f / new_aspect);
-			}
-		} else {
-			cx = (uint32_t)cx_in;
-			cy = (uint32_t)cy_in;
+			if (image_cache_get_size(file->path, &file->cx,
+						 &file->cy) ||
+			    !image_cache_prefetch(file->path))
+				file->size_known = true;
 		}
+		pthread_mutex_unlock(&ss->mutex);
 	}
 
 	/* ------------------------- */
 
-	ss->cx = cx;
-	ss->cy = cy;
 	ss->cur_item = 0;
 	ss->elapsed = 0.0f;
-	obs_transition_set_size(ss->transition, cx, cy);
+	ss->size_check_elapsed = 0.0f;
+	update_size(ss);
 	obs_transition_set_alignment(ss->transition, OBS_ALIGN_CENTER);
 	obs_transition_set_scale_type(ss->transition,
 				      OBS_TRANSITION_SCALE_ASPECT);
@@ -709,6 +803,14 @@ static void ss_video_tick(void *data, float seconds)
 		return;
 	}
 
+	if (ss->size_pending) {
+		ss->size_check_elapsed += seconds;
+		if (ss->size_check_elapsed >= 0.1f) {
+			ss->size_check_elapsed = 0.0f;
+			update_size(ss);
+		}
+	}
+
 	if (ss->pause_on_deactivate || ss->manual || ss->stop || ss->paused)
 		return;
 
@@ -741,11 +843,10 @@ static void ss_video_tick(void *data, float seconds)
 		}
 
 		if (ss->randomize) {
-			size_t next = ss->cur_item;
-			if (ss->files.num > 1) {
-				while (next == ss->cur_item)
-					next = random_file(ss);
-			}
+			size_t next = ss->next_random;
+			if (next >= ss->files.num ||
+			    (next == ss->cur_item && ss->files.num > 1))
+				next = random_next_file(ss);
 			ss->cur_item = next;
 
 		} else if (++ss->cur_item >= ss->files.num) {
@@ -18,13 +18,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <xcb/damage.h>
 #include <xcb/randr.h>
 #include <xcb/shm.h>
 #include <xcb/xfixes.h>
 #include <xcb/xinerama.h>
 
 #include <obs-module.h>
+#include <util/darray.h>
 #include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
 #include "xcursor-xcb.h"
 #include "xhelpers.h"
 
@@ -32,13 +36,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "xshm-input: " msg, ##__VA_ARGS__)
 
+/* past this many dirty rectangles the whole texture is uploaded */
+#define XSHM_MAX_DIRTY_RECTS 16
+
 struct xshm_data {
 	obs_source_t *source;
 
 	xcb_connection_t *xcb;
 	xcb_screen_t *xcb_screen;
-	xcb_shm_t *xshm;
+	xcb_shm_t *xshm[2];
 	xcb_xcursor_t *cursor;
+	xcb_damage_damage_t damage;
+	xcb_xfixes_region_t damage_region;
 
 	char *server;
 	uint_fast32_t screen_id;
@@ -49,6 +58,10 @@ struct xshm_data {
 
 	gs_texture_t *texture;
 
+	gs_eparam_t *image_param;
+	gs_technique_t *opaque_draw;
+	gs_technique_t *cursor_draw;
+
 	int_fast32_t cut_top;
 	int_fast32_t cut_left;
 	int_fast32_t cut_right;
@@ -63,6 +76,17 @@ struct xshm_data {
 	bool use_xinerama;
 	bool use_randr;
 	bool advanced;
+
+	pthread_t thread;
+	os_event_t *stop_event;
+	bool thread_active;
+
+	/* shared between the capture thread and the graphics tick */
+	pthread_mutex_t mutex;
+	int ready;
+	DARRAY(struct gs_rect) dirty;
+	bool dirty_all;
+	xcb_xfixes_get_cursor_image_reply_t *cursor_image;
 };
 
 /**
@@ -98,6 +122,10 @@ static bool xshm_check_extensions(xcb_connection_t *xcb)
 	if (!xcb_get_extension_data(xcb, &xcb_randr_id)->present)
 		blog(LOG_INFO, "Missing Randr extension !");
 
+	if (!xcb_get_extension_data(xcb, &xcb_damage_id)->present)
+		blog(LOG_INFO, "Missing Damage extension, the whole screen "
+			       "will be uploaded every frame");
+
 	return ok;
 }
 
@@ -183,11 +211,227 @@ static const char *xshm_getname(void *unused)
 	return obs_module_text("X11SharedMemoryScreenInput");
 }
 
+/**
+ * Track the changes of the root window
+ *
+ * The damage accumulated by the server is moved to damage_region and read
+ * back once per frame, so no events have to be processed.
+ */
+static void xshm_init_damage(struct xshm_data *data)
+{
+	xcb_damage_query_version_cookie_t ver_c;
+
+	if (!xcb_get_extension_data(data->xcb, &xcb_damage_id)->present)
+		return;
+
+	ver_c = xcb_damage_query_version_unchecked(data->xcb,
+						   XCB_DAMAGE_MAJOR_VERSION,
+						   XCB_DAMAGE_MINOR_VERSION);
+	free(xcb_damage_query_version_reply(data->xcb, ver_c, NULL));
+
+	data->damage = xcb_generate_id(data->xcb);
+	xcb_damage_create(data->xcb, data->damage, data->xcb_screen->root,
+			  XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+
+	data->damage_region = xcb_generate_id(data->xcb);
+	xcb_xfixes_create_region(data->xcb, data->damage_region, 0, NULL);
+}
+
+/**
+ * Add a damaged area of the root window to the dirty rectangles
+ *
+ * @note requires the mutex to be locked
+ */
+static void xshm_add_dirty_rect(struct xshm_data *data,
+				const xcb_rectangle_t *rect)
+{
+	int x0 = rect->x - (int)data->adj_x_org;
+	int y0 = rect->y - (int)data->adj_y_org;
+	int x1 = x0 + rect->width;
+	int y1 = y0 + rect->height;
+
+	if (x0 < 0)
+		x0 = 0;
+	if (y0 < 0)
+		y0 = 0;
+	if (x1 > data->adj_width)
+		x1 = data->adj_width;
+	if (y1 > data->adj_height)
+		y1 = data->adj_height;
+	if (x0 >= x1 || y0 >= y1 || data->dirty_all)
+		return;
+
+	if (data->dirty.num == XSHM_MAX_DIRTY_RECTS) {
+		data->dirty_all = true;
+		da_resize(data->dirty, 0);
+		return;
+	}
+
+	struct gs_rect *dirty = da_push_back_new(data->dirty);
+	dirty->x = x0;
+	dirty->y = y0;
+	dirty->cx = x1 - x0;
+	dirty->cy = y1 - y0;
+}
+
+/**
+ * Get the damage since the last call
+ *
+ * @return NULL if the screen did not change within the captured area
+ */
+static xcb_xfixes_fetch_region_reply_t *
+xshm_fetch_damage(struct xshm_data *data)
+{
+	xcb_xfixes_fetch_region_cookie_t region_c;
+	xcb_xfixes_fetch_region_reply_t *region_r;
+	xcb_rectangle_t *rects;
+	int num_rects;
+	int x1 = data->adj_x_org + data->adj_width;
+	int y1 = data->adj_y_org + data->adj_height;
+
+	xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+			    data->damage_region);
+	region_c = xcb_xfixes_fetch_region_unchecked(data->xcb,
+						     data->damage_region);
+	region_r = xcb_xfixes_fetch_region_reply(data->xcb, region_c, NULL);
+	if (!region_r)
+		return NULL;
+
+	rects = xcb_xfixes_fetch_region_rectangles(region_r);
+	num_rects = xcb_xfixes_fetch_region_rectangles_length(region_r);
+
+	for (int i = 0; i < num_rects; i++) {
+		if (rects[i].x < x1 && rects[i].y < y1 &&
+		    rects[i].x + rects[i].width > data->adj_x_org &&
+		    rects[i].y + rects[i].height > data->adj_y_org)
+			return region_r;
+	}
+
+	free(region_r);
+	return NULL;
+}
+
+/**
+ * Grab the screen into the segment that is not waiting for the upload
+ *
+ * @param full grab and upload the whole area even if nothing was damaged,
+ *             the texture is created empty and damage is only collected
+ *             from the moment the damage object exists
+ * @return true if a frame was grabbed
+ */
+static bool xshm_capture_frame(struct xshm_data *data, bool full)
+{
+	xcb_shm_get_image_cookie_t img_c;
+	xcb_shm_get_image_reply_t *img_r;
+	xcb_xfixes_fetch_region_reply_t *region_r = NULL;
+	bool grabbed;
+	int back;
+
+	if (data->damage) {
+		region_r = xshm_fetch_damage(data);
+		if (!region_r && !full)
+			return false;
+	}
+
+	pthread_mutex_lock(&data->mutex);
+	back = data->ready == 0 ? 1 : 0;
+	pthread_mutex_unlock(&data->mutex);
+
+	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
+					    data->adj_x_org, data->adj_y_org,
+					    data->adj_width, data->adj_height,
+					    ~0, XCB_IMAGE_FORMAT_Z_PIXMAP,
+					    data->xshm[back]->seg, 0);
+	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
+
+	if (img_r) {
+		pthread_mutex_lock(&data->mutex);
+
+		if (region_r && !full) {
+			xcb_rectangle_t *rects =
+				xcb_xfixes_fetch_region_rectangles(region_r);
+			int num_rects =
+				xcb_xfixes_fetch_region_rectangles_length(
+					region_r);
+
+			for (int i = 0; i < num_rects; i++)
+				xshm_add_dirty_rect(data, &rects[i]);
+		} else {
+			data->dirty_all = true;
+		}
+
+		data->ready = back;
+		pthread_mutex_unlock(&data->mutex);
+	}
+
+	grabbed = img_r != NULL;
+	free(img_r);
+	free(region_r);
+	return grabbed;
+}
+
+/**
+ * Worker thread grabbing the screen and the cursor once per frame
+ */
+static void *xshm_capture_thread(void *vptr)
+{
+	XSHM_DATA(vptr);
+	xcb_xfixes_get_cursor_image_cookie_t cur_c;
+	xcb_xfixes_get_cursor_image_reply_t *cur_r;
+	xcb_generic_event_t *event;
+	uint64_t interval = video_output_get_frame_time(obs_get_video());
+	uint64_t next = os_gettime_ns();
+
+	/* the thread is restarted on every settings or geometry change, its
+	 * first frame fills the new texture */
+	bool full = true;
+
+	os_set_thread_name("xshm: capture");
+
+	while (os_event_try(data->stop_event) == EAGAIN) {
+		/* damage notifications are not used, only discarded */
+		while ((event = xcb_poll_for_event(data->xcb)) != NULL)
+			free(event);
+
+		if (obs_source_showing(data->source)) {
+			cur_c = xcb_xfixes_get_cursor_image_unchecked(
+				data->xcb);
+
+			if (xshm_capture_frame(data, full))
+				full = false;
+
+			cur_r = xcb_xfixes_get_cursor_image_reply(
+				data->xcb, cur_c, NULL);
+			if (cur_r) {
+				pthread_mutex_lock(&data->mutex);
+				free(data->cursor_image);
+				data->cursor_image = cur_r;
+				pthread_mutex_unlock(&data->mutex);
+			}
+		}
+
+		next += interval;
+		if (!os_sleepto_ns(next))
+			next = os_gettime_ns();
+	}
+
+	return NULL;
+}
+
 /**
  * Stop the capture
  */
 static void xshm_capture_stop(struct xshm_data *data)
 {
+	if (data->thread_active) {
+		os_event_signal(data->stop_event);
+		pthread_join(data->thread, NULL);
+		data->thread_active = false;
+	}
+
+	os_event_destroy(data->stop_event);
+	data->stop_event = NULL;
+
 	obs_enter_graphics();
 
 	if (data->texture) {
@@ -201,11 +445,26 @@ static void xshm_capture_stop(struct xshm_data *data)
 
 	obs_leave_graphics();
 
-	if (data->xshm) {
-		xshm_xcb_detach(data->xshm);
-		data->xshm = NULL;
+	for (size_t i = 0; i < 2; i++) {
+		if (data->xshm[i]) {
+			xshm_xcb_detach(data->xshm[i]);
+			data->xshm[i] = NULL;
+		}
+	}
+
+	if (data->damage) {
+		xcb_damage_destroy(data->xcb, data->damage);
+		xcb_xfixes_destroy_region(data->xcb, data->damage_region);
+		data->damage = 0;
+		data->damage_region = 0;
 	}
 
+	free(data->cursor_image);
+	data->cursor_image = NULL;
+	da_resize(data->dirty, 0);
+	data->dirty_all = false;
+	data->ready = -1;
+
 	if (data->xcb) {
 		xcb_disconnect(data->xcb);
 		data->xcb = NULL;
@@ -242,22 +501,35 @@ static void xshm_capture_start(struct xshm_data *data)
 		goto fail;
 	}
 
-	data->xshm =
-		xshm_xcb_attach(data->xcb, data->adj_width, data->adj_height);
-	if (!data->xshm) {
-		blog(LOG_ERROR, "failed to attach shm !");
-		goto fail;
+	for (size_t i = 0; i < 2; i++) {
+		data->xshm[i] = xshm_xcb_attach(data->xcb, data->adj_width,
+						data->adj_height);
+		if (!data->xshm[i]) {
+			blog(LOG_ERROR, "failed to attach shm !");
+			goto fail;
+		}
 	}
 
 	data->cursor = xcb_xcursor_init(data->xcb);
 	xcb_xcursor_offset(data->cursor, data->adj_x_org, data->adj_y_org);
 
+	xshm_init_damage(data);
+
 	obs_enter_graphics();
 
 	xshm_resize_texture(data);
 
 	obs_leave_graphics();
 
+	if (os_event_init(&data->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (pthread_create(&data->thread, NULL, xshm_capture_thread, data) !=
+	    0) {
+		blog(LOG_ERROR, "failed to start the capture thread !");
+		goto fail;
+	}
+	data->thread_active = true;
+
 	return;
 fail:
 	xshm_capture_stop(data);
@@ -451,6 +723,8 @@ static void xshm_destroy(void *vptr)
 
 	xshm_capture_stop(data);
 
+	da_free(data->dirty);
+	pthread_mutex_destroy(&data->mutex);
 	bfree(data);
 }
 
@@ -461,6 +735,14 @@ static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct xshm_data *data = bzalloc(sizeof(struct xshm_data));
 	data->source = source;
+	data->ready = -1;
+	pthread_mutex_init(&data->mutex, NULL);
+
+	gs_effect_t *opaque = obs_get_base_effect(OBS_EFFECT_OPAQUE);
+	data->image_param = gs_effect_get_param_by_name(opaque, "image");
+	data->opaque_draw = gs_effect_get_technique(opaque, "Draw");
+	data->cursor_draw = gs_effect_get_technique(
+		obs_get_base_effect(OBS_EFFECT_DEFAULT), "Draw");
 
 	xshm_update(data, settings);
 
@@ -468,46 +750,64 @@ static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 }
 
 /**
- * Prepare the capture data
+ * Upload the parts of the texture that changed since the last upload
+ *
+ * @note requires the mutex to be locked and the obs graphics context
+ */
+static void xshm_upload(struct xshm_data *data, const uint8_t *image)
+{
+	const uint32_t linesize = data->adj_width * 4;
+	bool uploaded = !data->dirty_all;
+
+	for (size_t i = 0; uploaded && i < data->dirty.num; i++) {
+		const struct gs_rect *rect = &data->dirty.array[i];
+		const uint8_t *pos = image + rect->y * linesize + rect->x * 4;
+
+		uploaded = gs_texture_set_image_region(data->texture, pos,
+						       linesize, rect->x,
+						       rect->y, rect->cx,
+						       rect->cy);
+	}
+
+	if (!uploaded)
+		gs_texture_set_image(data->texture, image, linesize, false);
+
+	da_resize(data->dirty, 0);
+	data->dirty_all = false;
+}
+
+/**
+ * Upload the last grabbed frame, if the screen changed
  */
 static void xshm_video_tick(void *vptr, float seconds)
 {
 	UNUSED_PARAMETER(seconds);
 	XSHM_DATA(vptr);
 
+	xcb_xfixes_get_cursor_image_reply_t *cur_r;
+
 	if (!data->texture)
 		return;
-	if (!obs_source_showing(data->source))
-		return;
 
-	xcb_shm_get_image_cookie_t img_c;
-	xcb_shm_get_image_reply_t *img_r;
-	xcb_xfixes_get_cursor_image_cookie_t cur_c;
-	xcb_xfixes_get_cursor_image_reply_t *cur_r;
+	pthread_mutex_lock(&data->mutex);
 
-	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
-					    data->adj_x_org, data->adj_y_org,
-					    data->adj_width, data->adj_height,
-					    ~0, XCB_IMAGE_FORMAT_Z_PIXMAP,
-					    data->xshm->seg, 0);
-	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
+	cur_r = data->cursor_image;
+	data->cursor_image = NULL;
 
-	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
-	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
+	if (data->ready != -1 || cur_r) {
+		obs_enter_graphics();
 
-	if (!img_r)
-		goto exit;
+		if (data->ready != -1)
+			xshm_upload(data, data->xshm[data->ready]->data);
+		xcb_xcursor_update(data->cursor, cur_r);
 
-	obs_enter_graphics();
+		obs_leave_graphics();
+	}
 
-	gs_texture_set_image(data->texture, (void *)data->xshm->data,
-			     data->adj_width * 4, false);
-	xcb_xcursor_update(data->cursor, cur_r);
+	data->ready = -1;
 
-	obs_leave_graphics();
+	pthread_mutex_unlock(&data->mutex);
 
-exit:
-	free(img_r);
 	free(cur_r);
 }
 
@@ -518,25 +818,22 @@ static void xshm_video_render(void *vptr, gs_effect_t *effect)
 {
 	XSHM_DATA(vptr);
 
-	effect = obs_get_base_effect(OBS_EFFECT_OPAQUE);
-
 	if (!data->texture)
 		return;
 
-	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
-	gs_effect_set_texture(image, data->texture);
+	gs_effect_set_texture(data->image_param, data->texture);
 
-	while (gs_effect_loop(effect, "Draw")) {
+	while (gs_technique_loop(data->opaque_draw)) {
 		gs_draw_sprite(data->texture, 0, 0, 0);
 	}
 
 	if (data->show_cursor) {
-		effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
-
-		while (gs_effect_loop(effect, "Draw")) {
+		while (gs_technique_loop(data->cursor_draw)) {
 			xcb_xcursor_render(data->cursor);
 		}
 	}
+
+	UNUSED_PARAMETER(effect);
 }
 
 /**
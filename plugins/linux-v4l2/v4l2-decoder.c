@@ -0,0 +1,420 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <inttypes.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+
+#include "v4l2-decoder.h"
+
+#define blog(level, msg, ...) blog(level, "v4l2-decoder: " msg, ##__VA_ARGS__)
+
+/* MJPEG frames do not depend on each other, each worker has its own codec
+ * context and decodes whole frames */
+#define MAX_WORKERS 4
+/* compressed frames waiting per worker before new frames are dropped */
+#define WORKER_QUEUE 2
+#define MAX_PENDING (MAX_WORKERS * WORKER_QUEUE)
+
+struct decode_job {
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+	uint64_t timestamp;
+	uint64_t seq;
+};
+
+struct decode_worker {
+	struct v4l2_decoder *decoder;
+	AVCodecContext *context;
+	AVFrame *frame;
+	pthread_t thread;
+	bool thread_active;
+
+	os_sem_t *sem;
+	pthread_mutex_t mutex;
+	struct decode_job jobs[WORKER_QUEUE];
+	size_t first_job;
+	size_t num_jobs;
+};
+
+struct decoded_frame {
+	AVFrame *frame;
+	bool done;
+};
+
+struct v4l2_decoder {
+	obs_source_t *source;
+	enum video_range_type color_range;
+	const char *profile_name;
+	volatile bool stop;
+
+	struct decode_worker workers[MAX_WORKERS];
+	size_t num_workers;
+
+	/* used by the capture thread only */
+	size_t next_worker;
+	uint64_t next_seq;
+	uint64_t dropped;
+
+	/* frames decoded ahead of time wait here for the previous ones */
+	pthread_mutex_t output_mutex;
+	struct decoded_frame pending[MAX_PENDING];
+	uint64_t output_seq;
+	bool format_warned;
+};
+
+static inline enum video_format convert_pixel_format(int format)
+{
+	switch (format) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P:
+		return VIDEO_FORMAT_I420;
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUVJ422P:
+		return VIDEO_FORMAT_I422;
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_YUVJ444P:
+		return VIDEO_FORMAT_I444;
+	case AV_PIX_FMT_NV12:
+		return VIDEO_FORMAT_NV12;
+	case AV_PIX_FMT_YUYV422:
+		return VIDEO_FORMAT_YUY2;
+	case AV_PIX_FMT_GRAY8:
+		return VIDEO_FORMAT_Y800;
+	default:
+		return VIDEO_FORMAT_NONE;
+	}
+}
+
+static inline bool is_full_range(const AVFrame *frame)
+{
+	switch (frame->format) {
+	case AV_PIX_FMT_YUVJ420P:
+	case AV_PIX_FMT_YUVJ422P:
+	case AV_PIX_FMT_YUVJ444P:
+		return true;
+	default:
+		return frame->color_range == AVCOL_RANGE_JPEG;
+	}
+}
+
+static void release_frame(void *param, struct obs_source_frame *frame)
+{
+	AVFrame *av_frame = param;
+
+	av_frame_free(&av_frame);
+	UNUSED_PARAMETER(frame);
+}
+
+/* hands the decoded planes to libobs as they are, the frame is freed once
+ * libobs is done with it */
+static void output_frame(struct v4l2_decoder *d, AVFrame *frame)
+{
+	struct obs_source_frame out = {0};
+	enum video_range_type range = d->color_range;
+
+	out.format = convert_pixel_format(frame->format);
+	if (out.format == VIDEO_FORMAT_NONE) {
+		if (!d->format_warned) {
+			blog(LOG_WARNING, "Unsupported decoded format %s",
+			     av_get_pix_fmt_name(frame->format));
+			d->format_warned = true;
+		}
+		av_frame_free(&frame);
+		return;
+	}
+
+	if (range == VIDEO_RANGE_DEFAULT)
+		range = is_full_range(frame) ? VIDEO_RANGE_FULL
+					     : VIDEO_RANGE_PARTIAL;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		out.data[i] = frame->data[i];
+		out.linesize[i] = (uint32_t)frame->linesize[i];
+	}
+
+	out.width = frame->width;
+	out.height = frame->height;
+	/* the pts is the capture timestamp of the packet */
+	out.timestamp = frame->pts != AV_NOPTS_VALUE
+				? (uint64_t)frame->pts
+				: (uint64_t)frame->best_effort_timestamp;
+	out.full_range = range == VIDEO_RANGE_FULL;
+	video_format_get_parameters(VIDEO_CS_DEFAULT, range, out.color_matrix,
+				    out.color_range_min, out.color_range_max);
+
+	obs_source_output_video_ref(d->source, &out, release_frame, frame);
+}
+
+/* workers finish out of order: a frame is parked until every frame captured
+ * before it has been output (or failed to decode) */
+static void output_in_order(struct v4l2_decoder *d, uint64_t seq,
+			    AVFrame *frame)
+{
+	struct decoded_frame *slot;
+
+	pthread_mutex_lock(&d->output_mutex);
+
+	slot = &d->pending[seq % MAX_PENDING];
+	slot->frame = frame;
+	slot->done = true;
+
+	slot = &d->pending[d->output_seq % MAX_PENDING];
+	while (slot->done) {
+		if (slot->frame)
+			output_frame(d, slot->frame);
+
+		slot->frame = NULL;
+		slot->done = false;
+		slot = &d->pending[++d->output_seq % MAX_PENDING];
+	}
+
+	pthread_mutex_unlock(&d->output_mutex);
+}
+
+static AVFrame *receive_frame(struct decode_worker *w)
+{
+	AVFrame *frame;
+
+	if (avcodec_receive_frame(w->context, w->frame) < 0)
+		return NULL;
+
+	frame = av_frame_alloc();
+	if (frame)
+		av_frame_move_ref(frame, w->frame);
+	else
+		av_frame_unref(w->frame);
+	return frame;
+}
+
+static void decode_job(struct decode_worker *w, struct decode_job *job)
+{
+	struct v4l2_decoder *d = w->decoder;
+	AVFrame *frame = NULL;
+	AVPacket packet;
+	int ret;
+
+	av_init_packet(&packet);
+	packet.data = job->data;
+	packet.size = (int)job->size;
+	packet.pts = (int64_t)job->timestamp;
+
+	ret = avcodec_send_packet(w->context, &packet);
+
+	/* a single (frame threaded) decoder keeps the order by itself, but
+	 * may return frames later than the packet they came from */
+	if (d->num_workers == 1) {
+		while (ret == 0 && (frame = receive_frame(w)) != NULL)
+			output_frame(d, frame);
+		return;
+	}
+
+	if (ret == 0)
+		frame = receive_frame(w);
+	output_in_order(d, job->seq, frame);
+}
+
+static void *decode_thread(void *param)
+{
+	struct decode_worker *w = param;
+	struct v4l2_decoder *d = w->decoder;
+	struct decode_job *job;
+
+	os_set_thread_name("v4l2: decode");
+
+	while (os_sem_wait(w->sem) == 0) {
+		if (os_atomic_load_bool(&d->stop))
+			break;
+
+		pthread_mutex_lock(&w->mutex);
+		job = &w->jobs[w->first_job];
+		pthread_mutex_unlock(&w->mutex);
+
+		profile_start(d->profile_name);
+		decode_job(w, job);
+		profile_end(d->profile_name);
+
+		pthread_mutex_lock(&w->mutex);
+		w->first_job = (w->first_job + 1) % WORKER_QUEUE;
+		w->num_jobs--;
+		pthread_mutex_unlock(&w->mutex);
+	}
+
+	return NULL;
+}
+
+static bool init_worker(struct v4l2_decoder *d, struct decode_worker *w,
+			const AVCodec *codec, int threads)
+{
+	w->decoder = d;
+
+	w->context = avcodec_alloc_context3(codec);
+	if (!w->context)
+		return false;
+
+	w->context->thread_count = threads;
+	if (threads > 1)
+		w->context->thread_type = FF_THREAD_FRAME;
+
+	if (avcodec_open2(w->context, codec, NULL) < 0)
+		return false;
+
+	w->frame = av_frame_alloc();
+	if (!w->frame)
+		return false;
+
+	if (os_sem_init(&w->sem, 0) != 0)
+		return false;
+	if (pthread_create(&w->thread, NULL, decode_thread, w) != 0)
+		return false;
+
+	w->thread_active = true;
+	return true;
+}
+
+static void free_worker(struct decode_worker *w)
+{
+	if (w->thread_active) {
+		os_sem_post(w->sem);
+		pthread_join(w->thread, NULL);
+	}
+
+	for (size_t i = 0; i < WORKER_QUEUE; i++)
+		bfree(w->jobs[i].data);
+
+	av_frame_free(&w->frame);
+	avcodec_free_context(&w->context);
+	os_sem_destroy(w->sem);
+	pthread_mutex_destroy(&w->mutex);
+}
+
+struct v4l2_decoder *v4l2_decoder_create(obs_source_t *source,
+					 uint_fast32_t pixfmt,
+					 enum video_range_type color_range)
+{
+	enum AVCodecID id = pixfmt == V4L2_PIX_FMT_H264 ? AV_CODEC_ID_H264
+							: AV_CODEC_ID_MJPEG;
+	const AVCodec *codec;
+	struct v4l2_decoder *d;
+	int threads;
+
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+	avcodec_register_all();
+#endif
+
+	codec = avcodec_find_decoder(id);
+	if (!codec) {
+		blog(LOG_ERROR, "No decoder for %s", avcodec_get_name(id));
+		return NULL;
+	}
+
+	threads = os_get_logical_cores() / 2;
+	if (threads > MAX_WORKERS)
+		threads = MAX_WORKERS;
+	if (threads < 1)
+		threads = 1;
+
+	d = bzalloc(sizeof(struct v4l2_decoder));
+	d->source = source;
+	d->color_range = color_range;
+	d->num_workers = id == AV_CODEC_ID_H264 ? 1 : (size_t)threads;
+	d->profile_name = profile_store_name(obs_get_profiler_name_store(),
+					     "v4l2_decode(%s)",
+					     obs_source_get_name(source));
+	pthread_mutex_init(&d->output_mutex, NULL);
+
+	for (size_t i = 0; i < d->num_workers; i++)
+		pthread_mutex_init(&d->workers[i].mutex, NULL);
+
+	for (size_t i = 0; i < d->num_workers; i++) {
+		int worker_threads = d->num_workers == 1 ? threads : 1;
+
+		if (!init_worker(d, &d->workers[i], codec, worker_threads)) {
+			blog(LOG_ERROR, "Failed to start decoder");
+			v4l2_decoder_destroy(d);
+			return NULL;
+		}
+	}
+
+	blog(LOG_INFO, "Decoding %s with %d threads", codec->name, threads);
+	return d;
+}
+
+void v4l2_decoder_destroy(struct v4l2_decoder *d)
+{
+	if (!d)
+		return;
+
+	os_atomic_set_bool(&d->stop, true);
+
+	for (size_t i = 0; i < d->num_workers; i++)
+		free_worker(&d->workers[i]);
+
+	for (size_t i = 0; i < MAX_PENDING; i++)
+		av_frame_free(&d->pending[i].frame);
+
+	if (d->dropped)
+		blog(LOG_INFO, "Dropped %" PRIu64 " frames while decoding",
+		     d->dropped);
+
+	pthread_mutex_destroy(&d->output_mutex);
+	bfree(d);
+}
+
+bool v4l2_decoder_push(struct v4l2_decoder *d, const uint8_t *data,
+		       size_t size, uint64_t timestamp)
+{
+	struct decode_worker *w = &d->workers[d->next_worker];
+	struct decode_job *job;
+	bool full;
+
+	/* the worker only touches queued jobs, the free slot is ours */
+	pthread_mutex_lock(&w->mutex);
+	full = w->num_jobs == WORKER_QUEUE;
+	job = &w->jobs[(w->first_job + w->num_jobs) % WORKER_QUEUE];
+	pthread_mutex_unlock(&w->mutex);
+
+	/* the next frame goes to the same worker, to keep frames in order */
+	if (full) {
+		d->dropped++;
+		return false;
+	}
+
+	if (job->capacity < size + AV_INPUT_BUFFER_PADDING_SIZE) {
+		job->capacity = size + AV_INPUT_BUFFER_PADDING_SIZE;
+		job->data = brealloc(job->data, job->capacity);
+	}
+
+	memcpy(job->data, data, size);
+	memset(job->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+	job->size = size;
+	job->timestamp = timestamp;
+	job->seq = d->next_seq++;
+
+	pthread_mutex_lock(&w->mutex);
+	w->num_jobs++;
+	pthread_mutex_unlock(&w->mutex);
+	os_sem_post(w->sem);
+
+	d->next_worker = (d->next_worker + 1) % d->num_workers;
+	return true;
+}
@@ -0,0 +1,91 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <linux/videodev2.h>
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct v4l2_decoder;
+
+/**
+ * Check if a v4l2 pixel format is compressed and needs a decoder
+ *
+ * @param pixfmt v4l2 format id
+ *
+ * @return true for the formats supported by v4l2_decoder_create
+ */
+static inline bool v4l2_is_compressed_format(uint_fast32_t pixfmt)
+{
+	switch (pixfmt) {
+	case V4L2_PIX_FMT_MJPEG:
+	case V4L2_PIX_FMT_JPEG:
+	case V4L2_PIX_FMT_H264:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Create a decoder for a compressed capture format
+ *
+ * MJPEG frames are decoded in parallel by a small pool of worker threads,
+ * H.264 by a single worker using frame threading. Decoded frames are output
+ * to the source in capture order, without being copied.
+ *
+ * @param source the source the decoded frames are output to
+ * @param pixfmt v4l2 format id
+ * @param color_range the color range setting of the source
+ *
+ * @return the decoder or NULL on failure
+ */
+struct v4l2_decoder *v4l2_decoder_create(obs_source_t *source,
+					 uint_fast32_t pixfmt,
+					 enum video_range_type color_range);
+
+/**
+ * Stop the workers and destroy the decoder
+ *
+ * Frames that were already output stay valid until libobs releases them.
+ *
+ * @param decoder the decoder
+ */
+void v4l2_decoder_destroy(struct v4l2_decoder *decoder);
+
+/**
+ * Queue a compressed frame for decoding
+ *
+ * The data is copied so the capture buffer can be queued again right away.
+ * The frame is dropped when the decoder is lagging behind.
+ *
+ * @param decoder the decoder
+ * @param data compressed frame
+ * @param size size of the compressed frame
+ * @param timestamp timestamp of the frame in nanoseconds
+ *
+ * @return false if the frame was dropped
+ */
+bool v4l2_decoder_push(struct v4l2_decoder *decoder, const uint8_t *data,
+		       size_t size, uint64_t timestamp);
+
+#ifdef __cplusplus
+}
+#endif
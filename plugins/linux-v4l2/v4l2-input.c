@@ -19,6 +19,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <unistd.h>
 #include <string.h>
 #include <inttypes.h>
+#include <errno.h>
+#include <time.h>
 #include <fcntl.h>
 #include <dirent.h>
 #include <sys/time.h>
@@ -36,6 +38,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <obs-module.h>
 
 #include "v4l2-controls.h"
+#include "v4l2-decoder.h"
 #include "v4l2-helpers.h"
 
 #if HAVE_UDEV
@@ -62,6 +65,31 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "v4l2-input: " msg, ##__VA_ARGS__)
 
+/* buffers that are never lent to libobs, so the driver can keep capturing */
+#define V4L2_MIN_QUEUED_BUFFERS 2
+
+/* how long to wait for libobs to release the lent buffers at the end of a
+ * capture session */
+#define V4L2_RELEASE_TIMEOUT_MS 1000
+
+/**
+ * Capture session shared with the frames that are passed to libobs without
+ * a copy
+ *
+ * Frames hold on to their mmap buffer until libobs releases them, which may
+ * happen after the capture stopped. If that takes too long the session takes
+ * over the device and the buffers, and the last released frame frees them.
+ */
+struct v4l2_session {
+	pthread_mutex_t mutex;
+	pthread_cond_t released;
+	int_fast32_t dev;
+	struct v4l2_buffer_data buffers;
+	long lent;
+	bool streaming;
+	bool orphaned;
+};
+
 /**
  * Data structure for the v4l2 source
  */
@@ -88,6 +116,8 @@ struct v4l2_data {
 	int height;
 	int linesize;
 	struct v4l2_buffer_data buffers;
+	struct v4l2_session *session;
+	struct v4l2_decoder *decoder;
 };
 
 /* forward declarations */
@@ -146,6 +176,70 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data,
 	}
 }
 
+static void v4l2_session_free(struct v4l2_session *session)
+{
+	if (session->orphaned) {
+		v4l2_destroy_mmap(&session->buffers);
+		v4l2_close(session->dev);
+	}
+
+	pthread_cond_destroy(&session->released);
+	pthread_mutex_destroy(&session->mutex);
+	bfree(session);
+}
+
+/**
+ * Lend a dequeued buffer to libobs, unless that would leave too few buffers
+ * to the driver
+ */
+static bool v4l2_lend_buffer(struct v4l2_session *session)
+{
+	bool lend;
+
+	pthread_mutex_lock(&session->mutex);
+	lend = session->lent + V4L2_MIN_QUEUED_BUFFERS <
+	       (long)session->buffers.count;
+	if (lend)
+		session->lent++;
+	pthread_mutex_unlock(&session->mutex);
+
+	return lend;
+}
+
+/**
+ * Release callback of the frames lent to libobs, re-queues the buffer
+ */
+static void v4l2_release_frame(void *vptr, struct obs_source_frame *frame)
+{
+	struct v4l2_session *session = vptr;
+	struct v4l2_buffer buf;
+	bool free_session;
+
+	pthread_mutex_lock(&session->mutex);
+
+	if (session->streaming) {
+		memset(&buf, 0, sizeof(buf));
+		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.memory = V4L2_MEMORY_MMAP;
+
+		while (buf.index < session->buffers.count &&
+		       session->buffers.info[buf.index].start != frame->data[0])
+			buf.index++;
+
+		if (v4l2_ioctl(session->dev, VIDIOC_QBUF, &buf) < 0)
+			blog(LOG_DEBUG, "failed to enqueue buffer");
+	}
+
+	free_session = --session->lent == 0 && session->orphaned;
+	if (session->lent == 0)
+		pthread_cond_signal(&session->released);
+
+	pthread_mutex_unlock(&session->mutex);
+
+	if (free_session)
+		v4l2_session_free(session);
+}
+
 /*
  * Worker thread to get video data
  */
@@ -165,6 +259,10 @@ static void *v4l2_thread(void *vptr)
 	if (v4l2_start_capture(data->dev, &data->buffers) < 0)
 		goto exit;
 
+	pthread_mutex_lock(&data->session->mutex);
+	data->session->streaming = true;
+	pthread_mutex_unlock(&data->session->mutex);
+
 	frames = 0;
 	first_ts = 0;
 	v4l2_prep_obs_frame(data, &out, plane_offsets);
@@ -202,9 +300,24 @@ static void *v4l2_thread(void *vptr)
 		out.timestamp -= first_ts;
 
 		start = (uint8_t *)data->buffers.info[buf.index].start;
-		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
-			out.data[i] = start + plane_offsets[i];
-		obs_source_output_video(data->source, &out);
+
+		if (data->decoder) {
+			v4l2_decoder_push(data->decoder, start, buf.bytesused,
+					  out.timestamp);
+		} else {
+			for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
+				out.data[i] = start + plane_offsets[i];
+
+			if (v4l2_lend_buffer(data->session)) {
+				obs_source_output_video_ref(data->source, &out,
+							    v4l2_release_frame,
+							    data->session);
+				frames++;
+				continue;
+			}
+
+			obs_source_output_video(data->source, &out);
+		}
 
 		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
 			blog(LOG_DEBUG, "failed to enqueue buffer");
@@ -217,6 +330,10 @@ static void *v4l2_thread(void *vptr)
 	blog(LOG_INFO, "Stopped capture after %" PRIu64 " frames", frames);
 
 exit:
+	pthread_mutex_lock(&data->session->mutex);
+	data->session->streaming = false;
+	pthread_mutex_unlock(&data->session->mutex);
+
 	v4l2_stop_capture(data->dev);
 	return NULL;
 }
@@ -398,7 +515,8 @@ static void v4l2_format_list(int dev, obs_property_t *prop)
 			dstr_cat(&buffer, " (Emulated)");
 
 		if (v4l2_to_obs_video_format(fmt.pixelformat) !=
-		    VIDEO_FORMAT_NONE) {
+			    VIDEO_FORMAT_NONE ||
+		    v4l2_is_compressed_format(fmt.pixelformat)) {
 			obs_property_list_add_int(prop, buffer.array,
 						  fmt.pixelformat);
 			blog(LOG_INFO, "Pixelformat: %s (available)",
@@ -815,6 +933,54 @@ static obs_properties_t *v4l2_properties(void *vptr)
 	return props;
 }
 
+/**
+ * Get the buffers lent to libobs back before they are unmapped
+ *
+ * Dropping the queued frames releases most of them right away, the others
+ * are only held while libobs uploads or outputs them.
+ */
+static void v4l2_end_session(struct v4l2_data *data)
+{
+	struct v4l2_session *session = data->session;
+	struct timespec deadline;
+	bool done;
+
+	obs_source_output_video_ref(data->source, NULL, v4l2_release_frame,
+				    session);
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += V4L2_RELEASE_TIMEOUT_MS / 1000;
+	deadline.tv_nsec += (V4L2_RELEASE_TIMEOUT_MS % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&session->mutex);
+
+	while (session->lent != 0) {
+		if (pthread_cond_timedwait(&session->released, &session->mutex,
+					   &deadline) == ETIMEDOUT)
+			break;
+	}
+
+	done = session->lent == 0;
+	if (!done) {
+		blog(LOG_WARNING,
+		     "%ld buffers still in use, keeping the device open "
+		     "until they are released",
+		     session->lent);
+		session->orphaned = true;
+		data->dev = -1;
+		memset(&data->buffers, 0, sizeof(data->buffers));
+	}
+	pthread_mutex_unlock(&session->mutex);
+
+	if (done)
+		v4l2_session_free(session);
+	data->session = NULL;
+}
+
 static void v4l2_terminate(struct v4l2_data *data)
 {
 	if (data->thread) {
@@ -824,6 +990,12 @@ static void v4l2_terminate(struct v4l2_data *data)
 		data->thread = 0;
 	}
 
+	v4l2_decoder_destroy(data->decoder);
+	data->decoder = NULL;
+
+	if (data->session)
+		v4l2_end_session(data);
+
 	v4l2_destroy_mmap(&data->buffers);
 
 	if (data->dev != -1) {
@@ -914,7 +1086,13 @@ static void v4l2_init(struct v4l2_data *data)
 		blog(LOG_ERROR, "Unable to set format");
 		goto fail;
 	}
-	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE) {
+	if (v4l2_is_compressed_format(data->pixfmt)) {
+		data->decoder = v4l2_decoder_create(data->source, data->pixfmt,
+						    data->color_range);
+		if (!data->decoder)
+			goto fail;
+	} else if (v4l2_to_obs_video_format(data->pixfmt) ==
+		   VIDEO_FORMAT_NONE) {
 		blog(LOG_ERROR, "Selected video format not supported");
 		goto fail;
 	}
@@ -937,6 +1115,12 @@ static void v4l2_init(struct v4l2_data *data)
 		goto fail;
 	}
 
+	data->session = bzalloc(sizeof(struct v4l2_session));
+	data->session->dev = data->dev;
+	data->session->buffers = data->buffers;
+	pthread_mutex_init(&data->session->mutex, NULL);
+	pthread_cond_init(&data->session->released, NULL);
+
 	/* start the capture thread */
 	if (os_event_init(&data->event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
@@ -24,6 +24,7 @@
 #include <util/platform.h>
 #include <util/circlebuf.h>
 #include <util/threading.h>
+#include <inttypes.h>
 #include "ffmpeg-mux/ffmpeg-mux.h"
 
 #ifdef _WIN32
@@ -39,6 +40,30 @@
 #define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
 #define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
 
+/* packets smaller than this are batched into a single pipe write */
+#define WRITE_BATCH_SIZE (64 * 1024)
+/* pipe writes taking longer than this count as the muxer stalling */
+#define WRITE_STALL_NS 20000000ULL
+
+/* what to do when the muxer process falls behind by more than the budget */
+enum write_policy {
+	WRITE_POLICY_DROP_FRAMES,
+	WRITE_POLICY_STOP,
+};
+
+/* replay buffer packets from one keyframe up to the next, so that the buffer
+ * is purged a whole segment at a time.  segments older than the RAM tail can
+ * be spilled to disk, their packets then only keep their metadata. */
+struct replay_segment {
+	DARRAY(struct encoder_packet) packets;
+	volatile long refs;
+	int64_t size;
+	bool keyframe;
+	bool spill;
+	bool spilled;
+	struct dstr path;
+};
+
 struct ffmpeg_muxer {
 	obs_output_t *output;
 	os_process_pipe_t *pipe;
@@ -51,7 +76,9 @@ struct ffmpeg_muxer {
 	volatile bool capturing;
 
 	/* replay buffer */
-	struct circlebuf packets;
+	DARRAY(struct replay_segment *) segments;
+	pthread_mutex_t segments_mutex;
+	bool segment_open;
 	int64_t cur_size;
 	int64_t cur_time;
 	int64_t max_size;
@@ -60,11 +87,41 @@ struct ffmpeg_muxer {
 	int keyframes;
 	obs_hotkey_id hotkey;
 
+	pthread_t spill_thread;
+	bool spill_thread_active;
+	volatile bool spill_stop;
+	os_sem_t *spill_sem;
+	int64_t ram_tail;
+	struct dstr spill_dir;
+	unsigned int spill_count;
+
+	DARRAY(struct replay_segment *) save_segments;
 	DARRAY(struct encoder_packet) mux_packets;
+	DARRAY(uint8_t) spill_buffer;
 	pthread_t mux_thread;
 	bool mux_thread_joinable;
 	volatile bool muxing;
 
+	/* packets are written to the muxer process from a writer thread, so
+	 * that slow storage does not hold back the encoders */
+	pthread_t write_thread;
+	bool write_thread_active;
+	/* lives as long as the muxer, get_congestion can be called anytime */
+	pthread_mutex_t write_mutex;
+	os_sem_t *write_sem;
+	struct circlebuf write_queue;
+	size_t write_queue_bytes;
+	size_t write_queue_peak;
+	size_t max_write_bytes;
+	enum write_policy write_policy;
+	bool write_stop;
+	volatile bool write_failed;
+	volatile bool write_overflow;
+	bool drop_until_keyframe;
+	volatile long dropped_frames;
+	uint64_t stall_ns;
+	DARRAY(uint8_t) write_buffer;
+
 	bool is_network;
 };
 
@@ -80,15 +137,43 @@ static const char *ffmpeg_mpegts_mux_getname(void *type)
 	return obs_module_text("FFmpegMpegtsMuxer");
 }
 
+static void replay_segment_release(struct replay_segment *segment)
+{
+	if (!segment || os_atomic_dec_long(&segment->refs) > 0)
+		return;
+
+	for (size_t i = 0; i < segment->packets.num; i++)
+		obs_encoder_packet_release(&segment->packets.array[i]);
+	da_free(segment->packets);
+
+	if (segment->spilled)
+		os_unlink(segment->path.array);
+	dstr_free(&segment->path);
+	bfree(segment);
+}
+
+static void stop_spill_thread(struct ffmpeg_muxer *stream)
+{
+	if (!stream->spill_thread_active)
+		return;
+
+	os_atomic_set_bool(&stream->spill_stop, true);
+	os_sem_post(stream->spill_sem);
+	pthread_join(stream->spill_thread, NULL);
+	os_sem_destroy(stream->spill_sem);
+	stream->spill_sem = NULL;
+	stream->spill_thread_active = false;
+}
+
 static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 {
-	while (stream->packets.size > 0) {
-		struct encoder_packet pkt;
-		circlebuf_pop_front(&stream->packets, &pkt, sizeof(pkt));
-		obs_encoder_packet_release(&pkt);
-	}
+	stop_spill_thread(stream);
 
-	circlebuf_free(&stream->packets);
+	for (size_t i = 0; i < stream->segments.num; i++)
+		replay_segment_release(stream->segments.array[i]);
+	da_free(stream->segments);
+
+	stream->segment_open = false;
 	stream->cur_size = 0;
 	stream->cur_time = 0;
 	stream->max_size = 0;
@@ -97,16 +182,26 @@ static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 	stream->keyframes = 0;
 }
 
+static void stop_write_thread(struct ffmpeg_muxer *stream, bool flush);
+
 static void ffmpeg_mux_destroy(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
 
+	stop_write_thread(stream, false);
 	replay_buffer_clear(stream);
 	if (stream->mux_thread_joinable)
 		pthread_join(stream->mux_thread, NULL);
+	da_free(stream->save_segments);
 	da_free(stream->mux_packets);
+	da_free(stream->spill_buffer);
 
 	os_process_pipe_destroy(stream->pipe);
+
+	/* the spill and mux threads are joined, nothing locks them anymore */
+	pthread_mutex_destroy(&stream->segments_mutex);
+	pthread_mutex_destroy(&stream->write_mutex);
+	dstr_free(&stream->spill_dir);
 	dstr_free(&stream->path);
 	bfree(stream);
 }
@@ -116,6 +211,16 @@ static void *ffmpeg_mux_create(obs_data_t *settings, obs_output_t *output)
 	struct ffmpeg_muxer *stream = bzalloc(sizeof(*stream));
 	stream->output = output;
 
+	if (pthread_mutex_init(&stream->segments_mutex, NULL) != 0) {
+		bfree(stream);
+		return NULL;
+	}
+	if (pthread_mutex_init(&stream->write_mutex, NULL) != 0) {
+		pthread_mutex_destroy(&stream->segments_mutex);
+		bfree(stream);
+		return NULL;
+	}
+
 	if (obs_output_get_flags(output) & OBS_OUTPUT_SERVICE)
 		stream->is_network = true;
 
@@ -323,6 +428,235 @@ static void set_file_not_readable_error(struct ffmpeg_muxer *stream,
 	obs_data_release(settings);
 }
 
+static inline struct ffm_packet_info
+get_packet_info(const struct encoder_packet *packet)
+{
+	bool is_video = packet->type == OBS_ENCODER_VIDEO;
+
+	struct ffm_packet_info info = {.pts = packet->pts,
+				       .dts = packet->dts,
+				       .size = (uint32_t)packet->size,
+				       .index = (int)packet->track_idx,
+				       .type = is_video ? FFM_PACKET_VIDEO
+							: FFM_PACKET_AUDIO,
+				       .keyframe = packet->keyframe};
+	return info;
+}
+
+static bool pipe_write(struct ffmpeg_muxer *stream, const uint8_t *data,
+		       size_t size)
+{
+	uint64_t start = os_gettime_ns();
+	uint64_t elapsed;
+	size_t ret;
+
+	ret = os_process_pipe_write(stream->pipe, data, size);
+
+	elapsed = os_gettime_ns() - start;
+	if (elapsed > WRITE_STALL_NS)
+		stream->stall_ns += elapsed;
+
+	return ret == size;
+}
+
+static bool flush_write_buffer(struct ffmpeg_muxer *stream)
+{
+	size_t size = stream->write_buffer.num;
+
+	stream->write_buffer.num = 0;
+	return !size || pipe_write(stream, stream->write_buffer.array, size);
+}
+
+static bool write_queued_packet(struct ffmpeg_muxer *stream,
+				struct encoder_packet *packet)
+{
+	struct ffm_packet_info info = get_packet_info(packet);
+
+	da_push_back_array(stream->write_buffer, (uint8_t *)&info,
+			   sizeof(info));
+
+	if (packet->size < WRITE_BATCH_SIZE) {
+		da_push_back_array(stream->write_buffer, packet->data,
+				   packet->size);
+		if (stream->write_buffer.num < WRITE_BATCH_SIZE)
+			return true;
+		return flush_write_buffer(stream);
+	}
+
+	return flush_write_buffer(stream) &&
+	       pipe_write(stream, packet->data, packet->size);
+}
+
+/* call with write_mutex locked */
+static void release_write_queue(struct ffmpeg_muxer *stream)
+{
+	while (stream->write_queue.size) {
+		struct encoder_packet packet;
+		circlebuf_pop_front(&stream->write_queue, &packet,
+				    sizeof(packet));
+		stream->write_queue_bytes -= packet.size;
+		obs_encoder_packet_release(&packet);
+	}
+}
+
+/* the muxer fell behind with the "stop" policy and the output is being
+ * stopped: closing the pipe waits for the muxer process, so it is done from
+ * here rather than from the encoder thread */
+static void close_overflowed_pipe(struct ffmpeg_muxer *stream)
+{
+	pthread_mutex_lock(&stream->write_mutex);
+	release_write_queue(stream);
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	/* unless deactivate() got to it first */
+	if (!os_atomic_set_bool(&stream->active, false))
+		return;
+
+	os_process_pipe_destroy(stream->pipe);
+	stream->pipe = NULL;
+
+	info("Output of file '%s' stopped", stream->path.array);
+}
+
+static void *write_thread(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+
+	os_set_thread_name("ffmpeg-mux: writer thread");
+
+	while (os_sem_wait(stream->write_sem) == 0) {
+		bool success = true;
+		bool stop;
+
+		if (os_atomic_load_bool(&stream->write_overflow)) {
+			close_overflowed_pipe(stream);
+			break;
+		}
+
+		/* write everything queued so far, batching small packets */
+		for (;;) {
+			struct encoder_packet packet;
+			bool empty;
+
+			if (os_atomic_load_bool(&stream->write_overflow))
+				break;
+
+			pthread_mutex_lock(&stream->write_mutex);
+			empty = !stream->write_queue.size;
+			if (!empty)
+				circlebuf_pop_front(&stream->write_queue,
+						    &packet, sizeof(packet));
+			stop = stream->write_stop;
+			pthread_mutex_unlock(&stream->write_mutex);
+
+			if (empty)
+				break;
+
+			success = write_queued_packet(stream, &packet);
+
+			pthread_mutex_lock(&stream->write_mutex);
+			stream->write_queue_bytes -= packet.size;
+			pthread_mutex_unlock(&stream->write_mutex);
+
+			stream->total_bytes += packet.size;
+			obs_encoder_packet_release(&packet);
+
+			if (!success)
+				break;
+		}
+
+		if (os_atomic_load_bool(&stream->write_overflow)) {
+			close_overflowed_pipe(stream);
+			break;
+		}
+
+		if (success)
+			success = flush_write_buffer(stream);
+
+		if (!success) {
+			warn("os_process_pipe_write for queued packets failed");
+			os_atomic_set_bool(&stream->write_failed, true);
+			break;
+		}
+
+		if (stop)
+			break;
+	}
+
+	return NULL;
+}
+
+static void start_write_thread(struct ffmpeg_muxer *stream,
+			       obs_data_t *settings)
+{
+	const char *policy = obs_data_get_string(settings, "write_policy");
+
+	stream->max_write_bytes =
+		(size_t)obs_data_get_int(settings, "write_buffer_mb") * 1024 *
+		1024;
+	stream->write_policy = strcmp(policy, "stop") == 0
+				       ? WRITE_POLICY_STOP
+				       : WRITE_POLICY_DROP_FRAMES;
+	stream->write_queue_bytes = 0;
+	stream->write_queue_peak = 0;
+	stream->write_stop = false;
+	stream->write_failed = false;
+	stream->write_overflow = false;
+	stream->drop_until_keyframe = false;
+	stream->dropped_frames = 0;
+	stream->stall_ns = 0;
+
+	if (os_sem_init(&stream->write_sem, 0) != 0)
+		goto fail;
+	if (pthread_create(&stream->write_thread, NULL, write_thread,
+			   stream) != 0) {
+		os_sem_destroy(stream->write_sem);
+		goto fail;
+	}
+
+	pthread_mutex_lock(&stream->write_mutex);
+	stream->write_thread_active = true;
+	pthread_mutex_unlock(&stream->write_mutex);
+	return;
+
+fail:
+	stream->write_sem = NULL;
+	warn("Failed to create writer thread, writing from the encoder "
+	     "thread instead");
+}
+
+static void stop_write_thread(struct ffmpeg_muxer *stream, bool flush)
+{
+	if (!stream->write_thread_active)
+		return;
+
+	pthread_mutex_lock(&stream->write_mutex);
+	stream->write_stop = true;
+	if (!flush)
+		release_write_queue(stream);
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	os_sem_post(stream->write_sem);
+	pthread_join(stream->write_thread, NULL);
+
+	/* left over if the writer thread failed */
+	pthread_mutex_lock(&stream->write_mutex);
+	release_write_queue(stream);
+	stream->write_thread_active = false;
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	if (stream->dropped_frames || stream->stall_ns)
+		info("Writer thread: %ld frames dropped, stalled for %" PRIu64
+		     " ms, peak queue %zu KiB",
+		     stream->dropped_frames, stream->stall_ns / 1000000,
+		     stream->write_queue_peak / 1024);
+
+	circlebuf_free(&stream->write_queue);
+	da_free(stream->write_buffer);
+	os_sem_destroy(stream->write_sem);
+	stream->write_sem = NULL;
+}
+
 static bool ffmpeg_mux_start(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -361,16 +695,24 @@ static bool ffmpeg_mux_start(void *data)
 		os_unlink(path);
 	}
 
+	/* writer thread of an output it stopped itself (see
+	 * close_overflowed_pipe), only left to be joined */
+	stop_write_thread(stream, false);
+	os_atomic_set_bool(&stream->sent_headers, false);
+
 	start_pipe(stream, path);
-	obs_data_release(settings);
 
 	if (!stream->pipe) {
+		obs_data_release(settings);
 		obs_output_set_last_error(
 			stream->output, obs_module_text("HelperProcessFailed"));
 		warn("Failed to create process pipe");
 		return false;
 	}
 
+	start_write_thread(stream, settings);
+	obs_data_release(settings);
+
 	/* write headers and start capture */
 	os_atomic_set_bool(&stream->active, true);
 	os_atomic_set_bool(&stream->capturing, true);
@@ -385,11 +727,14 @@ static int deactivate(struct ffmpeg_muxer *stream, int code)
 {
 	int ret = -1;
 
-	if (active(stream)) {
+	/* the writer thread may close an overflowed output concurrently */
+	if (os_atomic_set_bool(&stream->active, false)) {
+		bool failed = os_atomic_load_bool(&stream->write_failed);
+		stop_write_thread(stream, !code && !failed);
+
 		ret = os_process_pipe_destroy(stream->pipe);
 		stream->pipe = NULL;
 
-		os_atomic_set_bool(&stream->active, false);
 		os_atomic_set_bool(&stream->sent_headers, false);
 
 		info("Output of file '%s' stopped", stream->path.array);
@@ -451,19 +796,73 @@ static void signal_failure(struct ffmpeg_muxer *stream)
 	os_atomic_set_bool(&stream->capturing, false);
 }
 
-static bool write_packet(struct ffmpeg_muxer *stream,
+static bool queue_packet(struct ffmpeg_muxer *stream,
 			 struct encoder_packet *packet)
 {
-	bool is_video = packet->type == OBS_ENCODER_VIDEO;
-	size_t ret;
+	struct encoder_packet pkt;
+	bool over_budget;
 
-	struct ffm_packet_info info = {.pts = packet->pts,
-				       .dts = packet->dts,
-				       .size = (uint32_t)packet->size,
-				       .index = (int)packet->track_idx,
-				       .type = is_video ? FFM_PACKET_VIDEO
-							: FFM_PACKET_AUDIO,
-				       .keyframe = packet->keyframe};
+	if (os_atomic_load_bool(&stream->write_failed)) {
+		signal_failure(stream);
+		return false;
+	}
+	if (os_atomic_load_bool(&stream->write_overflow))
+		return false;
+
+	pthread_mutex_lock(&stream->write_mutex);
+	over_budget = stream->max_write_bytes &&
+		      stream->write_queue_bytes + packet->size >
+			      stream->max_write_bytes;
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	/* audio is always kept, video is dropped up to the next keyframe so
+	 * that the file stays decodable */
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		if (over_budget && stream->write_policy == WRITE_POLICY_STOP) {
+			warn("Muxer fell behind by more than %zu MiB, "
+			     "stopping",
+			     stream->max_write_bytes / (1024 * 1024));
+			/* the writer thread closes the pipe */
+			os_atomic_set_bool(&stream->write_overflow, true);
+			os_atomic_set_bool(&stream->capturing, false);
+			os_sem_post(stream->write_sem);
+			obs_output_signal_stop(stream->output,
+					       OBS_OUTPUT_ERROR);
+			return false;
+		}
+
+		if (over_budget ||
+		    (stream->drop_until_keyframe && !packet->keyframe)) {
+			if (!stream->drop_until_keyframe)
+				warn("Muxer fell behind by more than %zu MiB, "
+				     "dropping frames",
+				     stream->max_write_bytes / (1024 * 1024));
+			stream->drop_until_keyframe = true;
+			os_atomic_inc_long(&stream->dropped_frames);
+			return true;
+		}
+
+		stream->drop_until_keyframe = false;
+	}
+
+	obs_encoder_packet_ref(&pkt, packet);
+
+	pthread_mutex_lock(&stream->write_mutex);
+	circlebuf_push_back(&stream->write_queue, &pkt, sizeof(pkt));
+	stream->write_queue_bytes += pkt.size;
+	if (stream->write_queue_bytes > stream->write_queue_peak)
+		stream->write_queue_peak = stream->write_queue_bytes;
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	os_sem_post(stream->write_sem);
+	return true;
+}
+
+static bool write_packet_direct(struct ffmpeg_muxer *stream,
+				struct encoder_packet *packet)
+{
+	struct ffm_packet_info info = get_packet_info(packet);
+	size_t ret;
 
 	ret = os_process_pipe_write(stream->pipe, (const uint8_t *)&info,
 				    sizeof(info));
@@ -484,6 +883,15 @@ static bool write_packet(struct ffmpeg_muxer *stream,
 	return true;
 }
 
+static bool write_packet(struct ffmpeg_muxer *stream,
+			 struct encoder_packet *packet)
+{
+	if (stream->write_thread_active)
+		return queue_packet(stream, packet);
+
+	return write_packet_direct(stream, packet);
+}
+
 static bool send_audio_headers(struct ffmpeg_muxer *stream,
 			       obs_encoder_t *aencoder, size_t idx)
 {
@@ -491,7 +899,7 @@ static bool send_audio_headers(struct ffmpeg_muxer *stream,
 		.type = OBS_ENCODER_AUDIO, .timebase_den = 1, .track_idx = idx};
 
 	obs_encoder_get_extra_data(aencoder, &packet.data, &packet.size);
-	return write_packet(stream, &packet);
+	return write_packet_direct(stream, &packet);
 }
 
 static bool send_video_headers(struct ffmpeg_muxer *stream)
@@ -502,9 +910,11 @@ static bool send_video_headers(struct ffmpeg_muxer *stream)
 					.timebase_den = 1};
 
 	obs_encoder_get_extra_data(vencoder, &packet.data, &packet.size);
-	return write_packet(stream, &packet);
+	return write_packet_direct(stream, &packet);
 }
 
+/* headers are written before the first packet is queued, directly from the
+ * encoder thread since they point to the encoder's extra data */
 static bool send_headers(struct ffmpeg_muxer *stream)
 {
 	obs_encoder_t *aencoder;
@@ -567,12 +977,38 @@ static obs_properties_t *ffmpeg_mux_properties(void *unused)
 	return props;
 }
 
+static void ffmpeg_mux_defaults(obs_data_t *s)
+{
+	obs_data_set_default_int(s, "write_buffer_mb", 64);
+	obs_data_set_default_string(s, "write_policy", "drop_frames");
+}
+
 static uint64_t ffmpeg_mux_total_bytes(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
 	return stream->total_bytes;
 }
 
+static int ffmpeg_mux_dropped_frames(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+	return (int)os_atomic_load_long(&stream->dropped_frames);
+}
+
+static float ffmpeg_mux_congestion(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+	float congestion = 0.0f;
+
+	pthread_mutex_lock(&stream->write_mutex);
+	if (stream->write_thread_active && stream->max_write_bytes)
+		congestion = (float)stream->write_queue_bytes /
+			     (float)stream->max_write_bytes;
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	return congestion > 1.0f ? 1.0f : congestion;
+}
+
 struct obs_output_info ffmpeg_muxer = {
 	.id = "ffmpeg_muxer",
 	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED | OBS_OUTPUT_MULTI_TRACK |
@@ -584,7 +1020,10 @@ struct obs_output_info ffmpeg_muxer = {
 	.stop = ffmpeg_mux_stop,
 	.encoded_packet = ffmpeg_mux_data,
 	.get_total_bytes = ffmpeg_mux_total_bytes,
+	.get_defaults = ffmpeg_mux_defaults,
 	.get_properties = ffmpeg_mux_properties,
+	.get_dropped_frames = ffmpeg_mux_dropped_frames,
+	.get_congestion = ffmpeg_mux_congestion,
 };
 
 static int connect_time(struct ffmpeg_muxer *stream)
@@ -614,7 +1053,10 @@ struct obs_output_info ffmpeg_mpegts_muxer = {
 	.stop = ffmpeg_mux_stop,
 	.encoded_packet = ffmpeg_mux_data,
 	.get_total_bytes = ffmpeg_mux_total_bytes,
+	.get_defaults = ffmpeg_mux_defaults,
 	.get_properties = ffmpeg_mux_properties,
+	.get_dropped_frames = ffmpeg_mux_dropped_frames,
+	.get_congestion = ffmpeg_mux_congestion,
 	.get_connect_time_ms = ffmpeg_mpegts_mux_connect_time,
 };
 
@@ -665,9 +1107,9 @@ static void get_last_replay(void *data, calldata_t *cd)
 
 static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
 {
-	UNUSED_PARAMETER(settings);
-	struct ffmpeg_muxer *stream = bzalloc(sizeof(*stream));
-	stream->output = output;
+	struct ffmpeg_muxer *stream = ffmpeg_mux_create(settings, output);
+	if (!stream)
+		return NULL;
 
 	stream->hotkey =
 		obs_hotkey_register_output(output, "ReplayBuffer.Save",
@@ -690,6 +1132,120 @@ static void replay_buffer_destroy(void *data)
 	ffmpeg_mux_destroy(data);
 }
 
+static bool spill_segment(struct ffmpeg_muxer *stream,
+			  struct replay_segment *segment)
+{
+	bool success = true;
+	FILE *file;
+
+	dstr_printf(&segment->path, "%s/.replay-%p-%u.tmp",
+		    stream->spill_dir.array, stream, stream->spill_count++);
+
+	file = os_fopen(segment->path.array, "wb");
+	if (!file)
+		return false;
+
+	/* the packets of a closed segment do not change */
+	for (size_t i = 0; i < segment->packets.num && success; i++) {
+		struct encoder_packet *pkt = &segment->packets.array[i];
+		success = fwrite(pkt->data, 1, pkt->size, file) == pkt->size;
+	}
+
+	if (fclose(file) != 0)
+		success = false;
+	if (!success) {
+		os_unlink(segment->path.array);
+		return false;
+	}
+
+	pthread_mutex_lock(&stream->segments_mutex);
+	for (size_t i = 0; i < segment->packets.num; i++) {
+		struct encoder_packet *pkt = &segment->packets.array[i];
+		struct encoder_packet data = *pkt;
+
+		obs_encoder_packet_release(&data);
+		pkt->data = NULL;
+	}
+	segment->spilled = true;
+	pthread_mutex_unlock(&stream->segments_mutex);
+
+	return true;
+}
+
+static void *replay_spill_thread(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+
+	os_set_thread_name("replay buffer: spill thread");
+
+	while (os_sem_wait(stream->spill_sem) == 0) {
+		struct replay_segment *segment = NULL;
+
+		if (os_atomic_load_bool(&stream->spill_stop))
+			break;
+
+		/* the last segment is still being filled */
+		pthread_mutex_lock(&stream->segments_mutex);
+		for (size_t i = 0; i + 1 < stream->segments.num; i++) {
+			struct replay_segment *cur = stream->segments.array[i];
+			if (cur->spill && !cur->spilled) {
+				os_atomic_inc_long(&cur->refs);
+				segment = cur;
+				break;
+			}
+		}
+		pthread_mutex_unlock(&stream->segments_mutex);
+
+		if (!segment)
+			continue;
+
+		if (!spill_segment(stream, segment)) {
+			warn("Failed to write replay buffer segment to '%s', "
+			     "keeping it in RAM",
+			     segment->path.array);
+
+			pthread_mutex_lock(&stream->segments_mutex);
+			segment->spill = false;
+			pthread_mutex_unlock(&stream->segments_mutex);
+		}
+
+		replay_segment_release(segment);
+	}
+
+	return NULL;
+}
+
+static void start_spill_thread(struct ffmpeg_muxer *stream,
+			       obs_data_t *settings)
+{
+	const char *dir = obs_data_get_string(settings, "directory");
+
+	if (!dir || !*dir) {
+		warn("No replay buffer directory, keeping the buffer in RAM");
+		return;
+	}
+
+	dstr_copy(&stream->spill_dir, dir);
+	dstr_replace(&stream->spill_dir, "\\", "/");
+	stream->ram_tail = obs_data_get_int(settings, "ram_tail_sec") *
+			   1000000LL;
+	stream->spill_stop = false;
+
+	if (os_sem_init(&stream->spill_sem, 0) != 0)
+		return;
+
+	if (pthread_create(&stream->spill_thread, NULL, replay_spill_thread,
+			   stream) != 0) {
+		os_sem_destroy(stream->spill_sem);
+		stream->spill_sem = NULL;
+		warn("Failed to create spill thread, keeping the buffer "
+		     "in RAM");
+		return;
+	}
+
+	stream->spill_thread_active = true;
+}
+
 static bool replay_buffer_start(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -702,6 +1258,8 @@ static bool replay_buffer_start(void *data)
 	obs_data_t *s = obs_output_get_settings(stream->output);
 	stream->max_time = obs_data_get_int(s, "max_time_sec") * 1000000LL;
 	stream->max_size = obs_data_get_int(s, "max_size_mb") * (1024 * 1024);
+	if (obs_data_get_bool(s, "spill_to_disk"))
+		start_spill_thread(stream, s);
 	obs_data_release(s);
 
 	os_atomic_set_bool(&stream->active, true);
@@ -712,101 +1270,170 @@ static bool replay_buffer_start(void *data)
 	return true;
 }
 
-static bool purge_front(struct ffmpeg_muxer *stream)
+static void purge_front(struct ffmpeg_muxer *stream)
 {
-	struct encoder_packet pkt;
-	bool keyframe;
+	struct replay_segment *segment = stream->segments.array[0];
 
-	circlebuf_pop_front(&stream->packets, &pkt, sizeof(pkt));
+	pthread_mutex_lock(&stream->segments_mutex);
+	da_erase(stream->segments, 0);
+	pthread_mutex_unlock(&stream->segments_mutex);
 
-	keyframe = pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe;
-
-	if (keyframe)
+	if (segment->keyframe)
 		stream->keyframes--;
+	stream->cur_size -= segment->size;
 
-	if (!stream->packets.size) {
+	if (stream->segments.num) {
+		stream->cur_time =
+			stream->segments.array[0]->packets.array[0].dts_usec;
+	} else {
 		stream->cur_size = 0;
 		stream->cur_time = 0;
-	} else {
-		struct encoder_packet first;
-		circlebuf_peek_front(&stream->packets, &first, sizeof(first));
-		stream->cur_time = first.dts_usec;
-		stream->cur_size -= (int64_t)pkt.size;
+		stream->segment_open = false;
 	}
 
-	obs_encoder_packet_release(&pkt);
-	return keyframe;
+	replay_segment_release(segment);
 }
 
 static inline void purge(struct ffmpeg_muxer *stream)
 {
-	if (purge_front(stream)) {
-		struct encoder_packet pkt;
-
-		for (;;) {
-			circlebuf_peek_front(&stream->packets, &pkt,
-					     sizeof(pkt));
-			if (pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe)
-				return;
+	purge_front(stream);
 
-			purge_front(stream);
-		}
-	}
+	/* the buffer has to start with a keyframe */
+	while (stream->segments.num &&
+	       !stream->segments.array[0]->keyframe)
+		purge_front(stream);
 }
 
 static inline void replay_buffer_purge(struct ffmpeg_muxer *stream,
 				       struct encoder_packet *pkt)
 {
 	if (stream->max_size) {
-		if (!stream->packets.size || stream->keyframes <= 2)
+		if (!stream->segments.num || stream->keyframes <= 2)
 			return;
 
-		while ((stream->cur_size + (int64_t)pkt->size) >
-		       stream->max_size)
+		while (stream->segments.num &&
+		       (stream->cur_size + (int64_t)pkt->size) >
+			       stream->max_size)
 			purge(stream);
 	}
 
-	if (!stream->packets.size || stream->keyframes <= 2)
+	if (!stream->segments.num || stream->keyframes <= 2)
 		return;
 
-	while ((pkt->dts_usec - stream->cur_time) > stream->max_time)
+	while (stream->segments.num &&
+	       (pkt->dts_usec - stream->cur_time) > stream->max_time)
 		purge(stream);
 }
 
-static void insert_packet(struct darray *array, struct encoder_packet *packet,
-			  int64_t video_offset, int64_t *audio_offsets,
-			  int64_t video_dts_offset, int64_t *audio_dts_offsets)
+/* marks the closed segments that fell out of the RAM tail for spilling */
+static void replay_buffer_spill(struct ffmpeg_muxer *stream, int64_t dts_usec)
 {
-	struct encoder_packet pkt;
-	DARRAY(struct encoder_packet) packets;
-	packets.da = *array;
-	size_t idx;
+	bool spill = false;
 
-	obs_encoder_packet_ref(&pkt, packet);
+	pthread_mutex_lock(&stream->segments_mutex);
+	for (size_t i = 0; i + 1 < stream->segments.num; i++) {
+		struct replay_segment *segment = stream->segments.array[i];
+		int64_t start = segment->packets.array[0].dts_usec;
 
-	if (pkt.type == OBS_ENCODER_VIDEO) {
-		pkt.dts_usec -= video_offset;
-		pkt.dts -= video_dts_offset;
-		pkt.pts -= video_dts_offset;
-	} else {
-		pkt.dts_usec -= audio_offsets[pkt.track_idx];
-		pkt.dts -= audio_dts_offsets[pkt.track_idx];
-		pkt.pts -= audio_dts_offsets[pkt.track_idx];
+		if (dts_usec - start <= stream->ram_tail)
+			break;
+		if (!segment->spill && !segment->spilled) {
+			segment->spill = true;
+			spill = true;
+		}
 	}
+	pthread_mutex_unlock(&stream->segments_mutex);
 
-	for (idx = packets.num; idx > 0; idx--) {
-		struct encoder_packet *p = packets.array + (idx - 1);
-		if (p->dts_usec < pkt.dts_usec)
-			break;
+	if (spill)
+		os_sem_post(stream->spill_sem);
+}
+
+/* references the packets of a segment, or reads them back from disk, with
+ * the timestamps offset to start at zero */
+static bool get_segment_packets(struct ffmpeg_muxer *stream,
+				struct replay_segment *segment,
+				int64_t video_offset, int64_t *audio_offsets,
+				int64_t video_dts_offset,
+				int64_t *audio_dts_offsets, bool *spilled)
+{
+	stream->mux_packets.num = 0;
+
+	pthread_mutex_lock(&stream->segments_mutex);
+	*spilled = segment->spilled;
+	for (size_t i = 0; i < segment->packets.num; i++) {
+		struct encoder_packet *pkt =
+			da_push_back_new(stream->mux_packets);
+
+		if (*spilled)
+			*pkt = segment->packets.array[i];
+		else
+			obs_encoder_packet_ref(pkt, &segment->packets.array[i]);
+	}
+	pthread_mutex_unlock(&stream->segments_mutex);
+
+	if (*spilled) {
+		FILE *file = os_fopen(segment->path.array, "rb");
+		size_t offset = 0;
+		bool success;
+
+		da_resize(stream->spill_buffer, (size_t)segment->size);
+		success = file && fread(stream->spill_buffer.array, 1,
+					stream->spill_buffer.num,
+					file) == stream->spill_buffer.num;
+		if (file)
+			fclose(file);
+		if (!success) {
+			warn("Failed to read replay buffer segment '%s'",
+			     segment->path.array);
+			return false;
+		}
+
+		for (size_t i = 0; i < stream->mux_packets.num; i++) {
+			struct encoder_packet *pkt =
+				&stream->mux_packets.array[i];
+			pkt->data = stream->spill_buffer.array + offset;
+			offset += pkt->size;
+		}
+	}
+
+	for (size_t i = 0; i < stream->mux_packets.num; i++) {
+		struct encoder_packet pkt = stream->mux_packets.array[i];
+		size_t idx;
+
+		if (pkt.type == OBS_ENCODER_VIDEO) {
+			pkt.dts_usec -= video_offset;
+			pkt.dts -= video_dts_offset;
+			pkt.pts -= video_dts_offset;
+		} else {
+			pkt.dts_usec -= audio_offsets[pkt.track_idx];
+			pkt.dts -= audio_dts_offsets[pkt.track_idx];
+			pkt.pts -= audio_dts_offsets[pkt.track_idx];
+		}
+
+		/* audio and video offsets differ slightly, reorder */
+		for (idx = i; idx > 0; idx--) {
+			struct encoder_packet *p =
+				&stream->mux_packets.array[idx - 1];
+			if (p->dts_usec < pkt.dts_usec)
+				break;
+			stream->mux_packets.array[idx] = *p;
+		}
+		stream->mux_packets.array[idx] = pkt;
 	}
 
-	da_insert(packets, idx, &pkt);
-	*array = packets.da;
+	return true;
 }
 
 static void *replay_buffer_mux_thread(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
+	bool found_video = false;
+	bool found_audio[MAX_AUDIO_MIXES] = {0};
+	int64_t video_offset = 0;
+	int64_t video_dts_offset = 0;
+	int64_t audio_offsets[MAX_AUDIO_MIXES] = {0};
+	int64_t audio_dts_offsets[MAX_AUDIO_MIXES] = {0};
+	size_t i;
 
 	start_pipe(stream, stream->path.array);
 
@@ -821,60 +1448,79 @@ static void *replay_buffer_mux_thread(void *data)
 		goto error;
 	}
 
-	for (size_t i = 0; i < stream->mux_packets.num; i++) {
-		struct encoder_packet *pkt = &stream->mux_packets.array[i];
-		write_packet(stream, pkt);
-		obs_encoder_packet_release(pkt);
+	/* offsets are taken from the first packet of every track */
+	for (i = 0; i < stream->save_segments.num; i++) {
+		struct replay_segment *segment = stream->save_segments.array[i];
+
+		for (size_t j = 0; j < segment->packets.num; j++) {
+			struct encoder_packet *pkt = &segment->packets.array[j];
+
+			if (pkt->type == OBS_ENCODER_VIDEO) {
+				if (!found_video) {
+					video_offset = pkt->dts_usec;
+					video_dts_offset = pkt->dts;
+					found_video = true;
+				}
+			} else if (!found_audio[pkt->track_idx]) {
+				found_audio[pkt->track_idx] = true;
+				audio_offsets[pkt->track_idx] = pkt->dts_usec;
+				audio_dts_offsets[pkt->track_idx] = pkt->dts;
+			}
+		}
 	}
 
-	info("Wrote replay buffer to '%s'", stream->path.array);
+	/* stream the segments one at a time */
+	for (i = 0; i < stream->save_segments.num; i++) {
+		struct replay_segment *segment = stream->save_segments.array[i];
+		bool spilled;
+		bool success;
+
+		if (!get_segment_packets(stream, segment, video_offset,
+					 audio_offsets, video_dts_offset,
+					 audio_dts_offsets, &spilled))
+			break;
+
+		success = true;
+		for (size_t j = 0; j < stream->mux_packets.num; j++) {
+			struct encoder_packet *pkt =
+				&stream->mux_packets.array[j];
+			if (success)
+				success = write_packet(stream, pkt);
+			if (!spilled)
+				obs_encoder_packet_release(pkt);
+		}
+
+		replay_segment_release(segment);
+		if (!success)
+			break;
+	}
+
+	if (i == stream->save_segments.num)
+		info("Wrote replay buffer to '%s'", stream->path.array);
 
 error:
+	for (; i < stream->save_segments.num; i++)
+		replay_segment_release(stream->save_segments.array[i]);
+
 	os_process_pipe_destroy(stream->pipe);
 	stream->pipe = NULL;
+	da_free(stream->save_segments);
 	da_free(stream->mux_packets);
+	da_free(stream->spill_buffer);
 	os_atomic_set_bool(&stream->muxing, false);
 	return NULL;
 }
 
 static void replay_buffer_save(struct ffmpeg_muxer *stream)
 {
-	const size_t size = sizeof(struct encoder_packet);
-	size_t num_packets = stream->packets.size / size;
-
-	da_reserve(stream->mux_packets, num_packets);
-
-	/* ---------------------------- */
-	/* reorder packets */
-
-	bool found_video = false;
-	bool found_audio[MAX_AUDIO_MIXES] = {0};
-	int64_t video_offset = 0;
-	int64_t video_dts_offset = 0;
-	int64_t audio_offsets[MAX_AUDIO_MIXES] = {0};
-	int64_t audio_dts_offsets[MAX_AUDIO_MIXES] = {0};
+	/* the segment being filled is closed, so that it can be saved */
+	stream->segment_open = false;
 
-	for (size_t i = 0; i < num_packets; i++) {
-		struct encoder_packet *pkt;
-		pkt = circlebuf_data(&stream->packets, i * size);
+	for (size_t i = 0; i < stream->segments.num; i++) {
+		struct replay_segment *segment = stream->segments.array[i];
 
-		if (pkt->type == OBS_ENCODER_VIDEO) {
-			if (!found_video) {
-				video_offset = pkt->dts_usec;
-				video_dts_offset = pkt->dts;
-				found_video = true;
-			}
-		} else {
-			if (!found_audio[pkt->track_idx]) {
-				found_audio[pkt->track_idx] = true;
-				audio_offsets[pkt->track_idx] = pkt->dts_usec;
-				audio_dts_offsets[pkt->track_idx] = pkt->dts;
-			}
-		}
-
-		insert_packet(&stream->mux_packets.da, pkt, video_offset,
-			      audio_offsets, video_dts_offset,
-			      audio_dts_offsets);
+		os_atomic_inc_long(&segment->refs);
+		da_push_back(stream->save_segments, &segment);
 	}
 
 	/* ---------------------------- */
@@ -930,6 +1576,7 @@ static void replay_buffer_data(void *data, struct encoder_packet *packet)
 {
 	struct ffmpeg_muxer *stream = data;
 	struct encoder_packet pkt;
+	bool keyframe;
 
 	if (!active(stream))
 		return;
@@ -950,14 +1597,32 @@ static void replay_buffer_data(void *data, struct encoder_packet *packet)
 	obs_encoder_packet_ref(&pkt, packet);
 	replay_buffer_purge(stream, &pkt);
 
-	if (!stream->packets.size)
+	keyframe = pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe;
+
+	if (keyframe || !stream->segment_open) {
+		struct replay_segment *segment = bzalloc(sizeof(*segment));
+		segment->refs = 1;
+		segment->keyframe = keyframe;
+
+		pthread_mutex_lock(&stream->segments_mutex);
+		da_push_back(stream->segments, &segment);
+		pthread_mutex_unlock(&stream->segments_mutex);
+
+		stream->segment_open = true;
+		if (keyframe)
+			stream->keyframes++;
+		if (stream->spill_thread_active)
+			replay_buffer_spill(stream, pkt.dts_usec);
+	}
+
+	if (stream->cur_size == 0)
 		stream->cur_time = pkt.dts_usec;
 	stream->cur_size += pkt.size;
 
-	circlebuf_push_back(&stream->packets, packet, sizeof(*packet));
-
-	if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe)
-		stream->keyframes++;
+	struct replay_segment *segment =
+		stream->segments.array[stream->segments.num - 1];
+	segment->size += pkt.size;
+	da_push_back(segment->packets, &pkt);
 
 	if (stream->save_ts && packet->sys_dts_usec >= stream->save_ts) {
 		if (os_atomic_load_bool(&stream->muxing))
@@ -980,6 +1645,8 @@ static void replay_buffer_defaults(obs_data_t *s)
 	obs_data_set_default_string(s, "format", "%CCYY-%MM-%DD %hh-%mm-%ss");
 	obs_data_set_default_string(s, "extension", "mp4");
 	obs_data_set_default_bool(s, "allow_spaces", true);
+	obs_data_set_default_bool(s, "spill_to_disk", false);
+	obs_data_set_default_int(s, "ram_tail_sec", 10);
 }
 
 struct obs_output_info replay_buffer = {
@@ -422,6 +422,16 @@ static bool vaapi_encode(void *data, struct encoder_frame *frame,
 	copy_data(enc->vframe, frame, enc->height, enc->context->pix_fmt);
 
 	enc->vframe->pts = frame->pts;
+	/* the vaapi encoders start a new IDR frame for forced I frames,
+	 * both are copied to the hw frame with the other props below */
+	enc->vframe->pict_type = frame->force_keyframe ? AV_PICTURE_TYPE_I
+						       : AV_PICTURE_TYPE_NONE;
+#ifdef AV_FRAME_FLAG_KEY
+	if (frame->force_keyframe)
+		enc->vframe->flags |= AV_FRAME_FLAG_KEY;
+	else
+		enc->vframe->flags &= ~AV_FRAME_FLAG_KEY;
+#endif
 	hwframe->pts = frame->pts;
 	hwframe->width = enc->vframe->width;
 	hwframe->height = enc->vframe->height;
@@ -3,6 +3,7 @@
 #include <graphics/vec4.h>
 #include <graphics/image-file.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include <util/dstr.h>
 #include <sys/stat.h>
 
@@ -33,6 +34,8 @@ struct mask_filter_data {
 	char *image_file;
 	time_t image_file_timestamp;
 	float update_time_elapsed;
+	os_file_watch_t *file_watch;
+	volatile bool file_changed;
 
 	gs_texture_t *target;
 	gs_image_file_t image;
@@ -80,6 +83,12 @@ static void mask_filter_image_load(struct mask_filter_data *filter)
 	}
 }
 
+static void mask_filter_file_changed(void *data)
+{
+	struct mask_filter_data *filter = data;
+	os_atomic_set_bool(&filter->file_changed, true);
+}
+
 static void mask_filter_update(void *data, obs_data_t *settings)
 {
 	struct mask_filter_data *filter = data;
@@ -90,6 +99,15 @@ static void mask_filter_update(void *data, obs_data_t *settings)
 	int opacity = (int)obs_data_get_int(settings, SETTING_OPACITY);
 	char *effect_path;
 
+	if (!filter->image_file || strcmp(filter->image_file, path) != 0) {
+		os_file_watch_destroy(filter->file_watch);
+		filter->file_watch =
+			*path ? os_file_watch_create(path,
+						     mask_filter_file_changed,
+						     filter)
+			      : NULL;
+	}
+
 	if (filter->image_file)
 		bfree(filter->image_file);
 	filter->image_file = bstrdup(path);
@@ -179,6 +197,8 @@ static void mask_filter_destroy(void *data)
 {
 	struct mask_filter_data *filter = data;
 
+	os_file_watch_destroy(filter->file_watch);
+
 	if (filter->image_file)
 		bfree(filter->image_file);
 
@@ -193,9 +213,16 @@ static void mask_filter_destroy(void *data)
 static void mask_filter_tick(void *data, float seconds)
 {
 	struct mask_filter_data *filter = data;
+	float interval = filter->file_watch ? 5.0f : 1.0f;
 	filter->update_time_elapsed += seconds;
 
-	if (filter->update_time_elapsed >= 1.0f) {
+	/* watched files are still polled now and then, the watch misses
+	 * changes to symlink targets and on network file systems */
+	if (filter->file_watch &&
+	    os_atomic_set_bool(&filter->file_changed, false)) {
+		mask_filter_image_load(filter);
+
+	} else if (filter->update_time_elapsed >= interval) {
 		time_t t = get_modified_timestamp(filter->image_file);
 		filter->update_time_elapsed = 0.0f;
 
@@ -6,6 +6,7 @@
 
 #ifdef LIBSPEEXDSP_ENABLED
 #include <speex/speex_preprocess.h>
+#include <media-io/audio-kernels.h>
 #endif
 
 #ifdef LIBRNNOISE_ENABLED
@@ -104,7 +105,6 @@ struct noise_suppress_data {
 #define SUP_MIN -60
 #define SUP_MAX 0
 
-static const float c_32_to_16 = (float)INT16_MAX;
 static const float c_16_to_32 = ((float)INT16_MAX + 1.0f);
 
 /* -------------------------------------------------------- */
@@ -280,15 +280,8 @@ static inline void process_speexdsp(struct noise_suppress_data *ng)
 
 	/* Convert to 16bit */
 	for (size_t i = 0; i < ng->channels; i++)
-		for (size_t j = 0; j < ng->frames; j++) {
-			float s = ng->copy_buffers[i][j];
-			if (s > 1.0f)
-				s = 1.0f;
-			else if (s < -1.0f)
-				s = -1.0f;
-			ng->spx_segment_buffers[i][j] =
-				(spx_int16_t)(s * c_32_to_16);
-		}
+		audio_float_to_s16((int16_t *)ng->spx_segment_buffers[i],
+				   ng->copy_buffers[i], ng->frames);
 
 	/* Execute */
 	for (size_t i = 0; i < ng->channels; i++)
@@ -0,0 +1,235 @@
+#include "NV12FrameBuffer.h"
+
+#include "api/video/i420_buffer.h"
+#include "rtc_base/checks.h"
+#include <libyuv.h>
+
+#include <obs.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+static const size_t kBufferAlignment = 64;
+// Simulcast never has more than this many layers
+static const size_t kMaxLayerSizes = 3;
+
+void NV12LayerSizes::Add(int width, int height)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	std::pair<int, int> size(width, height);
+	if (std::find(sizes_.begin(), sizes_.end(), size) != sizes_.end())
+		return;
+	if (sizes_.size() == kMaxLayerSizes)
+		sizes_.erase(sizes_.begin());
+	sizes_.push_back(size);
+}
+
+std::vector<std::pair<int, int>> NV12LayerSizes::Get()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return sizes_;
+}
+
+NV12FrameBuffer::NV12FrameBuffer(int width, int height)
+	: width_(width),
+	  height_(height),
+	  stride_y_(width),
+	  stride_uv_(width + (width & 1)),
+	  uv_offset_((size_t)stride_y_ * height),
+	  data_(static_cast<uint8_t *>(webrtc::AlignedMalloc(
+		  uv_offset_ + (size_t)stride_uv_ * ((height + 1) / 2),
+		  kBufferAlignment)))
+{
+	RTC_DCHECK_GT(width, 0);
+	RTC_DCHECK_GT(height, 0);
+}
+
+NV12FrameBuffer::~NV12FrameBuffer() {}
+
+void NV12FrameBuffer::CopyFrom(const video_data *frame)
+{
+	uint8_t *dst = data_.get();
+
+	ClearLayers();
+
+	libyuv::CopyPlane(frame->data[0], (int)frame->linesize[0], dst,
+			  stride_y_, width_, height_);
+	libyuv::CopyPlane(frame->data[1], (int)frame->linesize[1],
+			  dst + uv_offset_, stride_uv_, stride_uv_,
+			  (height_ + 1) / 2);
+}
+
+rtc::scoped_refptr<webrtc::I420BufferInterface> NV12FrameBuffer::ToI420()
+{
+	rtc::scoped_refptr<webrtc::I420Buffer> i420 =
+		webrtc::I420Buffer::Create(width_, height_);
+
+	libyuv::NV12ToI420(DataY(), StrideY(), DataUV(), StrideUV(),
+			   i420->MutableDataY(), i420->StrideY(),
+			   i420->MutableDataU(), i420->StrideU(),
+			   i420->MutableDataV(), i420->StrideV(), width_,
+			   height_);
+	return i420;
+}
+
+void NV12FrameBuffer::SetLayers(
+	std::vector<rtc::scoped_refptr<NV12FrameBuffer>> layers,
+	std::shared_ptr<NV12LayerSizes> sizes)
+{
+	layers_ = std::move(layers);
+	layer_sizes_ = std::move(sizes);
+}
+
+void NV12FrameBuffer::ClearLayers()
+{
+	layers_.clear();
+	layer_sizes_.reset();
+}
+
+rtc::scoped_refptr<webrtc::VideoFrameBuffer>
+NV12FrameBuffer::CropAndScale(int offset_x, int offset_y, int crop_width,
+			      int crop_height, int scaled_width,
+			      int scaled_height)
+{
+	// Simulcast may crop a few pixels so that every layer has an even
+	// size: a layer scaled from the whole frame is close enough.
+	bool whole_frame = std::abs(crop_width - width_) <= width_ / 32 &&
+			   std::abs(crop_height - height_) <= height_ / 32;
+
+	if (whole_frame) {
+		for (const auto &layer : layers_) {
+			if (layer->width() == scaled_width &&
+			    layer->height() == scaled_height)
+				return layer;
+		}
+		if (layer_sizes_ && (scaled_width != width_ ||
+				     scaled_height != height_))
+			layer_sizes_->Add(scaled_width, scaled_height);
+	}
+
+	return webrtc::NV12BufferInterface::CropAndScale(
+		offset_x, offset_y, crop_width, crop_height, scaled_width,
+		scaled_height);
+}
+
+NV12FrameBufferPool::NV12FrameBufferPool(size_t max_buffers)
+	: max_buffers_(max_buffers)
+{
+}
+
+rtc::scoped_refptr<NV12FrameBuffer>
+NV12FrameBufferPool::CreateBuffer(int width, int height)
+{
+	rtc::scoped_refptr<NV12FrameBuffer> available;
+
+	// Drop buffers of a previous resolution once nothing references them,
+	// and pick the first free buffer of the requested size. Free buffers
+	// give their simulcast layers back to the layer pools.
+	for (auto it = buffers_.begin(); it != buffers_.end();) {
+		if (!(*it)->HasOneRef()) {
+			++it;
+			continue;
+		}
+
+		(*it)->ClearLayers();
+		if ((*it)->width() != width ||
+			   (*it)->height() != height) {
+			it = buffers_.erase(it);
+		} else {
+			if (!available)
+				available = *it;
+			++it;
+		}
+	}
+
+	if (available)
+		return available;
+
+	if (buffers_.size() >= max_buffers_) {
+		blog(LOG_DEBUG, "NV12 frame pool exhausted (%zu buffers)",
+		     buffers_.size());
+		return nullptr;
+	}
+
+	rtc::scoped_refptr<PooledBuffer> buffer(
+		new PooledBuffer(width, height));
+	buffers_.push_back(buffer);
+	return buffer;
+}
+
+void NV12FrameBufferPool::Release()
+{
+	buffers_.clear();
+}
+
+NV12LayerScaler::NV12LayerScaler(size_t max_buffers)
+	: max_buffers_(max_buffers),
+	  requested_sizes_(std::make_shared<NV12LayerSizes>())
+{
+}
+
+void NV12LayerScaler::SetLayers(const std::vector<double> &scale_down_by)
+{
+	scale_down_by_ = scale_down_by;
+	layers_.clear();
+	requested_sizes_ = std::make_shared<NV12LayerSizes>();
+}
+
+void NV12LayerScaler::Scale(NV12FrameBuffer *frame)
+{
+	// Sizes actually asked for by the encoders win over the nominal ones
+	std::vector<std::pair<int, int>> sizes = requested_sizes_->Get();
+	if (sizes.empty()) {
+		for (double scale : scale_down_by_) {
+			if (scale <= 1.0)
+				continue;
+			int width = (int)(frame->width() / scale) & ~1;
+			int height = (int)(frame->height() / scale) & ~1;
+			if (width > 0 && height > 0)
+				sizes.emplace_back(width, height);
+		}
+	}
+
+	// Largest first, so that each layer is scaled from the previous one
+	std::sort(sizes.begin(), sizes.end(),
+		  [](const std::pair<int, int> &a,
+		     const std::pair<int, int> &b) {
+			  return a.first > b.first;
+		  });
+
+	while (layers_.size() < sizes.size())
+		layers_.emplace_back(new Layer(max_buffers_));
+
+	std::vector<rtc::scoped_refptr<NV12FrameBuffer>> scaled;
+	const NV12FrameBuffer *source = frame;
+
+	for (size_t i = 0; i < sizes.size(); i++) {
+		rtc::scoped_refptr<NV12FrameBuffer> layer =
+			layers_[i]->pool.CreateBuffer(sizes[i].first,
+						      sizes[i].second);
+		if (!layer)
+			continue;
+
+		libyuv::ScalePlane(source->DataY(), source->StrideY(),
+				   source->width(), source->height(),
+				   layer->MutableDataY(), layer->StrideY(),
+				   layer->width(), layer->height(),
+				   libyuv::kFilterBox);
+		libyuv::UVScale(source->DataUV(), source->StrideUV(),
+				source->ChromaWidth(), source->ChromaHeight(),
+				layer->MutableDataUV(), layer->StrideUV(),
+				layer->ChromaWidth(), layer->ChromaHeight(),
+				libyuv::kFilterBox);
+
+		scaled.push_back(layer);
+		source = layer.get();
+	}
+
+	frame->SetLayers(std::move(scaled), requested_sizes_);
+}
+
+void NV12LayerScaler::Release()
+{
+	layers_.clear();
+}
@@ -0,0 +1,122 @@
+#ifndef _OBS_NV12_FRAME_BUFFER_
+#define _OBS_NV12_FRAME_BUFFER_
+
+// lib obs includes
+#include <media-io/video-io.h>
+
+// webrtc includes
+#include <api/scoped_refptr.h>
+#include <api/video/video_frame_buffer.h>
+#include <rtc_base/memory/aligned_malloc.h>
+#include <rtc_base/ref_counted_object.h>
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Layer sizes asked for by the simulcast encoders, learned from the
+// CropAndScale() calls that did not match a pre-scaled layer. Shared by the
+// scaler (video-io thread) and the frames it produces (encoder threads).
+class NV12LayerSizes {
+public:
+	void Add(int width, int height);
+	std::vector<std::pair<int, int>> Get();
+
+private:
+	std::mutex mutex_;
+	std::vector<std::pair<int, int>> sizes_;
+};
+
+// Native NV12 frame buffer filled straight from the planes handed out by
+// video-io, so frames reach the encoder without a colorspace conversion.
+// Encoders that only understand I420 still get one through ToI420().
+class NV12FrameBuffer : public webrtc::NV12BufferInterface {
+public:
+	NV12FrameBuffer(int width, int height);
+	~NV12FrameBuffer() override;
+
+	// Copy both planes of an OBS NV12 frame, honoring its line sizes.
+	void CopyFrom(const video_data *frame);
+
+	uint8_t *MutableDataY() { return data_.get(); }
+	uint8_t *MutableDataUV() { return data_.get() + uv_offset_; }
+
+	// Downscaled copies of this frame, handed out by CropAndScale() to the
+	// simulcast encoders instead of scaling again for every layer.
+	void SetLayers(std::vector<rtc::scoped_refptr<NV12FrameBuffer>> layers,
+		       std::shared_ptr<NV12LayerSizes> sizes);
+	void ClearLayers();
+
+	int width() const override { return width_; }
+	int height() const override { return height_; }
+
+	const uint8_t *DataY() const override { return data_.get(); }
+	const uint8_t *DataUV() const override
+	{
+		return data_.get() + uv_offset_;
+	}
+	int StrideY() const override { return stride_y_; }
+	int StrideUV() const override { return stride_uv_; }
+
+	rtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override;
+	rtc::scoped_refptr<webrtc::VideoFrameBuffer>
+	CropAndScale(int offset_x, int offset_y, int crop_width,
+		     int crop_height, int scaled_width,
+		     int scaled_height) override;
+
+private:
+	std::vector<rtc::scoped_refptr<NV12FrameBuffer>> layers_;
+	std::shared_ptr<NV12LayerSizes> layer_sizes_;
+
+	const int width_;
+	const int height_;
+	const int stride_y_;
+	const int stride_uv_;
+	const size_t uv_offset_;
+	const std::unique_ptr<uint8_t, webrtc::AlignedFreeDeleter> data_;
+};
+
+// Recycles NV12 buffers once the encoder has released them, so the video-io
+// thread does not allocate a new frame every tick. Buffers are handed out
+// from the video-io thread only.
+class NV12FrameBufferPool {
+public:
+	explicit NV12FrameBufferPool(size_t max_buffers);
+
+	// Returns nullptr when every buffer is still held downstream.
+	rtc::scoped_refptr<NV12FrameBuffer> CreateBuffer(int width, int height);
+	void Release();
+
+private:
+	using PooledBuffer = rtc::RefCountedObject<NV12FrameBuffer>;
+
+	const size_t max_buffers_;
+	std::vector<rtc::scoped_refptr<PooledBuffer>> buffers_;
+};
+
+// Produces the lower simulcast layers of a frame once, each one scaled
+// (libyuv, SIMD) from the smallest already produced layer that is still
+// larger, and attaches them to the frame.
+class NV12LayerScaler {
+public:
+	explicit NV12LayerScaler(size_t max_buffers);
+
+	// Resolution divisors of the lower layers, e.g. {2.0, 4.0}
+	void SetLayers(const std::vector<double> &scale_down_by);
+	void Scale(NV12FrameBuffer *frame);
+	void Release();
+
+private:
+	struct Layer {
+		explicit Layer(size_t max_buffers) : pool(max_buffers) {}
+		NV12FrameBufferPool pool;
+	};
+
+	const size_t max_buffers_;
+	std::vector<double> scale_down_by_;
+	std::vector<std::unique_ptr<Layer>> layers_;
+	std::shared_ptr<NV12LayerSizes> requested_sizes_;
+};
+
+#endif
@@ -0,0 +1,291 @@
+#include "ObsVideoEncoderFactory.h"
+
+#include "absl/strings/match.h"
+#include "api/video/i420_buffer.h"
+#include "api/video_codecs/builtin_video_encoder_factory.h"
+#include "media/base/media_constants.h"
+#include "modules/video_coding/include/video_error_codes.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#define debug(format, ...) blog(LOG_DEBUG, format, ##__VA_ARGS__)
+#define info(format, ...) blog(LOG_INFO, format, ##__VA_ARGS__)
+#define warn(format, ...) blog(LOG_WARNING, format, ##__VA_ARGS__)
+
+// Bitrate changes smaller than this (in percent) are not sent to the OBS
+// encoder, reconfiguring it on every estimate update is not worth it.
+#define BITRATE_UPDATE_THRESHOLD 5
+
+EncodedFrameBuffer::EncodedFrameBuffer(
+	int width, int height, bool keyframe,
+	rtc::scoped_refptr<webrtc::EncodedImageBuffer> data)
+	: width_(width), height_(height), keyframe_(keyframe), data_(data)
+{
+}
+
+rtc::scoped_refptr<webrtc::I420BufferInterface> EncodedFrameBuffer::ToI420()
+{
+	// Only reached if something downstream insists on raw pixels
+	rtc::scoped_refptr<webrtc::I420Buffer> buffer =
+		webrtc::I420Buffer::Create(width_, height_);
+	webrtc::I420Buffer::SetBlack(buffer);
+	return buffer;
+}
+
+void ObsEncoderHandle::Set(obs_encoder_t *encoder, int max_bitrate_kbps)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// Leave the encoder with the bitrate the user configured
+	if (encoder_ && current_bitrate_kbps_ != max_bitrate_kbps_)
+		ApplyBitrate(max_bitrate_kbps_);
+
+	encoder_ = encoder;
+	max_bitrate_kbps_ = max_bitrate_kbps;
+	current_bitrate_kbps_ = max_bitrate_kbps;
+	shared_ = false;
+}
+
+bool ObsEncoderHandle::IsSet()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return encoder_ != nullptr;
+}
+
+void ObsEncoderHandle::RequestKeyframe()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (encoder_)
+		obs_encoder_request_keyframe(encoder_);
+}
+
+void ObsEncoderHandle::SetBitrate(uint32_t bitrate_kbps)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!encoder_ || !bitrate_kbps)
+		return;
+
+	// The encoder may also be recording (or feeding another output),
+	// which must keep the bitrate the user configured
+	bool shared = obs_encoder_get_num_consumers(encoder_) > 1;
+	if (shared != shared_) {
+		info("OBS encoder '%s' is %s, %s bitrate adaptation",
+		     obs_encoder_get_name(encoder_),
+		     shared ? "shared with another output" : "no longer shared",
+		     shared ? "pausing" : "resuming");
+		shared_ = shared;
+	}
+	if (shared) {
+		if (current_bitrate_kbps_ != max_bitrate_kbps_)
+			ApplyBitrate(max_bitrate_kbps_);
+		return;
+	}
+
+	int bitrate = std::min((int)bitrate_kbps, max_bitrate_kbps_);
+	int delta = std::abs(bitrate - current_bitrate_kbps_);
+	if (bitrate != max_bitrate_kbps_ &&
+	    delta * 100 < current_bitrate_kbps_ * BITRATE_UPDATE_THRESHOLD)
+		return;
+	if (bitrate == current_bitrate_kbps_)
+		return;
+
+	ApplyBitrate(bitrate);
+}
+
+void ObsEncoderHandle::ApplyBitrate(int bitrate_kbps)
+{
+	debug("OBS encoder '%s' bitrate: %d kbps",
+	      obs_encoder_get_name(encoder_), bitrate_kbps);
+
+	obs_data_t *settings = obs_data_create();
+	obs_data_set_int(settings, "bitrate", bitrate_kbps);
+	obs_encoder_update(encoder_, settings);
+	obs_data_release(settings);
+
+	current_bitrate_kbps_ = bitrate_kbps;
+}
+
+ObsVideoEncoder::ObsVideoEncoder(std::shared_ptr<ObsEncoderHandle> handle,
+				 const webrtc::SdpVideoFormat &format)
+	: handle_(handle),
+	  packetization_mode_(webrtc::H264PacketizationMode::SingleNalUnit)
+{
+	auto it = format.parameters.find(cricket::kH264FmtpPacketizationMode);
+	if (it != format.parameters.end() && it->second == "1")
+		packetization_mode_ =
+			webrtc::H264PacketizationMode::NonInterleaved;
+}
+
+ObsVideoEncoder::~ObsVideoEncoder() {}
+
+int32_t ObsVideoEncoder::InitEncode(const webrtc::VideoCodec *codec_settings,
+				    const webrtc::VideoEncoder::Settings &)
+{
+	if (!codec_settings ||
+	    codec_settings->codecType != webrtc::kVideoCodecH264)
+		return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
+
+	info("OBS pass-through encoder: %dx%d", codec_settings->width,
+	     codec_settings->height);
+
+	// Decoding can only start at a keyframe
+	waiting_for_keyframe_ = true;
+	has_last_frame_id_ = false;
+	handle_->RequestKeyframe();
+	return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t ObsVideoEncoder::RegisterEncodeCompleteCallback(
+	webrtc::EncodedImageCallback *callback)
+{
+	callback_ = callback;
+	return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t ObsVideoEncoder::Release()
+{
+	callback_ = nullptr;
+	return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t
+ObsVideoEncoder::Encode(const webrtc::VideoFrame &frame,
+			const std::vector<webrtc::VideoFrameType> *frame_types)
+{
+	if (!callback_)
+		return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+
+	rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer =
+		frame.video_frame_buffer();
+	if (buffer->type() != webrtc::VideoFrameBuffer::Type::kNative) {
+		warn("OBS pass-through encoder received a raw frame");
+		return WEBRTC_VIDEO_CODEC_ERROR;
+	}
+
+	const EncodedFrameBuffer *encoded =
+		static_cast<const EncodedFrameBuffer *>(buffer.get());
+
+	if (frame_types &&
+	    std::find(frame_types->begin(), frame_types->end(),
+		      webrtc::VideoFrameType::kVideoFrameKey) !=
+		    frame_types->end())
+		handle_->RequestKeyframe();
+
+	// A delta frame following one that was dropped on the way (by the
+	// frame dropper or while the encoder was paused) cannot be decoded:
+	// skip until the requested keyframe arrives.
+	bool gap = has_last_frame_id_ &&
+		   frame.id() != (uint16_t)(last_frame_id_ + 1);
+	has_last_frame_id_ = true;
+	last_frame_id_ = frame.id();
+
+	if (encoded->keyframe()) {
+		waiting_for_keyframe_ = false;
+	} else if (waiting_for_keyframe_ || gap) {
+		if (!waiting_for_keyframe_)
+			handle_->RequestKeyframe();
+		waiting_for_keyframe_ = true;
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+
+	webrtc::EncodedImage image;
+	image.SetEncodedData(encoded->data());
+	image._encodedWidth = encoded->width();
+	image._encodedHeight = encoded->height();
+	image._frameType = encoded->keyframe()
+				   ? webrtc::VideoFrameType::kVideoFrameKey
+				   : webrtc::VideoFrameType::kVideoFrameDelta;
+	image.SetTimestamp(frame.timestamp());
+	image.ntp_time_ms_ = frame.ntp_time_ms();
+	image.capture_time_ms_ = frame.render_time_ms();
+	image.rotation_ = frame.rotation();
+	image.content_type_ = webrtc::VideoContentType::UNSPECIFIED;
+	image.timing_.flags = webrtc::VideoSendTiming::kInvalid;
+
+	webrtc::CodecSpecificInfo codec_info;
+	codec_info.codecType = webrtc::kVideoCodecH264;
+	codec_info.codecSpecific.H264.packetization_mode = packetization_mode_;
+	codec_info.codecSpecific.H264.temporal_idx = webrtc::kNoTemporalIdx;
+	codec_info.codecSpecific.H264.idr_frame = encoded->keyframe();
+	codec_info.codecSpecific.H264.base_layer_sync = false;
+
+	webrtc::EncodedImageCallback::Result result =
+		callback_->OnEncodedImage(image, &codec_info);
+	if (result.error != webrtc::EncodedImageCallback::Result::OK)
+		return WEBRTC_VIDEO_CODEC_ERROR;
+
+	return WEBRTC_VIDEO_CODEC_OK;
+}
+
+void ObsVideoEncoder::SetRates(const RateControlParameters &parameters)
+{
+	handle_->SetBitrate(parameters.bitrate.get_sum_kbps());
+}
+
+webrtc::VideoEncoder::EncoderInfo ObsVideoEncoder::GetEncoderInfo() const
+{
+	EncoderInfo info;
+	info.implementation_name = "OBS";
+	// Frames are already encoded: no scaling, no rate control, no drops
+	info.supports_native_handle = true;
+	info.has_trusted_rate_controller = true;
+	info.scaling_settings = VideoEncoder::ScalingSettings::kOff;
+	return info;
+}
+
+static webrtc::SdpVideoFormat CreateH264Format(const char *profile_level_id)
+{
+	return webrtc::SdpVideoFormat(
+		cricket::kH264CodecName,
+		{{cricket::kH264FmtpProfileLevelId, profile_level_id},
+		 {cricket::kH264FmtpLevelAsymmetryAllowed, "1"},
+		 {cricket::kH264FmtpPacketizationMode, "1"}});
+}
+
+ObsVideoEncoderFactory::ObsVideoEncoderFactory()
+	: builtin_(webrtc::CreateBuiltinVideoEncoderFactory()),
+	  handle_(std::make_shared<ObsEncoderHandle>())
+{
+}
+
+ObsVideoEncoderFactory::~ObsVideoEncoderFactory()
+{
+	handle_->Set(nullptr, 0);
+}
+
+std::vector<webrtc::SdpVideoFormat>
+ObsVideoEncoderFactory::GetSupportedFormats() const
+{
+	std::vector<webrtc::SdpVideoFormat> formats =
+		builtin_->GetSupportedFormats();
+
+	// libwebrtc may be built without H.264, OBS encoders still produce it
+	bool has_h264 = std::any_of(
+		formats.begin(), formats.end(),
+		[](const webrtc::SdpVideoFormat &format) {
+			return absl::EqualsIgnoreCase(format.name,
+						      cricket::kH264CodecName);
+		});
+	if (!has_h264) {
+		formats.push_back(CreateH264Format("42e01f"));
+		formats.push_back(CreateH264Format("42001f"));
+	}
+	return formats;
+}
+
+std::unique_ptr<webrtc::VideoEncoder>
+ObsVideoEncoderFactory::CreateVideoEncoder(const webrtc::SdpVideoFormat &format)
+{
+	if (handle_->IsSet() &&
+	    absl::EqualsIgnoreCase(format.name, cricket::kH264CodecName))
+		return std::make_unique<ObsVideoEncoder>(handle_, format);
+
+	return builtin_->CreateVideoEncoder(format);
+}
+
+void ObsVideoEncoderFactory::SetObsEncoder(obs_encoder_t *encoder,
+					   int max_bitrate_kbps)
+{
+	handle_->Set(encoder, max_bitrate_kbps);
+}
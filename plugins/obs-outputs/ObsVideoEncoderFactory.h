@@ -0,0 +1,119 @@
+#ifndef _OBS_VIDEO_ENCODER_FACTORY_H_
+#define _OBS_VIDEO_ENCODER_FACTORY_H_
+
+// lib obs includes
+#include "obs.h"
+
+// webrtc includes
+#include "api/video/encoded_image.h"
+#include "api/video/video_frame_buffer.h"
+#include "api/video_codecs/sdp_video_format.h"
+#include "api/video_codecs/video_encoder.h"
+#include "api/video_codecs/video_encoder_factory.h"
+#include "modules/video_coding/include/video_codec_interface.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Native frame buffer carrying a packet already encoded by an OBS encoder.
+// It goes through the video track like a raw frame, so RTP timestamps,
+// pacing and stats keep working, and is unwrapped by ObsVideoEncoder.
+class EncodedFrameBuffer : public webrtc::VideoFrameBuffer {
+public:
+	EncodedFrameBuffer(
+		int width, int height, bool keyframe,
+		rtc::scoped_refptr<webrtc::EncodedImageBuffer> data);
+
+	Type type() const override { return Type::kNative; }
+	int width() const override { return width_; }
+	int height() const override { return height_; }
+	rtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override;
+
+	bool keyframe() const { return keyframe_; }
+	rtc::scoped_refptr<webrtc::EncodedImageBuffer> data() const
+	{
+		return data_;
+	}
+
+private:
+	const int width_;
+	const int height_;
+	const bool keyframe_;
+	const rtc::scoped_refptr<webrtc::EncodedImageBuffer> data_;
+};
+
+// The OBS encoder the packets come from, shared by the factory and the
+// encoders it creates. Bitrate changes asked for by the congestion
+// controller are applied to it, capped to the bitrate set by the user,
+// only while no other output uses the encoder. The user's bitrate is put
+// back when the stream stops or another output starts using it.
+class ObsEncoderHandle {
+public:
+	void Set(obs_encoder_t *encoder, int max_bitrate_kbps);
+	bool IsSet();
+
+	void RequestKeyframe();
+	void SetBitrate(uint32_t bitrate_kbps);
+
+private:
+	void ApplyBitrate(int bitrate_kbps);
+
+	std::mutex mutex_;
+	obs_encoder_t *encoder_ = nullptr;
+	int max_bitrate_kbps_ = 0;
+	int current_bitrate_kbps_ = 0;
+	bool shared_ = false;
+};
+
+// Pass-through encoder: forwards the OBS encoder packets found in
+// EncodedFrameBuffer frames to the RTP packetizer, and relays keyframe
+// requests (PLI/FIR) and bitrate estimates back to the OBS encoder.
+class ObsVideoEncoder : public webrtc::VideoEncoder {
+public:
+	ObsVideoEncoder(std::shared_ptr<ObsEncoderHandle> handle,
+			const webrtc::SdpVideoFormat &format);
+	~ObsVideoEncoder() override;
+
+	int32_t InitEncode(const webrtc::VideoCodec *codec_settings,
+			   const webrtc::VideoEncoder::Settings &settings)
+		override;
+	int32_t RegisterEncodeCompleteCallback(
+		webrtc::EncodedImageCallback *callback) override;
+	int32_t Release() override;
+	int32_t Encode(const webrtc::VideoFrame &frame,
+		       const std::vector<webrtc::VideoFrameType> *frame_types)
+		override;
+	void SetRates(const RateControlParameters &parameters) override;
+	EncoderInfo GetEncoderInfo() const override;
+
+private:
+	std::shared_ptr<ObsEncoderHandle> handle_;
+	webrtc::H264PacketizationMode packetization_mode_;
+	webrtc::EncodedImageCallback *callback_ = nullptr;
+	bool waiting_for_keyframe_ = true;
+	bool has_last_frame_id_ = false;
+	uint16_t last_frame_id_ = 0;
+};
+
+// Uses ObsVideoEncoder for H.264 while an OBS encoder is set, and the
+// libwebrtc built-in encoders otherwise.
+class ObsVideoEncoderFactory : public webrtc::VideoEncoderFactory {
+public:
+	ObsVideoEncoderFactory();
+	~ObsVideoEncoderFactory() override;
+
+	std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override;
+	std::unique_ptr<webrtc::VideoEncoder>
+	CreateVideoEncoder(const webrtc::SdpVideoFormat &format) override;
+
+	// Forward packets from this encoder (nullptr to go back to the
+	// built-in encoders). Restores the user's bitrate when unset.
+	void SetObsEncoder(obs_encoder_t *encoder, int max_bitrate_kbps);
+
+private:
+	std::unique_ptr<webrtc::VideoEncoderFactory> builtin_;
+	std::shared_ptr<ObsEncoderHandle> handle_;
+};
+
+#endif
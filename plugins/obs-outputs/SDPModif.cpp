@@ -0,0 +1,501 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "SDPModif.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+static bool equalsIgnoreCase(std::string_view s1, const char *s2)
+{
+	size_t len = strlen(s2);
+	if (s1.size() != len)
+		return false;
+	for (size_t i = 0; i < len; i++) {
+		if (tolower((unsigned char)s1[i]) !=
+		    tolower((unsigned char)s2[i]))
+			return false;
+	}
+	return true;
+}
+
+static bool startsWith(std::string_view s, const char *prefix)
+{
+	return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// Parse the payload type following |prefix| ("a=fmtp:96 ..."). Returns -1
+// for anything else than a number followed by a space or the end of line.
+static int parsePayload(std::string_view line, size_t prefix_len,
+			size_t *value_start)
+{
+	size_t end = line.find(' ', prefix_len);
+	if (end == std::string_view::npos)
+		end = line.size();
+	if (end == prefix_len || end - prefix_len > 3)
+		return -1;
+
+	int payload = 0;
+	for (size_t i = prefix_len; i < end; i++) {
+		if (!isdigit((unsigned char)line[i]))
+			return -1;
+		payload = payload * 10 + (line[i] - '0');
+	}
+
+	*value_start = end < line.size() ? end + 1 : end;
+	return payload;
+}
+
+// candidate:<foundation> <component> <transport> ...
+static bool matchesProtocol(std::string_view candidate,
+			    const std::string &protocol)
+{
+	size_t pos = candidate.find("candidate:");
+	if (pos == std::string_view::npos)
+		return false;
+	pos += 10;
+
+	for (int field = 0; field < 2; field++) {
+		pos = candidate.find(' ', pos);
+		if (pos == std::string_view::npos)
+			return false;
+		pos++;
+	}
+
+	size_t end = candidate.find(' ', pos);
+	if (end == std::string_view::npos)
+		end = candidate.size();
+	return equalsIgnoreCase(candidate.substr(pos, end - pos),
+				protocol.c_str());
+}
+
+const std::string *SDPModif::Codec::param(const char *key) const
+{
+	for (const auto &param : fmtp) {
+		if (equalsIgnoreCase(param.first, key))
+			return &param.second;
+	}
+	return nullptr;
+}
+
+void SDPModif::Codec::setParam(const char *key, const std::string &value)
+{
+	has_fmtp = true;
+	for (auto &param : fmtp) {
+		if (equalsIgnoreCase(param.first, key)) {
+			param.second = value;
+			return;
+		}
+	}
+	fmtp.emplace_back(key, value);
+}
+
+SDPModif::Codec *SDPModif::Media::codec(int payload)
+{
+	Codec *codec = findCodec(payload);
+	if (codec)
+		return codec;
+	codecs.emplace_back();
+	codecs.back().payload = payload;
+	return &codecs.back();
+}
+
+SDPModif::Codec *SDPModif::Media::findCodec(int payload)
+{
+	for (auto &codec : codecs) {
+		if (codec.payload == payload)
+			return &codec;
+	}
+	return nullptr;
+}
+
+const SDPModif::Codec *SDPModif::Media::findCodec(int payload) const
+{
+	return const_cast<Media *>(this)->findCodec(payload);
+}
+
+SDPModif::Codec *SDPModif::Media::findCodec(const char *name)
+{
+	for (auto &codec : codecs) {
+		if (!codec.removed && equalsIgnoreCase(codec.name, name))
+			return &codec;
+	}
+	return nullptr;
+}
+
+SDPModif::SDPModif(const std::string &sdp) : sdp_(sdp)
+{
+	std::string_view text = sdp_;
+	size_t pos = 0;
+
+	while (pos < text.size()) {
+		// Lines end with CR, LF or both. A plain scan is much faster
+		// than find_first_of() on a set of two characters.
+		size_t end = pos;
+		while (end < text.size() && text[end] != '\r' &&
+		       text[end] != '\n')
+			end++;
+		if (end > pos)
+			parseLine(text.substr(pos, end - pos));
+		pos = end + 1;
+	}
+}
+
+void SDPModif::parseLine(std::string_view line)
+{
+	if (startsWith(line, "m=")) {
+		media_.emplace_back();
+		Media &media = media_.back();
+		parseMediaLine(media, line);
+		media.codecs.reserve(media.formats.size());
+		media.lines.reserve(64);
+		return;
+	}
+	if (media_.empty()) {
+		session_.push_back(line);
+		return;
+	}
+
+	Media &media = media_.back();
+	size_t value = 0;
+	int payload;
+
+	if (startsWith(line, "a=rtpmap:") &&
+	    (payload = parsePayload(line, 9, &value)) >= 0) {
+		Codec *codec = media.codec(payload);
+		size_t slash = line.find('/', value);
+		if (slash == std::string_view::npos)
+			slash = line.size();
+		codec->name = line.substr(value, slash - value);
+		codec->clock = line.substr(slash);
+		media.lines.push_back({LineType::Rtpmap, payload, {}});
+	} else if (startsWith(line, "a=fmtp:") &&
+		   (payload = parsePayload(line, 7, &value)) >= 0) {
+		Codec *codec = media.codec(payload);
+		parseFmtp(*codec, line.substr(value));
+		codec->has_fmtp = true;
+		codec->has_fmtp_line = true;
+		media.lines.push_back({LineType::Fmtp, payload, {}});
+	} else if (startsWith(line, "a=rtcp-fb:") &&
+		   (payload = parsePayload(line, 10, &value)) >= 0) {
+		media.lines.push_back({LineType::PayloadAttr, payload, line});
+	} else if (startsWith(line, "b=AS:")) {
+		// atoi stops at the end of line
+		media.bandwidth_as = atoi(line.data() + 5);
+		media.has_bandwidth_line = true;
+		media.lines.push_back({LineType::BandwidthAS, -1, {}});
+	} else {
+		media.lines.push_back({LineType::Raw, -1, line});
+	}
+}
+
+void SDPModif::parseMediaLine(Media &media, std::string_view line)
+{
+	// m=<kind> <port> <proto> <fmt> ...
+	size_t kind_end = line.find(' ', 2);
+	if (kind_end == std::string_view::npos) {
+		media.kind = line.substr(2);
+		return;
+	}
+	media.kind = line.substr(2, kind_end - 2);
+
+	size_t port_end = line.find(' ', kind_end + 1);
+	size_t proto_end = port_end == std::string_view::npos
+				   ? std::string_view::npos
+				   : line.find(' ', port_end + 1);
+	if (proto_end == std::string_view::npos) {
+		media.transport = line.substr(kind_end + 1);
+		return;
+	}
+	media.transport = line.substr(kind_end + 1, proto_end - kind_end - 1);
+
+	size_t pos = proto_end + 1;
+	while (pos < line.size()) {
+		size_t end = line.find(' ', pos);
+		if (end == std::string_view::npos)
+			end = line.size();
+		if (end > pos)
+			media.formats.emplace_back(line.substr(pos, end - pos));
+		pos = end + 1;
+	}
+}
+
+void SDPModif::parseFmtp(Codec &codec, std::string_view params)
+{
+	size_t pos = 0;
+	while (pos < params.size()) {
+		size_t end = params.find(';', pos);
+		if (end == std::string_view::npos)
+			end = params.size();
+
+		size_t first = params.find_first_not_of(' ', pos);
+		if (first != std::string_view::npos && first < end) {
+			std::string_view param =
+				params.substr(first, end - first);
+			size_t eq = param.find('=');
+			if (eq == std::string_view::npos)
+				codec.fmtp.emplace_back(param, "");
+			else
+				codec.fmtp.emplace_back(param.substr(0, eq),
+							param.substr(eq + 1));
+		}
+		pos = end + 1;
+	}
+}
+
+std::string SDPModif::toString() const
+{
+	std::string out;
+	out.reserve(4096);
+
+	for (const auto &line : session_) {
+		out += line;
+		out += "\r\n";
+	}
+	for (const auto &media : media_)
+		writeMedia(out, media);
+	return out;
+}
+
+void SDPModif::writeFmtp(std::string &out, const Codec &codec)
+{
+	out += "a=fmtp:";
+	out += std::to_string(codec.payload);
+	out += " ";
+	for (size_t i = 0; i < codec.fmtp.size(); i++) {
+		if (i)
+			out += ";";
+		out += codec.fmtp[i].first;
+		if (!codec.fmtp[i].second.empty()) {
+			out += "=";
+			out += codec.fmtp[i].second;
+		}
+	}
+	out += "\r\n";
+}
+
+void SDPModif::writeMedia(std::string &out, const Media &media)
+{
+	out += "m=";
+	out += media.kind;
+	if (!media.transport.empty()) {
+		out += " ";
+		out += media.transport;
+	}
+	for (const auto &format : media.formats) {
+		out += " ";
+		out += format;
+	}
+	out += "\r\n";
+
+	// A new b=AS goes right after the c= line, or after the m= line
+	bool add_bandwidth = media.bandwidth_as >= 0 &&
+			     !media.has_bandwidth_line;
+	std::string bandwidth = "b=AS:" + std::to_string(media.bandwidth_as) +
+				"\r\n";
+	if (add_bandwidth &&
+	    (media.lines.empty() || !startsWith(media.lines[0].text, "c=")))
+		out += bandwidth;
+
+	for (size_t i = 0; i < media.lines.size(); i++) {
+		const Line &line = media.lines[i];
+		const Codec *codec = nullptr;
+
+		if (line.payload >= 0) {
+			codec = media.findCodec(line.payload);
+			if (codec && codec->removed)
+				continue;
+		}
+
+		switch (line.type) {
+		case LineType::Rtpmap:
+			out += "a=rtpmap:";
+			out += std::to_string(codec->payload);
+			out += " ";
+			out += codec->name;
+			out += codec->clock;
+			out += "\r\n";
+			if (codec->has_fmtp && !codec->has_fmtp_line)
+				writeFmtp(out, *codec);
+			break;
+		case LineType::Fmtp:
+			writeFmtp(out, *codec);
+			break;
+		case LineType::BandwidthAS:
+			out += bandwidth;
+			break;
+		default:
+			out += line.text;
+			out += "\r\n";
+			break;
+		}
+
+		if (add_bandwidth && i == 0 && startsWith(line.text, "c="))
+			out += bandwidth;
+	}
+}
+
+void SDPModif::forcePayload(std::vector<int> &audio_payload_numbers,
+			    std::vector<int> &video_payload_numbers,
+			    const std::string &audio_codec,
+			    const std::string &video_codec,
+			    int h264_packetization_mode,
+			    const std::string &h264_profile_level_id,
+			    int vp9_profile_id)
+{
+	for (auto &media : media_) {
+		const std::string *codec_name;
+		std::vector<int> *payload_numbers;
+
+		if (media.kind == "audio") {
+			codec_name = &audio_codec;
+			payload_numbers = &audio_payload_numbers;
+		} else if (media.kind == "video") {
+			codec_name = &video_codec;
+			payload_numbers = &video_payload_numbers;
+		} else {
+			continue;
+		}
+
+		std::vector<int> kept;
+		for (const auto &codec : media.codecs) {
+			if (equalsIgnoreCase(codec.name, "rtx"))
+				continue;
+
+			bool keep = codec_name->empty() ||
+				    equalsIgnoreCase(codec.name,
+						     codec_name->c_str());
+			const std::string *value;
+
+			if (keep && equalsIgnoreCase(codec.name, "h264")) {
+				value = codec.param("packetization-mode");
+				if (value && atoi(value->c_str()) !=
+						     h264_packetization_mode)
+					keep = false;
+				value = codec.param("profile-level-id");
+				if (value &&
+				    !equalsIgnoreCase(
+					    *value,
+					    h264_profile_level_id.c_str()))
+					keep = false;
+			} else if (keep &&
+				   equalsIgnoreCase(codec.name, "vp9")) {
+				value = codec.param("profile-id");
+				if (value &&
+				    atoi(value->c_str()) != vp9_profile_id)
+					keep = false;
+			}
+
+			if (keep)
+				kept.push_back(codec.payload);
+		}
+
+		// RTX follows the payload it retransmits
+		for (auto &codec : media.codecs) {
+			bool keep;
+			if (equalsIgnoreCase(codec.name, "rtx")) {
+				const std::string *apt = codec.param("apt");
+				int payload = apt ? atoi(apt->c_str()) : -1;
+				keep = std::find(kept.begin(), kept.end(),
+						 payload) != kept.end();
+			} else {
+				keep = std::find(kept.begin(), kept.end(),
+						 codec.payload) != kept.end();
+			}
+			codec.removed = !keep;
+		}
+
+		std::vector<std::string> formats;
+		for (const auto &format : media.formats) {
+			Codec *codec = media.findCodec(atoi(format.c_str()));
+			if (codec ? !codec->removed : codec_name->empty())
+				formats.push_back(format);
+		}
+		media.formats = std::move(formats);
+
+		payload_numbers->insert(payload_numbers->end(), kept.begin(),
+					kept.end());
+	}
+}
+
+void SDPModif::bitrate(int kbps)
+{
+	for (auto &media : media_) {
+		if (media.kind == "video" && media.bandwidth_as < 0)
+			media.bandwidth_as = kbps;
+	}
+}
+
+void SDPModif::bitrateMaxMin(int kbps,
+			     const std::vector<int> &video_payload_numbers)
+{
+	std::string value = std::to_string(kbps);
+
+	for (auto &media : media_) {
+		if (media.kind != "video")
+			continue;
+
+		media.bandwidth_as = kbps;
+		for (int payload : video_payload_numbers) {
+			Codec *codec = media.findCodec(payload);
+			if (!codec || codec->removed || codec->name.empty())
+				continue;
+			codec->setParam("x-google-min-bitrate", value);
+			codec->setParam("x-google-max-bitrate", value);
+		}
+	}
+}
+
+void SDPModif::stereo(int audio_bitrate)
+{
+	for (auto &media : media_) {
+		if (media.kind != "audio")
+			continue;
+
+		Codec *opus = media.findCodec("opus");
+		if (!opus)
+			continue;
+
+		// Already negotiated by the remote side: leave it as is
+		const std::string *value = opus->param("stereo");
+		if (value && *value == "1")
+			continue;
+
+		if (!opus->has_fmtp) {
+			opus->setParam("minptime", "10");
+			opus->setParam("useinbandfec", "1");
+		}
+		opus->setParam("stereo", "1");
+		opus->setParam("sprop-stereo", "1");
+		opus->setParam("maxplaybackrate", "48000");
+		opus->setParam("sprop-maxcapturerate", "48000");
+
+		if (audio_bitrate > 0) {
+			std::string kbps = std::to_string(audio_bitrate);
+			opus->setParam("maxaveragebitrate",
+				       std::to_string(audio_bitrate * 1024));
+			opus->setParam("x-google-min-bitrate", kbps);
+			opus->setParam("x-google-max-bitrate", kbps);
+		}
+	}
+}
+
+void SDPModif::filterCandidates(const std::string &protocol)
+{
+	for (auto &media : media_) {
+		auto end = std::remove_if(
+			media.lines.begin(), media.lines.end(),
+			[&protocol](const Line &line) {
+				return startsWith(line.text, "a=candidate:") &&
+				       !matchesProtocol(line.text, protocol);
+			});
+		media.lines.erase(end, media.lines.end());
+	}
+}
+
+bool SDPModif::filterIceCandidate(const std::string &candidate,
+				  const std::string &protocol)
+{
+	return matchesProtocol(candidate, protocol);
+}
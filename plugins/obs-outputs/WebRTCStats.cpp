@@ -0,0 +1,143 @@
+#include "WebRTCStats.h"
+
+#include "api/stats/rtcstats_objects.h"
+#include "rtc_base/time_utils.h"
+
+template<typename T>
+static inline T get_value(const webrtc::RTCStatsMember<T> &member)
+{
+	return member.is_defined() ? *member : T();
+}
+
+template<typename T>
+static inline void add_line(std::string &list, const char *name,
+			    const webrtc::RTCStatsMember<T> &member)
+{
+	if (!member.is_defined())
+		return;
+	list += name;
+	list += ":";
+	list += std::to_string(*member);
+	list += "\n";
+}
+
+std::shared_ptr<const WebRTCStats> WebRTCStats::FromReport(
+	const rtc::scoped_refptr<const webrtc::RTCStatsReport> &report,
+	const WebRTCStats *previous)
+{
+	auto stats = std::make_shared<WebRTCStats>();
+	std::string &list = stats->list;
+
+	stats->timestamp_us = rtc::TimeMicros();
+
+	// RTCDataChannelStats
+	for (const auto *stat :
+	     report->GetStatsOfType<webrtc::RTCDataChannelStats>()) {
+		add_line(list, "data_messages_sent", stat->messages_sent);
+		add_line(list, "data_bytes_sent", stat->bytes_sent);
+		add_line(list, "data_messages_received",
+			 stat->messages_received);
+		add_line(list, "data_bytes_received", stat->bytes_received);
+	}
+
+	// RTCMediaStreamTrackStats
+	for (const auto *stat :
+	     report->GetStatsOfType<webrtc::RTCMediaStreamTrackStats>()) {
+		if (get_value(stat->kind) == "audio") {
+			add_line(list, "track_audio_level", stat->audio_level);
+			add_line(list, "track_total_audio_energy",
+				 stat->total_audio_energy);
+			add_line(list, "track_total_samples_duration",
+				 stat->total_samples_duration);
+		} else if (get_value(stat->kind) == "video") {
+			stats->frame_width = get_value(stat->frame_width);
+			stats->frame_height = get_value(stat->frame_height);
+			stats->frames_sent = get_value(stat->frames_sent);
+			stats->huge_frames_sent =
+				get_value(stat->huge_frames_sent);
+
+			add_line(list, "track_frame_width", stat->frame_width);
+			add_line(list, "track_frame_height",
+				 stat->frame_height);
+			add_line(list, "track_frames_sent", stat->frames_sent);
+			add_line(list, "track_huge_frames_sent",
+				 stat->huge_frames_sent);
+		}
+	}
+
+	// FPS = frames sent since the previous report / elapsed time
+	if (previous && previous->timestamp_us &&
+	    stats->frames_sent >= previous->frames_sent) {
+		double elapsed = (double)(stats->timestamp_us -
+					  previous->timestamp_us) /
+				 rtc::kNumMicrosecsPerSec;
+		if (elapsed > 0.0)
+			stats->fps = (stats->frames_sent -
+				      previous->frames_sent) /
+				     elapsed;
+	}
+	list += "track_fps:" + std::to_string(stats->fps) + "\n";
+
+	// RTCOutboundRTPStreamStats
+	for (const auto *stat :
+	     report->GetStatsOfType<webrtc::RTCOutboundRTPStreamStats>()) {
+		if (get_value(stat->kind) == "audio") {
+			stats->audio_bytes_sent += get_value(stat->bytes_sent);
+			stats->audio_packets_sent +=
+				get_value(stat->packets_sent);
+
+			add_line(list, "outbound_audio_packets_sent",
+				 stat->packets_sent);
+			add_line(list, "outbound_audio_bytes_sent",
+				 stat->bytes_sent);
+		} else if (get_value(stat->kind) == "video") {
+			stats->video_bytes_sent += get_value(stat->bytes_sent);
+			stats->video_packets_sent +=
+				get_value(stat->packets_sent);
+			stats->pli_count += get_value(stat->pli_count);
+			stats->fir_count += get_value(stat->fir_count);
+			stats->nack_count += get_value(stat->nack_count);
+			stats->qp_sum += get_value(stat->qp_sum);
+
+			add_line(list, "outbound_video_packets_sent",
+				 stat->packets_sent);
+			add_line(list, "outbound_video_bytes_sent",
+				 stat->bytes_sent);
+			add_line(list, "outbound_video_fir_count",
+				 stat->fir_count);
+			add_line(list, "outbound_video_pli_count",
+				 stat->pli_count);
+			add_line(list, "outbound_video_nack_count",
+				 stat->nack_count);
+			add_line(list, "outbound_video_qp_sum", stat->qp_sum);
+		}
+	}
+	stats->total_bytes_sent =
+		stats->audio_bytes_sent + stats->video_bytes_sent;
+
+	// RTCIceCandidatePairStats
+	for (const auto *stat :
+	     report->GetStatsOfType<webrtc::RTCIceCandidatePairStats>()) {
+		if (get_value(stat->nominated) &&
+		    stat->current_round_trip_time.is_defined()) {
+			stats->rtt_ms = *stat->current_round_trip_time * 1000.0;
+			list += "candidate_pair_rtt_ms:" +
+				std::to_string(stats->rtt_ms) + "\n";
+			break;
+		}
+	}
+
+	// RTCTransportStats
+	for (const auto *stat :
+	     report->GetStatsOfType<webrtc::RTCTransportStats>()) {
+		stats->transport_bytes_sent += get_value(stat->bytes_sent);
+		stats->transport_bytes_received +=
+			get_value(stat->bytes_received);
+
+		add_line(list, "transport_bytes_sent", stat->bytes_sent);
+		add_line(list, "transport_bytes_received",
+			 stat->bytes_received);
+	}
+
+	return stats;
+}
@@ -0,0 +1,50 @@
+#ifndef _WEBRTC_STATS_H_
+#define _WEBRTC_STATS_H_
+
+// webrtc includes
+#include "api/scoped_refptr.h"
+#include "api/stats/rtc_stats_report.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Snapshot of the counters we care about, built from an RTCStatsReport on
+// the signaling thread and published as a whole. Readers hold on to a
+// snapshot (std::atomic_load) and never wait on libwebrtc.
+struct WebRTCStats {
+	// Microseconds (rtc::TimeMicros) at which the report was delivered
+	int64_t timestamp_us = 0;
+
+	uint64_t audio_bytes_sent = 0;
+	uint64_t audio_packets_sent = 0;
+	uint64_t video_bytes_sent = 0;
+	uint64_t video_packets_sent = 0;
+	uint64_t total_bytes_sent = 0;
+
+	uint32_t pli_count = 0;
+	uint32_t fir_count = 0;
+	uint32_t nack_count = 0;
+	uint64_t qp_sum = 0;
+
+	uint32_t frame_width = 0;
+	uint32_t frame_height = 0;
+	uint32_t frames_sent = 0;
+	uint32_t huge_frames_sent = 0;
+	double fps = 0.0;
+
+	// Current round trip time of the selected candidate pair
+	double rtt_ms = 0.0;
+
+	uint64_t transport_bytes_sent = 0;
+	uint64_t transport_bytes_received = 0;
+
+	// Human readable "key:value" lines, for obs_output_get_stats_list
+	std::string list;
+
+	static std::shared_ptr<const WebRTCStats>
+	FromReport(const rtc::scoped_refptr<const webrtc::RTCStatsReport> &report,
+		   const WebRTCStats *previous);
+};
+
+#endif
@@ -8,15 +8,13 @@
 #include "api/audio_codecs/builtin_audio_decoder_factory.h"
 #include "api/audio_codecs/builtin_audio_encoder_factory.h"
 #include "api/video_codecs/builtin_video_decoder_factory.h"
-#include "api/video_codecs/builtin_video_encoder_factory.h"
-#include "api/video/i420_buffer.h"
-#include "common_video/libyuv/include/webrtc_libyuv.h"
 #include "pc/rtc_stats_collector.h"
 #include "rtc_base/checks.h"
-#include <libyuv.h>
 
 #include <algorithm>
+#include <cctype>
 #include <chrono>
+#include <functional>
 #include <iterator>
 #include <memory>
 #include <mutex>
@@ -29,26 +27,35 @@
 #define warn(format, ...) blog(LOG_WARNING, format, ##__VA_ARGS__)
 #define error(format, ...) blog(LOG_ERROR, format, ##__VA_ARGS__)
 
+// Interval between two stats reports
+#define STATS_INTERVAL_MS 1000
+// Time given to ICE to recover from a disconnection before restarting it
+#define ICE_DISCONNECTED_GRACE_MS 2000
+// Time allowed for an ICE restart, then for a re-publish, to connect
+#define ICE_RESTART_TIMEOUT_MS 5000
+#define REPUBLISH_TIMEOUT_MS 15000
+// Same cap as the reconnect delay of libobs outputs
+#define MAX_RETRY_SEC (15 * 60)
+
 class StatsCallback : public webrtc::RTCStatsCollectorCallback {
 public:
-	rtc::scoped_refptr<const webrtc::RTCStatsReport> report()
+	using Handler = std::function<void(
+		const rtc::scoped_refptr<const webrtc::RTCStatsReport> &)>;
+
+	explicit StatsCallback(Handler handler) : handler_(std::move(handler))
 	{
-		return report_;
 	}
-	bool called() const { return called_; }
 
 protected:
 	void OnStatsDelivered(
 		const rtc::scoped_refptr<const webrtc::RTCStatsReport> &report)
 		override
 	{
-		report_ = report;
-		called_ = true;
+		handler_(report);
 	}
 
 private:
-	bool called_ = false;
-	rtc::scoped_refptr<const webrtc::RTCStatsReport> report_;
+	Handler handler_;
 };
 
 class CustomLogger : public rtc::LogSink {
@@ -61,7 +68,38 @@ public:
 
 CustomLogger logger;
 
+static void load_simulcast_layers(obs_service_t *service,
+				  std::vector<SimulcastLayer> &layers)
+{
+	static const struct {
+		const char *rid;
+		double scale_resolution_down_by;
+	} defaults[] = {{"L", 1.0}, {"M", 2.0}, {"S", 4.0}};
+
+	obs_data_t *settings = obs_service_get_settings(service);
+
+	layers.clear();
+	for (const auto &layer : defaults) {
+		std::string key = "simulcast_";
+		key += (char)tolower(layer.rid[0]);
+
+		double scale =
+			obs_data_get_double(settings, (key + "_scale").c_str());
+		int bitrate = (int)obs_data_get_int(settings,
+						    (key + "_bitrate").c_str());
+
+		layers.push_back({layer.rid,
+				  scale >= 1.0 ? scale
+					       : layer.scale_resolution_down_by,
+				  bitrate > 0 ? bitrate : 0});
+	}
+
+	obs_data_release(settings);
+}
+
 WebRTCStream::WebRTCStream(obs_output_t *output)
+	: buffer_pool(kMaxPooledVideoFrames),
+	  layer_scaler(kMaxPooledVideoFrames)
 {
 	rtc::LogMessage::RemoveLogToStream(&logger);
 	rtc::LogMessage::AddLogToStream(&logger,
@@ -76,6 +114,19 @@ WebRTCStream::WebRTCStream(obs_output_t *output)
 	this->output = output;
 	this->client = nullptr;
 
+	passthrough_encoder = nullptr;
+	passthrough_started = false;
+	warned_bframes = false;
+
+	media_started = false;
+	signaling_generation = 0;
+	reconnect_enabled = false;
+	reconnect_stop = false;
+	reconnect_requested = false;
+	reconnect_loss = ConnectionLoss::IceDisconnected;
+	attempt_pending = false;
+	ice_connected = false;
+
 	// Create audio device module
 	// NOTE ALEX: check if we still need this
 	adm = new rtc::RefCountedObject<AudioDeviceModuleWrapper>();
@@ -95,11 +146,15 @@ WebRTCStream::WebRTCStream(obs_output_t *output)
 	signaling->SetName("signaling", nullptr);
 	signaling->Start();
 
+	// Video encoder factory, forwards OBS encoder packets when possible
+	auto encoder_factory = std::make_unique<ObsVideoEncoderFactory>();
+	video_encoder_factory = encoder_factory.get();
+
 	factory = webrtc::CreatePeerConnectionFactory(
 		network.get(), worker.get(), signaling.get(), adm,
 		webrtc::CreateBuiltinAudioEncoderFactory(),
 		webrtc::CreateBuiltinAudioDecoderFactory(),
-		webrtc::CreateBuiltinVideoEncoderFactory(),
+		std::move(encoder_factory),
 		webrtc::CreateBuiltinVideoDecoderFactory(), nullptr, nullptr);
 
 	// Create video capture module
@@ -110,6 +165,7 @@ WebRTCStream::~WebRTCStream()
 {
 	rtc::LogMessage::RemoveLogToStream(&logger);
 
+	stopReconnect();
 	// Shutdown websocket connection and close Peer Connection
 	close(false);
 
@@ -134,13 +190,8 @@ WebRTCStream::~WebRTCStream()
 
 void WebRTCStream::resetStats()
 {
-	stats_list = "";
 	frame_id = 0;
-	pli_received = 0;
-	audio_bytes_sent = 0;
-	video_bytes_sent = 0;
-	total_bytes_sent = 0;
-	previous_frames_sent = 0;
+	std::atomic_store(&stats, std::make_shared<const WebRTCStats>());
 }
 
 bool WebRTCStream::start(WebRTCStream::Type type)
@@ -148,6 +199,9 @@ bool WebRTCStream::start(WebRTCStream::Type type)
 	info("WebRTCStream::start");
 	this->type = type;
 
+	stopReconnect();
+	media_started = false;
+
 	resetStats();
 
 	// Access service if started, or fail
@@ -194,6 +248,13 @@ bool WebRTCStream::start(WebRTCStream::Type type)
 	info("Video codec: %s",
 	     video_codec.empty() ? "Automatic" : video_codec.c_str());
 	info("Simulcast: %s", simulcast ? "true" : "false");
+	if (simulcast) {
+		load_simulcast_layers(service, simulcast_layers);
+		for (const auto &layer : simulcast_layers)
+			info("  Layer %s: 1/%g resolution, %d kbps",
+			     layer.rid.c_str(), layer.scale_resolution_down_by,
+			     layer.max_bitrate_kbps);
+	}
 	info("Publish API URL: %s", publishApiUrl.c_str());
 	info("Protocol:    %s",
 	     protocol.empty() ? "Automatic" : protocol.c_str());
@@ -243,6 +304,17 @@ bool WebRTCStream::start(WebRTCStream::Type type)
 	video_bitrate = (int)obs_data_get_int(vsettings, "bitrate");
 	obs_data_release(vsettings);
 
+	// Send the packets of the OBS video encoder as they are when it
+	// produces the codec negotiated with the server (H.264 by default):
+	// the user's encoder settings then apply and nothing is encoded twice.
+	// Simulcast needs one libwebrtc encoder per layer.
+	const char *vcodec = vencoder ? obs_encoder_get_codec(vencoder) : NULL;
+	bool passthrough = !simulcast && vcodec &&
+			   strcmp(vcodec, "h264") == 0 &&
+			   (video_codec.empty() || video_codec == "h264");
+	info("Video encoder: %s",
+	     passthrough ? obs_encoder_get_name(vencoder) : "libwebrtc");
+
 	struct obs_audio_info audio_info;
 	if (!obs_get_audio_info(&audio_info)) {
 		warn("Failed to load audio settings.  Defaulting to opus.");
@@ -258,31 +330,9 @@ bool WebRTCStream::start(WebRTCStream::Type type)
 	if (close(false))
 		obs_output_signal_stop(output, OBS_OUTPUT_ERROR);
 
-	webrtc::PeerConnectionInterface::RTCConfiguration config;
-	webrtc::PeerConnectionInterface::IceServer server;
-	server.urls = {"stun:stun.l.google.com:19302"};
-	config.servers.push_back(server);
-	// config.bundle_policy = webrtc::PeerConnectionInterface::kBundlePolicyMaxBundle;
-	// config.disable_ipv6 = true;
-	// config.rtcp_mux_policy = webrtc::PeerConnectionInterface::kRtcpMuxPolicyRequire;
-	config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
-	// config.set_cpu_adaptation(false);
-	// config.set_suspend_below_min_bitrate(false);
-
-	webrtc::PeerConnectionDependencies dependencies(this);
-
-	pc = factory->CreatePeerConnection(config, std::move(dependencies));
-
-	if (!pc.get()) {
-		error("Error creating Peer Connection");
-		obs_output_set_last_error(
-			output,
-			"There was an error connecting to the server. Are you connected to the internet?");
-		obs_output_signal_stop(output, OBS_OUTPUT_CONNECT_FAILED);
-		return false;
-	} else {
-		info("PEER CONNECTION CREATED\n");
-	}
+	passthrough_encoder = passthrough ? vencoder : nullptr;
+	video_encoder_factory->SetObsEncoder(passthrough_encoder,
+					     video_bitrate);
 
 	cricket::AudioOptions options;
 	options.echo_cancellation.emplace(false); // default: true
@@ -309,66 +359,119 @@ bool WebRTCStream::start(WebRTCStream::Type type)
 	// pc->AddTrack(video_track, {"obs"});
 	stream->AddTrack(video_track);
 
+	std::vector<double> lower_layers;
+	if (simulcast) {
+		for (const auto &layer : simulcast_layers) {
+			if (layer.scale_resolution_down_by > 1.0)
+				lower_layers.push_back(
+					layer.scale_resolution_down_by);
+		}
+	}
+	layer_scaler.SetLayers(lower_layers);
+
+	if (!createPeerConnection()) {
+		obs_output_signal_stop(output, OBS_OUTPUT_CONNECT_FAILED);
+		return false;
+	}
+
+	// Extra logging
+
+	if (type == WebRTCStream::Type::Millicast) {
+		info("Stream Name:      %s\nPublishing Token: %s\n",
+		     username.c_str(), password.c_str());
+		url = publishApiUrl;
+	}
+
+	if (!connectSignaling()) {
+		// Shutdown websocket connection and close Peer Connection
+		close(false);
+		// Disconnect, this will call stop on main thread
+		obs_output_signal_stop(output, OBS_OUTPUT_CONNECT_FAILED);
+		return false;
+	}
+	return true;
+}
+
+// Create the Peer Connection and add the (existing) audio and video tracks
+bool WebRTCStream::createPeerConnection()
+{
+	webrtc::PeerConnectionInterface::RTCConfiguration config;
+	webrtc::PeerConnectionInterface::IceServer server;
+	server.urls = {"stun:stun.l.google.com:19302"};
+	config.servers.push_back(server);
+	// config.bundle_policy = webrtc::PeerConnectionInterface::kBundlePolicyMaxBundle;
+	// config.disable_ipv6 = true;
+	// config.rtcp_mux_policy = webrtc::PeerConnectionInterface::kRtcpMuxPolicyRequire;
+	config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
+	// config.set_cpu_adaptation(false);
+	// config.set_suspend_below_min_bitrate(false);
+
+	webrtc::PeerConnectionDependencies dependencies(this);
+
+	pc = factory->CreatePeerConnection(config, std::move(dependencies));
+
+	if (!pc.get()) {
+		error("Error creating Peer Connection");
+		obs_output_set_last_error(
+			output,
+			"There was an error connecting to the server. Are you connected to the internet?");
+		return false;
+	} else {
+		info("PEER CONNECTION CREATED\n");
+	}
+
 	//Add audio track
 	webrtc::RtpTransceiverInit audio_init;
 	audio_init.stream_ids.push_back(stream->id());
 	audio_init.direction = webrtc::RtpTransceiverDirection::kSendOnly;
 	pc->AddTransceiver(audio_track, audio_init);
 
-	bool simulcast = false;
-
 	//Add video track
 	webrtc::RtpTransceiverInit video_init;
 	video_init.stream_ids.push_back(stream->id());
 	video_init.direction = webrtc::RtpTransceiverDirection::kSendOnly;
 	if (simulcast) {
-		webrtc::RtpEncodingParameters large;
-		webrtc::RtpEncodingParameters medium;
-		webrtc::RtpEncodingParameters small;
-		large.rid = "L";
-		large.scale_resolution_down_by = 1;
-		medium.rid = "M";
-		medium.scale_resolution_down_by = 2;
-		small.rid = "S";
-		small.scale_resolution_down_by = 4;
 		//In reverse order so large is dropped first on low network condition
-		video_init.send_encodings.push_back(small);
-		video_init.send_encodings.push_back(medium);
-		video_init.send_encodings.push_back(large);
+		for (auto it = simulcast_layers.rbegin();
+		     it != simulcast_layers.rend(); ++it) {
+			webrtc::RtpEncodingParameters encoding;
+			encoding.rid = it->rid;
+			encoding.scale_resolution_down_by =
+				it->scale_resolution_down_by;
+			if (it->max_bitrate_kbps)
+				encoding.max_bitrate_bps =
+					it->max_bitrate_kbps * 1000;
+			video_init.send_encodings.push_back(encoding);
+		}
 	}
 	pc->AddTransceiver(video_track, video_init);
+	return true;
+}
 
+// Create the websocket client and connect to the signalling server
+bool WebRTCStream::connectSignaling()
+{
 	client = createWebsocketClient(type);
 	if (!client) {
 		warn("Error creating Websocket client");
-		// Close Peer Connection
-		close(false);
-		// Disconnect, this will call stop on main thread
 		obs_output_set_last_error(
 			output,
 			"There was a problem creating the websocket connection.  Are you behind a firewall?");
-		obs_output_signal_stop(output, OBS_OUTPUT_CONNECT_FAILED);
 		return false;
 	}
 
-	// Extra logging
-
-	if (type == WebRTCStream::Type::Millicast) {
-		info("Stream Name:      %s\nPublishing Token: %s\n",
-		     username.c_str(), password.c_str());
-		url = publishApiUrl;
-	}
 	info("CONNECTING TO %s", url.c_str());
 
+	auto listener = std::make_unique<SignalingListener>(
+		this, ++signaling_generation);
+	WebsocketClient::Listener *current = listener.get();
+	signaling_listeners.push_back(std::move(listener));
+
 	// Connect to the signalling server
-	if (!client->connect(url, room, username, password, this)) {
+	if (!client->connect(url, room, username, password, current)) {
 		warn("Error connecting to server");
-		// Shutdown websocket connection and close Peer Connection
-		close(false);
-		// Disconnect, this will call stop on main thread
 		obs_output_set_last_error(
 			output, "There was a problem connecting to your room.");
-		obs_output_signal_stop(output, OBS_OUTPUT_CONNECT_FAILED);
 		return false;
 	}
 	return true;
@@ -400,7 +503,7 @@ void WebRTCStream::OnSuccess(webrtc::SessionDescriptionInterface *desc)
 	info("Video bitrate:    %d\n", video_bitrate);
 	info("OFFER:\n\n%s\n", sdp.c_str());
 
-	std::string sdpCopy = sdp;
+	SDPModif offer(sdp);
 	std::vector<int> audio_payloads;
 	std::vector<int> video_payloads;
 	// If codec setting is Automatic, set it to h264 by default
@@ -408,21 +511,24 @@ void WebRTCStream::OnSuccess(webrtc::SessionDescriptionInterface *desc)
 		video_codec = "h264"; // h264 must be in lowercase (Firefox)
 	}
 	// Force specific video/audio payload
-	SDPModif::forcePayload(sdpCopy, audio_payloads, video_payloads,
-			       // the packaging mode needs to be 1
-			       audio_codec, video_codec, 1, "42e01f", 0);
+	offer.forcePayload(audio_payloads, video_payloads,
+			   // the packaging mode needs to be 1
+			   audio_codec, video_codec, 1, "42e01f", 0);
 	// Constrain video bitrate
-	SDPModif::bitrateMaxMinSDP(sdpCopy, video_bitrate, video_payloads);
+	offer.bitrateMaxMin(video_bitrate, video_payloads);
 	// Enable stereo & constrain audio bitrate
-	// NOTE ALEX: check that it does not incorrectly detect multiopus as opus
-	SDPModif::stereoSDP(sdpCopy, audio_bitrate);
+	// (rtpmap names are matched exactly, multiopus is not taken for opus)
+	offer.stereo(audio_bitrate);
 	// NOTE ALEX: nothing special to do about multiopus with CoSMo libwebrtc package.
+	std::string sdpCopy = offer.toString();
 
 	info("SETTING LOCAL DESCRIPTION\n\n");
 	pc->SetLocalDescription(this, desc);
 
 	info("Sending OFFER (SDP) to remote peer:\n\n%s", sdpCopy.c_str());
 	if (!client->open(sdpCopy, video_codec, audio_codec, username)) {
+		if (requestReconnect(ConnectionLoss::SignalingLost))
+			return;
 		// Shutdown websocket connection and close Peer Connection
 		close(false);
 		// Disconnect, this will call stop on main thread
@@ -438,6 +544,8 @@ void WebRTCStream::OnSuccess()
 void WebRTCStream::OnFailure(webrtc::RTCError error)
 {
 	warn("WebRTCStream::OnFailure [%s]", error.message());
+	if (requestReconnect(ConnectionLoss::Failed))
+		return;
 	// Shutdown websocket connection and close Peer Connection
 	close(false);
 	// Disconnect, this will call stop on main thread
@@ -461,7 +569,19 @@ void WebRTCStream::OnIceConnectionChange(
 	info("WebRTCStream::OnIceConnectionChange [%u]", state);
 
 	switch (state) {
+	case PeerConnectionInterface::IceConnectionState::kIceConnectionConnected:
+	case PeerConnectionInterface::IceConnectionState::kIceConnectionCompleted:
+		onIceConnected();
+		break;
+	case PeerConnectionInterface::IceConnectionState::
+		kIceConnectionDisconnected:
+		requestReconnect(ConnectionLoss::IceDisconnected);
+		break;
 	case PeerConnectionInterface::IceConnectionState::kIceConnectionFailed: {
+		// Once on air the Peer Connection state goes failed as well,
+		// recovery starts from there
+		if (canReconnect())
+			break;
 		// Close must be carried out on a separate thread in order to avoid deadlock
 		auto thread = std::thread([=]() {
 			obs_output_set_last_error(
@@ -486,6 +606,8 @@ void WebRTCStream::OnConnectionChange(
 
 	switch (state) {
 	case PeerConnectionInterface::PeerConnectionState::kFailed: {
+		if (requestReconnect(ConnectionLoss::Failed))
+			break;
 
 		// Close must be carried out on a separate thread in order to avoid deadlock
 		auto thread = std::thread([=]() {
@@ -512,7 +634,7 @@ void WebRTCStream::onRemoteIceCandidate(const std::string &sdpData)
 		std::string s = sdpData;
 		s.erase(remove(s.begin(), s.end(), '\"'), s.end());
 		if (protocol.empty() ||
-		    SDPModif::filterIceCandidates(s, protocol)) {
+		    SDPModif::filterIceCandidate(s, protocol)) {
 			const std::string candidate = s;
 			info("Remote %s\n", candidate.c_str());
 			const std::string sdpMid = "";
@@ -533,12 +655,16 @@ void WebRTCStream::onOpened(const std::string &sdp)
 {
 	info("ANSWER:\n\n%s\n", sdp.c_str());
 
-	std::string sdpCopy = sdp;
+	SDPModif answer_sdp(sdp);
 
 	// Constrain video bitrate
-	SDPModif::bitrateSDP(sdpCopy, video_bitrate);
+	answer_sdp.bitrate(video_bitrate);
 	// Enable stereo & constrain audio bitrate
-	SDPModif::stereoSDP(sdpCopy, audio_bitrate);
+	answer_sdp.stereo(audio_bitrate);
+	// Only keep candidates using the selected protocol
+	if (!protocol.empty())
+		answer_sdp.filterCandidates(protocol);
+	std::string sdpCopy = answer_sdp.toString();
 
 	// SetRemoteDescription observer
 	srd_observer = make_scoped_refptr(this);
@@ -552,6 +678,12 @@ void WebRTCStream::onOpened(const std::string &sdp)
 	info("SETTING REMOTE DESCRIPTION\n\n%s", sdpCopy.c_str());
 	pc->SetRemoteDescription(std::move(answer), srd_observer);
 
+	// Answer to an ICE restart or a re-publish: capture is still running
+	if (media_started) {
+		startStats();
+		return;
+	}
+
 	// Set audio conversion info
 	audio_convert_info conversion;
 	conversion.format = AUDIO_FORMAT_16BIT;
@@ -559,8 +691,29 @@ void WebRTCStream::onOpened(const std::string &sdp)
 	conversion.speakers = (speaker_layout)channel_count;
 	obs_output_set_audio_conversion(output, &conversion);
 
+	// Set video conversion info, frames are sent to webrtc as native NV12
+	video_scale_info video_conversion = {};
+	video_conversion.format = VIDEO_FORMAT_NV12;
+	obs_output_set_video_conversion(output, &video_conversion);
+
 	info("Begin data capture...");
 	obs_output_begin_data_capture(output, 0);
+
+	startStats();
+
+	media_started = true;
+	startReconnect();
+
+	if (passthrough_encoder) {
+		passthrough_started = obs_encoder_add_packet_callback(
+			passthrough_encoder, receive_video_packet, this);
+		if (!passthrough_started) {
+			error("Could not start OBS video encoder");
+			obs_output_set_last_error(
+				output, "Failed to start the video encoder.");
+			obs_output_signal_stop(output, OBS_OUTPUT_ENCODE_ERROR);
+		}
+	}
 }
 
 void WebRTCStream::OnSetRemoteDescriptionComplete(webrtc::RTCError error)
@@ -572,15 +725,30 @@ void WebRTCStream::OnSetRemoteDescriptionComplete(webrtc::RTCError error)
 }
 
 bool WebRTCStream::close(bool wait)
+{
+	if (passthrough_started) {
+		obs_encoder_remove_packet_callback(passthrough_encoder,
+						   receive_video_packet, this);
+		passthrough_started = false;
+	}
+	video_encoder_factory->SetObsEncoder(nullptr, 0);
+
+	return closePeerConnection(wait);
+}
+
+bool WebRTCStream::closePeerConnection(bool wait)
 {
 	if (!pc.get())
 		return false;
+	// No more stats requests on this Peer Connection
+	stopStats();
 	// Get pointer
 	auto old = pc.release();
 	// Close Peer Connection
 	old->Close();
-	// Shutdown websocket connection
+	// Shutdown websocket connection, ignoring its late callbacks
 	if (client) {
+		signaling_generation++;
 		client->disconnect(wait);
 		delete (client);
 		client = nullptr;
@@ -588,9 +756,232 @@ bool WebRTCStream::close(bool wait)
 	return true;
 }
 
+void WebRTCStream::startReconnect()
+{
+	int retry_count = 0;
+	obs_output_get_reconnect_settings(output, &retry_count, nullptr);
+	if (retry_count <= 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(reconnect_mutex);
+	reconnect_enabled = true;
+	reconnect_stop = false;
+	reconnect_requested = false;
+	attempt_pending = false;
+	ice_connected = false;
+	reconnect_thread = std::thread(&WebRTCStream::reconnectLoop, this);
+}
+
+void WebRTCStream::stopReconnect()
+{
+	{
+		std::lock_guard<std::mutex> lock(reconnect_mutex);
+		reconnect_stop = true;
+	}
+	reconnect_cv.notify_all();
+
+	if (reconnect_thread.joinable()) {
+		if (reconnect_thread.get_id() == std::this_thread::get_id())
+			reconnect_thread.detach();
+		else
+			reconnect_thread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(reconnect_mutex);
+	reconnect_enabled = false;
+}
+
+bool WebRTCStream::canReconnect()
+{
+	std::lock_guard<std::mutex> lock(reconnect_mutex);
+	return media_started && reconnect_enabled;
+}
+
+// Returns false when the caller should stop the output as before: not on
+// air yet, or automatic reconnection disabled in the settings.
+bool WebRTCStream::requestReconnect(ConnectionLoss loss)
+{
+	if (!media_started)
+		return false;
+
+	std::lock_guard<std::mutex> lock(reconnect_mutex);
+	if (!reconnect_enabled)
+		return false;
+	if (reconnect_stop)
+		return true;
+	// ICE goes through disconnected while an attempt connects
+	if (attempt_pending && loss == ConnectionLoss::IceDisconnected)
+		return true;
+
+	warn("Connection lost (%s), recovering...",
+	     loss == ConnectionLoss::IceDisconnected ? "ICE disconnected"
+	     : loss == ConnectionLoss::Failed       ? "connection failed"
+						    : "signaling lost");
+	ice_connected = false;
+	if (!reconnect_requested || loss > reconnect_loss)
+		reconnect_loss = loss;
+	reconnect_requested = true;
+	reconnect_cv.notify_all();
+	return true;
+}
+
+void WebRTCStream::onIceConnected()
+{
+	{
+		std::lock_guard<std::mutex> lock(reconnect_mutex);
+		ice_connected = true;
+	}
+	reconnect_cv.notify_all();
+}
+
+void WebRTCStream::reconnectLoop()
+{
+	int retry_count = 0;
+	int retry_sec = 0;
+	obs_output_get_reconnect_settings(output, &retry_count, &retry_sec);
+
+	// Re-publish attempts since the connection was last up
+	int retries = 0;
+	bool ice_restarted = false;
+
+	std::unique_lock<std::mutex> lock(reconnect_mutex);
+	for (;;) {
+		reconnect_cv.wait(lock, [this]() {
+			return reconnect_stop || reconnect_requested;
+		});
+		if (reconnect_stop)
+			break;
+
+		ConnectionLoss loss = reconnect_loss;
+		reconnect_requested = false;
+
+		// A short ICE disconnection (Wi-Fi blip) often recovers alone
+		if (loss == ConnectionLoss::IceDisconnected) {
+			auto grace = std::chrono::milliseconds(
+				ICE_DISCONNECTED_GRACE_MS);
+			reconnect_cv.wait_for(lock, grace, [this]() {
+				return reconnect_stop || ice_connected ||
+				       reconnect_requested;
+			});
+			if (reconnect_stop)
+				break;
+			if (ice_connected || reconnect_requested)
+				continue;
+		}
+
+		// ICE restart first, as long as the signaling is still there
+		bool ice_restart = !ice_restarted &&
+				   loss != ConnectionLoss::SignalingLost;
+		if (!ice_restart) {
+			if (retries >= retry_count) {
+				warn("Giving up reconnecting after %d attempts",
+				     retries);
+				reconnect_stop = true;
+				lock.unlock();
+				obs_output_set_last_error(
+					output, "Connection failure\n\n");
+				obs_output_signal_stop(output,
+						       OBS_OUTPUT_ERROR);
+				return;
+			}
+
+			// Same back off as the libobs reconnect: the delay
+			// doubles on each retry, the first one is immediate
+			if (retries) {
+				int sec = retry_sec;
+				for (int i = 1;
+				     i < retries && sec < MAX_RETRY_SEC; i++)
+					sec *= 2;
+				sec = std::min(sec, MAX_RETRY_SEC);
+				info("Re-publishing in %d seconds...", sec);
+				reconnect_cv.wait_for(
+					lock, std::chrono::seconds(sec),
+					[this]() { return reconnect_stop; });
+				if (reconnect_stop)
+					break;
+			}
+			retries++;
+		} else {
+			ice_restarted = true;
+		}
+
+		ice_connected = false;
+		reconnect_requested = false;
+		attempt_pending = true;
+		lock.unlock();
+
+		bool started = ice_restart ? restartIce() : republish();
+
+		lock.lock();
+		if (!started) {
+			attempt_pending = false;
+			reconnect_requested = true;
+			reconnect_loss = ConnectionLoss::SignalingLost;
+			continue;
+		}
+
+		auto timeout = std::chrono::milliseconds(
+			ice_restart ? ICE_RESTART_TIMEOUT_MS
+				    : REPUBLISH_TIMEOUT_MS);
+		bool done = reconnect_cv.wait_for(lock, timeout, [this]() {
+			return reconnect_stop || ice_connected ||
+			       reconnect_requested;
+		});
+		attempt_pending = false;
+		if (reconnect_stop)
+			break;
+
+		if (!done) {
+			warn("%s timed out",
+			     ice_restart ? "ICE restart" : "Re-publish");
+			reconnect_requested = true;
+			reconnect_loss = std::max(reconnect_loss,
+						  ConnectionLoss::Failed);
+		} else if (ice_connected && !reconnect_requested) {
+			info("Connection recovered (%s)",
+			     ice_restart ? "ICE restart" : "re-published");
+			retries = 0;
+			ice_restarted = false;
+		}
+	}
+}
+
+// Restart ICE on the current Peer Connection: new offer, same session.
+// The offer goes through client->open() on the websocket already in use, so
+// the signaling server has to accept a second publish on one session and
+// answer it. A server refusing it reports an error or drops the websocket:
+// both end up as SignalingLost, and the next attempt re-publishes instead.
+bool WebRTCStream::restartIce()
+{
+	if (!pc.get() || !client)
+		return false;
+
+	info("Restarting ICE...");
+	webrtc::PeerConnectionInterface::RTCOfferAnswerOptions offer_options;
+	offer_options.voice_activity_detection = false;
+	offer_options.ice_restart = true;
+	pc->CreateOffer(this, offer_options);
+	return true;
+}
+
+// Publish again on a new Peer Connection, reusing the tracks
+bool WebRTCStream::republish()
+{
+	info("Re-publishing...");
+
+	// Wait for the old websocket to go away before connecting again, its
+	// callbacks are ignored from now on anyway
+	closePeerConnection(true);
+
+	if (!createPeerConnection())
+		return false;
+	return connectSignaling();
+}
+
 bool WebRTCStream::stop()
 {
 	info("WebRTCStream::stop");
+	stopReconnect();
 	// Shutdown websocket connection and close Peer Connection
 	close(true);
 	// Disconnect, this will call stop on main thread
@@ -602,6 +993,9 @@ void WebRTCStream::onDisconnected()
 {
 	info("WebRTCStream::onDisconnected");
 
+	if (requestReconnect(ConnectionLoss::SignalingLost))
+		return;
+
 	// are we done retrying?
 	if (thread_closeAsync.joinable())
 		thread_closeAsync.join();
@@ -617,6 +1011,8 @@ void WebRTCStream::onDisconnected()
 void WebRTCStream::onLoggedError(int code)
 {
 	info("WebRTCStream::onLoggedError [code: %d]", code);
+	if (requestReconnect(ConnectionLoss::SignalingLost))
+		return;
 	// Shutdown websocket connection and close Peer Connection
 	close(false);
 	// Disconnect, this will call stop on main thread
@@ -629,12 +1025,65 @@ void WebRTCStream::onLoggedError(int code)
 void WebRTCStream::onOpenedError(int code)
 {
 	info("WebRTCStream::onOpenedError [code: %d]", code);
+	if (requestReconnect(ConnectionLoss::SignalingLost))
+		return;
 	// Shutdown websocket connection and close Peer Connection
 	close(false);
 	// Disconnect, this will call stop on main thread
 	obs_output_signal_stop(output, OBS_OUTPUT_ERROR);
 }
 
+bool WebRTCStream::SignalingListener::isCurrent(const char *callback) const
+{
+	if (generation == stream->signaling_generation)
+		return true;
+	info("Ignoring %s from a closed websocket client", callback);
+	return false;
+}
+
+void WebRTCStream::SignalingListener::onConnected()
+{
+	if (isCurrent("onConnected"))
+		stream->onConnected();
+}
+
+void WebRTCStream::SignalingListener::onDisconnected()
+{
+	if (isCurrent("onDisconnected"))
+		stream->onDisconnected();
+}
+
+void WebRTCStream::SignalingListener::onLogged(int code)
+{
+	if (isCurrent("onLogged"))
+		stream->onLogged(code);
+}
+
+void WebRTCStream::SignalingListener::onLoggedError(int code)
+{
+	if (isCurrent("onLoggedError"))
+		stream->onLoggedError(code);
+}
+
+void WebRTCStream::SignalingListener::onOpened(const std::string &sdp)
+{
+	if (isCurrent("onOpened"))
+		stream->onOpened(sdp);
+}
+
+void WebRTCStream::SignalingListener::onOpenedError(int code)
+{
+	if (isCurrent("onOpenedError"))
+		stream->onOpenedError(code);
+}
+
+void WebRTCStream::SignalingListener::onRemoteIceCandidate(
+	const std::string &sdpData)
+{
+	if (isCurrent("onRemoteIceCandidate"))
+		stream->onRemoteIceCandidate(sdpData);
+}
+
 void WebRTCStream::onAudioFrame(audio_data *frame)
 {
 	if (!frame)
@@ -650,39 +1099,24 @@ void WebRTCStream::onVideoFrame(video_data *frame)
 	if (!videoCapturer)
 		return;
 
-	if (std::chrono::system_clock::time_point(
-		    std::chrono::duration<int>(0)) == previous_time)
-		// First frame sent: Initialize previous_time
-		previous_time = std::chrono::system_clock::now();
+	// Frames come pre-encoded through onVideoPacket instead
+	if (passthrough_encoder)
+		return;
 
-	// Calculate size
 	int outputWidth = obs_output_get_width(output);
 	int outputHeight = obs_output_get_height(output);
-	auto videoType = webrtc::VideoType::kNV12;
-	uint32_t size = outputWidth * outputHeight * 3 / 2;
-
-	int stride_y = outputWidth;
-	int stride_uv = (outputWidth + 1) / 2;
-	int target_width = abs(outputWidth);
-	int target_height = abs(outputHeight);
-
-	// Convert frame
-	rtc::scoped_refptr<webrtc::I420Buffer> buffer =
-		webrtc::I420Buffer::Create(target_width, target_height,
-					   stride_y, stride_uv, stride_uv);
-
-	libyuv::RotationMode rotation_mode = libyuv::kRotate0;
 
-	const int conversionResult = libyuv::ConvertToI420(
-		frame->data[0], size, buffer.get()->MutableDataY(),
-		buffer.get()->StrideY(), buffer.get()->MutableDataU(),
-		buffer.get()->StrideU(), buffer.get()->MutableDataV(),
-		buffer.get()->StrideV(), 0, 0, outputWidth, outputHeight,
-		target_width, target_height, rotation_mode,
-		ConvertVideoType(videoType));
-
-	// not using the result yet, silence compiler
-	(void)conversionResult;
+	// video-io hands out NV12 (see onOpened): copy the planes as they are
+	// into a recycled native buffer instead of converting to I420.
+	rtc::scoped_refptr<NV12FrameBuffer> buffer =
+		buffer_pool.CreateBuffer(outputWidth, outputHeight);
+	if (!buffer) {
+		// Every pooled frame is still queued in the encoder
+		return;
+	}
+	buffer->CopyFrom(frame);
+	if (simulcast)
+		layer_scaler.Scale(buffer.get());
 
 	const int64_t obs_timestamp_us =
 		(int64_t)frame->timestamp / rtc::kNumNanosecsPerMicrosec;
@@ -705,204 +1139,110 @@ void WebRTCStream::onVideoFrame(video_data *frame)
 	videoCapturer->OnFrameCaptured(video_frame);
 }
 
-// NOTE LUDO: #80 add getStats
-void WebRTCStream::getStats()
+void WebRTCStream::onVideoPacket(encoder_packet *packet)
 {
-	rtc::scoped_refptr<const webrtc::RTCStatsReport> report = NewGetStats();
-	if (nullptr == report) {
+	if (!packet || !videoCapturer)
 		return;
-	}
-	stats_list = "";
 
-	std::vector<const webrtc::RTCOutboundRTPStreamStats *> send_stream_stats =
-		report->GetStatsOfType<webrtc::RTCOutboundRTPStreamStats>();
-	for (const auto &stat : send_stream_stats) {
-		if (stat->kind.ValueToString() == "audio") {
-			audio_bytes_sent =
-				std::stoll(stat->bytes_sent.ValueToJson());
-		}
-		if (stat->kind.ValueToString() == "video") {
-			video_bytes_sent =
-				std::stoll(stat->bytes_sent.ValueToJson());
-			pli_received = std::stoi(stat->pli_count.ValueToJson());
-		}
-	}
-	total_bytes_sent = audio_bytes_sent + video_bytes_sent;
-
-	// RTCDataChannelStats
-	std::vector<const webrtc::RTCDataChannelStats *> data_channel_stats =
-		report->GetStatsOfType<webrtc::RTCDataChannelStats>();
-	for (const auto &stat : data_channel_stats) {
-		stats_list += "data_messages_sent:" +
-			      stat->messages_sent.ValueToJson() + "\n";
-		stats_list += "data_bytes_sent:" +
-			      stat->bytes_sent.ValueToJson() + "\n";
-		stats_list += "data_messages_received:" +
-			      stat->messages_received.ValueToJson() + "\n";
-		stats_list += "data_bytes_received:" +
-			      stat->bytes_received.ValueToJson() + "\n";
-	}
-
-	// RTCMediaStreamTrackStats
-	// double audio_track_jitter_buffer_delay = 0.0;
-	// double video_track_jitter_buffer_delay = 0.0;
-	// uint64_t audio_track_jitter_buffer_emitted_count = 0;
-	// uint64_t video_track_jitter_buffer_emitted_count = 0;
-	std::vector<const webrtc::RTCMediaStreamTrackStats *>
-		media_stream_track_stats = report->GetStatsOfType<
-			webrtc::RTCMediaStreamTrackStats>();
-	for (const auto &stat : media_stream_track_stats) {
-		if (stat->kind.ValueToString() == "audio") {
-			if (stat->audio_level.is_defined())
-				stats_list += "track_audio_level:" +
-					      stat->audio_level.ValueToJson() +
-					      "\n";
-			if (stat->total_audio_energy.is_defined())
-				stats_list +=
-					"track_total_audio_energy:" +
-					stat->total_audio_energy.ValueToJson() +
-					"\n";
-			// stats_list += "track_echo_return_loss:"   + stat->echo_return_loss.ValueToJson() + "\n";
-			// stats_list += "track_echo_return_loss_enhancement:" + stat->echo_return_loss_enhancement.ValueToJson() + "\n";
-			// stats_list += "track_total_samples_received:" + stat->total_samples_received.ValueToJson() + "\n";
-			if (stat->total_samples_duration.is_defined())
-				stats_list += "track_total_samples_duration:" +
-					      stat->total_samples_duration
-						      .ValueToJson() +
-					      "\n";
-			// stats_list += "track_concealed_samples:" + stat->concealed_samples.ValueToJson() + "\n";
-			// stats_list += "track_concealment_events:" + stat->concealment_events.ValueToJson() + "\n";
-		}
-		if (stat->kind.ValueToString() == "video") {
-			// stats_list += "track_jitter_buffer_delay:"    + stat->jitter_buffer_delay.ValueToJson() + "\n";
-			// stats_list += "track_jitter_buffer_emitted_count:" + stat->jitter_buffer_emitted_count.ValueToJson() + "\n";
-			stats_list += "track_frame_width:" +
-				      stat->frame_width.ValueToJson() + "\n";
-			stats_list += "track_frame_height:" +
-				      stat->frame_height.ValueToJson() + "\n";
-			stats_list += "track_frames_sent:" +
-				      stat->frames_sent.ValueToJson() + "\n";
-			stats_list += "track_huge_frames_sent:" +
-				      stat->huge_frames_sent.ValueToJson() +
-				      "\n";
-
-			// FPS = frames_sent / (time_now - start_time)
-			std::chrono::system_clock::time_point time_now =
-				std::chrono::system_clock::now();
-			std::chrono::duration<double> elapsed_seconds =
-				time_now - previous_time;
-			previous_time = time_now;
-			uint32_t frames_sent =
-				std::stol(stat->frames_sent.ValueToJson());
-			stats_list += "track_fps:" +
-				      std::to_string((frames_sent -
-						      previous_frames_sent) /
-						     elapsed_seconds.count()) +
-				      "\n";
-			previous_frames_sent = frames_sent;
-
-			// stats_list += "track_frames_received:"        + stat->frames_received.ValueToJson() + "\n";
-			// stats_list += "track_frames_decoded:"         + stat->frames_decoded.ValueToJson() + "\n";
-			// stats_list += "track_frames_dropped:"         + stat->frames_dropped.ValueToJson() + "\n";
-			// stats_list += "track_frames_corrupted:"       + stat->frames_corrupted.ValueToJson() + "\n";
-			// stats_list += "track_partial_frames_lost:"    + stat->partial_frames_lost.ValueToJson() + "\n";
-			// stats_list += "track_full_frames_lost:"       + stat->full_frames_lost.ValueToJson() + "\n";
-		}
+	if (packet->pts != packet->dts && !warned_bframes) {
+		warn("B-frames are not supported by WebRTC, disable them in the video encoder settings");
+		warned_bframes = true;
 	}
 
-	// RTCPeerConnectionStats
-	// std::vector<const webrtc::RTCPeerConnectionStats*> pc_stats =
-	//         report->GetStatsOfType<webrtc::RTCPeerConnectionStats>();
-	// for (const auto& stat : pc_stats) {
-	//   stats_list += "data_channels_opened:" + stat->data_channels_opened.ValueToJson() + "\n";
-	//   stats_list += "data_channels_closed:" + stat->data_channels_closed.ValueToJson() + "\n";
-	// }
-
-	// RTCRTPStreamStats
-	// std::vector<const webrtc::RTCRTPStreamStats*> rtcrtp_stats =
-	//         report->GetStatsOfType<webrtc::RTCRTPStreamStats>();
-	// for (const auto& stat : rtcrtp_stats) {
-	//   if (stat->kind.ValueToString() == "video") {
-	//     stats_list += "rtcrtp_fir_count:" + stat->fir_count.ValueToJson() + "\n";
-	//     stats_list += "rtcrtp_pli_count:" + stat->pli_count.ValueToJson() + "\n";
-	//     stats_list += "rtcrtp_nack_count:" + stat->nack_count.ValueToJson() + "\n";
-	//     stats_list += "rtcrtp_sli_count:" + stat->sli_count.ValueToJson() + "\n";
-	//     stats_list += "rtcrtp_qp_sum:" + stat->qp_sum.ValueToJson() + "\n";
-	//   }
-	// }
-
-	// RTCInboundRTPStreamStats
-	// std::vector<const webrtc::RTCInboundRTPStreamStats*> inbound_stream_stats =
-	//         report->GetStatsOfType<webrtc::RTCInboundRTPStreamStats>();
-	// for (const auto& stat : inbound_stream_stats) {
-	//   stats_list += "inbound_stream_packets_received:"        + stat->packets_received.ValueToJson() + "\n";
-	//   stats_list += "inbound_stream_bytes_received:"          + stat->bytes_received.ValueToJson() + "\n";
-	//   stats_list += "inbound_stream_packets_lost:"            + stat->packets_lost.ValueToJson() + "\n";
-
-	//   if (stat->kind.ValueToString() == "audio") {
-	//     stats_list += "inbound_stream_jitter:" + stat->jitter.ValueToJson() + "\n";
-	//   }
-	// }
-
-	// RTCOutboundRTPStreamStats
-	std::vector<const webrtc::RTCOutboundRTPStreamStats *>
-		outbound_stream_stats = report->GetStatsOfType<
-			webrtc::RTCOutboundRTPStreamStats>();
-	for (const auto &stat : outbound_stream_stats) {
-		if (stat->kind.ValueToString() == "audio") {
-			stats_list += "outbound_audio_packets_sent:" +
-				      stat->packets_sent.ValueToJson() + "\n";
-			stats_list += "outbound_audio_bytes_sent:" +
-				      stat->bytes_sent.ValueToJson() + "\n";
-			// stats_list += "outbound_audio_target_bitrate:" + stat->target_bitrate.ValueToJson() + "\n";
-			// stats_list += "outbound_audio_frames_encoded:" + stat->frames_encoded.ValueToJson() + "\n";
-		}
-		if (stat->kind.ValueToString() == "video") {
-			stats_list += "outbound_video_packets_sent:" +
-				      stat->packets_sent.ValueToJson() + "\n";
-			stats_list += "outbound_video_bytes_sent:" +
-				      stat->bytes_sent.ValueToJson() + "\n";
-			// stats_list += "outbound_video_target_bitrate:" + stat->target_bitrate.ValueToJson() + "\n";
-			// stats_list += "outbound_video_frames_encoded:" + stat->frames_encoded.ValueToJson() + "\n";
-			stats_list += "outbound_video_fir_count:" +
-				      stat->fir_count.ValueToJson() + "\n";
-			stats_list += "outbound_video_pli_count:" +
-				      stat->pli_count.ValueToJson() + "\n";
-			stats_list += "outbound_video_nack_count:" +
-				      stat->nack_count.ValueToJson() + "\n";
-			// stats_list += "outbound_video_sli_count:"      + stat->sli_count.ValueToJson() + "\n";
-			if (stat->qp_sum.is_defined())
-				stats_list += "outbound_video_qp_sum:" +
-					      stat->qp_sum.ValueToJson() + "\n";
-		}
-	}
+	// Keyframes need SPS/PPS in band, OBS encoders only output them as
+	// extra data
+	uint8_t *header = nullptr;
+	size_t header_size = 0;
+	if (packet->keyframe &&
+	    !obs_encoder_get_extra_data(packet->encoder, &header, &header_size))
+		header_size = 0;
+
+	rtc::scoped_refptr<webrtc::EncodedImageBuffer> data =
+		webrtc::EncodedImageBuffer::Create(header_size + packet->size);
+	if (header_size)
+		memcpy(data->data(), header, header_size);
+	memcpy(data->data() + header_size, packet->data, packet->size);
+
+	rtc::scoped_refptr<EncodedFrameBuffer> buffer(
+		new rtc::RefCountedObject<EncodedFrameBuffer>(
+			(int)obs_encoder_get_width(packet->encoder),
+			(int)obs_encoder_get_height(packet->encoder),
+			packet->keyframe, data));
+
+	// Align timestamps from OBS encoder with rtc::TimeMicros timebase
+	const int64_t aligned_timestamp_us =
+		timestamp_aligner_.TranslateTimestamp(packet->dts_usec,
+						      rtc::TimeMicros());
 
-	// RTCTransportStats
-	std::vector<const webrtc::RTCTransportStats *> transport_stats =
-		report->GetStatsOfType<webrtc::RTCTransportStats>();
-	for (const auto &stat : transport_stats) {
-		stats_list += "transport_bytes_sent:" +
-			      stat->bytes_sent.ValueToJson() + "\n";
-		stats_list += "transport_bytes_received:" +
-			      stat->bytes_received.ValueToJson() + "\n";
-	}
+	webrtc::VideoFrame video_frame =
+		webrtc::VideoFrame::Builder()
+			.set_video_frame_buffer(buffer)
+			.set_rotation(webrtc::kVideoRotation_0)
+			.set_timestamp_us(aligned_timestamp_us)
+			.set_id(++frame_id)
+			.build();
+
+	// Send encoded frame through the video track
+	videoCapturer->OnFrameCaptured(video_frame);
 }
 
-rtc::scoped_refptr<const webrtc::RTCStatsReport> WebRTCStream::NewGetStats()
+void WebRTCStream::receive_video_packet(void *param, encoder_packet *packet)
 {
-	webrtc::MutexLock lock(&crit_);
+	WebRTCStream *stream = (WebRTCStream *)param;
+	stream->onVideoPacket(packet);
+}
 
-	if (nullptr == pc) {
-		return nullptr;
-	}
+// NOTE LUDO: #80 add getStats
+void WebRTCStream::getStats()
+{
+	// Stats are gathered on a timer, get_stats_list returns the latest
+	// report
+}
 
-	rtc::scoped_refptr<StatsCallback> stats_callback =
-		new rtc::RefCountedObject<StatsCallback>();
+void WebRTCStream::startStats()
+{
+	signaling->Invoke<void>(RTC_FROM_HERE, [this]() {
+		stats_task.Stop();
+		stats_alive = std::make_shared<bool>(true);
+
+		std::weak_ptr<bool> alive = stats_alive;
+		rtc::scoped_refptr<StatsCallback> callback(
+			new rtc::RefCountedObject<StatsCallback>(
+				[this, alive](const rtc::scoped_refptr<
+					      const webrtc::RTCStatsReport>
+						      &report) {
+					// Delivered on the signaling thread,
+					// drop reports that arrive after
+					// stopStats()
+					if (alive.lock())
+						onStatsDelivered(report);
+				}));
+
+		stats_task = webrtc::RepeatingTaskHandle::Start(
+			signaling.get(), [this, callback]() {
+				if (pc)
+					pc->GetStats(callback);
+				return webrtc::TimeDelta::Millis(
+					STATS_INTERVAL_MS);
+			});
+	});
+}
 
-	pc->GetStats(stats_callback);
+void WebRTCStream::stopStats()
+{
+	signaling->Invoke<void>(RTC_FROM_HERE, [this]() {
+		stats_task.Stop();
+		stats_alive.reset();
+	});
+}
 
-	while (!stats_callback->called())
-		std::this_thread::sleep_for(std::chrono::microseconds(1));
+void WebRTCStream::onStatsDelivered(
+	const rtc::scoped_refptr<const webrtc::RTCStatsReport> &report)
+{
+	if (!report)
+		return;
 
-	return stats_callback->report();
+	std::shared_ptr<const WebRTCStats> previous = getStatsSnapshot();
+	std::atomic_store(&stats, WebRTCStats::FromReport(report,
+							  previous.get()));
 }
@@ -16,6 +16,9 @@
 // obs-webrtc includes
 #include "WebsocketClient.h"
 #include "VideoCapturer.h"
+#include "NV12FrameBuffer.h"
+#include "ObsVideoEncoderFactory.h"
+#include "WebRTCStats.h"
 #include "AudioDeviceModuleWrapper.h"
 #include "obsWebrtcAudioSource.h"
 
@@ -29,11 +32,16 @@
 #include "modules/audio_processing/include/audio_processing.h"
 #include "rtc_base/synchronization/mutex.h"
 #include "rtc_base/ref_counted_object.h"
+#include "rtc_base/task_utils/repeating_task.h"
 #include "rtc_base/thread.h"
 #include "rtc_base/timestamp_aligner.h"
 
 // std lib
+#include <atomic>
+#include <condition_variable>
 #include <initializer_list>
+#include <memory>
+#include <mutex>
 #include <regex>
 #include <string>
 #include <vector>
@@ -48,6 +56,13 @@ class WebRTCStreamInterface
 	  public webrtc::SetRemoteDescriptionObserverInterface {
 };
 
+// One simulcast encoding, read from the service settings
+struct SimulcastLayer {
+	std::string rid;
+	double scale_resolution_down_by;
+	int max_bitrate_kbps; // 0: let libwebrtc allocate
+};
+
 class WebRTCStream : public rtc::RefCountedObject<WebRTCStreamInterface> {
 public:
 	enum Type { Millicast = 0, CustomWebrtc = 1 };
@@ -60,6 +75,8 @@ public:
 	bool stop();
 	void onAudioFrame(audio_data *frame);
 	void onVideoFrame(video_data *frame);
+	void onVideoPacket(encoder_packet *packet);
+	static void receive_video_packet(void *param, encoder_packet *packet);
 	void setCodec(const std::string &new_codec)
 	{
 		this->video_codec = new_codec;
@@ -128,14 +145,24 @@ public:
 	void OnSetRemoteDescriptionComplete(webrtc::RTCError error) override;
 
 	// NOTE LUDO: #80 add getStats
-	// WebRTC stats
+	// WebRTC stats, collected periodically on the signaling thread.
+	// None of these wait for libwebrtc.
+	std::shared_ptr<const WebRTCStats> getStatsSnapshot() const
+	{
+		return std::atomic_load(&stats);
+	}
 	void getStats();
-	const char *get_stats_list() { return stats_list.c_str(); }
+	// The UI and plugins may ask from different threads, so each thread
+	// gets its own copy, valid until its next call
+	const char *get_stats_list()
+	{
+		thread_local std::string list;
+		list = getStatsSnapshot()->list;
+		return list.c_str();
+	}
 	// Bitrate & dropped frames
-	uint64_t getBitrate() { return total_bytes_sent; }
-	int getDroppedFrames() { return pli_received; }
-	// Synchronously get stats
-	rtc::scoped_refptr<const webrtc::RTCStatsReport> NewGetStats();
+	uint64_t getBitrate() { return getStatsSnapshot()->total_bytes_sent; }
+	int getDroppedFrames() { return (int)getStatsSnapshot()->pli_count; }
 
 	template<typename T> rtc::scoped_refptr<T> make_scoped_refptr(T *t)
 	{
@@ -155,28 +182,85 @@ private:
 	std::string audio_codec;
 	std::string video_codec;
 	bool simulcast;
+	// Largest layer first
+	std::vector<SimulcastLayer> simulcast_layers;
 	std::string publishApiUrl;
 	int channel_count;
 
 	void resetStats();
+	void startStats();
+	void stopStats();
+	void onStatsDelivered(
+		const rtc::scoped_refptr<const webrtc::RTCStatsReport> &report);
 
 	// NOTE LUDO: #80 add getStats
-	std::string stats_list;
 	uint16_t frame_id;
-	uint64_t audio_bytes_sent;
-	uint64_t video_bytes_sent;
-	uint64_t total_bytes_sent;
-	int pli_received;
-	// Used to compute fps
-	// NOTE ALEX: Should be initialized in constructor.
-	std::chrono::system_clock::time_point previous_time =
-		std::chrono::system_clock::time_point(
-			std::chrono::duration<int>(0));
-	uint32_t previous_frames_sent = 0;
+	// Latest snapshot, replaced with std::atomic_store
+	std::shared_ptr<const WebRTCStats> stats;
+	// Signaling thread only
+	webrtc::RepeatingTaskHandle stats_task;
+	std::shared_ptr<bool> stats_alive;
 
 	std::thread thread_closeAsync;
 
-	webrtc::Mutex crit_;
+	// Automatic recovery once media is flowing: ICE restart on the current
+	// Peer Connection first, then re-publishing on a new one. The factory,
+	// threads, tracks, capturer and OBS encoder are kept running.
+	enum class ConnectionLoss { IceDisconnected, Failed, SignalingLost };
+	bool createPeerConnection();
+	bool connectSignaling();
+	bool closePeerConnection(bool wait);
+	void startReconnect();
+	void stopReconnect();
+	bool canReconnect();
+	bool requestReconnect(ConnectionLoss loss);
+	void onIceConnected();
+	void reconnectLoop();
+	bool restartIce();
+	bool republish();
+
+	// Forwards the callbacks of one websocket client. Disconnecting is
+	// asynchronous: callbacks of a client that has since been closed or
+	// replaced must not act on the current connection, they are dropped.
+	class SignalingListener : public WebsocketClient::Listener {
+	public:
+		SignalingListener(WebRTCStream *stream, uint64_t generation)
+			: stream(stream), generation(generation)
+		{
+		}
+
+		void onConnected() override;
+		void onDisconnected() override;
+		void onLogged(int code) override;
+		void onLoggedError(int code) override;
+		void onOpened(const std::string &sdp) override;
+		void onOpenedError(int code) override;
+		void onRemoteIceCandidate(const std::string &sdpData) override;
+
+	private:
+		bool isCurrent(const char *callback) const;
+
+		WebRTCStream *stream;
+		const uint64_t generation;
+	};
+
+	// Data capture started: the output is on air
+	std::atomic<bool> media_started;
+	// Bumped whenever a websocket client is created or closed
+	std::atomic<uint64_t> signaling_generation;
+	// Listeners of the current and of the replaced websocket clients,
+	// kept until destruction since a late callback may still reach them
+	std::vector<std::unique_ptr<SignalingListener>> signaling_listeners;
+	std::thread reconnect_thread;
+	std::mutex reconnect_mutex;
+	std::condition_variable reconnect_cv;
+	// Guarded by reconnect_mutex
+	bool reconnect_enabled;
+	bool reconnect_stop;
+	bool reconnect_requested;
+	ConnectionLoss reconnect_loss;
+	bool attempt_pending;
+	bool ice_connected;
 
 	// Audio Wrapper
 	rtc::scoped_refptr<AudioDeviceModuleWrapper> adm;
@@ -185,6 +269,20 @@ private:
 	rtc::scoped_refptr<VideoCapturer> videoCapturer;
 	rtc::TimestampAligner timestamp_aligner_;
 
+	// Recycled NV12 frames handed to the video track
+	static const size_t kMaxPooledVideoFrames = 8;
+	NV12FrameBufferPool buffer_pool;
+	// Lower simulcast layers, scaled once per frame for all encoders
+	NV12LayerScaler layer_scaler;
+
+	// OBS video encoder whose packets are sent as is (H.264 only),
+	// nullptr when libwebrtc encodes the raw frames itself
+	obs_encoder_t *passthrough_encoder;
+	bool passthrough_started;
+	bool warned_bframes;
+	// Owned by the PeerConnectionFactory
+	ObsVideoEncoderFactory *video_encoder_factory;
+
 	// PeerConnection
 	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory;
 	rtc::scoped_refptr<webrtc::PeerConnectionInterface> pc;
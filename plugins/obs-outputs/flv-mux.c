@@ -501,3 +501,26 @@ void flv_additional_packet_mux(struct encoder_packet *packet,
 	*data = out.bytes.array;
 	*size = out.bytes.num;
 }
+
+void flv_packet_mux_buffer(struct array_output_data *buffer,
+			   struct encoder_packet *packet, int32_t dts_offset,
+			   bool is_header, size_t index)
+{
+	struct array_output_data reused = *buffer;
+	struct serializer s;
+
+	array_output_serializer_init(&s, buffer);
+	*buffer = reused;
+	buffer->bytes.num = 0;
+
+	if (index > 0) {
+		if (packet->type == OBS_ENCODER_VIDEO)
+			bcrash("who said you could output an additional "
+			       "video packet?");
+		flv_additional_audio(&s, dts_offset, packet, is_header, index);
+	} else if (packet->type == OBS_ENCODER_VIDEO) {
+		flv_video(&s, dts_offset, packet, is_header);
+	} else {
+		flv_audio(&s, dts_offset, packet, is_header);
+	}
+}
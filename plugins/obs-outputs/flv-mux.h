@@ -18,6 +18,7 @@
 #pragma once
 
 #include <obs.h>
+#include <util/array-serializer.h>
 
 #define MILLISECOND_DEN 1000
 
@@ -38,3 +39,9 @@ extern void flv_additional_packet_mux(struct encoder_packet *packet,
 				      int32_t dts_offset, uint8_t **output,
 				      size_t *size, bool is_header,
 				      size_t index);
+
+/* muxes a packet of track |index| into |buffer|, reusing its allocation */
+extern void flv_packet_mux_buffer(struct array_output_data *buffer,
+				  struct encoder_packet *packet,
+				  int32_t dts_offset, bool is_header,
+				  size_t index);
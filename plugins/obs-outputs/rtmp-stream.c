@@ -122,6 +122,7 @@ static void rtmp_stream_destroy(void *data)
 	os_sem_destroy(stream->send_sem);
 	pthread_mutex_destroy(&stream->packets_mutex);
 	circlebuf_free(&stream->packets);
+	array_output_serializer_free(&stream->mux_buffer);
 #ifdef TEST_FRAMEDROPS
 	circlebuf_free(&stream->droptest_info);
 #endif
@@ -423,21 +424,17 @@ static int send_packet(struct rtmp_stream *stream,
 		}
 	}
 
-	if (idx > 0) {
-		flv_additional_packet_mux(
-			packet, is_header ? 0 : stream->start_dts_offset, &data,
-			&size, is_header, idx);
-	} else {
-		flv_packet_mux(packet, is_header ? 0 : stream->start_dts_offset,
-			       &data, &size, is_header);
-	}
+	flv_packet_mux_buffer(&stream->mux_buffer, packet,
+			      is_header ? 0 : stream->start_dts_offset,
+			      is_header, idx);
+	data = stream->mux_buffer.bytes.array;
+	size = stream->mux_buffer.bytes.num;
 
 #ifdef TEST_FRAMEDROPS
 	droptest_cap_data_rate(stream, size);
 #endif
 
 	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
-	bfree(data);
 
 	if (is_header)
 		bfree(packet->data);
@@ -60,6 +60,9 @@ struct rtmp_stream {
 	struct circlebuf packets;
 	bool sent_headers;
 
+	/* FLV tag of the packet being sent, kept between packets */
+	struct array_output_data mux_buffer;
+
 	bool got_first_video;
 	int64_t start_dts_offset;
 
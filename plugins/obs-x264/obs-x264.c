@@ -725,6 +725,9 @@ static inline void init_pic_data(struct obs_x264 *obsx264, x264_picture_t *pic,
 	pic->i_pts = frame->pts;
 	pic->img.i_csp = obsx264->params.i_csp;
 
+	if (frame->force_keyframe)
+		pic->i_type = X264_TYPE_IDR;
+
 	if (obsx264->params.i_csp == X264_CSP_NV12)
 		pic->img.i_plane = 2;
 	else if (obsx264->params.i_csp == X264_CSP_I420)
@@ -1,6 +1,7 @@
 /* Copyright Dr. Alex. Gouaillard (2015, 2020) */
 
 #include <obs-module.h>
+#include <util/dstr.h>
 
 struct webrtc_custom {
 	char *server;
@@ -81,6 +82,34 @@ static bool use_auth_modified(obs_properties_t *ppts, obs_property_t *p,
 	return true;
 }
 
+static void webrtc_custom_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_double(settings, "simulcast_l_scale", 1.0);
+	obs_data_set_default_double(settings, "simulcast_m_scale", 2.0);
+	obs_data_set_default_double(settings, "simulcast_s_scale", 4.0);
+	obs_data_set_default_int(settings, "simulcast_l_bitrate", 0);
+	obs_data_set_default_int(settings, "simulcast_m_bitrate", 0);
+	obs_data_set_default_int(settings, "simulcast_s_bitrate", 0);
+}
+
+static void add_simulcast_layer_properties(obs_properties_t *ppts,
+					   const char *rid, const char *name)
+{
+	struct dstr key = {0};
+	struct dstr desc = {0};
+
+	dstr_printf(&key, "simulcast_%s_scale", rid);
+	dstr_printf(&desc, "Simulcast %s Layer Downscale", name);
+	obs_properties_add_float(ppts, key.array, desc.array, 1.0, 16.0, 0.5);
+
+	dstr_printf(&key, "simulcast_%s_bitrate", rid);
+	dstr_printf(&desc, "Simulcast %s Layer Max Bitrate (0 = Auto)", name);
+	obs_properties_add_int(ppts, key.array, desc.array, 0, 100000, 50);
+
+	dstr_free(&key);
+	dstr_free(&desc);
+}
+
 static obs_properties_t *webrtc_custom_properties(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -96,6 +125,10 @@ static obs_properties_t *webrtc_custom_properties(void *unused)
 	obs_properties_add_text(ppts, "codec", "Codec", OBS_TEXT_DEFAULT);
 	obs_properties_add_text(ppts, "protocol", "Protocol", OBS_TEXT_DEFAULT);
 
+	add_simulcast_layer_properties(ppts, "l", "High");
+	add_simulcast_layer_properties(ppts, "m", "Medium");
+	add_simulcast_layer_properties(ppts, "s", "Low");
+
 	obs_property_list_add_string(obs_properties_get(ppts, "codec"), "AV1",
 				     "av1");
 
@@ -187,6 +220,7 @@ struct obs_service_info webrtc_custom_service = {
 	.create = webrtc_custom_create,
 	.destroy = webrtc_custom_destroy,
 	.update = webrtc_custom_update,
+	.get_defaults = webrtc_custom_defaults,
 	.get_properties = webrtc_custom_properties,
 	.get_url = webrtc_custom_url,
 	.get_key = webrtc_custom_key,
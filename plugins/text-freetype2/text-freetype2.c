@@ -187,10 +187,115 @@ static obs_properties_t *ft2_source_properties(void *unused)
 	return props;
 }
 
+static wchar_t *read_text_file(struct ft2_source *srcdata, const char *file)
+{
+	return srcdata->log_mode ? read_from_end(srcdata, file)
+				 : load_text_from_file(srcdata, file);
+}
+
+static void ft2_file_changed(void *data)
+{
+	struct ft2_source *srcdata = data;
+	os_event_signal(srcdata->file_event);
+}
+
+/* watched files are still polled now and then, the watch misses changes to
+ * symlink targets and on network file systems */
+static void *ft2_file_thread(void *data)
+{
+	struct ft2_source *srcdata = data;
+	unsigned long interval = srcdata->file_watch ? 5000 : 1000;
+	time_t timestamp = srcdata->m_timestamp;
+
+	os_set_thread_name("ft2: text file");
+
+	for (;;) {
+		int ret = os_event_timedwait(srcdata->file_event, interval);
+		time_t t;
+		wchar_t *text;
+
+		if (os_atomic_load_bool(&srcdata->file_stop))
+			break;
+
+		t = get_modified_timestamp(srcdata->text_file);
+		if (ret == ETIMEDOUT && t == timestamp)
+			continue;
+
+		timestamp = t;
+		text = read_text_file(srcdata, srcdata->text_file);
+		if (!text)
+			continue;
+
+		pthread_mutex_lock(&srcdata->pending_mutex);
+		bfree(srcdata->pending_text);
+		srcdata->pending_text = text;
+		pthread_mutex_unlock(&srcdata->pending_mutex);
+	}
+
+	return NULL;
+}
+
+static void start_file_thread(struct ft2_source *srcdata)
+{
+	if (os_event_init(&srcdata->file_event, OS_EVENT_TYPE_AUTO) != 0)
+		return;
+
+	srcdata->file_stop = false;
+	srcdata->file_watch = os_file_watch_create(srcdata->text_file,
+						   ft2_file_changed, srcdata);
+
+	if (pthread_create(&srcdata->file_thread, NULL, ft2_file_thread,
+			   srcdata) != 0) {
+		blog(LOG_WARNING, "FT2-text: Failed to create file thread");
+		os_file_watch_destroy(srcdata->file_watch);
+		srcdata->file_watch = NULL;
+		os_event_destroy(srcdata->file_event);
+		srcdata->file_event = NULL;
+		return;
+	}
+
+	srcdata->file_thread_active = true;
+}
+
+/* text read but not swapped in yet is dropped, it may be from a file or in
+ * a mode that is about to change */
+static void stop_file_thread(struct ft2_source *srcdata)
+{
+	if (!srcdata->file_thread_active)
+		return;
+
+	os_file_watch_destroy(srcdata->file_watch);
+	srcdata->file_watch = NULL;
+
+	os_atomic_set_bool(&srcdata->file_stop, true);
+	os_event_signal(srcdata->file_event);
+	pthread_join(srcdata->file_thread, NULL);
+
+	os_event_destroy(srcdata->file_event);
+	srcdata->file_event = NULL;
+	srcdata->file_thread_active = false;
+
+	pthread_mutex_lock(&srcdata->pending_mutex);
+	bfree(srcdata->pending_text);
+	srcdata->pending_text = NULL;
+	pthread_mutex_unlock(&srcdata->pending_mutex);
+}
+
+static inline void set_text(struct ft2_source *srcdata, wchar_t *text)
+{
+	if (text) {
+		bfree(srcdata->text);
+		srcdata->text = text;
+	}
+}
+
 static void ft2_source_destroy(void *data)
 {
 	struct ft2_source *srcdata = data;
 
+	stop_file_thread(srcdata);
+	pthread_mutex_destroy(&srcdata->pending_mutex);
+
 	if (srcdata->font_face != NULL) {
 		FT_Done_Face(srcdata->font_face);
 		srcdata->font_face = NULL;
@@ -262,30 +367,22 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 static void ft2_video_tick(void *data, float seconds)
 {
 	struct ft2_source *srcdata = data;
+	wchar_t *text;
+
 	if (srcdata == NULL)
 		return;
-	if (!srcdata->from_file || !srcdata->text_file)
+	if (!srcdata->from_file)
 		return;
 
-	if (os_gettime_ns() - srcdata->last_checked >= 1000000000) {
-		time_t t = get_modified_timestamp(srcdata->text_file);
-		srcdata->last_checked = os_gettime_ns();
-
-		if (srcdata->update_file) {
-			if (srcdata->log_mode)
-				read_from_end(srcdata, srcdata->text_file);
-			else
-				load_text_from_file(srcdata,
-						    srcdata->text_file);
-			cache_glyphs(srcdata, srcdata->text);
-			set_up_vertex_buffer(srcdata);
-			srcdata->update_file = false;
-		}
+	pthread_mutex_lock(&srcdata->pending_mutex);
+	text = srcdata->pending_text;
+	srcdata->pending_text = NULL;
+	pthread_mutex_unlock(&srcdata->pending_mutex);
 
-		if (srcdata->m_timestamp != t) {
-			srcdata->m_timestamp = t;
-			srcdata->update_file = true;
-		}
+	if (text) {
+		set_text(srcdata, text);
+		cache_glyphs(srcdata, srcdata->text);
+		set_up_vertex_buffer(srcdata);
 	}
 
 	UNUSED_PARAMETER(seconds);
@@ -325,6 +422,9 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	if (!font_obj)
 		return;
 
+	/* the file thread reads the text file and chat log settings */
+	stop_file_thread(srcdata);
+
 	srcdata->outline_width = 0;
 
 	srcdata->drop_shadow = obs_data_get_bool(settings, "drop_shadow");
@@ -475,14 +575,13 @@ skip_font_load:
 			bfree(srcdata->text_file);
 
 			srcdata->text_file = bstrdup(tmp);
-			if (chat_log_mode)
-				read_from_end(srcdata, tmp);
-			else
-				load_text_from_file(srcdata, tmp);
-			srcdata->last_checked = os_gettime_ns();
+			srcdata->m_timestamp =
+				get_modified_timestamp(srcdata->text_file);
+			set_text(srcdata, read_text_file(srcdata, tmp));
 		}
 	} else {
 		const char *tmp = obs_data_get_string(settings, "text");
+
 		if (!tmp || !*tmp)
 			goto error;
 
@@ -500,6 +599,9 @@ skip_font_load:
 	}
 
 error:
+	if (srcdata->from_file && srcdata->text_file)
+		start_file_thread(srcdata);
+
 	obs_data_release(font_obj);
 }
 
@@ -518,6 +620,8 @@ static void *ft2_source_create(obs_data_t *settings, obs_source_t *source,
 	obs_data_t *font_obj = obs_data_create();
 	srcdata->src = source;
 
+	pthread_mutex_init(&srcdata->pending_mutex, NULL);
+
 	init_plugin();
 
 	const uint16_t font_size = ver == 1 ? 32 : 256;
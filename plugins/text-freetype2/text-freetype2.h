@@ -18,6 +18,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
 #include <ft2build.h>
 
 #define num_cache_slots 65535
@@ -41,8 +43,17 @@ struct ft2_source {
 	char *text_file;
 	wchar_t *text;
 	time_t m_timestamp;
-	bool update_file;
-	uint64_t last_checked;
+
+	/* the text file is read on a thread of its own, woken up by the file
+	 * watch or polling the file, and the text is swapped in on the next
+	 * tick.  the thread is stopped while the settings are updated. */
+	os_file_watch_t *file_watch;
+	pthread_t file_thread;
+	bool file_thread_active;
+	os_event_t *file_event;
+	volatile bool file_stop;
+	pthread_mutex_t pending_mutex;
+	wchar_t *pending_text;
 
 	uint32_t cx, cy, max_h, custom_width;
 	uint32_t outline_width;
@@ -91,8 +102,8 @@ static const char *ft2_source_get_name(void *unused);
 uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata);
 
 time_t get_modified_timestamp(char *filename);
-void load_text_from_file(struct ft2_source *srcdata, const char *filename);
-void read_from_end(struct ft2_source *srcdata, const char *filename);
+wchar_t *load_text_from_file(struct ft2_source *srcdata, const char *filename);
+wchar_t *read_from_end(struct ft2_source *srcdata, const char *filename);
 
 void cache_standard_glyphs(struct ft2_source *srcdata);
 void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs);
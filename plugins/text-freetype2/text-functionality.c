@@ -418,11 +418,12 @@ static void remove_cr(wchar_t *source)
 	source[j] = '\0';
 }
 
-void load_text_from_file(struct ft2_source *srcdata, const char *filename)
+wchar_t *load_text_from_file(struct ft2_source *srcdata, const char *filename)
 {
 	FILE *tmp_file = NULL;
 	uint32_t filesize = 0;
 	char *tmp_read = NULL;
+	wchar_t *text = NULL;
 	uint16_t header = 0;
 	size_t bytes_read;
 
@@ -432,7 +433,7 @@ void load_text_from_file(struct ft2_source *srcdata, const char *filename)
 			blog(LOG_WARNING, "Failed to open file %s", filename);
 			srcdata->file_load_failed = true;
 		}
-		return;
+		return NULL;
 	}
 	fseek(tmp_file, 0, SEEK_END);
 	filesize = (uint32_t)ftell(tmp_file);
@@ -441,17 +442,13 @@ void load_text_from_file(struct ft2_source *srcdata, const char *filename)
 
 	if (bytes_read == 2 && header == 0xFEFF) {
 		// File is already in UTF-16 format
-		if (srcdata->text != NULL) {
-			bfree(srcdata->text);
-			srcdata->text = NULL;
-		}
-		srcdata->text = bzalloc(filesize);
-		bytes_read = fread(srcdata->text, filesize - 2, 1, tmp_file);
+		text = bzalloc(filesize);
+		bytes_read = fread(text, filesize - 2, 1, tmp_file);
 
 		bfree(tmp_read);
 		fclose(tmp_file);
 
-		return;
+		return text;
 	}
 
 	fseek(tmp_file, 0, SEEK_SET);
@@ -460,23 +457,21 @@ void load_text_from_file(struct ft2_source *srcdata, const char *filename)
 	bytes_read = fread(tmp_read, filesize, 1, tmp_file);
 	fclose(tmp_file);
 
-	if (srcdata->text != NULL) {
-		bfree(srcdata->text);
-		srcdata->text = NULL;
-	}
-	srcdata->text = bzalloc((strlen(tmp_read) + 1) * sizeof(wchar_t));
-	os_utf8_to_wcs(tmp_read, strlen(tmp_read), srcdata->text,
+	text = bzalloc((strlen(tmp_read) + 1) * sizeof(wchar_t));
+	os_utf8_to_wcs(tmp_read, strlen(tmp_read), text,
 		       (strlen(tmp_read) + 1));
 
-	remove_cr(srcdata->text);
+	remove_cr(text);
 	bfree(tmp_read);
+	return text;
 }
 
-void read_from_end(struct ft2_source *srcdata, const char *filename)
+wchar_t *read_from_end(struct ft2_source *srcdata, const char *filename)
 {
 	FILE *tmp_file = NULL;
 	uint32_t filesize = 0, cur_pos = 0, log_lines = 0;
 	char *tmp_read = NULL;
+	wchar_t *text = NULL;
 	uint16_t value = 0, line_breaks = 0;
 	size_t bytes_read;
 	char bvalue;
@@ -489,7 +484,7 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 			blog(LOG_WARNING, "Failed to open file %s", filename);
 			srcdata->file_load_failed = true;
 		}
-		return;
+		return NULL;
 	}
 	bytes_read = fread(&value, 2, 1, tmp_file);
 
@@ -525,35 +520,27 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 	fseek(tmp_file, cur_pos, SEEK_SET);
 
 	if (utf16) {
-		if (srcdata->text != NULL) {
-			bfree(srcdata->text);
-			srcdata->text = NULL;
-		}
-		srcdata->text = bzalloc(filesize - cur_pos);
-		bytes_read =
-			fread(srcdata->text, (filesize - cur_pos), 1, tmp_file);
+		text = bzalloc(filesize - cur_pos);
+		bytes_read = fread(text, (filesize - cur_pos), 1, tmp_file);
 
-		remove_cr(srcdata->text);
+		remove_cr(text);
 		bfree(tmp_read);
 		fclose(tmp_file);
 
-		return;
+		return text;
 	}
 
 	tmp_read = bzalloc((filesize - cur_pos) + 1);
 	bytes_read = fread(tmp_read, filesize - cur_pos, 1, tmp_file);
 	fclose(tmp_file);
 
-	if (srcdata->text != NULL) {
-		bfree(srcdata->text);
-		srcdata->text = NULL;
-	}
-	srcdata->text = bzalloc((strlen(tmp_read) + 1) * sizeof(wchar_t));
-	os_utf8_to_wcs(tmp_read, strlen(tmp_read), srcdata->text,
+	text = bzalloc((strlen(tmp_read) + 1) * sizeof(wchar_t));
+	os_utf8_to_wcs(tmp_read, strlen(tmp_read), text,
 		       (strlen(tmp_read) + 1));
 
-	remove_cr(srcdata->text);
+	remove_cr(text);
 	bfree(tmp_read);
+	return text;
 }
 
 uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
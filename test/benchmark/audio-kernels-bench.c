@@ -0,0 +1,216 @@
+/*
+ * Throughput of the audio kernels compared to plain scalar loops.  Both are
+ * run alternately a few times and the best run of each is kept, the first
+ * loops run otherwise get an edge over the later ones.
+ *
+ * usage: audio-kernels-bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <util/platform.h>
+#include <media-io/audio-kernels.h>
+#include <media-io/audio-io.h>
+
+#define CHANNELS 2
+#define FRAMES AUDIO_OUTPUT_FRAMES
+#define SAMPLES (FRAMES * CHANNELS)
+#define RUNS 5
+
+static float src[SAMPLES];
+static float dst[SAMPLES];
+static float gain[SAMPLES];
+static int16_t s16[SAMPLES];
+
+/* keeps the compiler from dropping the scalar loops */
+static volatile float sink;
+
+/* the scalar loops get their sample count at run time like the code they
+ * stand for, otherwise the compiler vectorizes them for this exact size */
+static volatile size_t samples = SAMPLES;
+
+static void scalar_mix_add(void)
+{
+	const size_t count = samples;
+
+	for (size_t i = 0; i < count; i++)
+		dst[i] += src[i];
+}
+
+static void scalar_mix_add_gain(void)
+{
+	const size_t count = samples;
+
+	for (size_t i = 0; i < count; i++)
+		dst[i] += src[i] * gain[i];
+}
+
+static void scalar_mix_add_ramp(void)
+{
+	const size_t count = samples;
+
+	for (size_t i = 0; i < count; i++)
+		dst[i] += src[i] * (0.5f + 0.0001f * (float)i);
+}
+
+static void scalar_mul(void)
+{
+	const size_t count = samples;
+
+	for (size_t i = 0; i < count; i++)
+		dst[i] *= -1.0f;
+}
+
+static void scalar_clamp(void)
+{
+	const size_t count = samples;
+
+	for (size_t i = 0; i < count; i++) {
+		float val = dst[i];
+		val = (val > 1.0f) ? 1.0f : val;
+		val = (val < -1.0f) ? -1.0f : val;
+		dst[i] = val;
+	}
+}
+
+static void scalar_float_to_s16(void)
+{
+	const size_t count = samples;
+
+	for (size_t i = 0; i < count; i++) {
+		float val = src[i];
+		val = (val > 1.0f) ? 1.0f : val;
+		val = (val < -1.0f) ? -1.0f : val;
+		s16[i] = (int16_t)(val * 32767.0f);
+	}
+}
+
+static void scalar_interleave(void)
+{
+	for (size_t i = 0; i < FRAMES; i++) {
+		dst[i * 2] = src[i];
+		dst[i * 2 + 1] = src[FRAMES + i];
+	}
+}
+
+static void scalar_deinterleave(void)
+{
+	for (size_t i = 0; i < FRAMES; i++) {
+		dst[i] = src[i * 2];
+		dst[FRAMES + i] = src[i * 2 + 1];
+	}
+}
+
+static void kernel_mix_add(void)
+{
+	audio_mix_add(dst, src, SAMPLES);
+}
+
+static void kernel_mix_add_gain(void)
+{
+	audio_mix_add_gain(dst, src, gain, SAMPLES);
+}
+
+static void kernel_mix_add_ramp(void)
+{
+	audio_mix_add_ramp(dst, src, 0.5f, 0.0001f, SAMPLES);
+}
+
+static void kernel_mul(void)
+{
+	audio_mul(dst, -1.0f, SAMPLES);
+}
+
+static void kernel_clamp(void)
+{
+	audio_clamp(dst, SAMPLES);
+}
+
+static void kernel_float_to_s16(void)
+{
+	audio_float_to_s16(s16, src, SAMPLES);
+}
+
+static void kernel_interleave(void)
+{
+	const float *planes[CHANNELS] = {src, src + FRAMES};
+	audio_interleave(dst, planes, CHANNELS, FRAMES);
+}
+
+static void kernel_deinterleave(void)
+{
+	float *planes[CHANNELS] = {dst, dst + FRAMES};
+	audio_deinterleave(planes, src, CHANNELS, FRAMES);
+}
+
+struct bench {
+	const char *name;
+	void (*scalar)(void);
+	void (*kernel)(void);
+};
+
+static const struct bench benches[] = {
+	{"mix_add", scalar_mix_add, kernel_mix_add},
+	{"mix_add_gain", scalar_mix_add_gain, kernel_mix_add_gain},
+	{"mix_add_ramp", scalar_mix_add_ramp, kernel_mix_add_ramp},
+	{"mul", scalar_mul, kernel_mul},
+	{"clamp", scalar_clamp, kernel_clamp},
+	{"float_to_s16", scalar_float_to_s16, kernel_float_to_s16},
+	{"interleave", scalar_interleave, kernel_interleave},
+	{"deinterleave", scalar_deinterleave, kernel_deinterleave},
+};
+
+static double run(void (*func)(void), long iterations)
+{
+	uint64_t start;
+
+	for (size_t i = 0; i < SAMPLES; i++)
+		dst[i] = src[i];
+
+	start = os_gettime_ns();
+
+	for (long i = 0; i < iterations; i++)
+		func();
+
+	uint64_t elapsed = os_gettime_ns() - start;
+	sink = dst[0] + (float)s16[0];
+
+	/* millions of samples per second */
+	return (double)SAMPLES * (double)iterations * 1000.0 /
+	       (double)(elapsed ? elapsed : 1);
+}
+
+int main(int argc, char *argv[])
+{
+	long iterations = argc > 1 ? atol(argv[1]) : 50000;
+
+	for (size_t i = 0; i < SAMPLES; i++) {
+		src[i] = sinf((float)i * 0.01f) * 1.2f;
+		gain[i] = (float)i / (float)SAMPLES;
+	}
+
+	printf("%-14s %12s %12s %8s\n", "kernel", "scalar MS/s", "simd MS/s",
+	       "speedup");
+
+	for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		const struct bench *b = &benches[i];
+		double scalar = 0.0, kernel = 0.0;
+
+		for (int j = 0; j < RUNS; j++) {
+			double val = run(b->scalar, iterations);
+			if (val > scalar)
+				scalar = val;
+
+			val = run(b->kernel, iterations);
+			if (val > kernel)
+				kernel = val;
+		}
+
+		printf("%-14s %12.1f %12.1f %7.2fx\n", b->name, scalar, kernel,
+		       kernel / scalar);
+	}
+
+	return 0;
+}
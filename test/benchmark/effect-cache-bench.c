@@ -0,0 +1,145 @@
+/*
+ * Startup cost of the core effects with a cold and a warm shader cache.
+ *
+ * Initializes video twice with the OpenGL renderer and draws every pass of
+ * the base effects so that all their programs get linked.  The first run
+ * starts from an empty cache, the second one reuses what the first wrote.
+ * Driver-side caches (e.g. Mesa's) also apply to the cold run unless they
+ * are disabled, with MESA_SHADER_CACHE_DISABLE=true for Mesa.
+ *
+ * usage: effect-cache-bench [config dir]
+ */
+
+#include <stdio.h>
+
+#include <obs.h>
+#include <graphics/effect.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+
+#define GRAPHICS_MODULE "libobs-opengl"
+
+static void clear_cache(const char *config_dir)
+{
+	struct dstr path = {0};
+	struct os_dirent *ent;
+	os_dir_t *dir;
+
+	dstr_printf(&path, "%s/%s/shader-cache", config_dir, GRAPHICS_MODULE);
+
+	dir = os_opendir(path.array);
+	if (dir) {
+		while ((ent = os_readdir(dir)) != NULL) {
+			struct dstr file = {0};
+
+			if (ent->directory)
+				continue;
+
+			dstr_printf(&file, "%s/%s", path.array, ent->d_name);
+			os_unlink(file.array);
+			dstr_free(&file);
+		}
+
+		os_closedir(dir);
+	}
+
+	dstr_free(&path);
+}
+
+static void draw_all_passes(gs_effect_t *effect)
+{
+	if (!effect)
+		return;
+
+	for (size_t i = 0; i < effect->techniques.num; i++) {
+		gs_technique_t *tech = effect->techniques.array + i;
+		size_t passes = gs_technique_begin(tech);
+
+		for (size_t j = 0; j < passes; j++) {
+			if (gs_technique_begin_pass(tech, j)) {
+				gs_draw(GS_TRIS, 0, 3);
+				gs_technique_end_pass(tech);
+			}
+		}
+
+		gs_technique_end(tech);
+	}
+}
+
+static bool run(const char *config_dir, uint64_t *init_ns,
+		uint64_t *link_ns)
+{
+	struct obs_video_info ovi = {
+		.graphics_module = GRAPHICS_MODULE,
+		.fps_num = 30,
+		.fps_den = 1,
+		.base_width = 64,
+		.base_height = 64,
+		.output_width = 64,
+		.output_height = 64,
+		.output_format = VIDEO_FORMAT_NV12,
+		.gpu_conversion = true,
+		.colorspace = VIDEO_CS_709,
+		.range = VIDEO_RANGE_PARTIAL,
+		.scale_type = OBS_SCALE_BICUBIC,
+	};
+	gs_texture_t *target;
+	uint64_t start;
+
+	if (!obs_startup("en-US", config_dir, NULL))
+		return false;
+
+	start = os_gettime_ns();
+	if (obs_reset_video(&ovi) != OBS_VIDEO_SUCCESS) {
+		obs_shutdown();
+		return false;
+	}
+	*init_ns = os_gettime_ns() - start;
+
+	obs_enter_graphics();
+
+	target = gs_texture_create(64, 64, GS_RGBA, 1, NULL, GS_RENDER_TARGET);
+	gs_set_render_target(target, NULL);
+	gs_load_vertexbuffer(NULL);
+	gs_load_indexbuffer(NULL);
+
+	start = os_gettime_ns();
+	for (int i = OBS_EFFECT_DEFAULT; i <= OBS_EFFECT_AREA; i++)
+		draw_all_passes(obs_get_base_effect((enum obs_base_effect)i));
+	gs_flush();
+	*link_ns = os_gettime_ns() - start;
+
+	gs_set_render_target(NULL, NULL);
+	gs_texture_destroy(target);
+
+	obs_leave_graphics();
+
+	obs_shutdown();
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *config_dir = argc > 1 ? argv[1] : "effect-cache-bench";
+	const char *names[] = {"cold", "warm"};
+
+	clear_cache(config_dir);
+
+	printf("%-6s %12s %12s %12s\n", "cache", "init ms", "link ms",
+	       "total ms");
+
+	for (size_t i = 0; i < 2; i++) {
+		uint64_t init_ns = 0, link_ns = 0;
+
+		if (!run(config_dir, &init_ns, &link_ns)) {
+			fprintf(stderr, "Failed to initialize video\n");
+			return 1;
+		}
+
+		printf("%-6s %12.2f %12.2f %12.2f\n", names[i],
+		       init_ns / 1000000.0, link_ns / 1000000.0,
+		       (init_ns + link_ns) / 1000000.0);
+	}
+
+	return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * Cost of interleaving encoded packets: the per-track ring buffers used by
+ * outputs compared to the single sorted array they replaced.
+ *
+ * Replays a packet timeline: packets are inserted in arrival order and the
+ * first packet of the interleaved order is sent once more than |depth|
+ * packets are buffered, as an output does at startup or with a stream
+ * delay.  Without a file, the timeline is 60 fps video with 1 and 6 AAC
+ * tracks, video packets arriving two frames late (encoder latency).
+ *
+ * A timeline file has one packet per line, in arrival order:
+ *
+ *   <track> <dts in microseconds>
+ *
+ * track 0 being video and tracks 1 to 6 the audio mixes.
+ *
+ * usage: interleave-bench [timeline file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include <obs-interleave.h>
+#include <util/darray.h>
+#include <util/platform.h>
+
+#define SECONDS 600
+#define VIDEO_LATENCY_USEC 33333
+
+struct timeline {
+	DARRAY(struct encoder_packet) packets;
+};
+
+/* order sensitive, so that both implementations must send the same packets
+ * in the same order */
+static inline void hash_packet(uint64_t *hash, const struct encoder_packet *p)
+{
+	*hash = *hash * 31 + (uint64_t)p->dts_usec * 2 +
+		(p->type == OBS_ENCODER_VIDEO);
+}
+
+static void add_packet(struct timeline *tl, size_t track, int64_t dts_usec)
+{
+	struct encoder_packet *packet = da_push_back_new(tl->packets);
+
+	packet->type = track ? OBS_ENCODER_AUDIO : OBS_ENCODER_VIDEO;
+	packet->track_idx = track ? track - 1 : 0;
+	packet->dts_usec = dts_usec;
+}
+
+/* packets of all tracks, ordered by the time they leave their encoder */
+static void generate_timeline(struct timeline *tl, size_t audio_tracks)
+{
+	const int64_t video_usec = 1000000 / 60;
+	const int64_t audio_usec = 1024 * 1000000 / 48000;
+	const int64_t end = (int64_t)SECONDS * 1000000;
+	int64_t video_dts = 0;
+	int64_t audio_dts = 0;
+
+	while (video_dts < end || audio_dts < end) {
+		if (video_dts + VIDEO_LATENCY_USEC <= audio_dts) {
+			add_packet(tl, 0, video_dts);
+			video_dts += video_usec;
+		} else {
+			for (size_t i = 1; i <= audio_tracks; i++)
+				add_packet(tl, i, audio_dts);
+			audio_dts += audio_usec;
+		}
+	}
+}
+
+static bool load_timeline(struct timeline *tl, const char *path)
+{
+	FILE *file = os_fopen(path, "r");
+	unsigned int track;
+	int64_t dts_usec;
+
+	if (!file)
+		return false;
+
+	while (fscanf(file, "%u %" SCNd64, &track, &dts_usec) == 2) {
+		if (track < INTERLEAVED_TRACKS)
+			add_packet(tl, track, dts_usec);
+	}
+
+	fclose(file);
+	return tl->packets.num != 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* previous implementation: one array kept sorted on insertion               */
+
+static void array_insert(struct darray *da, struct encoder_packet *out)
+{
+	DARRAY(struct encoder_packet) packets;
+	size_t idx;
+
+	packets.da = *da;
+
+	for (idx = 0; idx < packets.num; idx++) {
+		struct encoder_packet *cur_packet = packets.array + idx;
+
+		if (out->dts_usec == cur_packet->dts_usec &&
+		    out->type == OBS_ENCODER_VIDEO) {
+			break;
+		} else if (out->dts_usec < cur_packet->dts_usec) {
+			break;
+		}
+	}
+
+	da_insert(packets, idx, out);
+	*da = packets.da;
+}
+
+static uint64_t replay_array(const struct timeline *tl, size_t depth,
+			     uint64_t *checksum)
+{
+	DARRAY(struct encoder_packet) packets;
+	uint64_t start;
+
+	da_init(packets);
+	start = os_gettime_ns();
+
+	for (size_t i = 0; i < tl->packets.num; i++) {
+		array_insert(&packets.da, tl->packets.array + i);
+
+		if (packets.num > depth) {
+			hash_packet(checksum, packets.array);
+			da_erase(packets, 0);
+		}
+	}
+
+	start = os_gettime_ns() - start;
+	da_free(packets);
+	return start;
+}
+
+/* ------------------------------------------------------------------------- */
+/* per-track ring buffers (obs-interleave.h)                                 */
+
+static uint64_t replay_tracks(const struct timeline *tl, size_t depth,
+			      uint64_t *checksum)
+{
+	struct interleaved_track tracks[INTERLEAVED_TRACKS] = {0};
+	size_t buffered = 0;
+	uint64_t start;
+
+	start = os_gettime_ns();
+
+	for (size_t i = 0; i < tl->packets.num; i++) {
+		struct encoder_packet *packet = tl->packets.array + i;
+		size_t idx = packet->type == OBS_ENCODER_VIDEO
+				     ? 0
+				     : packet->track_idx + 1;
+
+		interleaved_track_push(&tracks[idx], packet);
+
+		if (++buffered > depth) {
+			size_t track_idx = 0;
+
+			packet = interleaved_tracks_first(tracks, &track_idx);
+			hash_packet(checksum, packet);
+			interleaved_track_pop(&tracks[track_idx]);
+			buffered--;
+		}
+	}
+
+	start = os_gettime_ns() - start;
+
+	for (size_t i = 0; i < INTERLEAVED_TRACKS; i++)
+		bfree(tracks[i].packets);
+	return start;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool run(const char *name, const struct timeline *tl)
+{
+	static const size_t depths[] = {8, 64, 512, 2048};
+	bool match = true;
+
+	printf("%s: %zu packets\n", name, tl->packets.num);
+	printf("%-8s %14s %14s %10s\n", "depth", "array ns/pkt",
+	       "tracks ns/pkt", "speedup");
+
+	for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+		uint64_t array_sum = 0, tracks_sum = 0;
+		uint64_t array_ns =
+			replay_array(tl, depths[i], &array_sum);
+		uint64_t tracks_ns =
+			replay_tracks(tl, depths[i], &tracks_sum);
+
+		printf("%-8zu %14.1f %14.1f %9.1fx\n", depths[i],
+		       (double)array_ns / (double)tl->packets.num,
+		       (double)tracks_ns / (double)tl->packets.num,
+		       (double)array_ns / (double)tracks_ns);
+
+		if (array_sum != tracks_sum)
+			match = false;
+	}
+
+	printf("\n");
+	return match;
+}
+
+int main(int argc, char *argv[])
+{
+	bool match = true;
+
+	if (argc > 1) {
+		struct timeline tl = {0};
+
+		if (!load_timeline(&tl, argv[1])) {
+			fprintf(stderr, "Failed to load '%s'\n", argv[1]);
+			return 1;
+		}
+
+		match = run(argv[1], &tl);
+		da_free(tl.packets);
+	} else {
+		static const size_t audio_tracks[] = {1, 6};
+
+		for (size_t i = 0; i < 2; i++) {
+			struct timeline tl = {0};
+			char name[64];
+
+			generate_timeline(&tl, audio_tracks[i]);
+			snprintf(name, sizeof(name), "60 fps + %zu audio",
+				 audio_tracks[i]);
+
+			match = run(name, &tl) && match;
+			da_free(tl.packets);
+		}
+	}
+
+	if (!match) {
+		fprintf(stderr, "Implementations sent packets in a "
+				"different order\n");
+		return 1;
+	}
+
+	return 0;
+}
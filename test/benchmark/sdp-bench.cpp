@@ -0,0 +1,800 @@
+/*
+ * Cost of the SDP munging done by the WebRTC outputs: SDPModif, which parses
+ * the description once, compared to the regex based munging it replaced
+ * (sdp-regex.h).
+ *
+ * Each setter is run on its own and chained as WebRTCStream does, on offers
+ * as created by the libwebrtc of the WebRTC outputs (with and without the
+ * gathered candidates) and on a media server answer.  Every output of SDPModif is checked against the one of the
+ * previous implementation, apart from two bugs SDPModif fixed:
+ *
+ *  - removing a payload also removed the other lines containing
+ *    ":<payload> ", like "a=rtcp:9 ..." with G722 (9) or "a=extmap:13 ..."
+ *    with CN (13).  These lines are left out of the comparison, and checked
+ *    to be all kept instead.
+ *  - an fmtp line added for bitrateMaxMin was written "a= fmtp:".
+ *
+ * Other SDP files can be given, with LF or CRLF line endings.
+ *
+ * usage: sdp-bench [sdp file] ...
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <util/platform.h>
+
+#include "SDPModif.h"
+#include "sdp-regex.h"
+
+#define ITERATIONS 100
+
+#define VIDEO_KBPS 2500
+#define AUDIO_KBPS 64
+
+/* libwebrtc offer, trickle ICE (no candidates) */
+static const char offer_trickle[] =
+	"v=0\r\n"
+	"o=- 4611731400430051336 2 IN IP4 127.0.0.1\r\n"
+	"s=-\r\n"
+	"t=0 0\r\n"
+	"a=group:BUNDLE 0 1\r\n"
+	"a=msid-semantic: WMS stream\r\n"
+	"m=audio 9 UDP/TLS/RTP/SAVPF 111 103 104 9 0 8 106 105 13 110 112 "
+	"113 126\r\n"
+	"c=IN IP4 0.0.0.0\r\n"
+	"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+	"a=ice-ufrag:ZZZZ\r\n"
+	"a=ice-pwd:AU/SQPupllyS0SDG/eRWDCfA\r\n"
+	"a=ice-options:trickle\r\n"
+	"a=fingerprint:sha-256 22:8A:4E:1B:6C:90:3F:D2:57:0A:B8:E4:13:9C:"
+	"7D:F1:02:6B:A9:34:C5:8E:71:D0:2F:BB:46:E3:19:85:5A:C7\r\n"
+	"a=setup:actpass\r\n"
+	"a=mid:0\r\n"
+	"a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\n"
+	"a=sendonly\r\n"
+	"a=msid:stream audio\r\n"
+	"a=rtcp-mux\r\n"
+	"a=rtpmap:111 opus/48000/2\r\n"
+	"a=rtcp-fb:111 transport-cc\r\n"
+	"a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+	"a=rtpmap:103 ISAC/16000\r\n"
+	"a=rtpmap:104 ISAC/32000\r\n"
+	"a=rtpmap:9 G722/8000\r\n"
+	"a=rtpmap:0 PCMU/8000\r\n"
+	"a=rtpmap:8 PCMA/8000\r\n"
+	"a=rtpmap:106 CN/32000\r\n"
+	"a=rtpmap:105 CN/16000\r\n"
+	"a=rtpmap:13 CN/8000\r\n"
+	"a=rtpmap:110 telephone-event/48000\r\n"
+	"a=rtpmap:112 telephone-event/32000\r\n"
+	"a=rtpmap:113 telephone-event/16000\r\n"
+	"a=rtpmap:126 telephone-event/8000\r\n"
+	"a=ssrc:1001 cname:abcd\r\n"
+	"m=video 9 UDP/TLS/RTP/SAVPF 96 97 98 99 100 101 102 121 127 120 125 "
+	"107 108 109 124 119 123 118 114 115 116\r\n"
+	"c=IN IP4 0.0.0.0\r\n"
+	"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+	"a=ice-ufrag:ZZZZ\r\n"
+	"a=ice-pwd:AU/SQPupllyS0SDG/eRWDCfA\r\n"
+	"a=mid:1\r\n"
+	"a=sendonly\r\n"
+	"a=rtcp-mux\r\n"
+	"a=rtcp-rsize\r\n"
+	"a=rtpmap:96 VP8/90000\r\n"
+	"a=rtcp-fb:96 goog-remb\r\n"
+	"a=rtcp-fb:96 transport-cc\r\n"
+	"a=rtcp-fb:96 ccm fir\r\n"
+	"a=rtcp-fb:96 nack\r\n"
+	"a=rtcp-fb:96 nack pli\r\n"
+	"a=rtpmap:97 rtx/90000\r\n"
+	"a=fmtp:97 apt=96\r\n"
+	"a=rtpmap:98 VP9/90000\r\n"
+	"a=rtcp-fb:98 nack pli\r\n"
+	"a=fmtp:98 profile-id=0\r\n"
+	"a=rtpmap:99 rtx/90000\r\n"
+	"a=fmtp:99 apt=98\r\n"
+	"a=rtpmap:100 VP9/90000\r\n"
+	"a=rtcp-fb:100 nack pli\r\n"
+	"a=fmtp:100 profile-id=2\r\n"
+	"a=rtpmap:101 rtx/90000\r\n"
+	"a=fmtp:101 apt=100\r\n"
+	"a=rtpmap:102 H264/90000\r\n"
+	"a=rtcp-fb:102 goog-remb\r\n"
+	"a=rtcp-fb:102 nack pli\r\n"
+	"a=fmtp:102 level-asymmetry-allowed=1;packetization-mode=1;"
+	"profile-level-id=42001f\r\n"
+	"a=rtpmap:121 rtx/90000\r\n"
+	"a=fmtp:121 apt=102\r\n"
+	"a=rtpmap:127 H264/90000\r\n"
+	"a=rtcp-fb:127 nack pli\r\n"
+	"a=fmtp:127 level-asymmetry-allowed=1;packetization-mode=0;"
+	"profile-level-id=42001f\r\n"
+	"a=rtpmap:120 rtx/90000\r\n"
+	"a=fmtp:120 apt=127\r\n"
+	"a=rtpmap:125 H264/90000\r\n"
+	"a=rtcp-fb:125 goog-remb\r\n"
+	"a=rtcp-fb:125 nack pli\r\n"
+	"a=fmtp:125 level-asymmetry-allowed=1;packetization-mode=1;"
+	"profile-level-id=42e01f\r\n"
+	"a=rtpmap:107 rtx/90000\r\n"
+	"a=fmtp:107 apt=125\r\n"
+	"a=rtpmap:108 H264/90000\r\n"
+	"a=fmtp:108 level-asymmetry-allowed=1;packetization-mode=0;"
+	"profile-level-id=42e01f\r\n"
+	"a=rtpmap:109 rtx/90000\r\n"
+	"a=fmtp:109 apt=108\r\n"
+	"a=rtpmap:124 red/90000\r\n"
+	"a=rtpmap:119 rtx/90000\r\n"
+	"a=fmtp:119 apt=124\r\n"
+	"a=rtpmap:123 ulpfec/90000\r\n"
+	"a=rtpmap:118 H264/90000\r\n"
+	"a=fmtp:118 level-asymmetry-allowed=1;packetization-mode=1;"
+	"profile-level-id=64001f\r\n"
+	"a=rtpmap:114 rtx/90000\r\n"
+	"a=fmtp:114 apt=118\r\n"
+	"a=rtpmap:115 AV1X/90000\r\n"
+	"a=rtpmap:116 rtx/90000\r\n"
+	"a=fmtp:116 apt=115\r\n"
+	"a=ssrc-group:FID 2001 2002\r\n"
+	"a=ssrc:2001 cname:abcd\r\n"
+	"a=ssrc:2002 cname:abcd\r\n";
+
+/* libwebrtc offer created once gathering completed, with candidates */
+static const char offer_gathered[] =
+	"v=0\r\n"
+	"o=- 7382913051664123084 2 IN IP4 127.0.0.1\r\n"
+	"s=-\r\n"
+	"t=0 0\r\n"
+	"a=group:BUNDLE audio video\r\n"
+	"a=msid-semantic: WMS obs\r\n"
+	"m=audio 9 UDP/TLS/RTP/SAVPF 111 103 104 9 0 8 106 105 13 110 112 "
+	"113 126\r\n"
+	"c=IN IP4 0.0.0.0\r\n"
+	"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+	"a=candidate:1467250027 1 udp 2122260223 192.168.1.20 56143 typ host "
+	"generation 0 network-id 1\r\n"
+	"a=candidate:434248539 1 tcp 1518280447 192.168.1.20 9 typ host "
+	"tcptype active generation 0 network-id 1\r\n"
+	"a=candidate:842163049 1 udp 1686052607 203.0.113.7 56143 typ srflx "
+	"raddr 192.168.1.20 rport 56143 generation 0 network-id 1\r\n"
+	"a=ice-ufrag:h3Kp\r\n"
+	"a=ice-pwd:rJ8u2pX+fVhQk0yT3mNcLw7e\r\n"
+	"a=ice-options:trickle\r\n"
+	"a=fingerprint:sha-256 5C:0E:A1:97:3D:68:F2:14:B9:2A:E7:50:C3:8D:"
+	"16:7F:04:DB:92:3E:A5:61:FC:28:B0:4D:E9:73:1A:C6:85:3B\r\n"
+	"a=setup:actpass\r\n"
+	"a=mid:audio\r\n"
+	"a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\n"
+	"a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/"
+	"abs-send-time\r\n"
+	"a=extmap:3 http://www.ietf.org/id/"
+	"draft-holmer-rmcat-transport-wide-cc-extensions-01\r\n"
+	"a=sendonly\r\n"
+	"a=rtcp-mux\r\n"
+	"a=rtpmap:111 opus/48000/2\r\n"
+	"a=rtcp-fb:111 transport-cc\r\n"
+	"a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+	"a=rtpmap:103 ISAC/16000\r\n"
+	"a=rtpmap:104 ISAC/32000\r\n"
+	"a=rtpmap:9 G722/8000\r\n"
+	"a=rtpmap:0 PCMU/8000\r\n"
+	"a=rtpmap:8 PCMA/8000\r\n"
+	"a=rtpmap:106 CN/32000\r\n"
+	"a=rtpmap:105 CN/16000\r\n"
+	"a=rtpmap:13 CN/8000\r\n"
+	"a=rtpmap:110 telephone-event/48000\r\n"
+	"a=rtpmap:112 telephone-event/32000\r\n"
+	"a=rtpmap:113 telephone-event/16000\r\n"
+	"a=rtpmap:126 telephone-event/8000\r\n"
+	"a=ssrc:3570614608 cname:4TOk42mSjXCkVIa6\r\n"
+	"a=ssrc:3570614608 msid:obs audio\r\n"
+	"a=ssrc:3570614608 mslabel:obs\r\n"
+	"a=ssrc:3570614608 label:audio\r\n"
+	"m=video 9 UDP/TLS/RTP/SAVPF 96 97 98 99 100 101 102 122 127 121 125 "
+	"107 108 109 124 120 123\r\n"
+	"c=IN IP4 0.0.0.0\r\n"
+	"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+	"a=candidate:1467250027 1 udp 2122260223 192.168.1.20 56144 typ host "
+	"generation 0 network-id 1\r\n"
+	"a=candidate:434248539 1 tcp 1518280447 192.168.1.20 9 typ host "
+	"tcptype active generation 0 network-id 1\r\n"
+	"a=candidate:842163049 1 udp 1686052607 203.0.113.7 56144 typ srflx "
+	"raddr 192.168.1.20 rport 56144 generation 0 network-id 1\r\n"
+	"a=ice-ufrag:h3Kp\r\n"
+	"a=ice-pwd:rJ8u2pX+fVhQk0yT3mNcLw7e\r\n"
+	"a=ice-options:trickle\r\n"
+	"a=fingerprint:sha-256 5C:0E:A1:97:3D:68:F2:14:B9:2A:E7:50:C3:8D:"
+	"16:7F:04:DB:92:3E:A5:61:FC:28:B0:4D:E9:73:1A:C6:85:3B\r\n"
+	"a=setup:actpass\r\n"
+	"a=mid:video\r\n"
+	"a=extmap:14 urn:ietf:params:rtp-hdrext:toffset\r\n"
+	"a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/"
+	"abs-send-time\r\n"
+	"a=extmap:13 urn:3gpp:video-orientation\r\n"
+	"a=extmap:3 http://www.ietf.org/id/"
+	"draft-holmer-rmcat-transport-wide-cc-extensions-01\r\n"
+	"a=extmap:12 http://www.webrtc.org/experiments/rtp-hdrext/"
+	"playout-delay\r\n"
+	"a=sendonly\r\n"
+	"a=rtcp-mux\r\n"
+	"a=rtcp-rsize\r\n"
+	"a=rtpmap:96 VP8/90000\r\n"
+	"a=rtcp-fb:96 goog-remb\r\n"
+	"a=rtcp-fb:96 transport-cc\r\n"
+	"a=rtcp-fb:96 ccm fir\r\n"
+	"a=rtcp-fb:96 nack\r\n"
+	"a=rtcp-fb:96 nack pli\r\n"
+	"a=rtpmap:97 rtx/90000\r\n"
+	"a=fmtp:97 apt=96\r\n"
+	"a=rtpmap:98 VP9/90000\r\n"
+	"a=rtcp-fb:98 goog-remb\r\n"
+	"a=rtcp-fb:98 transport-cc\r\n"
+	"a=rtcp-fb:98 ccm fir\r\n"
+	"a=rtcp-fb:98 nack\r\n"
+	"a=rtcp-fb:98 nack pli\r\n"
+	"a=fmtp:98 profile-id=0\r\n"
+	"a=rtpmap:99 rtx/90000\r\n"
+	"a=fmtp:99 apt=98\r\n"
+	"a=rtpmap:100 VP9/90000\r\n"
+	"a=rtcp-fb:100 goog-remb\r\n"
+	"a=rtcp-fb:100 transport-cc\r\n"
+	"a=rtcp-fb:100 ccm fir\r\n"
+	"a=rtcp-fb:100 nack\r\n"
+	"a=rtcp-fb:100 nack pli\r\n"
+	"a=fmtp:100 profile-id=2\r\n"
+	"a=rtpmap:101 rtx/90000\r\n"
+	"a=fmtp:101 apt=100\r\n"
+	"a=rtpmap:102 H264/90000\r\n"
+	"a=rtcp-fb:102 goog-remb\r\n"
+	"a=rtcp-fb:102 transport-cc\r\n"
+	"a=rtcp-fb:102 ccm fir\r\n"
+	"a=rtcp-fb:102 nack\r\n"
+	"a=rtcp-fb:102 nack pli\r\n"
+	"a=fmtp:102 level-asymmetry-allowed=1;packetization-mode=1;"
+	"profile-level-id=42001f\r\n"
+	"a=rtpmap:122 rtx/90000\r\n"
+	"a=fmtp:122 apt=102\r\n"
+	"a=rtpmap:127 H264/90000\r\n"
+	"a=rtcp-fb:127 goog-remb\r\n"
+	"a=rtcp-fb:127 transport-cc\r\n"
+	"a=rtcp-fb:127 ccm fir\r\n"
+	"a=rtcp-fb:127 nack\r\n"
+	"a=rtcp-fb:127 nack pli\r\n"
+	"a=fmtp:127 level-asymmetry-allowed=1;packetization-mode=0;"
+	"profile-level-id=42001f\r\n"
+	"a=rtpmap:121 rtx/90000\r\n"
+	"a=fmtp:121 apt=127\r\n"
+	"a=rtpmap:125 H264/90000\r\n"
+	"a=rtcp-fb:125 goog-remb\r\n"
+	"a=rtcp-fb:125 transport-cc\r\n"
+	"a=rtcp-fb:125 ccm fir\r\n"
+	"a=rtcp-fb:125 nack\r\n"
+	"a=rtcp-fb:125 nack pli\r\n"
+	"a=fmtp:125 level-asymmetry-allowed=1;packetization-mode=1;"
+	"profile-level-id=42e01f\r\n"
+	"a=rtpmap:107 rtx/90000\r\n"
+	"a=fmtp:107 apt=125\r\n"
+	"a=rtpmap:108 H264/90000\r\n"
+	"a=rtcp-fb:108 goog-remb\r\n"
+	"a=rtcp-fb:108 transport-cc\r\n"
+	"a=rtcp-fb:108 ccm fir\r\n"
+	"a=rtcp-fb:108 nack\r\n"
+	"a=rtcp-fb:108 nack pli\r\n"
+	"a=fmtp:108 level-asymmetry-allowed=1;packetization-mode=0;"
+	"profile-level-id=42e01f\r\n"
+	"a=rtpmap:109 rtx/90000\r\n"
+	"a=fmtp:109 apt=108\r\n"
+	"a=rtpmap:124 red/90000\r\n"
+	"a=rtpmap:120 rtx/90000\r\n"
+	"a=fmtp:120 apt=124\r\n"
+	"a=rtpmap:123 ulpfec/90000\r\n"
+	"a=ssrc-group:FID 1832440921 3197063402\r\n"
+	"a=ssrc:1832440921 cname:4TOk42mSjXCkVIa6\r\n"
+	"a=ssrc:1832440921 msid:obs video\r\n"
+	"a=ssrc:1832440921 mslabel:obs\r\n"
+	"a=ssrc:1832440921 label:video\r\n"
+	"a=ssrc:3197063402 cname:4TOk42mSjXCkVIa6\r\n"
+	"a=ssrc:3197063402 msid:obs video\r\n"
+	"a=ssrc:3197063402 mslabel:obs\r\n"
+	"a=ssrc:3197063402 label:video\r\n";
+
+/* media server answer to an h264 offer, ICE lite with UDP and TCP
+ * candidates */
+static const char answer[] =
+	"v=0\r\n"
+	"o=- 1601634537 1601634537 IN IP4 0.0.0.0\r\n"
+	"s=-\r\n"
+	"t=0 0\r\n"
+	"a=ice-lite\r\n"
+	"a=group:BUNDLE 0 1\r\n"
+	"a=msid-semantic: WMS *\r\n"
+	"m=audio 9 UDP/TLS/RTP/SAVPF 111\r\n"
+	"c=IN IP4 0.0.0.0\r\n"
+	"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+	"a=candidate:1 1 UDP 2130706431 198.51.100.10 10000 typ host\r\n"
+	"a=candidate:2 1 UDP 2130706175 2001:db8::10 10000 typ host\r\n"
+	"a=candidate:3 1 TCP 1694498815 198.51.100.10 443 typ host "
+	"tcptype passive\r\n"
+	"a=end-of-candidates\r\n"
+	"a=ice-ufrag:nU1p4kEz\r\n"
+	"a=ice-pwd:7d2c0b8e5f3a41f6a9b1c4e2d8f07a35\r\n"
+	"a=fingerprint:sha-256 A4:3C:19:E0:7B:52:D8:6F:21:9A:C5:04:FE:38:"
+	"B7:6D:92:1E:AF:50:C3:87:4B:E6:0D:F9:25:71:3A:C8:96:0B\r\n"
+	"a=setup:passive\r\n"
+	"a=mid:0\r\n"
+	"a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\n"
+	"a=recvonly\r\n"
+	"a=rtcp-mux\r\n"
+	"a=rtpmap:111 opus/48000/2\r\n"
+	"a=rtcp-fb:111 transport-cc\r\n"
+	"a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+	"m=video 9 UDP/TLS/RTP/SAVPF 125 107\r\n"
+	"c=IN IP4 0.0.0.0\r\n"
+	"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+	"a=candidate:1 1 UDP 2130706431 198.51.100.10 10000 typ host\r\n"
+	"a=candidate:2 1 UDP 2130706175 2001:db8::10 10000 typ host\r\n"
+	"a=candidate:3 1 TCP 1694498815 198.51.100.10 443 typ host "
+	"tcptype passive\r\n"
+	"a=end-of-candidates\r\n"
+	"a=ice-ufrag:nU1p4kEz\r\n"
+	"a=ice-pwd:7d2c0b8e5f3a41f6a9b1c4e2d8f07a35\r\n"
+	"a=fingerprint:sha-256 A4:3C:19:E0:7B:52:D8:6F:21:9A:C5:04:FE:38:"
+	"B7:6D:92:1E:AF:50:C3:87:4B:E6:0D:F9:25:71:3A:C8:96:0B\r\n"
+	"a=setup:passive\r\n"
+	"a=mid:1\r\n"
+	"a=extmap:3 http://www.ietf.org/id/"
+	"draft-holmer-rmcat-transport-wide-cc-extensions-01\r\n"
+	"a=recvonly\r\n"
+	"a=rtcp-mux\r\n"
+	"a=rtcp-rsize\r\n"
+	"a=rtpmap:125 H264/90000\r\n"
+	"a=rtcp-fb:125 goog-remb\r\n"
+	"a=rtcp-fb:125 transport-cc\r\n"
+	"a=rtcp-fb:125 nack\r\n"
+	"a=rtcp-fb:125 nack pli\r\n"
+	"a=fmtp:125 level-asymmetry-allowed=1;packetization-mode=1;"
+	"profile-level-id=42e01f\r\n"
+	"a=rtpmap:107 rtx/90000\r\n"
+	"a=fmtp:107 apt=125\r\n";
+
+struct video_codec {
+	const char *name;
+	int h264_packetization_mode;
+	const char *h264_profile_level_id;
+	int vp9_profile_id;
+};
+
+/* codec settings of WebRTCStream */
+static const video_codec video_codecs[] = {
+	{"h264", 1, "42e01f", 0},
+	{"vp8", 1, "42e01f", 0},
+	{"vp9", 1, "42e01f", 0},
+};
+
+static const char *protocols[] = {"udp", "TCP"};
+
+typedef std::function<std::string(const std::string &)> munge_t;
+
+struct setter {
+	std::string name;
+	munge_t regex;
+	munge_t model;
+};
+
+/* ------------------------------------------------------------------------- */
+
+static void appendPayloads(std::string &out, const char *media,
+			   const std::vector<int> &payloads)
+{
+	out += media;
+	for (int payload : payloads)
+		out += " " + std::to_string(payload);
+	out += "\n";
+}
+
+static std::vector<std::string> splitLines(const std::string &sdp)
+{
+	std::vector<std::string> lines;
+	std::istringstream in(sdp);
+	std::string line;
+
+	while (std::getline(in, line)) {
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (!line.empty())
+			lines.push_back(line);
+	}
+	return lines;
+}
+
+static bool startsWith(const std::string &line, const char *prefix)
+{
+	return line.compare(0, strlen(prefix), prefix) == 0;
+}
+
+/* lines the regex munging could remove along with a payload */
+static std::vector<std::string> getCollateral(const std::string &sdp)
+{
+	std::vector<std::string> lines = splitLines(sdp);
+	std::vector<std::string> payloads;
+	std::vector<std::string> collateral;
+
+	for (const auto &line : lines) {
+		if (!startsWith(line, "m="))
+			continue;
+
+		std::istringstream in(line);
+		std::string format;
+		for (int i = 0; in >> format; i++) {
+			if (i >= 3)
+				payloads.push_back(":" + format + " ");
+		}
+	}
+
+	for (const auto &line : lines) {
+		if (startsWith(line, "a=rtpmap:") ||
+		    startsWith(line, "a=fmtp:") ||
+		    startsWith(line, "a=rtcp-fb:") ||
+		    startsWith(line, "a=candidate:"))
+			continue;
+
+		for (const auto &payload : payloads) {
+			if (line.find(payload) != std::string::npos) {
+				collateral.push_back(line);
+				break;
+			}
+		}
+	}
+	return collateral;
+}
+
+static bool contains(const std::vector<std::string> &lines,
+		     const std::string &line)
+{
+	return std::find(lines.begin(), lines.end(), line) != lines.end();
+}
+
+/* leaves out the differences coming from the fixed bugs */
+static std::vector<std::string>
+normalize(const std::string &sdp, const std::vector<std::string> &collateral)
+{
+	std::vector<std::string> lines;
+
+	for (auto &line : splitLines(sdp)) {
+		if (contains(collateral, line))
+			continue;
+		if (startsWith(line, "a= fmtp:"))
+			line.erase(2, 1);
+		lines.push_back(line);
+	}
+	return lines;
+}
+
+/* ------------------------------------------------------------------------- */
+/* previous implementation                                                   */
+
+static void regexForce(std::string &sdp, const video_codec &codec,
+		       std::vector<int> &audio_payloads,
+		       std::vector<int> &video_payloads)
+{
+	RegexSDPModif::forcePayload(sdp, audio_payloads, video_payloads,
+				    "opus", codec.name,
+				    codec.h264_packetization_mode,
+				    codec.h264_profile_level_id,
+				    codec.vp9_profile_id);
+}
+
+/* the candidates were only checked one by one as they were received */
+static std::string regexFilter(const std::string &sdp,
+			       const std::string &protocol)
+{
+	std::string out;
+
+	for (const auto &line : splitLines(sdp)) {
+		if (startsWith(line, "a=candidate:") &&
+		    !RegexSDPModif::filterIceCandidates(line.substr(2),
+							protocol))
+			continue;
+		out += line + "\r\n";
+	}
+	return out;
+}
+
+static std::string regexOffer(const std::string &sdp)
+{
+	std::vector<int> audio_payloads;
+	std::vector<int> video_payloads;
+	std::string out = sdp;
+
+	regexForce(out, video_codecs[0], audio_payloads, video_payloads);
+	RegexSDPModif::bitrateMaxMinSDP(out, VIDEO_KBPS, video_payloads);
+	RegexSDPModif::stereoSDP(out, AUDIO_KBPS);
+	return out;
+}
+
+static std::string regexAnswer(const std::string &sdp)
+{
+	std::string out = sdp;
+
+	RegexSDPModif::bitrateSDP(out, VIDEO_KBPS);
+	RegexSDPModif::stereoSDP(out, AUDIO_KBPS);
+	return regexFilter(out, protocols[0]);
+}
+
+/* ------------------------------------------------------------------------- */
+/* SDPModif                                                                  */
+
+static void modelForce(SDPModif &modif, const video_codec &codec,
+		       std::vector<int> &audio_payloads,
+		       std::vector<int> &video_payloads)
+{
+	modif.forcePayload(audio_payloads, video_payloads, "opus", codec.name,
+			   codec.h264_packetization_mode,
+			   codec.h264_profile_level_id, codec.vp9_profile_id);
+}
+
+static std::string modelOffer(const std::string &sdp)
+{
+	std::vector<int> audio_payloads;
+	std::vector<int> video_payloads;
+	SDPModif modif(sdp);
+
+	modelForce(modif, video_codecs[0], audio_payloads, video_payloads);
+	modif.bitrateMaxMin(VIDEO_KBPS, video_payloads);
+	modif.stereo(AUDIO_KBPS);
+	return modif.toString();
+}
+
+static std::string modelAnswer(const std::string &sdp)
+{
+	SDPModif modif(sdp);
+
+	modif.bitrate(VIDEO_KBPS);
+	modif.stereo(AUDIO_KBPS);
+	modif.filterCandidates(protocols[0]);
+	return modif.toString();
+}
+
+/* ------------------------------------------------------------------------- */
+
+static std::vector<setter> getSetters(const std::string &sdp)
+{
+	std::vector<setter> setters;
+
+	/* the retained payloads are compared too */
+	for (const auto &codec : video_codecs) {
+		setters.push_back(
+			{std::string("forcePayload ") + codec.name,
+			 [&codec](const std::string &in) {
+				 std::vector<int> audio, video;
+				 std::string out = in;
+				 regexForce(out, codec, audio, video);
+				 appendPayloads(out, "audio", audio);
+				 appendPayloads(out, "video", video);
+				 return out;
+			 },
+			 [&codec](const std::string &in) {
+				 std::vector<int> audio, video;
+				 SDPModif modif(in);
+				 modelForce(modif, codec, audio, video);
+				 std::string out = modif.toString();
+				 appendPayloads(out, "audio", audio);
+				 appendPayloads(out, "video", video);
+				 return out;
+			 }});
+	}
+
+	/* constrains the payloads forcePayload keeps */
+	for (const auto &codec : video_codecs) {
+		std::vector<int> audio, payloads;
+		SDPModif modif(sdp);
+		modelForce(modif, codec, audio, payloads);
+
+		setters.push_back({std::string("bitrateMaxMin ") + codec.name,
+				   [payloads](const std::string &in) {
+					   std::string out = in;
+					   RegexSDPModif::bitrateMaxMinSDP(
+						   out, VIDEO_KBPS, payloads);
+					   return out;
+				   },
+				   [payloads](const std::string &in) {
+					   SDPModif modif(in);
+					   modif.bitrateMaxMin(VIDEO_KBPS,
+							       payloads);
+					   return modif.toString();
+				   }});
+	}
+
+	setters.push_back({"bitrate",
+			   [](const std::string &in) {
+				   std::string out = in;
+				   RegexSDPModif::bitrateSDP(out, VIDEO_KBPS);
+				   return out;
+			   },
+			   [](const std::string &in) {
+				   SDPModif modif(in);
+				   modif.bitrate(VIDEO_KBPS);
+				   return modif.toString();
+			   }});
+
+	for (int kbps : {0, AUDIO_KBPS}) {
+		setters.push_back({"stereo " + std::to_string(kbps),
+				   [kbps](const std::string &in) {
+					   std::string out = in;
+					   RegexSDPModif::stereoSDP(out, kbps);
+					   return out;
+				   },
+				   [kbps](const std::string &in) {
+					   SDPModif modif(in);
+					   modif.stereo(kbps);
+					   return modif.toString();
+				   }});
+	}
+
+	for (const char *protocol : protocols) {
+		setters.push_back({std::string("filterCandidates ") + protocol,
+				   [protocol](const std::string &in) {
+					   return regexFilter(in, protocol);
+				   },
+				   [protocol](const std::string &in) {
+					   SDPModif modif(in);
+					   modif.filterCandidates(protocol);
+					   return modif.toString();
+				   }});
+	}
+
+	setters.push_back({"offer", regexOffer, modelOffer});
+	setters.push_back({"answer", regexAnswer, modelAnswer});
+	return setters;
+}
+
+static uint64_t timeMunge(const munge_t &munge, const std::string &sdp)
+{
+	uint64_t start = os_gettime_ns();
+
+	for (int i = 0; i < ITERATIONS; i++)
+		munge(sdp);
+
+	return (os_gettime_ns() - start) / ITERATIONS;
+}
+
+static bool compare(const setter &s, const std::string &sdp)
+{
+	std::string regex_out = s.regex(sdp);
+	std::string model_out = s.model(sdp);
+	std::vector<std::string> collateral = getCollateral(sdp);
+	std::vector<std::string> regex_lines = normalize(regex_out, collateral);
+	std::vector<std::string> model_lines = normalize(model_out, collateral);
+	std::vector<std::string> model_all = splitLines(model_out);
+	bool match = true;
+
+	for (const auto &line : collateral) {
+		if (!contains(model_all, line)) {
+			fprintf(stderr, "%s: removed '%s'\n", s.name.c_str(),
+				line.c_str());
+			match = false;
+		}
+	}
+
+	for (size_t i = 0; i < regex_lines.size() || i < model_lines.size();
+	     i++) {
+		const char *regex_line =
+			i < regex_lines.size() ? regex_lines[i].c_str() : "";
+		const char *model_line =
+			i < model_lines.size() ? model_lines[i].c_str() : "";
+
+		if (strcmp(regex_line, model_line) != 0) {
+			fprintf(stderr,
+				"%s: line %zu differs\n"
+				"  regex: %s\n"
+				"  model: %s\n",
+				s.name.c_str(), i + 1, regex_line, model_line);
+			return false;
+		}
+	}
+	return match;
+}
+
+/* remote candidates received one at a time, without the "a=" */
+static bool compareCandidates(const std::string &sdp)
+{
+	bool match = true;
+
+	for (const auto &line : splitLines(sdp)) {
+		if (!startsWith(line, "a=candidate:"))
+			continue;
+
+		std::string candidate = line.substr(2);
+		for (const char *protocol : protocols) {
+			bool regex = RegexSDPModif::filterIceCandidates(
+				candidate, protocol);
+			bool model = SDPModif::filterIceCandidate(candidate,
+								  protocol);
+
+			if (regex != model) {
+				fprintf(stderr,
+					"filterIceCandidate %s: %s differs\n",
+					protocol, candidate.c_str());
+				match = false;
+			}
+		}
+	}
+	return match;
+}
+
+static bool run(const char *name, const std::string &sdp)
+{
+	bool match = compareCandidates(sdp);
+
+	printf("%s: %zu lines\n", name, splitLines(sdp).size());
+	printf("%-22s %12s %12s %10s\n", "setter", "regex us", "model us",
+	       "speedup");
+
+	for (const auto &s : getSetters(sdp)) {
+		uint64_t regex_ns = timeMunge(s.regex, sdp);
+		uint64_t model_ns = timeMunge(s.model, sdp);
+
+		printf("%-22s %12.1f %12.1f %9.1fx\n", s.name.c_str(),
+		       (double)regex_ns / 1000.0, (double)model_ns / 1000.0,
+		       (double)regex_ns / (double)model_ns);
+
+		match = compare(s, sdp) && match;
+	}
+
+	printf("\n");
+	return match;
+}
+
+static bool loadSDP(const char *path, std::string &sdp)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	std::string text((std::istreambuf_iterator<char>(file)),
+			 std::istreambuf_iterator<char>());
+
+	for (const auto &line : splitLines(text))
+		sdp += line + "\r\n";
+	return !sdp.empty();
+}
+
+int main(int argc, char *argv[])
+{
+	bool match = true;
+
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++) {
+			std::string sdp;
+
+			if (!loadSDP(argv[i], sdp)) {
+				fprintf(stderr, "Failed to load '%s'\n",
+					argv[i]);
+				return 1;
+			}
+
+			match = run(argv[i], sdp) && match;
+		}
+	} else {
+		match = run("offer (trickle)", offer_trickle) && match;
+		match = run("offer (gathered)", offer_gathered) && match;
+		match = run("answer", answer) && match;
+	}
+
+	if (!match) {
+		fprintf(stderr, "SDPModif and the regex munging gave "
+				"different results\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,125 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <media-io/audio-kernels.h>
+
+/* not a multiple of the vector size, to cover the scalar tails */
+#define COUNT 37
+
+static void fill(float *data, float scale)
+{
+	for (size_t i = 0; i < COUNT; i++)
+		data[i] = ((float)i - COUNT / 2) * scale;
+}
+
+static void mix_test(void **state)
+{
+	float dst[COUNT], src[COUNT], gain[COUNT];
+
+	fill(dst, 0.1f);
+	fill(src, 0.2f);
+	fill(gain, 0.01f);
+
+	audio_mix_add(dst, src, COUNT);
+	for (size_t i = 0; i < COUNT; i++)
+		assert_true(dst[i] == ((float)i - COUNT / 2) * 0.1f +
+					     ((float)i - COUNT / 2) * 0.2f);
+
+	fill(dst, 0.1f);
+	audio_mix_add_gain(dst, src, gain, COUNT);
+	for (size_t i = 0; i < COUNT; i++)
+		assert_true(dst[i] == ((float)i - COUNT / 2) * 0.1f +
+					     src[i] * gain[i]);
+
+	fill(dst, 0.0f);
+	audio_mix_add_ramp(dst, src, 0.5f, 0.01f, COUNT);
+	for (size_t i = 0; i < COUNT; i++) {
+		float expected = src[i] * (0.5f + 0.01f * (float)i);
+		assert_true(dst[i] - expected < 0.0001f &&
+			    expected - dst[i] < 0.0001f);
+	}
+
+	(void)state;
+}
+
+static void volume_test(void **state)
+{
+	float data[COUNT], vol[COUNT];
+
+	fill(data, 0.1f);
+	audio_mul(data, 0.5f, COUNT);
+	for (size_t i = 0; i < COUNT; i++)
+		assert_true(data[i] == ((float)i - COUNT / 2) * 0.1f * 0.5f);
+
+	fill(data, 0.1f);
+	fill(vol, 0.3f);
+	audio_mul_buf(data, vol, COUNT);
+	for (size_t i = 0; i < COUNT; i++)
+		assert_true(data[i] == ((float)i - COUNT / 2) * 0.1f * vol[i]);
+
+	(void)state;
+}
+
+static void clamp_test(void **state)
+{
+	float data[COUNT];
+	int16_t s16[COUNT];
+
+	fill(data, 0.1f);
+	audio_float_to_s16(s16, data, COUNT);
+	audio_clamp(data, COUNT);
+
+	assert_true(data[0] == -1.0f);
+	assert_true(data[COUNT / 2] == 0.0f);
+	assert_true(data[COUNT - 1] == 1.0f);
+	assert_true(data[COUNT / 2 + 5] == 5 * 0.1f);
+
+	assert_int_equal(s16[0], -32767);
+	assert_int_equal(s16[COUNT / 2], 0);
+	assert_int_equal(s16[COUNT - 1], 32767);
+	assert_int_equal(s16[COUNT / 2 + 5], (int16_t)(5 * 0.1f * 32767.0f));
+
+	(void)state;
+}
+
+static void interleave_test(void **state)
+{
+	float planes[3][COUNT];
+	float packed[3 * COUNT];
+	float out[3][COUNT];
+
+	for (size_t channels = 1; channels <= 3; channels++) {
+		const float *src[3] = {planes[0], planes[1], planes[2]};
+		float *dst[3] = {out[0], out[1], out[2]};
+
+		for (size_t ch = 0; ch < channels; ch++)
+			fill(planes[ch], (float)(ch + 1));
+
+		audio_interleave(packed, src, channels, COUNT);
+		for (size_t i = 0; i < COUNT; i++)
+			for (size_t ch = 0; ch < channels; ch++)
+				assert_true(packed[i * channels + ch] ==
+					    planes[ch][i]);
+
+		audio_deinterleave(dst, packed, channels, COUNT);
+		for (size_t ch = 0; ch < channels; ch++)
+			assert_memory_equal(out[ch], planes[ch],
+					    sizeof(planes[ch]));
+	}
+
+	(void)state;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(mix_test),
+		cmocka_unit_test(volume_test),
+		cmocka_unit_test(clamp_test),
+		cmocka_unit_test(interleave_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,179 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/dstr.h>
+
+/* changes are reported a short while after the last one of a burst */
+#define TIMEOUT_MS 2000
+#define SETTLE_MS 300
+
+struct watch_test {
+	char dir[64];
+	struct dstr path;
+	volatile long calls;
+	volatile long running;
+	unsigned int sleep_ms;
+};
+
+static void changed(void *param)
+{
+	struct watch_test *test = param;
+
+	os_atomic_set_long(&test->running, 1);
+	if (test->sleep_ms)
+		os_sleep_ms(test->sleep_ms);
+	os_atomic_inc_long(&test->calls);
+	os_atomic_set_long(&test->running, 0);
+}
+
+static void write_file(const char *path, const char *text)
+{
+	FILE *file = fopen(path, "w");
+
+	assert_non_null(file);
+	fputs(text, file);
+	fclose(file);
+}
+
+static bool wait_calls(struct watch_test *test, long calls)
+{
+	for (int i = 0; i < TIMEOUT_MS / 10; i++) {
+		if (os_atomic_load_long(&test->calls) >= calls)
+			return true;
+		os_sleep_ms(10);
+	}
+
+	return false;
+}
+
+static int setup(void **state)
+{
+	struct watch_test *test = bzalloc(sizeof(*test));
+
+	strcpy(test->dir, "/tmp/obs-file-watch-XXXXXX");
+	if (!mkdtemp(test->dir)) {
+		bfree(test);
+		return -1;
+	}
+
+	dstr_printf(&test->path, "%s/watched.txt", test->dir);
+	write_file(test->path.array, "initial");
+
+	*state = test;
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	struct watch_test *test = *state;
+	struct dstr cmd = {0};
+
+	dstr_printf(&cmd, "rm -rf '%s'", test->dir);
+	if (system(cmd.array) != 0)
+		return -1;
+
+	dstr_free(&cmd);
+	dstr_free(&test->path);
+	bfree(test);
+	return 0;
+}
+
+static os_file_watch_t *create_watch(struct watch_test *test)
+{
+	os_file_watch_t *watch =
+		os_file_watch_create(test->path.array, changed, test);
+
+	if (!watch)
+		skip();
+	return watch;
+}
+
+static void modify_test(void **state)
+{
+	struct watch_test *test = *state;
+	os_file_watch_t *watch = create_watch(test);
+
+	/* a burst of writes is reported once */
+	for (int i = 0; i < 5; i++)
+		write_file(test->path.array, "modified");
+
+	assert_true(wait_calls(test, 1));
+	os_sleep_ms(SETTLE_MS);
+	assert_int_equal(os_atomic_load_long(&test->calls), 1);
+
+	os_file_watch_destroy(watch);
+}
+
+static void rename_replace_test(void **state)
+{
+	struct watch_test *test = *state;
+	os_file_watch_t *watch = create_watch(test);
+	struct dstr tmp = {0};
+
+	/* other files of the directory are not reported */
+	dstr_printf(&tmp, "%s/watched.txt.tmp", test->dir);
+	write_file(tmp.array, "replaced");
+	os_sleep_ms(SETTLE_MS);
+	assert_int_equal(os_atomic_load_long(&test->calls), 0);
+
+	/* saved to a temporary file and renamed over the watched one */
+	assert_int_equal(rename(tmp.array, test->path.array), 0);
+	assert_true(wait_calls(test, 1));
+
+	/* the file is still watched after being replaced */
+	write_file(test->path.array, "modified");
+	assert_true(wait_calls(test, 2));
+
+	os_file_watch_destroy(watch);
+	dstr_free(&tmp);
+}
+
+static void destroy_pending_test(void **state)
+{
+	struct watch_test *test = *state;
+	os_file_watch_t *watch = create_watch(test);
+
+	/* destroyed before the change is reported */
+	write_file(test->path.array, "modified");
+	os_file_watch_destroy(watch);
+
+	os_sleep_ms(SETTLE_MS);
+	assert_int_equal(os_atomic_load_long(&test->calls), 0);
+
+	/* destroyed while the callback runs, which it waits for */
+	test->sleep_ms = SETTLE_MS;
+	watch = create_watch(test);
+	write_file(test->path.array, "modified again");
+
+	for (int i = 0; i < TIMEOUT_MS / 10; i++) {
+		if (os_atomic_load_long(&test->running))
+			break;
+		os_sleep_ms(10);
+	}
+
+	assert_int_equal(os_atomic_load_long(&test->running), 1);
+	os_file_watch_destroy(watch);
+	assert_int_equal(os_atomic_load_long(&test->calls), 1);
+	assert_int_equal(os_atomic_load_long(&test->running), 0);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup_teardown(modify_test, setup, teardown),
+		cmocka_unit_test_setup_teardown(rename_replace_test, setup,
+						teardown),
+		cmocka_unit_test_setup_teardown(destroy_pending_test, setup,
+						teardown),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}